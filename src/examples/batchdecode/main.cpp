@@ -0,0 +1,119 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Program entry point
+
+	Runs the filter graph from a saved session over any number of CSV/BIN captures, in parallel.
+
+	Usage: batchdecode [--jobs N] [--out dir] [--captures dir] foo.scopesession capture1.csv [capture2.csv ...]
+
+	The first scope in the session is used for importing each capture, so the capture files should have the same
+	channels as whatever the session was set up with.
+ */
+
+#include "../scopehal/scopehal.h"
+#include "../scopeprotocols/scopeprotocols.h"
+#include "../../ngscopeclient/BatchProcessor.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	BatchOptions options;
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		if(s == "--help")
+		{
+			fprintf(stderr,
+				"Usage: batchdecode [--jobs N] [--out dir] [--captures dir] session.scopesession [capture ...]\n");
+			return 0;
+		}
+		else if( (s == "--jobs") && (i+1 < argc) )
+		{
+			if(!options.ParseJobs(argv[++i]))
+			{
+				fprintf(stderr, "Invalid job count \"%s\" (expected 0 to use all CPUs, or a thread count)\n", argv[i]);
+				return 1;
+			}
+		}
+		else if( (s == "--out") && (i+1 < argc) )
+			options.m_outputDir = argv[++i];
+		else if( (s == "--captures") && (i+1 < argc) )
+			options.m_captureDir = argv[++i];
+		else if(s[0] == '-')
+		{
+			fprintf(stderr, "Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+		else if(options.m_sessionPath.empty())
+			options.m_sessionPath = s;
+		else
+			options.m_captureFiles.push_back(s);
+	}
+
+	if(options.m_sessionPath.empty() || !options.IsCaptureMode())
+	{
+		fprintf(stderr, "A session file and at least one capture are required, use --help\n");
+		return 1;
+	}
+
+	//Set up logging
+	g_log_sinks.emplace(g_log_sinks.begin(), new ColoredSTDLogSink(console_verbosity));
+
+	//Initialize object creation tables
+	if(!VulkanInit(true))
+		return 1;
+	TransportStaticInit();
+	DriverStaticInit();
+	ScopeProtocolStaticInit();
+	InitializePlugins();
+
+	//Do the actual work
+	bool ok;
+	{
+		BatchProcessor proc(options);
+		ok = proc.Run();
+	}
+
+	ScopehalStaticCleanup();
+	return ok ? 0 : 1;
+}
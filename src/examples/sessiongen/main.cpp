@@ -0,0 +1,571 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Generates large synthetic .scopesession files for load testing session save/load and history
+
+	The output is an offline session (using "demo" scopes with null transports) written in the same on-disk layout
+	as Session::SerializeWaveforms(), so it can be opened directly by ngscopeclient.
+ */
+
+#include "../scopehal/scopehal.h"
+#include "../scopehal/MockOscilloscope.h"
+#include "../scopeprotocols/scopeprotocols.h"
+#include "../../ngscopeclient/WaveformFileIO.h"
+
+#include <fstream>
+#include <random>
+#include <cerrno>
+#include <cctype>
+
+using namespace std;
+
+/**
+	@brief Configuration for the session being generated
+ */
+class GeneratorConfig
+{
+public:
+	GeneratorConfig()
+	: m_numScopes(1)
+	, m_numChannels(4)
+	, m_historyDepth(10)
+	, m_sampleDepth(1000000)
+	, m_sparseFraction(0)
+	, m_seed(0)
+	{}
+
+	///@brief Number of oscilloscopes in the session
+	size_t m_numScopes;
+
+	///@brief Number of analog channels per oscilloscope
+	size_t m_numChannels;
+
+	///@brief Number of history points to generate
+	size_t m_historyDepth;
+
+	///@brief Number of samples in each waveform
+	size_t m_sampleDepth;
+
+	///@brief Fraction of channels (0 to 1) which store sparse rather than uniform waveforms
+	double m_sparseFraction;
+
+	///@brief Seed for the random number generator
+	uint32_t m_seed;
+
+	///@brief Names of protocol filters to create (each is connected to a channel of the first scope)
+	vector<string> m_filters;
+};
+
+///@brief Colors for generated channels and filters
+static const char* g_channelColors[] = { "#ffff00", "#ff6abc", "#00ffff", "#00c100" };
+
+static void ShowUsage();
+static bool ParseCount(const char* str, size_t& value);
+static bool ParseFraction(const char* str, double& value);
+static bool MakeDirectory(const string& path);
+static bool IsSparseChannel(const GeneratorConfig& config, size_t nchan);
+static WaveformBase* GenerateWaveform(const GeneratorConfig& config, bool sparse, minstd_rand& rng, TimePoint time);
+static bool WriteWaveforms(
+	const GeneratorConfig& config,
+	const string& dataDir,
+	const vector<shared_ptr<MockOscilloscope>>& scopes,
+	IDTable& idtable);
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	GeneratorConfig config;
+	string sessionPath;
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+
+		//Everything else takes an argument
+		if(i+1 >= argc)
+		{
+			fprintf(stderr, "Missing value for command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+
+		bool valid = true;
+		if(s == "--out")
+			sessionPath = argv[++i];
+		else if(s == "--scopes")
+			valid = ParseCount(argv[++i], config.m_numScopes);
+		else if(s == "--channels")
+			valid = ParseCount(argv[++i], config.m_numChannels);
+		else if(s == "--history")
+			valid = ParseCount(argv[++i], config.m_historyDepth);
+		else if(s == "--depth")
+			valid = ParseCount(argv[++i], config.m_sampleDepth);
+		else if(s == "--sparse")
+			valid = ParseFraction(argv[++i], config.m_sparseFraction);
+		else if(s == "--filter")
+			config.m_filters.push_back(argv[++i]);
+		else if(s == "--seed")
+		{
+			size_t seed;
+			valid = ParseCount(argv[++i], seed) && (seed <= UINT32_MAX);
+			if(valid)
+				config.m_seed = seed;
+		}
+		else
+		{
+			fprintf(stderr, "Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+
+		if(!valid)
+		{
+			fprintf(stderr, "Invalid value \"%s\" for command-line argument \"%s\"\n\n", argv[i], s.c_str());
+			ShowUsage();
+			return 1;
+		}
+	}
+
+	//Set up logging
+	g_log_sinks.emplace(g_log_sinks.begin(), new ColoredSTDLogSink(console_verbosity));
+
+	if(sessionPath.empty())
+	{
+		ShowUsage();
+		return 1;
+	}
+	if( (config.m_numScopes == 0) || (config.m_numChannels == 0) || (config.m_sampleDepth < 2) )
+	{
+		LogError("Need at least one scope, one channel, and two samples per waveform\n");
+		return 1;
+	}
+
+	//Initialize object creation tables
+	TransportStaticInit();
+	DriverStaticInit();
+	ScopeProtocolStaticInit();
+	InitializePlugins();
+
+	//Figure out file names the same way MainWindow::DoSaveFile() does
+	if(sessionPath.find(".scopesession") == string::npos)
+		sessionPath += ".scopesession";
+	string base = sessionPath.substr(0, sessionPath.length() - strlen(".scopesession"));
+	string dataDir = base + "_data";
+
+	LogNotice("Generating %s: %zu scopes x %zu channels, %zu history points of %s each (%.0f%% sparse)\n",
+		sessionPath.c_str(),
+		config.m_numScopes,
+		config.m_numChannels,
+		config.m_historyDepth,
+		Unit(Unit::UNIT_SAMPLEDEPTH).PrettyPrint(config.m_sampleDepth).c_str(),
+		config.m_sparseFraction * 100);
+
+	//Create the instruments.
+	//Use the demo driver so the session is recognized as containing oscilloscopes when loaded
+	IDTable idtable;
+	vector<shared_ptr<MockOscilloscope>> scopes;
+	for(size_t i=0; i<config.m_numScopes; i++)
+	{
+		auto scope = make_shared<MockOscilloscope>(
+			string("Synthetic ") + to_string(i), "ngscopeclient", to_string(10000 + i), "null", "demo", "");
+		scope->m_nickname = string("synth") + to_string(i);
+		for(size_t j=0; j<config.m_numChannels; j++)
+		{
+			scope->AddChannel(new OscilloscopeChannel(
+				scope.get(),
+				string("CH") + to_string(j+1),
+				g_channelColors[j % 4],
+				Unit(Unit::UNIT_FS),
+				Unit(Unit::UNIT_VOLTS)));
+		}
+		scopes.push_back(scope);
+	}
+
+	//Create filters, spreading inputs across channels of the first scope
+	for(size_t i=0; i<config.m_filters.size(); i++)
+	{
+		auto f = Filter::CreateFilter(config.m_filters[i], g_channelColors[i % 4]);
+		if(!f)
+		{
+			LogError("Unknown filter \"%s\"\n", config.m_filters[i].c_str());
+			return 1;
+		}
+		f->AddRef();
+
+		auto chan = scopes[0]->GetOscilloscopeChannel(i % config.m_numChannels);
+		for(size_t j=0; j<f->GetInputCount(); j++)
+		{
+			StreamDescriptor stream(chan, 0);
+			if(f->ValidateChannel(j, stream))
+				f->SetInput(j, stream);
+		}
+	}
+
+	//Make the data directory
+	if(!MakeDirectory(dataDir))
+	{
+		LogError("Failed to create data directory %s\n", dataDir.c_str());
+		return 1;
+	}
+
+	//Serialize everything except waveform data (in the same order as MainWindow::SaveSessionToYaml)
+	YAML::Node node;
+	node["version"] = 2;
+
+	YAML::Node metadata;
+	metadata["appver"] = "sessiongen";
+	metadata["appdate"] = __DATE__ " " __TIME__;
+	node["metadata"] = metadata;
+
+	YAML::Node instruments;
+	YAML::Node groups;
+	for(auto scope : scopes)
+	{
+		auto iconfig = scope->SerializeConfiguration(idtable);
+		instruments["inst" + iconfig["id"].as<string>()] = iconfig;
+
+		//One trigger group per scope
+		YAML::Node gnode;
+		gnode["primary"] = idtable[(Instrument*)scope.get()];
+		gnode["secondaries"] = YAML::Node(YAML::NodeType::Map);
+		gnode["default"] = true;
+		groups[string("group") + to_string(groups.size())] = gnode;
+	}
+	node["instruments"] = instruments;
+	node["triggergroups"] = groups;
+
+	auto filters = Filter::GetAllInstances();
+	if(!filters.empty())
+	{
+		YAML::Node decodes;
+		for(auto f : filters)
+		{
+			auto fnode = f->SerializeConfiguration(idtable);
+			decodes["filter" + fnode["id"].as<string>()] = fnode;
+		}
+		node["decodes"] = decodes;
+	}
+
+	//Minimal UI configuration with no waveform views, so load time is dominated by waveform data
+	YAML::Node window;
+	window["width"] = 1920;
+	window["height"] = 1080;
+	window["fullscreen"] = false;
+	node["ui_config"]["window"] = window;
+
+	//Generate and write the waveforms
+	double start = GetTime();
+	if(!WriteWaveforms(config, dataDir, scopes, idtable))
+		return 1;
+	double dt = GetTime() - start;
+
+	ofstream outfs(sessionPath);
+	if(!outfs)
+	{
+		LogError("Failed to open %s for writing\n", sessionPath.c_str());
+		return 1;
+	}
+	outfs << node;
+	outfs.close();
+
+	LogNotice("Done in %.2f sec\n", dt);
+
+	//Clean up
+	for(auto f : Filter::GetAllInstances())
+		f->Release();
+	scopes.clear();
+	return 0;
+}
+
+/**
+	@brief Parses a non-negative integer argument, rejecting signs, trailing garbage, and out of range values
+ */
+static bool ParseCount(const char* str, size_t& value)
+{
+	if(!isdigit(static_cast<unsigned char>(str[0])))
+		return false;
+
+	errno = 0;
+	char* end = nullptr;
+	auto v = strtoull(str, &end, 10);
+	if( (errno != 0) || (*end != '\0') )
+		return false;
+
+	value = v;
+	return true;
+}
+
+/**
+	@brief Parses a number between 0 and 1
+ */
+static bool ParseFraction(const char* str, double& value)
+{
+	errno = 0;
+	char* end = nullptr;
+	double v = strtod(str, &end);
+	if( (errno != 0) || (end == str) || (*end != '\0') || !(v >= 0) || !(v <= 1) )
+		return false;
+
+	value = v;
+	return true;
+}
+
+static void ShowUsage()
+{
+	fprintf(stderr,
+		"Usage: sessiongen --out path.scopesession [options]\n"
+		"\n"
+		"    --scopes N      Number of oscilloscopes (default 1)\n"
+		"    --channels N    Analog channels per oscilloscope (default 4)\n"
+		"    --history N     Number of history points (default 10)\n"
+		"    --depth N       Samples per waveform (default 1000000)\n"
+		"    --sparse F      Fraction of channels stored as sparse waveforms, 0 to 1 (default 0)\n"
+		"    --filter NAME   Add a filter of the given type, fed from the first scope (may be repeated)\n"
+		"    --seed N        Random seed (default 0)\n");
+}
+
+static bool MakeDirectory(const string& path)
+{
+	#ifdef _WIN32
+		int ret = mkdir(path.c_str());
+	#else
+		int ret = mkdir(path.c_str(), 0755);
+	#endif
+	return (ret == 0) || (errno == EEXIST);
+}
+
+/**
+	@brief Decide whether a given channel index is sparse, spreading sparse channels evenly
+ */
+static bool IsSparseChannel(const GeneratorConfig& config, size_t nchan)
+{
+	size_t nsparse = round(config.m_sparseFraction * config.m_numChannels);
+	return (nchan * nsparse) % config.m_numChannels < nsparse;
+}
+
+/**
+	@brief Makes a waveform containing a noisy NRZ signal at 10 samples per bit, vaguely resembling a serial bus
+
+	Sparse waveforms have random gaps between samples, so they don't get converted back to uniform on load.
+ */
+static WaveformBase* GenerateWaveform(const GeneratorConfig& config, bool sparse, minstd_rand& rng, TimePoint time)
+{
+	auto noise = normal_distribution<float>(0, 0.05);
+	auto bit = uniform_int_distribution<int>(0, 1);
+	auto gap = uniform_int_distribution<int64_t>(1, 4);
+	size_t len = config.m_sampleDepth;
+
+	WaveformBase* wfm;
+	if(sparse)
+	{
+		auto swfm = new SparseAnalogWaveform;
+		swfm->Resize(len);
+		swfm->PrepareForCpuAccess();
+		int64_t off = 0;
+		float v = 0;
+		for(size_t i=0; i<len; i++)
+		{
+			if( (i % 10) == 0)
+				v = bit(rng) ? 1 : -1;
+			int64_t dur = gap(rng);
+			swfm->m_offsets[i] = off;
+			swfm->m_durations[i] = dur;
+			swfm->m_samples[i] = v + noise(rng);
+			off += dur;
+		}
+		swfm->MarkModifiedFromCpu();
+		wfm = swfm;
+	}
+	else
+	{
+		auto uwfm = new UniformAnalogWaveform;
+		uwfm->Resize(len);
+		uwfm->PrepareForCpuAccess();
+		float v = 0;
+		for(size_t i=0; i<len; i++)
+		{
+			if( (i % 10) == 0)
+				v = bit(rng) ? 1 : -1;
+			uwfm->m_samples[i] = v + noise(rng);
+		}
+		uwfm->MarkModifiedFromCpu();
+		wfm = uwfm;
+	}
+
+	wfm->m_timescale = 100000;		//10 Gsps
+	wfm->m_triggerPhase = 0;
+	wfm->m_startTimestamp = time.GetSec();
+	wfm->m_startFemtoseconds = time.GetFs();
+	return wfm;
+}
+
+/**
+	@brief Generates waveform data for every history point and writes it, plus metadata, to the data directory
+
+	History points are independent so they're generated in parallel. Each point has its own RNG seeded from the
+	global seed and the point index, so output is reproducible regardless of thread count.
+ */
+static bool WriteWaveforms(
+	const GeneratorConfig& config,
+	const string& dataDir,
+	const vector<shared_ptr<MockOscilloscope>>& scopes,
+	IDTable& idtable)
+{
+	//Create all directories up front
+	vector<string> scopeDirs;
+	for(auto scope : scopes)
+	{
+		string scopedir = dataDir + "/scope_" + to_string(idtable[(Instrument*)scope.get()]) + "_waveforms";
+		if(!MakeDirectory(scopedir))
+		{
+			LogError("Failed to create %s\n", scopedir.c_str());
+			return false;
+		}
+		for(size_t i=0; i<config.m_historyDepth; i++)
+		{
+			if(!MakeDirectory(scopedir + "/waveform_" + to_string(i)))
+			{
+				LogError("Failed to create waveform directory in %s\n", scopedir.c_str());
+				return false;
+			}
+		}
+		scopeDirs.push_back(scopedir);
+	}
+
+	//Timestamps one second apart, ending now
+	TimePoint tnow(time(nullptr), 0);
+
+	bool ok = true;
+	#pragma omp parallel for reduction(&& : ok)
+	for(size_t i=0; i<config.m_historyDepth; i++)
+	{
+		minstd_rand rng(config.m_seed * 1000003 + i);
+		TimePoint t(tnow.GetSec() - (config.m_historyDepth - i), 0);
+
+		for(size_t nscope=0; nscope<scopes.size(); nscope++)
+		{
+			string datdir = scopeDirs[nscope] + "/waveform_" + to_string(i);
+			for(size_t nchan=0; nchan<config.m_numChannels; nchan++)
+			{
+				bool sparse = IsSparseChannel(config, nchan);
+				auto wfm = GenerateWaveform(config, sparse, rng, t);
+
+				string datapath = datdir + "/channel_" + to_string(nchan) + ".bin";
+				bool written;
+				if(sparse)
+					written = SerializeSparseWaveform(dynamic_cast<SparseWaveformBase*>(wfm), datapath);
+				else
+					written = SerializeUniformWaveform(dynamic_cast<UniformWaveformBase*>(wfm), datapath);
+				if(!written)
+				{
+					LogError("Failed to write %s\n", datapath.c_str());
+					ok = false;
+				}
+
+				delete wfm;
+			}
+		}
+	}
+	if(!ok)
+		return false;
+
+	//Metadata for each scope, same structure as Session::SerializeWaveforms()
+	for(size_t nscope=0; nscope<scopes.size(); nscope++)
+	{
+		auto scope = scopes[nscope];
+
+		YAML::Node metadata;
+		for(size_t i=0; i<config.m_historyDepth; i++)
+		{
+			YAML::Node mnode;
+			mnode["timestamp"] = tnow.GetSec() - (config.m_historyDepth - i);
+			mnode["time_fsec"] = 0;
+			mnode["id"] = i;
+			mnode["pinned"] = false;
+			mnode["label"] = "";
+
+			for(size_t nchan=0; nchan<config.m_numChannels; nchan++)
+			{
+				bool sparse = IsSparseChannel(config, nchan);
+
+				YAML::Node chnode;
+				chnode["index"] = nchan;
+				chnode["stream"] = 0;
+				chnode["timescale"] = 100000;
+				chnode["trigphase"] = 0;
+				chnode["flags"] = 0;
+				if(sparse)
+				{
+					chnode["format"] = "sparsev1";
+					chnode["datatype"] = "analog";
+				}
+				else
+					chnode["format"] = "densev1";
+
+				mnode["channels"][string("ch") + to_string(nchan) + "s0"] = chnode;
+			}
+
+			metadata["waveforms"][string("wfm") + to_string(i)] = mnode;
+		}
+
+		string fname = dataDir + "/scope_" + to_string(idtable[(Instrument*)scope.get()]) + "_metadata.yml";
+		ofstream outfs(fname);
+		if(!outfs)
+		{
+			LogError("Failed to open %s for writing\n", fname.c_str());
+			return false;
+		}
+		outfs << metadata;
+		outfs.close();
+	}
+
+	//No persisted filter waveforms
+	if(!MakeDirectory(dataDir + "/filter_waveforms"))
+		return false;
+	ofstream outfs(dataDir + "/filter_metadata.yml");
+	if(!outfs)
+		return false;
+	outfs << YAML::Node();
+	outfs.close();
+
+	return true;
+}
@@ -0,0 +1,420 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of AcquisitionJournal
+ */
+#include "ngscopeclient.h"
+#include "AcquisitionJournal.h"
+#include "WaveformFileIO.h"
+#include "WaveformMetadata.h"
+#include "pthread_compat.h"
+
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static void MakeDirectory(const string& path);
+static void RemoveJournalDirectory(const string& path);
+static bool WriteFileAtomic(const string& path, const YAML::Node& node);
+
+//Minimum time between rewrites of the metadata index, in seconds
+static const double g_metadataInterval = 1;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Creates a new journal and starts the writer thread
+
+	@param sessionPath	Path to the .scopesession file. The data directory goes next to it, as for a normal save.
+	@param maxDepth				Maximum number of points to keep
+	@param waveformDataMutex	The session's waveform data mutex
+ */
+AcquisitionJournal::AcquisitionJournal(const string& sessionPath, size_t maxDepth, shared_mutex& waveformDataMutex)
+	: m_sessionPath(sessionPath)
+	, m_maxDepth(maxDepth)
+	, m_waveformDataMutex(waveformDataMutex)
+	, m_nextID(0)
+	, m_closing(false)
+	, m_metadataDirty(false)
+	, m_lastMetadataWrite(0)
+{
+	m_dataDir = sessionPath.substr(0, sessionPath.length() - strlen(".scopesession")) + "_data";
+	MakeDirectory(m_dataDir);
+
+	LogNotice("Journaling acquisitions to %s\n", m_sessionPath.c_str());
+
+	m_thread = thread(&AcquisitionJournal::WriterThread, this);
+}
+
+AcquisitionJournal::~AcquisitionJournal()
+{
+	Close(false);
+}
+
+/**
+	@brief Stops the writer thread
+
+	@param discard	True to delete the journal from disk once it's closed (e.g. because the session was closed
+					normally and there is nothing to recover). Otherwise everything still in the queue is written
+					out first.
+ */
+void AcquisitionJournal::Close(bool discard)
+{
+	if(m_thread.joinable())
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_closing = true;
+
+			//No point writing anything we're about to delete
+			if(discard)
+				m_pending.clear();
+		}
+		m_condition.notify_all();
+		m_thread.join();
+	}
+
+	if(discard && !m_sessionPath.empty())
+	{
+		LogTrace("Discarding journal %s\n", m_sessionPath.c_str());
+
+		for(auto& entry : m_written)
+		{
+			for(auto& it : entry.m_metadata)
+			{
+				RemoveJournalDirectory(
+					m_dataDir + "/scope_" + to_string(it.first) + "_waveforms/waveform_" + to_string(entry.m_id));
+			}
+		}
+		m_written.clear();
+
+		auto files = Glob(m_dataDir + "/*", false);
+		for(auto& f : files)
+			RemoveJournalDirectory(f);
+		RemoveJournalDirectory(m_dataDir);
+		remove(m_sessionPath.c_str());
+		m_sessionPath = "";
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Producer side
+
+/**
+	@brief Replaces the journal's .scopesession file
+
+	Must be called whenever the set of instruments changes, so recovered waveform data always has a scope to go to.
+ */
+void AcquisitionJournal::WriteHeader(const YAML::Node& node)
+{
+	if(!WriteFileAtomic(m_sessionPath, node))
+		LogError("Failed to write journal session file %s\n", m_sessionPath.c_str());
+}
+
+/**
+	@brief Queues a history point to be written by the background thread
+
+	Returns immediately; the entry holds a reference to the point so it stays valid even if it's purged from
+	history before it's written.
+
+	If the disk can't keep up, the queue is capped at the history depth by dropping the oldest un-pinned points
+	(they would have been rotated out as soon as they were written anyway).
+ */
+void AcquisitionJournal::Append(const JournalEntry& entry)
+{
+	size_t dropped = 0;
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		size_t depth = max(m_maxDepth.load(), (size_t)1);
+		while(m_pending.size() >= depth)
+		{
+			auto it = m_pending.begin();
+			while( (it != m_pending.end()) && (m_pinned.find(it->m_time) != m_pinned.end()) )
+				it ++;
+			if(it == m_pending.end())
+				break;
+			m_pending.erase(it);
+			dropped ++;
+		}
+
+		m_pending.push_back(entry);
+	}
+	m_condition.notify_one();
+
+	if(dropped)
+		LogWarning("Journal can't keep up with acquisitions, dropped %zu unwritten points\n", dropped);
+}
+
+/**
+	@brief Updates the set of points which are pinned in history
+
+	Pin state can change at any time after a point is queued, so rotation always uses the most recent set.
+
+	@param pinned	Timestamps of every pinned point
+ */
+void AcquisitionJournal::SetPinned(const set<TimePoint>& pinned)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_pinned = pinned;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writer thread
+
+void AcquisitionJournal::WriterThread()
+{
+	pthread_setname_np_compat("Journal");
+
+	while(true)
+	{
+		unique_lock<mutex> lock(m_mutex);
+		auto ready = [&]{ return m_closing || !m_pending.empty(); };
+
+		//If the index is out of date, only sleep until it's due to be rewritten
+		if(m_metadataDirty)
+		{
+			double wait = max(m_lastMetadataWrite + g_metadataInterval - GetTime(), 0.0);
+			m_condition.wait_for(lock, chrono::duration<double>(wait), ready);
+		}
+		else
+			m_condition.wait(lock, ready);
+
+		if(m_pending.empty())
+		{
+			bool closing = m_closing;
+			lock.unlock();
+
+			if(m_metadataDirty)
+				WriteMetadata();
+			if(closing)
+				break;
+			continue;
+		}
+
+		JournalEntry entry = m_pending.front();
+		m_pending.pop_front();
+		lock.unlock();
+
+		entry.m_id = m_nextID ++;
+		WritePoint(entry);
+
+		//Done with the waveforms, don't keep them alive any longer than history would
+		entry.m_point = nullptr;
+		m_written.push_back(entry);
+
+		Rotate();
+
+		//Rewriting the index is O(n) in the journal depth, so batch it up rather than doing it for every point
+		m_metadataDirty = true;
+		if(GetTime() - m_lastMetadataWrite >= g_metadataInterval)
+			WriteMetadata();
+	}
+}
+
+/**
+	@brief Writes the waveform data for one point, and generates its metadata
+ */
+void AcquisitionJournal::WritePoint(JournalEntry& entry)
+{
+	auto timestamp = entry.m_point->m_time;
+
+	for(auto& it : entry.m_point->m_history)
+	{
+		auto scope = it.first;
+		auto& hist = it.second;
+		int scopeID = entry.m_scopeIDs[scope.get()];
+
+		string scopedir = m_dataDir + "/scope_" + to_string(scopeID) + "_waveforms";
+		MakeDirectory(scopedir);
+		string datdir = scopedir + "/waveform_" + to_string(entry.m_id);
+		MakeDirectory(datdir);
+
+		//Same layout as Session::SerializeWaveforms()
+		YAML::Node mnode;
+		mnode["timestamp"] = timestamp.first;
+		mnode["time_fsec"] = timestamp.second;
+		mnode["id"] = entry.m_id;
+		mnode["pinned"] = false;
+		mnode["label"] = entry.m_label;
+
+		for(auto& jt : hist)
+		{
+			auto chan = dynamic_cast<OscilloscopeChannel*>(jt.first.m_channel);
+			auto data = jt.second;
+			if(!chan || !data)
+				continue;
+
+			size_t index = chan->GetIndex();
+			size_t stream = jt.first.m_stream;
+
+			//The current point's waveforms may still be in use by the filter graph, so lock them just long enough
+			//to get the samples into CPU memory. Don't hold up the filter graph or GUI for the disk write.
+			YAML::Node chnode;
+			chnode["index"] = index;
+			chnode["stream"] = stream;
+			{
+				shared_lock<shared_mutex> lock(m_waveformDataMutex);
+				data->PrepareForCpuAccess();
+				SerializeWaveformMetadata(data, chnode);
+			}
+			if(!SerializeWaveform(data, datdir + "/" + GetWaveformFileName(index, stream)))
+				LogError("Failed to write journal waveform data to %s\n", datdir.c_str());
+
+			mnode["channels"][string("ch") + to_string(index) + "s" + to_string(stream)] = chnode;
+		}
+
+		entry.m_metadata[scopeID] = mnode;
+	}
+}
+
+/**
+	@brief Deletes the oldest un-pinned points once the journal holds more than the history depth
+
+	Also brings the pin state in each point's metadata up to date.
+ */
+void AcquisitionJournal::Rotate()
+{
+	set<TimePoint> pinned;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		pinned = m_pinned;
+	}
+	for(auto& entry : m_written)
+	{
+		bool pin = (pinned.find(entry.m_time) != pinned.end());
+		for(auto& it : entry.m_metadata)
+			it.second["pinned"] = pin;
+	}
+
+	size_t depth = m_maxDepth;
+	while(m_written.size() > depth)
+	{
+		auto it = m_written.begin();
+		while( (it != m_written.end()) && (pinned.find(it->m_time) != pinned.end()) )
+			it ++;
+		if(it == m_written.end())
+			break;
+
+		for(auto& jt : it->m_metadata)
+		{
+			RemoveJournalDirectory(
+				m_dataDir + "/scope_" + to_string(jt.first) + "_waveforms/waveform_" + to_string(it->m_id));
+		}
+		m_written.erase(it);
+	}
+}
+
+/**
+	@brief Rewrites the metadata file for each scope to match what's on disk
+ */
+void AcquisitionJournal::WriteMetadata()
+{
+	m_metadataDirty = false;
+	m_lastMetadataWrite = GetTime();
+
+	map<int, YAML::Node> scopeNodes;
+	for(auto& entry : m_written)
+	{
+		for(auto& it : entry.m_metadata)
+			scopeNodes[it.first]["waveforms"][string("wfm") + to_string(entry.m_id)] = it.second;
+	}
+
+	for(auto& it : scopeNodes)
+	{
+		string fname = m_dataDir + "/scope_" + to_string(it.first) + "_metadata.yml";
+		if(!WriteFileAtomic(fname, it.second))
+			LogError("Failed to write journal metadata file %s\n", fname.c_str());
+		else
+			UpdateScopeMetadataSidecar(fname, it.second);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+static void MakeDirectory(const string& path)
+{
+	#ifdef _WIN32
+		mkdir(path.c_str());
+	#else
+		mkdir(path.c_str(), 0755);
+	#endif
+}
+
+/**
+	@brief Deletes a directory and any files inside it (not recursive), or a single file
+ */
+static void RemoveJournalDirectory(const string& path)
+{
+	auto files = Glob(path + "/*", false);
+	for(auto& f : files)
+		remove(f.c_str());
+
+	#ifdef _WIN32
+		_rmdir(path.c_str());
+	#else
+		rmdir(path.c_str());
+	#endif
+	remove(path.c_str());
+}
+
+/**
+	@brief Writes a YAML file to a temporary name then moves it into place, so a crash mid-write never leaves a
+	truncated file behind
+ */
+static bool WriteFileAtomic(const string& path, const YAML::Node& node)
+{
+	string tmp = path + ".tmp";
+	{
+		ofstream outfs(tmp);
+		if(!outfs)
+			return false;
+		outfs << node;
+		outfs.close();
+		if(!outfs)
+			return false;
+	}
+
+	#ifdef _WIN32
+		remove(path.c_str());
+	#endif
+	return (rename(tmp.c_str(), path.c_str()) == 0);
+}
@@ -0,0 +1,157 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of AcquisitionJournal
+ */
+#ifndef AcquisitionJournal_h
+#define AcquisitionJournal_h
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+/**
+	@brief A history point waiting to be written to the journal
+ */
+class JournalEntry
+{
+public:
+	JournalEntry(std::shared_ptr<HistoryPoint> point)
+	: m_point(point)
+	, m_time(point->m_time)
+	, m_label(point->m_nickname)
+	, m_id(0)
+	{}
+
+	///@brief The point being written (holding a reference keeps its waveforms alive until we're done)
+	std::shared_ptr<HistoryPoint> m_point;
+
+	///@brief Session IDs of the scopes in the point
+	std::map<Oscilloscope*, int> m_scopeIDs;
+
+	///@brief Timestamp of the point (kept after m_point is released, to look up its pin state)
+	TimePoint m_time;
+
+	///@brief Label at the time the point was queued
+	std::string m_label;
+
+	///@brief Index of the waveform_N directory the point is written to
+	size_t m_id;
+
+	///@brief Metadata for the point, indexed by scope ID (filled out once it's written)
+	std::map<int, YAML::Node> m_metadata;
+};
+
+/**
+	@brief Background log of every acquisition, for recovering a session after a crash
+
+	The journal is laid out exactly like a saved session: a .scopesession file next to a _data directory containing
+	waveform data in the normal per-waveform binary format. Recovering after a crash is just a matter of opening it.
+
+	Points are written by a background thread. Once the number of points in the journal exceeds the history depth
+	the oldest un-pinned ones are deleted, so the journal never holds much more than history does. The metadata index
+	is rewritten at most once a second, so after a crash the newest second or so of points may be missing from it.
+ */
+class AcquisitionJournal
+{
+public:
+	AcquisitionJournal(const std::string& sessionPath, size_t maxDepth, std::shared_mutex& waveformDataMutex);
+	~AcquisitionJournal();
+
+	void WriteHeader(const YAML::Node& node);
+	void Append(const JournalEntry& entry);
+	void SetPinned(const std::set<TimePoint>& pinned);
+	void Close(bool discard);
+
+	///@brief Sets the maximum number of points to retain
+	void SetMaxDepth(size_t depth)
+	{ m_maxDepth = depth; }
+
+	///@brief Returns the path to the .scopesession file
+	const std::string& GetSessionPath()
+	{ return m_sessionPath; }
+
+	///@brief Returns the path to the _data directory
+	const std::string& GetDataDir()
+	{ return m_dataDir; }
+
+protected:
+	void WriterThread();
+	void WritePoint(JournalEntry& entry);
+	void Rotate();
+	void WriteMetadata();
+
+	///@brief Path to the .scopesession file
+	std::string m_sessionPath;
+
+	///@brief Path to the _data directory
+	std::string m_dataDir;
+
+	///@brief Maximum number of points to retain
+	std::atomic<size_t> m_maxDepth;
+
+	///@brief The session's waveform data mutex, held while reading sample data
+	std::shared_mutex& m_waveformDataMutex;
+
+	///@brief Mutex protecting m_pending and m_pinned
+	std::mutex m_mutex;
+
+	///@brief Signalled when a point is queued or we're shutting down
+	std::condition_variable m_condition;
+
+	///@brief Points waiting to be written
+	std::deque<JournalEntry> m_pending;
+
+	///@brief Timestamps of every point currently pinned in history
+	std::set<TimePoint> m_pinned;
+
+	///@brief Points currently on disk, oldest first (only touched by the writer thread)
+	std::deque<JournalEntry> m_written;
+
+	///@brief ID to use for the next point
+	size_t m_nextID;
+
+	///@brief Set to make the writer thread exit once the queue is empty
+	bool m_closing;
+
+	///@brief True if the metadata index is out of date (only touched by the writer thread)
+	bool m_metadataDirty;
+
+	///@brief Time the metadata index was last written (only touched by the writer thread)
+	double m_lastMetadataWrite;
+
+	///@brief The writer thread
+	std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,968 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of BatchProcessor
+ */
+#include "../scopehal/scopehal.h"
+#include "../scopehal/MockOscilloscope.h"
+#include "../scopeprotocols/scopeprotocols.h"
+#include "BatchProcessor.h"
+#include "WaveformFileIO.h"
+#include "WaveformMetadata.h"
+#include "CSVImport.h"
+#include "pthread_compat.h"
+
+#include <cerrno>
+#include <thread>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+using namespace std;
+
+static vector<YAML::Node> GetScopeNodes(const YAML::Node& instruments);
+static WaveformBase* CreateWaveformForStream(OscilloscopeChannel* chan, const BatchStream& stream);
+static string GetCaptureHeader(bool captureMode);
+static string GetCaptureColumns(const BatchJob& job);
+static string CsvEscape(const string& str);
+static string SanitizeFileName(const string& str);
+static string GetCaptureExtension(const string& path);
+static size_t GetFileSize(const string& path);
+static bool LoadCSVCapture(MockOscilloscope* scope, const string& path);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// BatchOptions
+
+///@brief Upper limit on --jobs, anything bigger is almost certainly a typo
+#define MAX_BATCH_JOBS 4096
+
+/**
+	@brief Parses the argument to --jobs
+
+	@return False if the string isn't a plain non-negative integer in range (m_jobs is left unchanged)
+ */
+bool BatchOptions::ParseJobs(const char* str)
+{
+	if(!isdigit(static_cast<unsigned char>(str[0])))
+		return false;
+
+	errno = 0;
+	char* end = nullptr;
+	auto jobs = strtoull(str, &end, 10);
+	if( (errno != 0) || (*end != '\0') || (jobs > MAX_BATCH_JOBS) )
+		return false;
+
+	m_jobs = jobs;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// BatchContext
+
+BatchContext::BatchContext()
+{
+}
+
+BatchContext::~BatchContext()
+{
+	//Filters go first since they hold references to scope channels
+	for(auto f : m_filters)
+		f->Release();
+	m_filters.clear();
+	m_decoders.clear();
+	m_nodes.clear();
+
+	m_scopes.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+BatchProcessor::BatchProcessor(const BatchOptions& options)
+	: m_options(options)
+	, m_version(0)
+	, m_nextJob(0)
+	, m_failedJobs(0)
+	, m_nextOutput(0)
+	, m_totalInputBytes(0)
+	, m_measurementFile(nullptr)
+	, m_timingFile(nullptr)
+{
+}
+
+BatchProcessor::~BatchProcessor()
+{
+	if(m_measurementFile)
+		fclose(m_measurementFile);
+	if(m_timingFile)
+		fclose(m_timingFile);
+	for(auto fp : m_packetFiles)
+		fclose(fp);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Top level flow
+
+/**
+	@brief Loads the session, processes every capture, and writes the results
+
+	@return True if every capture was processed successfully
+ */
+bool BatchProcessor::Run()
+{
+	if(!LoadSession())
+		return false;
+
+	if(!m_options.IsCaptureMode())
+	{
+		if(!FindHistoryJobs())
+			return false;
+	}
+	else if(!FindCaptureJobs())
+		return false;
+
+	if(m_jobs.empty())
+	{
+		LogNotice("No captures to process\n");
+		return true;
+	}
+
+	//Figure out how many workers to use
+	size_t nthreads = m_options.m_jobs;
+	if(nthreads == 0)
+		nthreads = thread::hardware_concurrency();
+	nthreads = max((size_t)1, min(nthreads, m_jobs.size()));
+	LogNotice("Processing %zu captures using %zu threads\n", m_jobs.size(), nthreads);
+
+	//Each worker gets its own copy of the filter graph.
+	//Create them all up front from this thread since filter creation and YAML access aren't thread safe.
+	vector<unique_ptr<BatchContext>> contexts;
+	for(size_t i=0; i<nthreads; i++)
+	{
+		contexts.push_back(make_unique<BatchContext>());
+		if(!CreateContext(*contexts[i], (i == 0)))
+			return false;
+	}
+
+	if(!OpenOutputFiles(*contexts[0]))
+		return false;
+
+	//Process everything
+	double tstart = GetTime();
+	vector<thread> threads;
+	for(auto& ctx : contexts)
+		threads.push_back(thread(&BatchProcessor::WorkerThread, this, ctx.get()));
+	for(auto& t : threads)
+		t.join();
+	double dt = GetTime() - tstart;
+
+	Unit bytes(Unit::UNIT_BYTES);
+	LogNotice("Processed %zu captures (%s) in %.2f sec: %.1f captures/sec, %s/sec\n",
+		m_jobs.size(),
+		bytes.PrettyPrint(m_totalInputBytes).c_str(),
+		dt,
+		m_jobs.size() / dt,
+		bytes.PrettyPrint(m_totalInputBytes / dt).c_str());
+
+	contexts.clear();
+
+	if(m_failedJobs)
+	{
+		LogWarning("%zu captures could not be loaded\n", m_failedJobs.load());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+	@brief Loads the session file and figures out where its data lives
+ */
+bool BatchProcessor::LoadSession()
+{
+	const string ext = ".scopesession";
+	auto& path = m_options.m_sessionPath;
+	if( (path.length() <= ext.length()) || (path.substr(path.length() - ext.length()) != ext) )
+	{
+		LogError("\"%s\" does not look like a .scopesession file\n", path.c_str());
+		return false;
+	}
+
+	string base = path.substr(0, path.length() - ext.length());
+	m_dataDir = base + "_data";
+	if(m_options.m_outputDir.empty())
+		m_options.m_outputDir = base + "_batch";
+
+	LogDebug("Loading session file \"%s\" (data directory %s)\n", path.c_str(), m_dataDir.c_str());
+
+	vector<YAML::Node> docs;
+	try
+	{
+		docs = YAML::LoadAllFromFile(path);
+	}
+	catch(const YAML::BadFile&)
+	{
+		LogError("Unable to open session file \"%s\"\n", path.c_str());
+		return false;
+	}
+	catch(const YAML::Exception& ex)
+	{
+		LogError("Failed to parse session file \"%s\": %s\n", path.c_str(), ex.what());
+		return false;
+	}
+
+	if(docs.size() != 1)
+	{
+		LogError("Expected one YAML document in \"%s\", found %zu\n", path.c_str(), docs.size());
+		return false;
+	}
+	m_session = docs[0];
+
+	if(m_session["version"])
+		m_version = m_session["version"].as<int>();
+	else
+		m_version = 0;
+
+	if(!m_session["instruments"])
+	{
+		LogError("The session file is invalid because there is no \"instruments\" section\n");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+	@brief Builds the job list from the waveform history saved in the session's data directory
+
+	Waveforms from different scopes with the same timestamp are grouped into a single job, the same way they
+	would end up in a single history point when the session is opened in the GUI.
+ */
+bool BatchProcessor::FindHistoryJobs()
+{
+	auto scopes = GetScopeNodes(m_session["instruments"]);
+
+	map<TimePoint, BatchJob> jobs;
+	for(size_t i=0; i<scopes.size(); i++)
+	{
+		int scope_id = scopes[i]["id"].as<int>();
+
+		vector<WaveformMetadata> waveforms;
+		if(!LoadScopeMetadata(m_dataDir, scope_id, m_version, waveforms))
+			continue;
+
+		for(auto& wfm : waveforms)
+		{
+			auto time = wfm.m_time;
+
+			BatchWaveform w;
+			w.m_scope = i;
+			w.m_id = wfm.m_id;
+
+			//Per-stream metadata
+			for(auto& ch : wfm.m_streams)
+			{
+				BatchStream s;
+				s.m_channel = ch.m_channel;
+				s.m_stream = ch.m_stream;
+				s.m_format = ch.m_format;
+				s.m_datatype = ch.m_datatype;
+				s.m_timescale = ch.m_timescale;
+				s.m_triggerPhase = ch.m_triggerPhase;
+				w.m_streams.push_back(s);
+			}
+
+			auto it2 = jobs.find(time);
+			if(it2 == jobs.end())
+			{
+				BatchJob job;
+				job.m_time = time;
+				it2 = jobs.emplace(time, job).first;
+			}
+			it2->second.m_waveforms.push_back(w);
+		}
+	}
+
+	for(auto& it : jobs)
+		m_jobs.push_back(it.second);
+
+	LogDebug("Found %zu history points in session\n", m_jobs.size());
+	return true;
+}
+
+/**
+	@brief Builds the job list from the CSV and BIN files in the capture directory and/or file list
+ */
+bool BatchProcessor::FindCaptureJobs()
+{
+	if(GetScopeNodes(m_session["instruments"]).empty())
+	{
+		LogError("Session must contain an oscilloscope to load captures into\n");
+		return false;
+	}
+
+	//Everything of a supported type in the directory
+	if(!m_options.m_captureDir.empty())
+	{
+		auto files = Glob(m_options.m_captureDir + "/*", false);
+		sort(files.begin(), files.end());
+		for(auto& f : files)
+		{
+			auto ext = GetCaptureExtension(f);
+			if( (ext != ".csv") && (ext != ".bin") )
+				continue;
+
+			BatchJob job;
+			job.m_capturePath = f;
+			m_jobs.push_back(job);
+		}
+
+		LogDebug("Found %zu captures in %s\n", m_jobs.size(), m_options.m_captureDir.c_str());
+	}
+
+	//Then any individually specified files, in the order given
+	for(auto& f : m_options.m_captureFiles)
+	{
+		auto ext = GetCaptureExtension(f);
+		if( (ext != ".csv") && (ext != ".bin") )
+		{
+			LogWarning("Don't know how to load \"%s\", skipping\n", f.c_str());
+			continue;
+		}
+
+		BatchJob job;
+		job.m_capturePath = f;
+		m_jobs.push_back(job);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Graph setup
+
+/**
+	@brief Instantiates the session's scopes and filter graph into a context
+
+	This follows the same sequence as Session::PreLoadFromYaml() and Session::LoadFromYaml(), but always loads
+	scopes in offline mode and skips everything related to the UI.
+
+	@param ctx		The context to load into
+	@param primary	True for the first context, which reports any problems with the session
+ */
+bool BatchProcessor::CreateContext(BatchContext& ctx, bool primary)
+{
+	auto instruments = m_session["instruments"];
+
+	//Only scopes have waveforms to feed the graph, everything else is ignored
+	auto scopes = GetScopeNodes(instruments);
+	if(primary && (scopes.size() != instruments.size()) )
+		LogWarning("Session contains instruments other than oscilloscopes, these are ignored in batch mode\n");
+
+	//Preload scopes
+	for(auto& node : scopes)
+	{
+		auto scope = make_shared<MockOscilloscope>(
+			node["name"].as<string>(),
+			node["vendor"].as<string>(),
+			node["serial"].as<string>(),
+			node["transport"].as<string>(),
+			node["driver"].as<string>(),
+			node["args"].as<string>()
+			);
+
+		auto id = node["id"].as<uintptr_t>();
+		ctx.m_idtable.emplace(id, (Instrument*)scope.get());
+		ctx.m_scopes.push_back(scope);
+		ctx.m_scopeIDs.push_back(id);
+
+		ConfigWarningList warnings;
+		scope->PreLoadConfiguration(m_version, node, ctx.m_idtable, warnings);
+	}
+
+	//Load scope configuration
+	for(size_t i=0; i<scopes.size(); i++)
+		ctx.m_scopes[i]->LoadConfiguration(m_version, scopes[i], ctx.m_idtable);
+
+	//Create filters and load parameters
+	auto decodes = m_session["decodes"];
+	for(auto it : decodes)
+	{
+		auto dnode = it.second;
+
+		auto proto = dnode["protocol"].as<string>();
+		auto filter = Filter::CreateFilter(proto, dnode["color"].as<string>());
+		if(filter == nullptr)
+		{
+			if(primary)
+				LogError("Unable to create filter \"%s\", skipping\n", proto.c_str());
+			continue;
+		}
+		filter->AddRef();
+
+		ctx.m_idtable.emplace(dnode["id"].as<uintptr_t>(), filter);
+		filter->LoadParameters(dnode, ctx.m_idtable);
+		ctx.m_filters.push_back(filter);
+
+		auto pd = dynamic_cast<PacketDecoder*>(filter);
+		if(pd)
+			ctx.m_decoders.push_back(pd);
+
+		auto eye = dynamic_cast<EyePattern*>(filter);
+		if(eye)
+		{
+			eye->SetWidth(512);
+			eye->SetHeight(512);
+		}
+	}
+
+	//Hook up filter inputs once everything exists
+	for(auto it : decodes)
+	{
+		auto dnode = it.second;
+		auto filter = static_cast<Filter*>(ctx.m_idtable[dnode["id"].as<uintptr_t>()]);
+		if(filter)
+			filter->LoadInputs(dnode, ctx.m_idtable);
+	}
+
+	//Instrument channels can have inputs too
+	for(size_t i=0; i<scopes.size(); i++)
+	{
+		auto scope = ctx.m_scopes[i];
+		for(size_t j=0; j<scope->GetChannelCount(); j++)
+		{
+			auto channelNode = scopes[i]["channels"]["ch" + to_string(j)];
+			if(channelNode)
+				scope->GetChannel(j)->LoadInputs(channelNode, ctx.m_idtable);
+		}
+	}
+
+	//Collect the full graph
+	for(auto f : ctx.m_filters)
+		ctx.m_nodes.emplace(f);
+	for(auto scope : ctx.m_scopes)
+	{
+		for(size_t i=0; i<scope->GetChannelCount(); i++)
+			ctx.m_nodes.emplace(scope->GetChannel(i));
+	}
+
+	return true;
+}
+
+/**
+	@brief Creates the output directory and writes CSV headers
+ */
+bool BatchProcessor::OpenOutputFiles(BatchContext& ctx)
+{
+	auto& dir = m_options.m_outputDir;
+#ifdef _WIN32
+	int err = mkdir(dir.c_str());
+#else
+	int err = mkdir(dir.c_str(), 0755);
+#endif
+	if( (err != 0) && (errno != EEXIST) )
+	{
+		LogError("Failed to create output directory \"%s\"\n", dir.c_str());
+		return false;
+	}
+
+	bool captureMode = m_options.IsCaptureMode();
+
+	//Measurements: one column per scalar filter output
+	string fname = dir + "/measurements.csv";
+	m_measurementFile = fopen(fname.c_str(), "w");
+	if(!m_measurementFile)
+	{
+		LogError("Failed to create \"%s\"\n", fname.c_str());
+		return false;
+	}
+	string header = GetCaptureHeader(captureMode);
+	for(auto f : ctx.m_filters)
+	{
+		for(size_t i=0; i<f->GetStreamCount(); i++)
+		{
+			if(f->GetType(i) == Stream::STREAM_TYPE_ANALOG_SCALAR)
+				header += "," + CsvEscape(f->GetDisplayName() + "." + f->GetStreamName(i));
+		}
+	}
+	fprintf(m_measurementFile, "%s\n", header.c_str());
+
+	//Packets: one file per decoder
+	for(size_t i=0; i<ctx.m_decoders.size(); i++)
+	{
+		auto pd = ctx.m_decoders[i];
+		fname = dir + "/packets_" + to_string(i) + "_" + SanitizeFileName(pd->GetDisplayName()) + ".csv";
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp)
+		{
+			LogError("Failed to create \"%s\"\n", fname.c_str());
+			return false;
+		}
+		m_packetFiles.push_back(fp);
+
+		header = GetCaptureHeader(captureMode) + ",offset_fs,length_fs";
+		for(auto& col : pd->GetHeaders())
+			header += "," + CsvEscape(col);
+		header += ",data";
+		fprintf(fp, "%s\n", header.c_str());
+	}
+
+	//Timing: one row per capture
+	fname = dir + "/timing.csv";
+	m_timingFile = fopen(fname.c_str(), "w");
+	if(!m_timingFile)
+	{
+		LogError("Failed to create \"%s\"\n", fname.c_str());
+		return false;
+	}
+	fprintf(m_timingFile, "%s,status,bytes,load_ms,run_ms,packets\n", GetCaptureHeader(captureMode).c_str());
+
+	LogNotice("Writing results to %s\n", dir.c_str());
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Processing
+
+/**
+	@brief Pulls jobs off the shared list until there are none left
+ */
+void BatchProcessor::WorkerThread(BatchContext* ctx)
+{
+	pthread_setname_np_compat("BatchWorker");
+
+	while(true)
+	{
+		size_t i = m_nextJob ++;
+		if(i >= m_jobs.size())
+			break;
+
+		auto& job = m_jobs[i];
+		BatchResult result;
+
+		double tstart = GetTime();
+		result.m_ok = LoadJob(*ctx, job, result);
+		double tload = GetTime();
+		result.m_loadTime = tload - tstart;
+
+		if(result.m_ok)
+		{
+			ctx->m_executor.RunBlocking(ctx->m_nodes);
+			ExportJob(*ctx, job, result);
+			result.m_runTime = GetTime() - tload;
+		}
+		else
+			m_failedJobs ++;
+
+		CommitResult(i, std::move(result));
+	}
+}
+
+/**
+	@brief Loads the waveforms for a single job into the context's scopes
+ */
+bool BatchProcessor::LoadJob(BatchContext& ctx, const BatchJob& job, BatchResult& result)
+{
+	//Each capture is processed independently, don't let averages etc carry over from the last one
+	for(auto f : ctx.m_filters)
+		f->ClearSweeps();
+
+	//Capture directory mode: import the file into the first scope
+	if(!job.m_capturePath.empty())
+	{
+		auto scope = ctx.m_scopes[0];
+		result.m_inputBytes = GetFileSize(job.m_capturePath);
+
+		bool ok;
+		if(GetCaptureExtension(job.m_capturePath) == ".csv")
+			ok = LoadCSVCapture(scope.get(), job.m_capturePath);
+		else
+			ok = scope->LoadBIN(job.m_capturePath);
+		if(!ok)
+		{
+			LogError("Failed to load capture \"%s\"\n", job.m_capturePath.c_str());
+			return false;
+		}
+
+		//Importing may have created channels the session didn't have
+		for(size_t i=0; i<scope->GetChannelCount(); i++)
+			ctx.m_nodes.emplace(scope->GetChannel(i));
+
+		return true;
+	}
+
+	//History mode: get rid of the previous job's waveforms
+	for(auto scope : ctx.m_scopes)
+	{
+		for(size_t i=0; i<scope->GetChannelCount(); i++)
+		{
+			auto chan = scope->GetOscilloscopeChannel(i);
+			if(!chan)
+				continue;
+			for(size_t j=0; j<chan->GetStreamCount(); j++)
+				chan->SetData(nullptr, j);
+		}
+	}
+
+	//and load the new ones
+	char tmp[512];
+	for(auto& w : job.m_waveforms)
+	{
+		auto scope = ctx.m_scopes[w.m_scope];
+		auto scope_id = ctx.m_scopeIDs[w.m_scope];
+
+		for(auto& s : w.m_streams)
+		{
+			auto chan = scope->GetOscilloscopeChannel(s.m_channel);
+			if(!chan)
+			{
+				LogError("Scope \"%s\" has no channel %d\n", scope->m_nickname.c_str(), s.m_channel);
+				return false;
+			}
+
+			auto cap = CreateWaveformForStream(chan, s);
+			if(!cap)
+				return false;
+			cap->m_timescale = s.m_timescale;
+			cap->m_triggerPhase = s.m_triggerPhase;
+			cap->m_startTimestamp = job.m_time.first;
+			cap->m_startFemtoseconds = job.m_time.second;
+			chan->SetData(cap, s.m_stream);
+
+			if(s.m_stream == 0)
+			{
+				snprintf(tmp, sizeof(tmp), "%s/scope_%d_waveforms/waveform_%d/channel_%d.bin",
+					m_dataDir.c_str(),
+					scope_id,
+					w.m_id,
+					s.m_channel);
+			}
+			else
+			{
+				snprintf(tmp, sizeof(tmp), "%s/scope_%d_waveforms/waveform_%d/channel_%d_stream%d.bin",
+					m_dataDir.c_str(),
+					scope_id,
+					w.m_id,
+					s.m_channel,
+					s.m_stream);
+			}
+
+			//A missing or truncated file must fail the job, not be decoded as an empty waveform
+			result.m_inputBytes += GetFileSize(tmp);
+			auto loaded = LoadWaveformData(cap, s.m_format, tmp);
+			if(!loaded)
+			{
+				LogError("Failed to load waveform data \"%s\"\n", tmp);
+				return false;
+			}
+			if(loaded != cap)
+				chan->SetData(loaded, s.m_stream);
+		}
+	}
+
+	return true;
+}
+
+/**
+	@brief Formats the measurements and packets from a finished job as CSV rows
+ */
+void BatchProcessor::ExportJob(BatchContext& ctx, const BatchJob& job, BatchResult& result)
+{
+	auto key = GetCaptureColumns(job);
+
+	//Scalar outputs
+	result.m_measurements = key;
+	char tmp[64];
+	for(auto f : ctx.m_filters)
+	{
+		for(size_t i=0; i<f->GetStreamCount(); i++)
+		{
+			if(f->GetType(i) != Stream::STREAM_TYPE_ANALOG_SCALAR)
+				continue;
+			snprintf(tmp, sizeof(tmp), ",%.10g", f->GetScalarValue(i));
+			result.m_measurements += tmp;
+		}
+	}
+	result.m_measurements += "\n";
+
+	//Packets
+	result.m_packets.resize(ctx.m_decoders.size());
+	for(size_t i=0; i<ctx.m_decoders.size(); i++)
+	{
+		auto pd = ctx.m_decoders[i];
+		auto headers = pd->GetHeaders();
+		auto& rows = result.m_packets[i];
+
+		auto& packets = pd->GetPackets();
+		result.m_packetCount += packets.size();
+		for(auto p : packets)
+		{
+			rows += key;
+			rows += "," + to_string(p->m_offset) + "," + to_string(p->m_len);
+			for(auto& h : headers)
+				rows += "," + CsvEscape(p->m_headers[h]);
+
+			rows += ",";
+			for(auto b : p->m_data)
+			{
+				snprintf(tmp, sizeof(tmp), "%02x", b);
+				rows += tmp;
+			}
+			rows += "\n";
+		}
+	}
+}
+
+/**
+	@brief Writes out a job's results, after those of every job before it, so output order matches job order
+ */
+void BatchProcessor::CommitResult(size_t job, BatchResult&& result)
+{
+	lock_guard<mutex> lock(m_outputMutex);
+	m_pendingResults.emplace(job, std::move(result));
+
+	while(true)
+	{
+		auto it = m_pendingResults.find(m_nextOutput);
+		if(it == m_pendingResults.end())
+			break;
+
+		auto& r = it->second;
+		fputs(r.m_measurements.c_str(), m_measurementFile);
+		for(size_t i=0; i<r.m_packets.size() && i<m_packetFiles.size(); i++)
+			fputs(r.m_packets[i].c_str(), m_packetFiles[i]);
+
+		auto key = GetCaptureColumns(m_jobs[m_nextOutput]);
+		fprintf(m_timingFile, "%s,%s,%zu,%.3f,%.3f,%zu\n",
+			key.c_str(),
+			r.m_ok ? "ok" : "failed",
+			r.m_inputBytes,
+			r.m_loadTime * 1000,
+			r.m_runTime * 1000,
+			r.m_packetCount);
+		LogVerbose("%s: %zu bytes, load %.3f ms, run %.3f ms, %zu packets\n",
+			key.c_str(),
+			r.m_inputBytes,
+			r.m_loadTime * 1000,
+			r.m_runTime * 1000,
+			r.m_packetCount);
+		m_totalInputBytes += r.m_inputBytes;
+
+		m_pendingResults.erase(it);
+		m_nextOutput ++;
+
+		if( (m_nextOutput % 100) == 0)
+			LogNotice("%zu / %zu captures processed\n", m_nextOutput, m_jobs.size());
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+/**
+	@brief Returns the YAML nodes of every oscilloscope in the session, in file order
+ */
+static vector<YAML::Node> GetScopeNodes(const YAML::Node& instruments)
+{
+	vector<string> drivers;
+	SCPIOscilloscope::EnumDrivers(drivers);
+
+	vector<YAML::Node> ret;
+	for(auto it : instruments)
+	{
+		auto inst = it.second;
+		auto driver = inst["driver"].as<string>();
+		if(find(drivers.begin(), drivers.end(), driver) != drivers.end())
+			ret.push_back(inst);
+	}
+	return ret;
+}
+
+/**
+	@brief Creates an empty waveform of the right type for a saved stream
+
+	Same rules as Session::LoadWaveformDataForScope(): use the datatype tag if present, otherwise guess from
+	the stream type.
+ */
+static WaveformBase* CreateWaveformForStream(OscilloscopeChannel* chan, const BatchStream& stream)
+{
+	bool dense = (stream.m_format == "densev1");
+
+	if( (stream.m_format == "sparsev1") && !stream.m_datatype.empty() )
+	{
+		if(stream.m_datatype == "analog")
+			return new SparseAnalogWaveform;
+		else if(stream.m_datatype == "digital")
+			return new SparseDigitalWaveform;
+		else if(stream.m_datatype == "can")
+			return new CANWaveform;
+
+		LogError("Unrecognized sparsev1 datatype %s\n", stream.m_datatype.c_str());
+		return nullptr;
+	}
+
+	if(chan->GetType(0) == Stream::STREAM_TYPE_ANALOG)
+	{
+		if(dense)
+			return new UniformAnalogWaveform;
+		else
+			return new SparseAnalogWaveform;
+	}
+	else
+	{
+		if(dense)
+			return new UniformDigitalWaveform;
+		else
+			return new SparseDigitalWaveform;
+	}
+}
+
+/**
+	@brief Column headers identifying which capture a row came from
+ */
+static string GetCaptureHeader(bool captureMode)
+{
+	if(captureMode)
+		return "capture";
+	else
+		return "timestamp,time_fsec";
+}
+
+/**
+	@brief Column values identifying which capture a row came from
+ */
+static string GetCaptureColumns(const BatchJob& job)
+{
+	if(!job.m_capturePath.empty())
+		return CsvEscape(BaseName(job.m_capturePath));
+	else
+		return to_string(static_cast<int64_t>(job.m_time.first)) + "," + to_string(job.m_time.second);
+}
+
+/**
+	@brief Quotes a string for use as a CSV field, if needed
+ */
+static string CsvEscape(const string& str)
+{
+	if(str.find_first_of(",\"\n") == string::npos)
+		return str;
+
+	string ret = "\"";
+	for(auto c : str)
+	{
+		if(c == '"')
+			ret += "\"\"";
+		else
+			ret += c;
+	}
+	ret += "\"";
+	return ret;
+}
+
+/**
+	@brief Replaces anything that might not be legal in a file name with underscores
+ */
+static string SanitizeFileName(const string& str)
+{
+	string ret = str;
+	for(auto& c : ret)
+	{
+		if(!isalnum(c) && (c != '-') && (c != '_'))
+			c = '_';
+	}
+	return ret;
+}
+
+/**
+	@brief Returns the lowercased extension of a capture file, including the dot
+ */
+static string GetCaptureExtension(const string& path)
+{
+	auto dot = path.rfind('.');
+	if(dot == string::npos)
+		return "";
+
+	auto ext = path.substr(dot);
+	transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext;
+}
+
+/**
+	@brief Returns the size of a file, or zero if it can't be accessed
+ */
+static size_t GetFileSize(const string& path)
+{
+	struct stat st;
+	if(stat(path.c_str(), &st) != 0)
+		return 0;
+	return st.st_size;
+}
+
+/**
+	@brief Loads a CSV capture into a scope, one column per channel
+
+	Uses the parallel importer when the scope already has enough channels for every column, which is the normal
+	case since the session was presumably set up with captures of the same shape. Otherwise falls back to
+	MockOscilloscope::LoadCSV(), which can create channels.
+ */
+static bool LoadCSVCapture(MockOscilloscope* scope, const string& path)
+{
+	vector<string> names;
+	vector<WaveformBase*> waveforms;
+	if(!ImportCSV(path, names, waveforms))
+		return false;
+
+	if(waveforms.size() > scope->GetChannelCount())
+	{
+		for(auto w : waveforms)
+			delete w;
+		return scope->LoadCSV(path);
+	}
+
+	for(size_t i=0; i<scope->GetChannelCount(); i++)
+	{
+		WaveformBase* w = nullptr;
+		if(i < waveforms.size())
+			w = waveforms[i];
+
+		auto chan = scope->GetOscilloscopeChannel(i);
+		if(chan)
+			chan->SetData(w, 0);
+		else
+			delete w;
+	}
+
+	return true;
+}
@@ -0,0 +1,255 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of BatchProcessor
+ */
+#ifndef BatchProcessor_h
+#define BatchProcessor_h
+
+#include <atomic>
+
+class MockOscilloscope;
+
+/**
+	@brief Settings for a headless batch run
+ */
+class BatchOptions
+{
+public:
+	BatchOptions()
+	: m_jobs(0)
+	{}
+
+	///@brief Path to the .scopesession file containing the filter graph
+	std::string m_sessionPath;
+
+	///@brief Directory of CSV/BIN captures to process
+	std::string m_captureDir;
+
+	///@brief Individual CSV/BIN captures to process, after those in m_captureDir
+	std::vector<std::string> m_captureFiles;
+
+	///@brief Directory to write exported measurements and packets to
+	std::string m_outputDir;
+
+	///@brief Number of captures to process concurrently (zero for one per hardware thread)
+	size_t m_jobs;
+
+	///@brief True to process captures from m_captureDir / m_captureFiles, false for the session's own history
+	bool IsCaptureMode() const
+	{ return !m_captureDir.empty() || !m_captureFiles.empty(); }
+
+	bool ParseJobs(const char* str);
+};
+
+/**
+	@brief Metadata for a single stream of a saved waveform, parsed out of the scope metadata file
+ */
+class BatchStream
+{
+public:
+	int m_channel;
+	int m_stream;
+	std::string m_format;
+	std::string m_datatype;
+	int64_t m_timescale;
+	int64_t m_triggerPhase;
+};
+
+/**
+	@brief One saved waveform from one scope
+ */
+class BatchWaveform
+{
+public:
+	///@brief Index of the scope within the session (not the ID table key)
+	size_t m_scope;
+
+	///@brief Waveform ID used in the data directory path
+	int m_id;
+
+	std::vector<BatchStream> m_streams;
+};
+
+/**
+	@brief A single unit of work: one history point, or one capture file
+ */
+class BatchJob
+{
+public:
+	BatchJob()
+	: m_time(0, 0)
+	{}
+
+	TimePoint m_time;
+
+	///@brief Path to the capture file (capture directory mode only)
+	std::string m_capturePath;
+
+	///@brief Waveforms from each scope at this time (history mode only)
+	std::vector<BatchWaveform> m_waveforms;
+};
+
+/**
+	@brief Exported data from a single job, held until all earlier jobs have been written out
+ */
+class BatchResult
+{
+public:
+	BatchResult()
+	: m_ok(false)
+	, m_inputBytes(0)
+	, m_loadTime(0)
+	, m_runTime(0)
+	, m_packetCount(0)
+	{}
+
+	///@brief True if the capture loaded successfully
+	bool m_ok;
+
+	///@brief Size of the waveform files read for this job
+	size_t m_inputBytes;
+
+	///@brief Time spent loading waveforms, in seconds
+	double m_loadTime;
+
+	///@brief Time spent running the filter graph and formatting output, in seconds
+	double m_runTime;
+
+	///@brief Total number of packets decoded
+	size_t m_packetCount;
+
+	std::string m_measurements;
+
+	///@brief CSV rows for each packet decoder, in the same order as BatchContext::m_decoders
+	std::vector<std::string> m_packets;
+};
+
+/**
+	@brief A private copy of the session's instruments and filter graph, owned by a single worker thread
+
+	Filters keep their output waveforms internally, so independent captures can only be processed concurrently
+	if each one runs through its own instance of the graph.
+ */
+class BatchContext
+{
+public:
+	BatchContext();
+	~BatchContext();
+
+	IDTable m_idtable;
+
+	///@brief Scopes in the order they appear in the session file
+	std::vector<std::shared_ptr<MockOscilloscope>> m_scopes;
+
+	///@brief ID table keys of m_scopes
+	std::vector<int> m_scopeIDs;
+
+	///@brief Filters in the order they appear in the session file
+	std::vector<Filter*> m_filters;
+
+	///@brief Subset of m_filters which produce packets
+	std::vector<PacketDecoder*> m_decoders;
+
+	///@brief Every node in the graph
+	std::set<FlowGraphNode*> m_nodes;
+
+	FilterGraphExecutor m_executor;
+};
+
+/**
+	@brief Runs a saved filter graph over many captures without a GUI, and exports the results
+ */
+class BatchProcessor
+{
+public:
+	BatchProcessor(const BatchOptions& options);
+	~BatchProcessor();
+
+	bool Run();
+
+protected:
+	bool LoadSession();
+	bool FindHistoryJobs();
+	bool FindCaptureJobs();
+	bool CreateContext(BatchContext& ctx, bool primary);
+	bool OpenOutputFiles(BatchContext& ctx);
+
+	void WorkerThread(BatchContext* ctx);
+	bool LoadJob(BatchContext& ctx, const BatchJob& job, BatchResult& result);
+	void ExportJob(BatchContext& ctx, const BatchJob& job, BatchResult& result);
+	void CommitResult(size_t job, BatchResult&& result);
+
+	///@brief Our settings
+	BatchOptions m_options;
+
+	///@brief Data directory associated with the session file
+	std::string m_dataDir;
+
+	///@brief Root node of the session file
+	YAML::Node m_session;
+
+	///@brief File format version of the session
+	int m_version;
+
+	///@brief Everything we need to do
+	std::vector<BatchJob> m_jobs;
+
+	///@brief Index of the next job to hand out to a worker
+	std::atomic<size_t> m_nextJob;
+
+	///@brief Number of jobs which failed to load
+	std::atomic<size_t> m_failedJobs;
+
+	///@brief Mutex protecting the output files and pending results
+	std::mutex m_outputMutex;
+
+	///@brief Index of the next job whose results are to be written
+	size_t m_nextOutput;
+
+	///@brief Results which finished out of order and are waiting on earlier jobs
+	std::map<size_t, BatchResult> m_pendingResults;
+
+	///@brief Total size of all waveform files read so far
+	size_t m_totalInputBytes;
+
+	///@brief Measurement output file
+	FILE* m_measurementFile;
+
+	///@brief Per-capture timing output file
+	FILE* m_timingFile;
+
+	///@brief Packet output files, one per decoder
+	std::vector<FILE*> m_packetFiles;
+};
+
+#endif
@@ -0,0 +1,594 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Fast parallel import of waveform data from CSV files
+ */
+#include "../scopehal/scopehal.h"
+#include "CSVImport.h"
+
+#include <omp.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static bool NextLine(const char*& p, const char* end, const char*& line, const char*& eol);
+static bool ParseNumber(const char*& p, const char* end, double& value);
+static size_t ParseRow(
+	const char* p,
+	const char* eol,
+	double tfirst,
+	int64_t& time,
+	float* const* samples,
+	size_t ncols,
+	size_t row);
+static vector<string> SplitHeader(const char* p, const char* eol);
+static bool IsDigitalColumn(const float* samples, size_t len);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Top level import
+
+/**
+	@brief Loads a CSV file containing one or more waveforms sharing a common timebase
+
+	The file is expected to contain an optional header row of column names, followed by one row per sample. The first
+	column is the sample time in seconds and each remaining column is one waveform. Blank lines and lines starting
+	with # are ignored.
+
+	The file is memory mapped and split into chunks at line boundaries, which are parsed in parallel directly into
+	the output waveforms. If the timestamps are evenly spaced, uniform waveforms are returned; if every value in a
+	column is 0 or 1 it's returned as a digital waveform.
+
+	@param path			Path to the file
+	@param names		Name of each waveform, from the header row if present
+	@param waveforms	The loaded waveforms. Ownership passes to the caller.
+
+	@return True on success, false on error
+ */
+bool ImportCSV(const string& path, vector<string>& names, vector<WaveformBase*>& waveforms)
+{
+	names.clear();
+	waveforms.clear();
+
+	//Load the file into memory
+	const char* buf = nullptr;
+	size_t len = 0;
+
+	//Windows: use generic file reads for now
+	#ifdef _WIN32
+		FILE* fp = fopen(path.c_str(), "rb");
+		if(!fp)
+		{
+			LogError("couldn't open %s\n", path.c_str());
+			return false;
+		}
+		fseek(fp, 0, SEEK_END);
+		len = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		char* rbuf = new char[len];
+		if(len != fread(rbuf, 1, len, fp))
+		{
+			LogError("couldn't read %s\n", path.c_str());
+			delete[] rbuf;
+			fclose(fp);
+			return false;
+		}
+		fclose(fp);
+		buf = rbuf;
+
+	//On POSIX, just memory map the file
+	#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+		{
+			LogError("couldn't open %s\n", path.c_str());
+			return false;
+		}
+		len = lseek(fd, 0, SEEK_END);
+		void* mbuf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mbuf == MAP_FAILED)
+		{
+			LogError("couldn't map %s\n", path.c_str());
+			::close(fd);
+			return false;
+		}
+		madvise(mbuf, len, MADV_SEQUENTIAL);
+		buf = static_cast<const char*>(mbuf);
+	#endif
+
+	const char* end = buf + len;
+	bool ok = false;
+
+	do
+	{
+		//Skip any header lines, keeping the last one as column names
+		const char* p = buf;
+		const char* line = nullptr;
+		const char* eol = nullptr;
+		vector<string> header;
+		const char* dataStart = nullptr;
+		while(true)
+		{
+			const char* lineStart = p;
+			if(!NextLine(p, end, line, eol))
+				break;
+
+			double dummy;
+			const char* q = line;
+			if(ParseNumber(q, eol, dummy))
+			{
+				dataStart = lineStart;
+				break;
+			}
+
+			header = SplitHeader(line, eol);
+		}
+		if(!dataStart)
+		{
+			LogError("%s does not contain any sample data\n", path.c_str());
+			break;
+		}
+
+		//Column count and start time come from the first data row
+		size_t ncols = count(line, eol, ',');
+		if(ncols == 0)
+		{
+			LogError("%s needs at least two columns (time and one waveform)\n", path.c_str());
+			break;
+		}
+		double tfirst = 0;
+		{
+			const char* q = line;
+			ParseNumber(q, eol, tfirst);
+		}
+		for(size_t i=0; i<ncols; i++)
+		{
+			if( (i+1 < header.size()) && !header[i+1].empty() )
+				names.push_back(header[i+1]);
+			else
+				names.push_back(string("CH") + to_string(i+1));
+		}
+
+		//Split the data into chunks at line boundaries.
+		//Use a few chunks per thread to even out the load, but keep them big enough to not be dominated by overhead.
+		size_t datalen = end - dataStart;
+		size_t nthreads = omp_get_max_threads();
+		size_t nchunks = min(nthreads * 4, max(datalen / (1024 * 1024), (size_t)1));
+		vector<const char*> chunkStart(nchunks + 1);
+		chunkStart[0] = dataStart;
+		chunkStart[nchunks] = end;
+		for(size_t i=1; i<nchunks; i++)
+		{
+			const char* q = max(dataStart + (datalen * i) / nchunks, chunkStart[i-1]);
+			auto nl = static_cast<const char*>(memchr(q, '\n', end - q));
+			chunkStart[i] = nl ? (nl + 1) : end;
+		}
+
+		//Count rows in each chunk so we know where each one's output goes
+		vector<size_t> rowStart(nchunks + 1);
+		#pragma omp parallel for
+		for(size_t i=0; i<nchunks; i++)
+		{
+			const char* q = chunkStart[i];
+			const char* l;
+			const char* e;
+			size_t n = 0;
+			while(NextLine(q, chunkStart[i+1], l, e))
+				n ++;
+			rowStart[i+1] = n;
+		}
+		rowStart[0] = 0;
+		for(size_t i=0; i<nchunks; i++)
+			rowStart[i+1] += rowStart[i];
+		size_t nrows = rowStart[nchunks];
+
+		//Allocate output buffers. Parse everything as sparse analog first, since we can't know if the timebase
+		//is uniform or the data digital until we've seen all of it.
+		vector<SparseAnalogWaveform*> caps;
+		vector<float*> samples;
+		for(size_t i=0; i<ncols; i++)
+		{
+			auto cap = new SparseAnalogWaveform;
+			cap->m_timescale = 1;
+			cap->PrepareForCpuAccess();
+			cap->Resize(nrows);
+			caps.push_back(cap);
+			samples.push_back(cap->m_samples.GetCpuPointer());
+		}
+		int64_t* times = caps[0]->m_offsets.GetCpuPointer();
+
+		//Parse it
+		size_t errors = 0;
+		#pragma omp parallel for reduction(+:errors)
+		for(size_t i=0; i<nchunks; i++)
+		{
+			const char* q = chunkStart[i];
+			const char* l;
+			const char* e;
+			size_t row = rowStart[i];
+			while(NextLine(q, chunkStart[i+1], l, e))
+			{
+				errors += ParseRow(l, e, tfirst, times[row], samples.data(), ncols, row);
+				row ++;
+			}
+		}
+		if(errors)
+			LogWarning("%zu fields in %s could not be parsed\n", errors, path.c_str());
+
+		//Check if the timebase is uniform (allowing for some rounding since CSV timestamps are usually truncated)
+		int64_t interval = 0;
+		if(nrows > 1)
+			interval = times[nrows-1] / static_cast<int64_t>(nrows - 1);
+		size_t nonuniform = 0;
+		if(interval > 0)
+		{
+			int64_t tolerance = interval / 4;
+			#pragma omp parallel for reduction(+:nonuniform)
+			for(size_t i=0; i<nrows; i++)
+			{
+				if(llabs(times[i] - static_cast<int64_t>(i) * interval) > tolerance)
+					nonuniform ++;
+			}
+		}
+		bool uniform = (interval > 0) && (nonuniform == 0);
+
+		//Trigger phase is the time of the first sample, if it fits
+		int64_t phase = 0;
+		if(fabs(tfirst) < 9000)
+			phase = llround(tfirst * FS_PER_SECOND);
+
+		//Sparse: fill out durations, then share the timebase across all columns
+		if(!uniform)
+		{
+			auto durations = caps[0]->m_durations.GetCpuPointer();
+			#pragma omp parallel for
+			for(size_t i=0; i+1<nrows; i++)
+				durations[i] = times[i+1] - times[i];
+			if(nrows > 1)
+				durations[nrows-1] = durations[nrows-2];
+			else
+				durations[0] = 1;
+
+			for(size_t i=1; i<ncols; i++)
+			{
+				memcpy(caps[i]->m_offsets.GetCpuPointer(), times, nrows * sizeof(int64_t));
+				memcpy(caps[i]->m_durations.GetCpuPointer(), durations, nrows * sizeof(int64_t));
+			}
+		}
+
+		//Convert each column to its final form
+		for(size_t i=0; i<ncols; i++)
+		{
+			auto cap = caps[i];
+			bool digital = IsDigitalColumn(samples[i], nrows);
+
+			WaveformBase* out = nullptr;
+			if(uniform && digital)
+			{
+				auto wfm = new UniformDigitalWaveform;
+				wfm->PrepareForCpuAccess();
+				wfm->Resize(nrows);
+				auto dst = wfm->m_samples.GetCpuPointer();
+				auto src = samples[i];
+				#pragma omp parallel for
+				for(size_t j=0; j<nrows; j++)
+					dst[j] = (src[j] != 0);
+				out = wfm;
+			}
+			else if(uniform)
+			{
+				auto wfm = new UniformAnalogWaveform;
+				wfm->PrepareForCpuAccess();
+				wfm->Resize(nrows);
+				memcpy(wfm->m_samples.GetCpuPointer(), samples[i], nrows * sizeof(float));
+				out = wfm;
+			}
+			else if(digital)
+			{
+				auto wfm = new SparseDigitalWaveform;
+				wfm->PrepareForCpuAccess();
+				wfm->Resize(nrows);
+				memcpy(wfm->m_offsets.GetCpuPointer(), cap->m_offsets.GetCpuPointer(), nrows * sizeof(int64_t));
+				memcpy(wfm->m_durations.GetCpuPointer(), cap->m_durations.GetCpuPointer(), nrows * sizeof(int64_t));
+				auto dst = wfm->m_samples.GetCpuPointer();
+				auto src = samples[i];
+				#pragma omp parallel for
+				for(size_t j=0; j<nrows; j++)
+					dst[j] = (src[j] != 0);
+				out = wfm;
+			}
+
+			//Already in the right format, keep it
+			if(!out)
+			{
+				out = cap;
+				caps[i] = nullptr;
+			}
+
+			out->m_timescale = uniform ? interval : 1;
+			out->m_triggerPhase = phase;
+			out->MarkModifiedFromCpu();
+			waveforms.push_back(out);
+		}
+
+		for(auto cap : caps)
+			delete cap;
+
+		LogTrace("Loaded %zu rows x %zu columns from %s (%s)\n",
+			nrows, ncols, path.c_str(), uniform ? "uniform" : "sparse");
+		ok = true;
+
+	} while(0);
+
+	#ifdef _WIN32
+		delete[] buf;
+	#else
+		munmap(const_cast<char*>(buf), len);
+		::close(fd);
+	#endif
+
+	return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Parsing helpers
+
+/**
+	@brief Finds the next line containing data
+
+	Blank lines and comments are skipped. On return, [line, eol) is the line without its terminator and p points
+	to the start of the following line.
+
+	@return False if there are no more lines before end
+ */
+static bool NextLine(const char*& p, const char* end, const char*& line, const char*& eol)
+{
+	while(p < end)
+	{
+		auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		if(!nl)
+			nl = end;
+
+		line = p;
+		eol = nl;
+		p = (nl < end) ? (nl + 1) : end;
+
+		if( (eol > line) && (eol[-1] == '\r') )
+			eol --;
+		if( (eol > line) && (line[0] != '#') )
+			return true;
+	}
+
+	return false;
+}
+
+/**
+	@brief Parses a decimal floating point number, advancing p past it
+
+	This is much faster than strtod() since it doesn't need a null terminated string, doesn't care about locales,
+	and handles the common case (up to 19 significant digits, small exponent) with a single multiply or divide.
+	Anything else (inf, nan, very long mantissas) falls back to strtod().
+ */
+static bool ParseNumber(const char*& p, const char* end, double& value)
+{
+	static const double powersOfTen[] =
+	{
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	//Skip leading whitespace and quotes
+	while( (p < end) && ( (*p == ' ') || (*p == '\t') || (*p == '"') ) )
+		p++;
+	const char* start = p;
+
+	bool negative = false;
+	if( (p < end) && ( (*p == '-') || (*p == '+') ) )
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	//Mantissa
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	bool fraction = false;
+	for(; p < end; p++)
+	{
+		char c = *p;
+		if( (c == '.') && !fraction)
+		{
+			fraction = true;
+			continue;
+		}
+		if( (c < '0') || (c > '9') )
+			break;
+
+		any = true;
+		if(digits < 19)
+		{
+			mantissa = mantissa*10 + (c - '0');
+			if(mantissa)
+				digits ++;
+			if(fraction)
+				exponent --;
+		}
+		else if(!fraction)
+			exponent ++;
+	}
+
+	//Not a plain number, see if the C library can make sense of it
+	if(!any)
+	{
+		char tmp[64];
+		size_t n = min((size_t)(end - start), sizeof(tmp) - 1);
+		memcpy(tmp, start, n);
+		tmp[n] = '\0';
+		char* tend;
+		value = strtod(tmp, &tend);
+		if(tend == tmp)
+		{
+			p = start;
+			return false;
+		}
+		p = start + (tend - tmp);
+		return true;
+	}
+
+	//Exponent
+	if( (p < end) && ( (*p == 'e') || (*p == 'E') ) )
+	{
+		p++;
+		bool eneg = false;
+		if( (p < end) && ( (*p == '-') || (*p == '+') ) )
+		{
+			eneg = (*p == '-');
+			p++;
+		}
+		int e = 0;
+		for(; (p < end) && (*p >= '0') && (*p <= '9'); p++)
+		{
+			if(e < 10000)
+				e = e*10 + (*p - '0');
+		}
+		exponent += eneg ? -e : e;
+	}
+
+	value = mantissa;
+	if( (exponent >= 0) && (exponent <= 22) )
+		value *= powersOfTen[exponent];
+	else if( (exponent < 0) && (exponent >= -22) )
+		value /= powersOfTen[-exponent];
+	else
+		value *= pow(10.0, exponent);
+
+	if(negative)
+		value = -value;
+	return true;
+}
+
+/**
+	@brief Parses a single row of the file
+
+	@return Number of fields which could not be parsed
+ */
+static size_t ParseRow(
+	const char* p,
+	const char* eol,
+	double tfirst,
+	int64_t& time,
+	float* const* samples,
+	size_t ncols,
+	size_t row)
+{
+	size_t errors = 0;
+
+	double t;
+	if(!ParseNumber(p, eol, t))
+	{
+		t = tfirst;
+		errors ++;
+	}
+	time = llround( (t - tfirst) * FS_PER_SECOND);
+
+	for(size_t i=0; i<ncols; i++)
+	{
+		//Advance to the next field, ignoring any junk after the previous one
+		auto comma = static_cast<const char*>(memchr(p, ',', eol - p));
+		if(!comma)
+		{
+			errors += ncols - i;
+			for(; i<ncols; i++)
+				samples[i][row] = NAN;
+			break;
+		}
+		p = comma + 1;
+
+		double v;
+		if(!ParseNumber(p, eol, v))
+		{
+			v = NAN;
+			errors ++;
+		}
+		samples[i][row] = v;
+	}
+
+	return errors;
+}
+
+/**
+	@brief Splits a header row into column names, removing quotes and surrounding whitespace
+ */
+static vector<string> SplitHeader(const char* p, const char* eol)
+{
+	vector<string> ret;
+	string field;
+	for(; p <= eol; p++)
+	{
+		if( (p == eol) || (*p == ',') )
+		{
+			auto first = field.find_first_not_of(" \t\"");
+			auto last = field.find_last_not_of(" \t\"");
+			if(first == string::npos)
+				ret.push_back("");
+			else
+				ret.push_back(field.substr(first, last - first + 1));
+			field.clear();
+		}
+		else
+			field += *p;
+	}
+	return ret;
+}
+
+/**
+	@brief Checks if a column contains nothing but zeroes and ones
+ */
+static bool IsDigitalColumn(const float* samples, size_t len)
+{
+	size_t analog = 0;
+	#pragma omp parallel for reduction(+:analog)
+	for(size_t i=0; i<len; i++)
+	{
+		if( (samples[i] != 0) && (samples[i] != 1) )
+			analog ++;
+	}
+	return (analog == 0);
+}
@@ -66,6 +66,8 @@ bool Dialog::Render()
 	if(!m_open)
 		return false;
 
+	m_budget.BeginFrame();
+
 	string name = m_title + "###" + m_id;
 	ImGui::SetNextWindowSize(m_defaultSize, ImGuiCond_Appearing);
 	if(!ImGui::Begin(name.c_str(), &m_open, ImGuiWindowFlags_NoCollapse))
@@ -73,18 +75,26 @@ bool Dialog::Render()
 		//If we get here, the window is tabbed out or the content area is otherwise not visible.
 		//Save time by not drawing anything, but don't close the window!
 		ImGui::End();
+		m_budget.EndFrame(false);
 		return true;
 	}
 
+	//Always refresh at full rate if the user is working with us
+	m_budget.UpdateRefresh(
+		ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) ||
+		ImGui::IsWindowHovered(ImGuiHoveredFlags_RootAndChildWindows));
+
 	if(!DoRender())
 	{
 		ImGui::End();
+		m_budget.EndFrame(true);
 		return false;
 	}
 
 	RenderErrorPopup();
 
 	ImGui::End();
+	m_budget.EndFrame(true);
 	return true;
 }
 
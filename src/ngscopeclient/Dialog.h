@@ -36,6 +36,7 @@
 #define Dialog_h
 
 #include "imgui_stdlib.h"
+#include "FrameBudget.h"
 
 /**
 	@brief Generic dialog box or other popup window
@@ -56,6 +57,12 @@ public:
 	std::string GetTitleAndID()
 	{ return m_title + "###" + m_id; }
 
+	const std::string& GetTitle()
+	{ return m_title; }
+
+	PanelBudget& GetBudget()
+	{ return m_budget; }
+
 	//TODO: this might be better off as a global method?
 	static bool Combo(const std::string& label, const std::vector<std::string>& items, int& selection);
 	static bool UnitInputWithImplicitApply(
@@ -103,6 +110,9 @@ protected:
 
 	std::string m_errorPopupTitle;
 	std::string m_errorPopupMessage;
+
+	///@brief Frame time accounting for this dialog
+	PanelBudget m_budget;
 };
 
 #endif
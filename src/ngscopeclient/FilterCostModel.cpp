@@ -0,0 +1,212 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of FilterCostModel
+ */
+#include "../scopehal/scopehal.h"
+#include "FilterCostModel.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+FilterCostModel::FilterCostModel()
+	: m_maxSamplesPerType(64)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Measurement history
+
+/**
+	@brief Records a new measurement for a filter
+
+	@param node		The filter that was run
+	@param type		Protocol name of the filter (used to group measurements of different instances)
+	@param sample	What it cost
+ */
+void FilterCostModel::AddSample(FlowGraphNode* node, const string& type, const FilterCostSample& sample)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_lastSamples[node] = sample;
+
+	//Empty inputs tell us nothing about scaling
+	if(sample.m_inputDepth == 0)
+		return;
+
+	auto& hist = m_history[type];
+	hist.m_samples.push_back(sample);
+	while(hist.m_samples.size() > m_maxSamplesPerType)
+		hist.m_samples.pop_front();
+	hist.m_fitValid = false;
+}
+
+/**
+	@brief Gets the most recent measurement for a node
+
+	@return False if the node has not been run since profiling was turned on
+ */
+bool FilterCostModel::GetLastSample(FlowGraphNode* node, FilterCostSample& sample)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	auto it = m_lastSamples.find(node);
+	if(it == m_lastSamples.end())
+		return false;
+	sample = it->second;
+	return true;
+}
+
+/**
+	@brief Removes measurements for nodes which no longer exist
+
+	This prevents a newly created filter, which happens to be allocated at the same address as a deleted one, from
+	showing the old filter's results.
+ */
+void FilterCostModel::PurgeStaleNodes(const set<FlowGraphNode*>& liveNodes)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	for(auto it = m_lastSamples.begin(); it != m_lastSamples.end(); )
+	{
+		if(liveNodes.find(it->first) == liveNodes.end())
+			it = m_lastSamples.erase(it);
+		else
+			++it;
+	}
+}
+
+/**
+	@brief Forgets all measurements
+ */
+void FilterCostModel::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_lastSamples.clear();
+	m_history.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Prediction
+
+/**
+	@brief Predicts the cost of running a filter of the given type at a given input depth
+
+	@return False if we have never seen this filter type run
+ */
+bool FilterCostModel::Estimate(const string& type, size_t inputDepth, FilterCostSample& estimate)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	auto it = m_history.find(type);
+	if( (it == m_history.end()) || it->second.m_samples.empty() )
+		return false;
+
+	auto& hist = it->second;
+	if(!hist.m_fitValid)
+		UpdateFit(hist);
+
+	double depth = inputDepth;
+	estimate.m_inputDepth = inputDepth;
+	estimate.m_execTime = llround(hist.m_timeFit.Evaluate(depth));
+	estimate.m_outputDepth = llround(hist.m_depthFit.Evaluate(depth));
+	estimate.m_outputBytes = llround(hist.m_bytesFit.Evaluate(depth));
+	return true;
+}
+
+/**
+	@brief Refits the scaling models for a filter type from its measurement history
+ */
+void FilterCostModel::UpdateFit(TypeHistory& hist)
+{
+	vector<pair<double, double> > time;
+	vector<pair<double, double> > depth;
+	vector<pair<double, double> > bytes;
+	for(auto& s : hist.m_samples)
+	{
+		double x = s.m_inputDepth;
+		time.push_back(pair<double, double>(x, s.m_execTime));
+		depth.push_back(pair<double, double>(x, s.m_outputDepth));
+		bytes.push_back(pair<double, double>(x, s.m_outputBytes));
+	}
+
+	hist.m_timeFit = FitPowerLaw(time);
+	hist.m_depthFit = FitPowerLaw(depth);
+	hist.m_bytesFit = FitPowerLaw(bytes);
+	hist.m_fitValid = true;
+}
+
+/**
+	@brief Least squares fit of y = a * x^k to a set of (x, y) points, done as a linear fit in log-log space
+
+	Points with a non-positive coordinate are ignored. If all of the remaining points are at the same x there's no
+	way to tell how the value scales, so we assume it's linear (true of the vast majority of filters). The exponent
+	is clamped to [0, 3] so a couple of noisy points can't produce absurd extrapolations.
+ */
+FilterCostFit FilterCostModel::FitPowerLaw(const vector<pair<double, double> >& points)
+{
+	double sumX = 0;
+	double sumY = 0;
+	double sumXX = 0;
+	double sumXY = 0;
+	size_t n = 0;
+	for(auto& p : points)
+	{
+		if( (p.first <= 0) || (p.second <= 0) )
+			continue;
+
+		double x = log(p.first);
+		double y = log(p.second);
+		sumX += x;
+		sumY += y;
+		sumXX += x*x;
+		sumXY += x*y;
+		n ++;
+	}
+
+	//Nothing usable: everything is zero
+	if(n == 0)
+		return FilterCostFit(0, 1);
+
+	double meanX = sumX / n;
+	double meanY = sumY / n;
+	double varX = sumXX/n - meanX*meanX;
+
+	double k = 1;
+	if(varX > 1e-6)
+		k = (sumXY/n - meanX*meanY) / varX;
+	k = min(3.0, max(0.0, k));
+
+	return FilterCostFit(exp(meanY - k*meanX), k);
+}
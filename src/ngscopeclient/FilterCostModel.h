@@ -0,0 +1,145 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of FilterCostModel
+ */
+#ifndef FilterCostModel_h
+#define FilterCostModel_h
+
+#include <deque>
+
+/**
+	@brief A single measurement (or estimate) of what it costs to run one filter
+ */
+class FilterCostSample
+{
+public:
+	FilterCostSample()
+	: m_inputDepth(0)
+	, m_outputDepth(0)
+	, m_execTime(0)
+	, m_outputBytes(0)
+	{}
+
+	///@brief Number of samples in the deepest input
+	size_t m_inputDepth;
+
+	///@brief Number of samples in the deepest output
+	size_t m_outputDepth;
+
+	///@brief Time spent in the filter, in fs
+	int64_t m_execTime;
+
+	///@brief Total size of all output waveforms, in bytes
+	size_t m_outputBytes;
+};
+
+/**
+	@brief Power law y = a * x^k fitted to a set of measurements
+ */
+class FilterCostFit
+{
+public:
+	FilterCostFit(double scale = 0, double exponent = 1)
+	: m_scale(scale)
+	, m_exponent(exponent)
+	{}
+
+	double Evaluate(double x) const
+	{ return m_scale * pow(x, m_exponent); }
+
+	double m_scale;
+	double m_exponent;
+};
+
+/**
+	@brief Keeps track of how long each filter took to run, and predicts how long it will take at other input depths
+
+	Measurements are recorded per filter instance (for display of the most recent run) and per filter type. The per
+	type history is used to fit a power law of execution time, output depth, and output size vs input depth, so that
+	we can warn about a chain of filters that will be painfully slow at the memory depth the scope is about to capture
+	before the user actually arms the trigger.
+
+	All methods are thread safe.
+ */
+class FilterCostModel
+{
+public:
+	FilterCostModel();
+
+	void AddSample(FlowGraphNode* node, const std::string& type, const FilterCostSample& sample);
+	bool GetLastSample(FlowGraphNode* node, FilterCostSample& sample);
+	bool Estimate(const std::string& type, size_t inputDepth, FilterCostSample& estimate);
+	void PurgeStaleNodes(const std::set<FlowGraphNode*>& liveNodes);
+	void Clear();
+
+	static FilterCostFit FitPowerLaw(const std::vector<std::pair<double, double> >& points);
+
+protected:
+
+	/**
+		@brief Measurement history for a single filter type
+	 */
+	class TypeHistory
+	{
+	public:
+		TypeHistory()
+		: m_fitValid(false)
+		{}
+
+		///@brief Most recent measurements, oldest first
+		std::deque<FilterCostSample> m_samples;
+
+		///@brief True if the fits below are up to date with m_samples
+		bool m_fitValid;
+
+		FilterCostFit m_timeFit;
+		FilterCostFit m_depthFit;
+		FilterCostFit m_bytesFit;
+	};
+
+	void UpdateFit(TypeHistory& hist);
+
+	///@brief Mutex to interlock access to everything else
+	std::mutex m_mutex;
+
+	///@brief Most recent measurement for each node
+	std::map<FlowGraphNode*, FilterCostSample> m_lastSamples;
+
+	///@brief Measurement history for each filter type
+	std::map<std::string, TypeHistory> m_history;
+
+	///@brief Maximum number of samples kept per filter type
+	size_t m_maxSamplesPerType;
+};
+
+#endif
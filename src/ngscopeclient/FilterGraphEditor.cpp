@@ -198,8 +198,18 @@ FilterGraphEditor::FilterGraphEditor(Session& session, MainWindow* parent)
 	: Dialog("Filter Graph Editor", "Filter Graph Editor", ImVec2(800, 600))
 	, m_session(session)
 	, m_parent(parent)
+	, m_modelRevision(0)
+	, m_modelFilterCount(0)
+	, m_modelValid(false)
 	, m_nextID(1)
+	, m_showNodeCost(false)
+	, m_layoutSettled(false)
+	, m_checkInitialLayout(true)
+	, m_layoutDone(false)
 {
+	//Cost estimates can be refreshed at a reduced rate if the frame is running long
+	m_budget.SetThrottleable(true);
+
 	m_config.SaveSettings = &FilterGraphEditor::SaveSettingsCallback;
 	m_config.LoadSettings = &FilterGraphEditor::LoadSettingsCallback;
 	m_config.UserPointer = this;
@@ -227,6 +237,10 @@ FilterGraphEditor::FilterGraphEditor(Session& session, MainWindow* parent)
 
 FilterGraphEditor::~FilterGraphEditor()
 {
+	if(m_layoutThread)
+		m_layoutThread->join();
+
+	m_session.SetFilterProfilingEnabled(false);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -330,19 +344,52 @@ map<shared_ptr<Instrument>, vector<InstrumentChannel*> > FilterGraphEditor::GetA
 /**
 	@brief Get a list of all objects we're displaying nodes for (channels, filters, triggers, etc)
  */
-vector<FlowGraphNode*> FilterGraphEditor::GetAllNodes()
+const vector<FlowGraphNode*>& FilterGraphEditor::GetAllNodes()
 {
-	vector<FlowGraphNode*> ret;
+	RefreshGraphModel();
+	return m_modelNodes;
+}
+
+/**
+	@brief Rebuilds the cached lists of nodes and inputs, if the graph has changed since they were last built
+
+	Walking every instrument and filter is too slow to do every frame with large graphs, so we only do it when
+	Session::InvalidateGraph() has been called, a filter has been created or deleted, or the state of the instrument
+	channels and triggers has changed.
+ */
+void FilterGraphEditor::RefreshGraphModel()
+{
+	auto rev = m_session.GetGraphRevision();
+	auto nfilters = Filter::GetNumInstances();
+	auto chanState = GetChannelState();
+	if(m_modelValid && (rev == m_modelRevision) && (nfilters == m_modelFilterCount) &&
+		(chanState == m_modelChannelState) )
+	{
+		return;
+	}
+
+	m_modelValid = true;
+	m_modelRevision = rev;
+	m_modelFilterCount = nfilters;
+	m_modelChannelState = chanState;
+
+	//Cached cost estimates may refer to filters that no longer exist
+	m_costEstimates.clear();
+
+	m_modelNodes.clear();
+	m_modelTriggers.clear();
+	m_modelFilters.clear();
+	m_modelInputs.clear();
 
 	//Channels
-	auto chans = GetAllVisibleChannels();
-	for(auto it : chans)
+	m_modelChannels = GetAllVisibleChannels();
+	for(auto& it : m_modelChannels)
 	{
 		for(auto node : it.second)
-			ret.push_back(node);
+			m_modelNodes.push_back(node);
 	}
 
-	//Triggers
+	//Triggers, and inputs of all instrument channels (even ones we're not showing)
 	auto insts = m_session.GetInstruments();
 	for(auto inst : insts)
 	{
@@ -351,14 +398,73 @@ vector<FlowGraphNode*> FilterGraphEditor::GetAllNodes()
 		{
 			auto trig = scope->GetTrigger();
 			if(trig)
-				ret.push_back(trig);
+			{
+				m_modelTriggers.push_back(trig);
+				m_modelNodes.push_back(trig);
+			}
+		}
+
+		for(size_t i=0; i<inst->GetChannelCount(); i++)
+		{
+			auto chan = inst->GetChannel(i);
+			for(size_t j=0; j<chan->GetInputCount(); j++)
+				m_modelInputs.push_back(pair<FlowGraphNode*, size_t>(chan, j));
 		}
 	}
 
 	//Filters
 	auto filters = Filter::GetAllInstances();
 	for(auto f : filters)
-		ret.push_back(f);
+	{
+		m_modelFilters.push_back(f);
+		m_modelNodes.push_back(f);
+		for(size_t j=0; j<f->GetInputCount(); j++)
+			m_modelInputs.push_back(pair<FlowGraphNode*, size_t>(f, j));
+	}
+
+	//Don't show timing results from deleted filters
+	set<FlowGraphNode*> live(filters.begin(), filters.end());
+	m_session.GetFilterCostModel().PurgeStaleNodes(live);
+}
+
+/**
+	@brief Gets a snapshot of the instrument state that decides which channel and trigger nodes are shown
+
+	Channel enables and availability (e.g. after changing interleaving or sample rate), trigger type, and trigger
+	source are all changed in many places without calling Session::InvalidateGraph(). This only looks at channels, not
+	filters, so it's cheap enough to check every frame.
+ */
+vector<uintptr_t> FilterGraphEditor::GetChannelState()
+{
+	vector<uintptr_t> ret;
+
+	auto insts = m_session.GetInstruments();
+	for(auto inst : insts)
+	{
+		ret.push_back(reinterpret_cast<uintptr_t>(inst.get()));
+
+		auto scope = dynamic_pointer_cast<Oscilloscope>(inst);
+		if(scope)
+		{
+			auto trig = scope->GetTrigger();
+			ret.push_back(reinterpret_cast<uintptr_t>(trig));
+			if(trig && trig->GetInputCount())
+				ret.push_back(reinterpret_cast<uintptr_t>(trig->GetInput(0).m_channel));
+		}
+
+		for(size_t i=0; i<inst->GetChannelCount(); i++)
+		{
+			uintptr_t state = inst->GetChannel(i)->m_visibilityMode;
+			if(scope && (inst->GetInstrumentTypesForChannel(i) & Instrument::INST_OSCILLOSCOPE))
+			{
+				if(scope->CanEnableChannel(i))
+					state |= 0x100;
+				if(scope->IsChannelEnabled(i))
+					state |= 0x200;
+			}
+			ret.push_back(state);
+		}
+	}
 
 	return ret;
 }
@@ -429,9 +535,22 @@ bool FilterGraphEditor::DoRender()
 {
 	bool windowHovered = ImGui::IsWindowHovered();
 
+	//Screen space area the editor is about to fill
+	auto editorMin = ImGui::GetCursorScreenPos();
+	auto editorMax = editorMin + ImGui::GetContentRegionAvail();
+
 	ax::NodeEditor::SetCurrentEditor(m_context);
 	ax::NodeEditor::Begin("Filter Graph", ImVec2(0, 0));
 
+	//Figure out what part of the canvas is visible so we can skip drawing everything else
+	m_visibleCanvasMin = ax::NodeEditor::ScreenToCanvas(editorMin);
+	m_visibleCanvasMax = ax::NodeEditor::ScreenToCanvas(editorMax);
+
+	//Cost predictions depend on instrument settings which may have changed since last frame.
+	//They're only used for the overlay, so don't redo them every frame if we're short on time
+	if(m_budget.IsRefreshFrame())
+		m_costEstimates.clear();
+
 	//Handle dropping a stream or channel from the browser
 	ax::NodeEditor::NodeId newNode;
 	bool nodeAdded = false;
@@ -444,6 +563,7 @@ bool FilterGraphEditor::DoRender()
 			{
 				auto stream = *reinterpret_cast<StreamDescriptor*>(spay->Data);
 				stream.m_channel->m_visibilityMode = InstrumentChannel::VIS_SHOW;
+				m_session.InvalidateGraph();
 
 				nodeAdded = true;
 				newNode = GetID(stream.m_channel);
@@ -457,6 +577,7 @@ bool FilterGraphEditor::DoRender()
 			{
 				auto chan = *reinterpret_cast<InstrumentChannel**>(schan->Data);
 				chan->m_visibilityMode = InstrumentChannel::VIS_SHOW;
+				m_session.InvalidateGraph();
 
 				nodeAdded = true;
 				newNode = GetID(chan);
@@ -483,6 +604,9 @@ bool FilterGraphEditor::DoRender()
 		}
 	}
 
+	//Pick up any changes to the graph structure
+	RefreshGraphModel();
+
 	//Make nodes for all groups
 	RefreshGroupPorts();
 	for(auto it : m_groups)
@@ -490,8 +614,7 @@ bool FilterGraphEditor::DoRender()
 
 	//Make nodes for all instrument channels
 	bool multiInst = (m_session.GetInstrumentCount() > 1);
-	auto chans = GetAllVisibleChannels();
-	for(auto it : chans)
+	for(auto& it : m_modelChannels)
 	{
 		for(auto chan : it.second)
 			DoNodeForChannel(chan, it.first, multiInst);
@@ -502,23 +625,11 @@ bool FilterGraphEditor::DoRender()
 		ax::NodeEditor::SetNodePosition(newNode, ImGui::GetMousePos());
 
 	//Make nodes for all triggers
-	auto insts = m_session.GetInstruments();
-	for(auto inst : insts)
-	{
-		auto scope = dynamic_pointer_cast<Oscilloscope>(inst);
-
-		//Triggers (for now, only scopes have these)
-		if(scope)
-		{
-			auto trig = scope->GetTrigger();
-			if(trig)
-				DoNodeForTrigger(trig);
-		}
-	}
+	for(auto trig : m_modelTriggers)
+		DoNodeForTrigger(trig);
 
 	//Filters
-	auto filters = Filter::GetAllInstances();
-	for(auto f : filters)
+	for(auto f : m_modelFilters)
 	{
 		DoNodeForChannel(f, nullptr, false);
 
@@ -527,62 +638,58 @@ bool FilterGraphEditor::DoRender()
 	}
 	ClearOldPropertiesDialogs();
 
-	//All nodes
-	auto nodes = m_session.GetAllGraphNodes();
-
 	//Add links within groups
 	for(auto it : m_groups)
 		DoInternalLinksForGroup(it.first);
 
 	//Add links from each input to the stream it's fed by
-	set<ax::NodeEditor::LinkId, lessID<ax::NodeEditor::LinkId> > freshLinks;
-	for(auto f : nodes)
+	//(inputs themselves are cached, but what they're connected to is checked every frame)
+	m_freshLinks.clear();
+	for(auto& in : m_modelInputs)
 	{
-		for(size_t i=0; i<f->GetInputCount(); i++)
+		auto stream = in.first->GetInput(in.second);
+		if(stream)
 		{
-			auto stream = f->GetInput(i);
-			if(stream)
-			{
-				auto srcid = GetSourcePinForLink(stream, f);
-				auto dstid = GetSinkPinForLink(stream, pair<FlowGraphNode*, size_t>(f, i));
-				auto linkid = GetID(pair<ax::NodeEditor::PinId, ax::NodeEditor::PinId>(srcid, dstid));
-				freshLinks.emplace(linkid);
-				ax::NodeEditor::Link(linkid, srcid, dstid);
-			}
+			auto srcid = GetSourcePinForLink(stream, in.first);
+			auto dstid = GetSinkPinForLink(stream, in);
+			auto linkid = GetID(pair<ax::NodeEditor::PinId, ax::NodeEditor::PinId>(srcid, dstid));
+			m_freshLinks.push_back(linkid);
+			ax::NodeEditor::Link(linkid, srcid, dstid);
 		}
 	}
 
 	//Add links from each trigger input to the stream it's fed by
-	auto& scopes = m_session.GetScopes();
-	for(auto scope : scopes)
+	for(auto trig : m_modelTriggers)
 	{
-		auto trig = scope->GetTrigger();
-		if(trig)
+		for(size_t i=0; i<trig->GetInputCount(); i++)
 		{
-			for(size_t i=0; i<trig->GetInputCount(); i++)
+			auto stream = trig->GetInput(i);
+			if(stream)
 			{
-				auto stream = trig->GetInput(i);
-				if(stream)
-				{
-					auto srcid = GetSourcePinForLink(stream, trig);
-					auto dstid = GetID(pair<FlowGraphNode*, size_t>(trig, i));
-					auto linkid = GetID(pair<ax::NodeEditor::PinId, ax::NodeEditor::PinId>(srcid, dstid));
-					freshLinks.emplace(linkid);
-					ax::NodeEditor::Link(linkid, srcid, dstid);
-				}
+				auto srcid = GetSourcePinForLink(stream, trig);
+				auto dstid = GetID(pair<FlowGraphNode*, size_t>(trig, i));
+				auto linkid = GetID(pair<ax::NodeEditor::PinId, ax::NodeEditor::PinId>(srcid, dstid));
+				m_freshLinks.push_back(linkid);
+				ax::NodeEditor::Link(linkid, srcid, dstid);
 			}
 		}
 	}
 
-	//Purge any stale entries in our link map
-	set<ax::NodeEditor::LinkId, lessID<ax::NodeEditor::LinkId> > staleLinks;
-	for(auto it : m_linkMap)
+	//Purge any stale entries in our link map.
+	//Every link drawn this frame is in the map, so there's only something to purge if the map is bigger than that
+	if(static_cast<size_t>(distance(m_linkMap.begin(), m_linkMap.end())) > m_freshLinks.size())
 	{
-		if(freshLinks.find(it.second) == freshLinks.end())
-			staleLinks.emplace(it.second);
+		set<ax::NodeEditor::LinkId, lessID<ax::NodeEditor::LinkId> > freshLinks(
+			m_freshLinks.begin(), m_freshLinks.end());
+		set<ax::NodeEditor::LinkId, lessID<ax::NodeEditor::LinkId> > staleLinks;
+		for(auto it : m_linkMap)
+		{
+			if(freshLinks.find(it.second) == freshLinks.end())
+				staleLinks.emplace(it.second);
+		}
+		for(auto lid : staleLinks)
+			m_linkMap.erase(lid);
 	}
-	for(auto lid : staleLinks)
-		m_linkMap.erase(lid);
 
 	//Handle other user input
 	Filter* fReconfigure = nullptr;
@@ -603,9 +710,22 @@ bool FilterGraphEditor::DoRender()
 	//If we don't do that, node content and frames can get one frame out of sync
 	//If we changed the type of a trigger, don't do this as we have stale metadata
 	//TODO: can we dynamically refresh m_nodeGroupMap and anything else impacted?
-	if(!triggerChanged)
+	//Don't fight with the automatic layout while it's running
+	if(triggerChanged)
+		m_session.InvalidateGraph();
+	else if(m_layoutThread)
+		ApplyAutoLayout();
+	else
 		HandleOverlaps();
 
+	//A newly opened graph with no saved positions has everything piled on top of each other, so lay it out properly
+	if(m_checkInitialLayout && !m_modelNodes.empty())
+	{
+		m_checkInitialLayout = false;
+		if(IsGraphPiledUp())
+			StartAutoLayout();
+	}
+
 	//Add top level help text if there's nothing else
 	if(!ax::NodeEditor::GetHoveredNode() && !ax::NodeEditor::GetHoveredLink() && windowHovered)
 	{
@@ -628,8 +748,8 @@ bool FilterGraphEditor::DoRender()
 	}
 
 	//Remove our temporary ref on filters we're rendering
-	//This may cause some to be deleted
-	for(auto f : filters)
+	//This may cause some to be deleted (which changes the filter count, so the model gets rebuilt next frame)
+	for(auto f : m_modelFilters)
 		f->Release();
 
 	return true;
@@ -1069,7 +1189,6 @@ void FilterGraphEditor::OutputPortTooltip(StreamDescriptor stream)
 	@brief Calculates the forces applied to each node in the graph based on interaction physics
  */
 void FilterGraphEditor::CalculateNodeForces(
-	const vector<ax::NodeEditor::NodeId>& nodes,
 	const vector<bool>& isgroup,
 	const vector<bool>& dragging,
 	const vector<bool>& nocollide,
@@ -1077,75 +1196,25 @@ void FilterGraphEditor::CalculateNodeForces(
 	const vector<ImVec2>& sizes,
 	vector<ImVec2>& forces)
 {
-	//Loop over all nodes and find potential collisions
-	for(size_t i=0; i<nodes.size(); i++)
+	//Pack the geometry we already fetched this frame for the solver, so nothing has to go back to the node editor
+	size_t nnodes = positions.size();
+	m_collisionBodies.resize(nnodes);
+	for(size_t i=0; i<nnodes; i++)
 	{
-		if(nocollide[i])
-			continue;
-
-		auto nodeA = nodes[i];
-		auto posA = positions[i];
-		auto sizeA = sizes[i];
-		bool groupA = isgroup[i];
-
-		for(size_t j=i+1; j<nodes.size(); j++)
-		{
-			if(nocollide[j])
-				continue;
-
-			auto nodeB = nodes[j];
-			auto posB = positions[j];
-			auto sizeB = sizes[j];
-			bool groupB = isgroup[j];
-
-			//Check for node-group collisions
-			//Node-node is normal code path, group-group also repels
-			if( (groupA && !groupB) || (!groupA && groupB) )
-			{
-				auto nid = groupA ? nodeB : nodeA;
-				auto gid = groupA ? nodeA : nodeB;
-
-				auto posNode = ax::NodeEditor::GetNodePosition(nid);
-				auto sizeNode = ax::NodeEditor::GetNodeSize(nid);
-
-				auto posGroup = ax::NodeEditor::GetNodePosition(gid);
-				auto sizeGroup = ax::NodeEditor::GetNodeSize(gid);
-
-				//If node is completely INSIDE the group, don't repel
-				if(RectContains(posGroup, sizeGroup, posNode, sizeNode))
-					continue;
-
-				//If dragging group, we should push nodes away
-				//But if dragging the node, allow it to go into the group
-				if( (dragging[i] && !groupA) || (dragging[j] && !groupB) )
-					continue;
-			}
-
-			//If no overlap, no action required
-			if(!RectIntersect(posA, sizeA, posB, sizeB))
-				continue;
-
-			//We have an overlap!
-			//Find the unit vector between the node positions
-			float dx = posB.x - posA.x;
-			float dy = posB.y - posA.y;
-			float mag = sqrt(dx*dx + dy*dy);
-			ImVec2 force;
-			if(mag > 1e-2)
-				force = ImVec2(dx / mag, dy / mag);
+		auto& body = m_collisionBodies[i];
+		body.m_x = positions[i].x;
+		body.m_y = positions[i].y;
+		body.m_width = sizes[i].x;
+		body.m_height = sizes[i].y;
+		body.m_isGroup = isgroup[i];
+		body.m_dragging = dragging[i];
+		body.m_collide = !nocollide[i];
+	}
 
-			//If nodes are exactly on top of each other apply a force in a random direction
-			else
-			{
-				float theta = fmodf(rand() * 1e-3f, 2*M_PI);
-				force = ImVec2(sin(theta), cos(theta));
-			}
+	m_collisionSolver.CalculateForces(m_collisionBodies);
 
-			//Add this to the existing force vector
-			forces[i] -= force;
-			forces[j] += force;
-		}
-	}
+	for(size_t i=0; i<nnodes; i++)
+		forces[i] = ImVec2(m_collisionBodies[i].m_forceX, m_collisionBodies[i].m_forceY);
 }
 
 /**
@@ -1269,6 +1338,23 @@ void FilterGraphEditor::HandleOverlaps()
 		isgroup[i] = m_groups.HasEntry(nodes[i]);
 	}
 
+	//If nothing moved or changed size since the last time we found no overlaps, there's nothing to do
+	if(m_layoutSettled && (positions.size() == m_settledPositions.size()) )
+	{
+		bool moved = false;
+		for(int i=0; i<nnodes; i++)
+		{
+			if( (positions[i].x != m_settledPositions[i].x) || (positions[i].y != m_settledPositions[i].y) ||
+				(sizes[i].x != m_settledSizes[i].x) || (sizes[i].y != m_settledSizes[i].y) )
+			{
+				moved = true;
+				break;
+			}
+		}
+		if(!moved)
+			return;
+	}
+
 	//Find nodes which should not have collision detection applied to them
 	//(e.g. virtual nodes for group input/output regions)
 	vector<bool> nocollide;
@@ -1315,7 +1401,27 @@ void FilterGraphEditor::HandleOverlaps()
 	}
 
 	//Calculate forces from interaction physics
-	CalculateNodeForces(nodes, isgroup, dragging, nocollide, positions, sizes, forces);
+	CalculateNodeForces(isgroup, dragging, nocollide, positions, sizes, forces);
+
+	//If nothing is being pushed, remember where everything is so we can skip the work until something moves
+	m_layoutSettled = true;
+	for(auto f : forces)
+	{
+		if(sqrt(f.x*f.x + f.y*f.y) >= 1e-2)
+		{
+			m_layoutSettled = false;
+			break;
+		}
+	}
+	if(m_layoutSettled)
+	{
+		m_settledPositions = positions;
+		m_settledSizes = sizes;
+	}
+
+	//Nodes are still pushing each other apart, keep drawing frames until they settle even if there's no input
+	else
+		m_parent->RequestRedraw();
 
 	//DEBUG: save the forces
 	m_nodeForces.clear();
@@ -1328,6 +1434,156 @@ void FilterGraphEditor::HandleOverlaps()
 	ApplyNodeForces(nodes, isgroup, dragging, positions, forces);
 }
 
+/**
+	@brief Checks if a lot of nodes are sitting on top of each other (e.g. a session saved without node positions)
+ */
+bool FilterGraphEditor::IsGraphPiledUp()
+{
+	set< pair<float, float> > positions;
+	size_t duplicates = 0;
+	for(auto node : m_modelNodes)
+	{
+		auto pos = ax::NodeEditor::GetNodePosition(GetID(node));
+		if(!positions.emplace(pair<float, float>(pos.x, pos.y)).second)
+			duplicates ++;
+	}
+
+	return (duplicates >= 2) && (duplicates >= m_modelNodes.size() / 4);
+}
+
+/**
+	@brief Starts calculating an automatic layout for the whole graph in the background
+
+	The current graph structure and node sizes are copied into m_layout, so nothing on the background thread touches
+	the node editor. ApplyAutoLayout() moves the nodes once it's done.
+ */
+void FilterGraphEditor::StartAutoLayout()
+{
+	if(m_layoutThread)
+		return;
+
+	m_layout = FilterGraphLayout();
+	m_layoutNodeIDs.clear();
+	m_layoutGroupIDs.clear();
+
+	//Groups need room for the title and the hierarchical port nodes down each side
+	auto headerfont = m_parent->GetFontPref("Appearance.Filter Graph.header_font");
+	float headerheight = headerfont->FontSize * ImGui::GetIO().FontGlobalScale * 1.5;
+	auto gborder = ax::NodeEditor::GetStyle().GroupBorderWidth;
+	auto gpad = ax::NodeEditor::GetStyle().NodePadding.x;
+	map<ax::NodeEditor::NodeId, int, lessID<ax::NodeEditor::NodeId> > groupIndex;
+	for(auto it : m_groups)
+	{
+		auto group = it.first;
+		groupIndex[it.second] = m_layoutGroupIDs.size();
+		m_layoutGroupIDs.push_back(it.second);
+
+		FilterGraphLayoutGroup lgroup;
+		lgroup.m_padLeft = ax::NodeEditor::GetNodeSize(group->m_inputId).x + 2*(gborder + gpad);
+		lgroup.m_padRight = ax::NodeEditor::GetNodeSize(group->m_outputId).x + 4*(gborder + gpad);
+		lgroup.m_padTop = headerheight + gborder + gpad;
+		lgroup.m_padBottom = gborder + gpad;
+		m_layout.m_groups.push_back(lgroup);
+	}
+
+	//Add all of the nodes
+	map<FlowGraphNode*, size_t> nodeIndex;
+	for(auto node : m_modelNodes)
+	{
+		auto id = GetID(node);
+		int group = -1;
+		for(auto it : m_groups)
+		{
+			if(it.first->m_children.find(id) != it.first->m_children.end())
+			{
+				group = groupIndex[it.second];
+				break;
+			}
+		}
+
+		auto size = ax::NodeEditor::GetNodeSize(id);
+		nodeIndex[node] = m_layout.m_nodes.size();
+		m_layout.m_nodes.push_back(FilterGraphLayoutNode(size.x, size.y, group));
+		m_layoutNodeIDs.push_back(id);
+	}
+
+	//and the links between them
+	auto addEdge = [&](FlowGraphNode* src, FlowGraphNode* dst)
+	{
+		auto from = nodeIndex.find(src);
+		auto to = nodeIndex.find(dst);
+		if( (from != nodeIndex.end()) && (to != nodeIndex.end()) )
+			m_layout.m_edges.push_back(pair<size_t, size_t>(from->second, to->second));
+	};
+	for(auto& in : m_modelInputs)
+	{
+		auto stream = in.first->GetInput(in.second);
+		if(stream)
+			addEdge(stream.m_channel, in.first);
+	}
+	for(auto trig : m_modelTriggers)
+	{
+		for(size_t i=0; i<trig->GetInputCount(); i++)
+		{
+			auto stream = trig->GetInput(i);
+			if(stream)
+				addEdge(stream.m_channel, trig);
+		}
+	}
+
+	LogTrace("Starting automatic layout of %zu nodes, %zu groups, %zu links\n",
+		m_layout.m_nodes.size(), m_layout.m_groups.size(), m_layout.m_edges.size());
+
+	m_layoutDone = false;
+	m_layoutThread = make_unique<thread>([this]
+	{
+		double start = GetTime();
+		m_layout.Run();
+		LogTrace("Automatic layout took %.3f ms (%zu crossings)\n", (GetTime() - start) * 1000, m_layout.m_crossings);
+		m_layoutDone = true;
+	});
+}
+
+/**
+	@brief Moves nodes to the positions calculated by StartAutoLayout(), if it's finished
+ */
+void FilterGraphEditor::ApplyAutoLayout()
+{
+	if(!m_layoutDone)
+		return;
+	m_layoutThread->join();
+	m_layoutThread = nullptr;
+
+	//Nodes may have been deleted while we were busy, skip anything that's gone
+	set<ax::NodeEditor::NodeId, lessID<ax::NodeEditor::NodeId> > liveNodes;
+	for(auto node : m_modelNodes)
+		liveNodes.emplace(GetID(node));
+
+	for(size_t i=0; i<m_layoutNodeIDs.size(); i++)
+	{
+		auto id = m_layoutNodeIDs[i];
+		if(liveNodes.find(id) == liveNodes.end())
+			continue;
+
+		auto& node = m_layout.m_nodes[i];
+		ax::NodeEditor::SetNodePosition(id, ImVec2(node.m_x, node.m_y));
+	}
+
+	for(size_t i=0; i<m_layoutGroupIDs.size(); i++)
+	{
+		auto gid = m_layoutGroupIDs[i];
+		if(!m_groups.HasEntry(gid))
+			continue;
+
+		auto& group = m_layout.m_groups[i];
+		ax::NodeEditor::SetNodePosition(gid, ImVec2(group.m_x, group.m_y));
+		ax::NodeEditor::SetGroupSize(gid, ImVec2(group.m_width, group.m_height));
+	}
+
+	//Everything moved, so the collision solver has to look again
+	m_layoutSettled = false;
+}
+
 /**
 	@brief Gets the actual source/sink pin given a pin which might be a hierarchical port
  */
@@ -1963,12 +2219,20 @@ void FilterGraphEditor::DoNodeForChannel(InstrumentChannel* channel, shared_ptr<
 	float rounding = ax::NodeEditor::GetStyle().NodeRounding;
 
 	auto id = GetID(channel);
+
+	//If the node is off screen, just keep its pins in the right place for the links and don't draw anything else
+	auto pos = ax::NodeEditor::GetNodePosition(id);
+	auto size = ax::NodeEditor::GetNodeSize(id);
+	if(!IsNodeVisible(pos, size))
+	{
+		DoPlaceholderNodeForChannel(channel, id, size, headerheight);
+		return;
+	}
+
 	ax::NodeEditor::BeginNode(id);
 	ImGui::PushID(id.AsPointer());
 
 	//Get node info
-	auto pos = ax::NodeEditor::GetNodePosition(id);
-	auto size = ax::NodeEditor::GetNodeSize(id);
 	string headerText = channel->GetDisplayName();
 
 	//If >1 instrument connected, scope by instrument name
@@ -2098,6 +2362,10 @@ void FilterGraphEditor::DoNodeForChannel(InstrumentChannel* channel, shared_ptr<
 	if(contentHeight < minHeight)
 		ImGui::Dummy(ImVec2(1, minHeight - contentHeight));
 
+	//Measured and predicted cost
+	if(m_showNodeCost && f)
+		DoCostForFilter(f);
+
 	//Tooltip on hovered output port
 	if(hoveredStream)
 	{
@@ -2158,6 +2426,189 @@ void FilterGraphEditor::DoNodeForChannel(InstrumentChannel* channel, shared_ptr<
 		blocktype.c_str());
 }
 
+/**
+	@brief Checks if any part of a node (as of the last frame) is within the visible area of the canvas
+
+	Nodes which haven't been drawn yet, and so don't have a size, are always considered visible.
+ */
+bool FilterGraphEditor::IsNodeVisible(ImVec2 pos, ImVec2 size)
+{
+	if( (size.x <= 0) || (size.y <= 0) )
+		return true;
+
+	//Keep a bit of slack around the edges so nodes don't pop in as they scroll on screen
+	float margin = ImGui::GetFontSize() * 4;
+	if( (pos.x + size.x + margin < m_visibleCanvasMin.x) || (pos.x - margin > m_visibleCanvasMax.x) )
+		return false;
+	if( (pos.y + size.y + margin < m_visibleCanvasMin.y) || (pos.y - margin > m_visibleCanvasMax.y) )
+		return false;
+	return true;
+}
+
+/**
+	@brief Displays the last measured and predicted cost of a filter inside its node
+
+	The prediction is for the depth the instruments are currently set to, so it can be checked before arming.
+ */
+void FilterGraphEditor::DoCostForFilter(Filter* f)
+{
+	Unit fs(Unit::UNIT_FS);
+	Unit bytes(Unit::UNIT_BYTES);
+	Unit samples(Unit::UNIT_SAMPLEDEPTH);
+
+	FilterCostSample last;
+	string str;
+	if(m_session.GetFilterCostModel().GetLastSample(f, last))
+		str = "Last: " + fs.PrettyPrint(last.m_execTime) + ", " + bytes.PrettyPrint(last.m_outputBytes);
+	else
+		str = "Last: not run yet";
+	ImGui::TextUnformatted(str.c_str());
+
+	auto& est = EstimateCost(f);
+	if(!est.m_known)
+	{
+		ImGui::TextUnformatted("Est: unknown");
+		return;
+	}
+
+	str = "Est: " + fs.PrettyPrint(est.m_cost.m_execTime) + ", " + bytes.PrettyPrint(est.m_cost.m_outputBytes) +
+		" @ " + samples.PrettyPrint(est.m_cost.m_inputDepth);
+
+	//Highlight nodes at the end of an overly slow chain
+	auto threshold = m_session.GetPreferences().GetReal("Appearance.Filter Graph.cost_warning_threshold");
+	if(est.m_pathTime > threshold)
+	{
+		auto color = m_session.GetPreferences().GetColor("Appearance.Filter Graph.invalid_link_color");
+		ImGui::PushStyleColor(ImGuiCol_Text, color);
+			ImGui::TextUnformatted(str.c_str());
+			str = "Path: " + fs.PrettyPrint(est.m_pathTime);
+			ImGui::TextUnformatted(str.c_str());
+		ImGui::PopStyleColor();
+	}
+	else
+		ImGui::TextUnformatted(str.c_str());
+}
+
+/**
+	@brief Predicts the cost of a filter at the depth its inputs will have after the next trigger
+
+	Results are cached in m_costEstimates until the next refresh frame or graph change.
+ */
+const NodeCostEstimate& FilterGraphEditor::EstimateCost(Filter* f)
+{
+	auto it = m_costEstimates.find(f);
+	if(it != m_costEstimates.end())
+		return it->second;
+
+	//Insert a placeholder before recursing, just in case
+	m_costEstimates[f] = NodeCostEstimate();
+
+	NodeCostEstimate est;
+	size_t depth = EstimateInputDepth(f);
+	est.m_known = m_session.GetFilterCostModel().Estimate(f->GetProtocolDisplayName(), depth, est.m_cost);
+
+	//If we've never seen this filter run, assume it doesn't change the depth of the data passing through it
+	if(!est.m_known)
+	{
+		est.m_cost.m_inputDepth = depth;
+		est.m_cost.m_outputDepth = depth;
+	}
+
+	//Slowest upstream chain
+	int64_t upstreamTime = 0;
+	for(size_t i=0; i<f->GetInputCount(); i++)
+	{
+		auto upstream = dynamic_cast<Filter*>(f->GetInput(i).m_channel);
+		if(upstream)
+			upstreamTime = max(upstreamTime, EstimateCost(upstream).m_pathTime);
+	}
+	est.m_pathTime = upstreamTime + est.m_cost.m_execTime;
+
+	m_costEstimates[f] = est;
+	return m_costEstimates[f];
+}
+
+/**
+	@brief Figures out how deep the deepest input to a filter will be after the next trigger
+
+	Instrument channels use the configured memory depth of the scope rather than the size of the current waveform,
+	so that changes to the depth are reflected before arming. Filter outputs use the predicted depth of the filter.
+ */
+size_t FilterGraphEditor::EstimateInputDepth(Filter* f)
+{
+	size_t depth = 0;
+	for(size_t i=0; i<f->GetInputCount(); i++)
+	{
+		auto stream = f->GetInput(i);
+		if(stream.m_channel == nullptr)
+			continue;
+
+		auto upstream = dynamic_cast<Filter*>(stream.m_channel);
+		auto ochan = dynamic_cast<OscilloscopeChannel*>(stream.m_channel);
+		if(upstream)
+			depth = max(depth, EstimateCost(upstream).m_cost.m_outputDepth);
+		else if(ochan && ochan->GetScope())
+			depth = max(depth, static_cast<size_t>(ochan->GetScope()->GetSampleDepth()));
+		else
+		{
+			auto data = stream.GetData();
+			if(data)
+				depth = max(depth, data->size());
+		}
+	}
+	return depth;
+}
+
+/**
+	@brief Make a cheap stand-in for an off screen channel node
+
+	The node keeps the size it had when it was last drawn, and has its pins at roughly the same place as the real
+	ones so links to it still end in the right spot. None of the text, icons, or port tables are generated.
+ */
+void FilterGraphEditor::DoPlaceholderNodeForChannel(
+	InstrumentChannel* channel,
+	ax::NodeEditor::NodeId id,
+	ImVec2 size,
+	float headerheight)
+{
+	auto& style = ax::NodeEditor::GetStyle();
+	ImVec2 inner(
+		size.x - (style.NodePadding.x + style.NodePadding.z),
+		size.y - (style.NodePadding.y + style.NodePadding.w));
+
+	ax::NodeEditor::BeginNode(id);
+	ImGui::PushID(id.AsPointer());
+
+	auto start = ImGui::GetCursorPos();
+	float rowheight = ImGui::GetTextLineHeight() + ImGui::GetStyle().CellPadding.y*2;
+	float firstrow = start.y + headerheight + ImGui::GetStyle().ItemSpacing.y;
+	ImVec2 pinsize(1, ImGui::GetTextLineHeight());
+
+	for(size_t i=0; i<channel->GetInputCount(); i++)
+	{
+		ImGui::SetCursorPos(ImVec2(start.x, firstrow + i*rowheight));
+		ax::NodeEditor::BeginPin(GetID(pair<InstrumentChannel*, size_t>(channel, i)), ax::NodeEditor::PinKind::Input);
+			ax::NodeEditor::PinPivotAlignment(ImVec2(0, 0.5));
+			ImGui::Dummy(pinsize);
+		ax::NodeEditor::EndPin();
+	}
+	for(size_t i=0; i<channel->GetStreamCount(); i++)
+	{
+		ImGui::SetCursorPos(ImVec2(start.x + inner.x - pinsize.x, firstrow + i*rowheight));
+		ax::NodeEditor::BeginPin(GetID(StreamDescriptor(channel, i)), ax::NodeEditor::PinKind::Output);
+			ax::NodeEditor::PinPivotAlignment(ImVec2(1, 0.5));
+			ImGui::Dummy(pinsize);
+		ax::NodeEditor::EndPin();
+	}
+
+	//Reserve the full size of the node
+	ImGui::SetCursorPos(start);
+	ImGui::Dummy(inner);
+
+	ImGui::PopID();
+	ax::NodeEditor::EndNode();
+}
+
 void FilterGraphEditor::RenderForceVector(ImDrawList* list, ImVec2 pos, ImVec2 size, ImVec2 vec)
 {
 	//uncomment to enable this for debugging
@@ -2481,6 +2932,19 @@ void FilterGraphEditor::DoAddMenu()
 
 		m_groups.emplace(group, id);
 	}
+
+	if(ImGui::MenuItem("Auto Layout", nullptr, false, !m_layoutThread))
+		StartAutoLayout();
+
+	if(ImGui::MenuItem("Show Node Cost", nullptr, m_showNodeCost))
+	{
+		m_showNodeCost = !m_showNodeCost;
+		m_session.SetFilterProfilingEnabled(m_showNodeCost);
+
+		//Run everything once so we have numbers to show right away
+		if(m_showNodeCost)
+			m_session.RefreshAllFiltersNonblocking();
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +38,8 @@
 #include "Dialog.h"
 #include "Session.h"
 #include "Bijection.h"
+#include "NodeCollisionSolver.h"
+#include "FilterGraphLayout.h"
 class EmbeddableDialog;
 
 #include <imgui_node_editor.h>
@@ -72,6 +74,27 @@ public:
 	}
 };
 
+/**
+	@brief Predicted cost of running a filter node at the depth the instruments are currently configured for
+ */
+class NodeCostEstimate
+{
+public:
+	NodeCostEstimate()
+	: m_known(false)
+	, m_pathTime(0)
+	{}
+
+	///@brief Predicted cost of the node itself
+	FilterCostSample m_cost;
+
+	///@brief True if we have measurements for this filter type to base the prediction on
+	bool m_known;
+
+	///@brief Predicted run time of the slowest chain of filters ending at (and including) this node, in fs
+	int64_t m_pathTime;
+};
+
 class FilterGraphEditor;
 
 class FilterGraphGroup
@@ -166,7 +189,9 @@ protected:
 	friend class FilterGraphGroup;
 
 	std::map<std::shared_ptr<Instrument>, std::vector<InstrumentChannel*> > GetAllVisibleChannels();
-	std::vector<FlowGraphNode*> GetAllNodes();
+	const std::vector<FlowGraphNode*>& GetAllNodes();
+	void RefreshGraphModel();
+	std::vector<uintptr_t> GetChannelState();
 
 	void RefreshGroupPorts();
 
@@ -178,6 +203,15 @@ protected:
 	void DoNodeForGroupOutputs(std::shared_ptr<FilterGraphGroup> group);
 	void DoNodeForGroupInputs(std::shared_ptr<FilterGraphGroup> group);
 	void DoNodeForChannel(InstrumentChannel* channel, std::shared_ptr<Instrument> inst, bool multiInst);
+	bool IsNodeVisible(ImVec2 pos, ImVec2 size);
+	void DoCostForFilter(Filter* f);
+	const NodeCostEstimate& EstimateCost(Filter* f);
+	size_t EstimateInputDepth(Filter* f);
+	void DoPlaceholderNodeForChannel(
+		InstrumentChannel* channel,
+		ax::NodeEditor::NodeId id,
+		ImVec2 size,
+		float headerheight);
 	void DoNodeForTrigger(Trigger* trig);
 	bool HandleNodeProperties();
 	void HandleDoubleClicks();
@@ -188,8 +222,10 @@ protected:
 	bool IsBackEdge(FlowGraphNode* src, FlowGraphNode* dst);
 
 	void HandleOverlaps();
+	bool IsGraphPiledUp();
+	void StartAutoLayout();
+	void ApplyAutoLayout();
 	void CalculateNodeForces(
-		const std::vector<ax::NodeEditor::NodeId>& nodes,
 		const std::vector<bool>& isgroup,
 		const std::vector<bool>& dragging,
 		const std::vector<bool>& nocollide,
@@ -244,6 +280,39 @@ protected:
 		lessIDPair,
 		lessID<ax::NodeEditor::LinkId> > m_linkMap;
 
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Cached graph structure, rebuilt by RefreshGraphModel() only when the session says the graph changed
+
+	///@brief Value of Session::GetGraphRevision() when the model was last built
+	uint64_t m_modelRevision;
+
+	///@brief Number of filters in existence when the model was last built (catches filters deleted by refcount)
+	size_t m_modelFilterCount;
+
+	///@brief False if the model has never been built
+	bool m_modelValid;
+
+	///@brief Value of GetChannelState() when the model was last built
+	std::vector<uintptr_t> m_modelChannelState;
+
+	///@brief Channels we're displaying nodes for, by instrument
+	std::map<std::shared_ptr<Instrument>, std::vector<InstrumentChannel*> > m_modelChannels;
+
+	///@brief Triggers we're displaying nodes for
+	std::vector<Trigger*> m_modelTriggers;
+
+	///@brief Filters we're displaying nodes for
+	std::vector<Filter*> m_modelFilters;
+
+	///@brief Every node we're displaying (channels, triggers, and filters)
+	std::vector<FlowGraphNode*> m_modelNodes;
+
+	///@brief Every input of every filter or channel which might have a link drawn to it
+	std::vector<std::pair<FlowGraphNode*, size_t> > m_modelInputs;
+
+	///@brief Link IDs drawn this frame (kept around to avoid reallocating)
+	std::vector<ax::NodeEditor::LinkId> m_freshLinks;
+
 	///@brief Map of signal sources to the group the source node is in (if there is one)
 	Bijection<FlowGraphNode*, std::shared_ptr<FilterGraphGroup> > m_nodeGroupMap;
 
@@ -294,6 +363,51 @@ protected:
 		lessID<ax::NodeEditor::NodeId>
 		 > m_groups;
 
+	///@brief Top left corner of the visible part of the canvas, as of the current frame
+	ImVec2 m_visibleCanvasMin;
+
+	///@brief Bottom right corner of the visible part of the canvas, as of the current frame
+	ImVec2 m_visibleCanvasMax;
+
+	///@brief True if we should show measured and predicted cost of each filter
+	bool m_showNodeCost;
+
+	///@brief Cost predictions for each filter, recalculated every frame while m_showNodeCost is set
+	std::map<Filter*, NodeCostEstimate> m_costEstimates;
+
+	///@brief Broadphase and force calculation for overlapping nodes
+	NodeCollisionSolver m_collisionSolver;
+
+	///@brief Per-frame node geometry passed to m_collisionSolver
+	std::vector<NodeCollisionBody> m_collisionBodies;
+
+	///@brief True if the last force calculation found no overlaps
+	bool m_layoutSettled;
+
+	///@brief True until we've checked if a newly opened graph needs laying out
+	bool m_checkInitialLayout;
+
+	///@brief Background thread running automatic layout, if one is in progress
+	std::unique_ptr<std::thread> m_layoutThread;
+
+	///@brief Set by m_layoutThread once m_layout has been calculated
+	std::atomic<bool> m_layoutDone;
+
+	///@brief Automatic layout being calculated by m_layoutThread
+	FilterGraphLayout m_layout;
+
+	///@brief Node IDs corresponding to m_layout.m_nodes
+	std::vector<ax::NodeEditor::NodeId> m_layoutNodeIDs;
+
+	///@brief Group IDs corresponding to m_layout.m_groups
+	std::vector<ax::NodeEditor::NodeId> m_layoutGroupIDs;
+
+	///@brief Node positions as of the last time the layout settled
+	std::vector<ImVec2> m_settledPositions;
+
+	///@brief Node sizes as of the last time the layout settled
+	std::vector<ImVec2> m_settledSizes;
+
 	//DEBUG: forces for display
 	std::map<
 		ax::NodeEditor::NodeId,
@@ -0,0 +1,593 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of FilterGraphLayout
+ */
+
+#include "../scopehal/scopehal.h"
+#include "FilterGraphLayout.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+FilterGraphLayout::FilterGraphLayout()
+	: m_columnSpacing(80)
+	, m_rowSpacing(20)
+	, m_emptyGroupSize(240)
+	, m_crossings(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Top level layout
+
+/**
+	@brief Calculates positions for all nodes and groups
+ */
+void FilterGraphLayout::Run()
+{
+	m_crossings = 0;
+	size_t ngroups = m_groups.size();
+
+	//Figure out what's in each group
+	vector< vector<size_t> > members(ngroups);
+	vector<size_t> localIndex(m_nodes.size(), 0);
+	for(size_t i=0; i<m_nodes.size(); i++)
+	{
+		auto g = m_nodes[i].m_group;
+		if( (g < 0) || (static_cast<size_t>(g) >= ngroups) )
+		{
+			m_nodes[i].m_group = -1;
+			continue;
+		}
+		localIndex[i] = members[g].size();
+		members[g].push_back(i);
+	}
+
+	//Lay out the contents of each group on its own
+	for(size_t g=0; g<ngroups; g++)
+	{
+		auto& group = m_groups[g];
+
+		vector<Item> items;
+		for(auto i : members[g])
+			items.push_back(Item(m_nodes[i].m_width, m_nodes[i].m_height));
+
+		vector< pair<size_t, size_t> > edges;
+		for(auto e : m_edges)
+		{
+			if( (m_nodes[e.first].m_group == (int)g) && (m_nodes[e.second].m_group == (int)g) )
+				edges.push_back(pair<size_t, size_t>(localIndex[e.first], localIndex[e.second]));
+		}
+
+		m_crossings += LayoutSubgraph(items, edges);
+
+		//Node positions are relative to the group for now
+		float width = 0;
+		float height = 0;
+		for(size_t j=0; j<items.size(); j++)
+		{
+			auto& node = m_nodes[members[g][j]];
+			node.m_x = items[j].m_x;
+			node.m_y = items[j].m_y;
+			width = max(width, items[j].m_x + items[j].m_width);
+			height = max(height, items[j].m_y + items[j].m_height);
+		}
+		if(items.empty())
+		{
+			width = m_emptyGroupSize;
+			height = m_emptyGroupSize;
+		}
+
+		group.m_width = group.m_padLeft + width + group.m_padRight;
+		group.m_height = group.m_padTop + height + group.m_padBottom;
+	}
+
+	//Top level graph: ungrouped nodes, plus one big node per group
+	vector<Item> items;
+	vector<size_t> topIndex(m_nodes.size());
+	vector<size_t> groupIndex(ngroups);
+	for(size_t g=0; g<ngroups; g++)
+	{
+		groupIndex[g] = items.size();
+		items.push_back(Item(m_groups[g].m_width, m_groups[g].m_height));
+	}
+	for(size_t i=0; i<m_nodes.size(); i++)
+	{
+		auto g = m_nodes[i].m_group;
+		if(g >= 0)
+			topIndex[i] = groupIndex[g];
+		else
+		{
+			topIndex[i] = items.size();
+			items.push_back(Item(m_nodes[i].m_width, m_nodes[i].m_height));
+		}
+	}
+
+	vector< pair<size_t, size_t> > edges;
+	for(auto e : m_edges)
+	{
+		auto from = topIndex[e.first];
+		auto to = topIndex[e.second];
+		if(from != to)
+			edges.push_back(pair<size_t, size_t>(from, to));
+	}
+
+	m_crossings += LayoutSubgraph(items, edges);
+
+	//Move everything into its final position
+	for(size_t g=0; g<ngroups; g++)
+	{
+		auto& item = items[groupIndex[g]];
+		m_groups[g].m_x = item.m_x;
+		m_groups[g].m_y = item.m_y;
+	}
+	for(size_t i=0; i<m_nodes.size(); i++)
+	{
+		auto& node = m_nodes[i];
+		if(node.m_group >= 0)
+		{
+			auto& group = m_groups[node.m_group];
+			node.m_x += group.m_x + group.m_padLeft;
+			node.m_y += group.m_y + group.m_padTop;
+		}
+		else
+		{
+			node.m_x = items[topIndex[i]].m_x;
+			node.m_y = items[topIndex[i]].m_y;
+		}
+	}
+}
+
+/**
+	@brief Lays out a single graph with no grouping
+
+	@param items	Nodes to place. Positions are filled in on return, starting from (0, 0)
+	@param edges	Edges between nodes (source index, sink index). Duplicates and cycles are allowed
+
+	@return Number of edge crossings in the final layout
+ */
+size_t FilterGraphLayout::LayoutSubgraph(vector<Item>& items, const vector< pair<size_t, size_t> >& edges)
+{
+	if(items.empty())
+		return 0;
+	size_t nreal = items.size();
+
+	//Remove self loops and duplicate edges
+	vector< pair<size_t, size_t> > cleanEdges;
+	for(auto e : edges)
+	{
+		if(e.first != e.second)
+			cleanEdges.push_back(e);
+	}
+	sort(cleanEdges.begin(), cleanEdges.end());
+	cleanEdges.erase(unique(cleanEdges.begin(), cleanEdges.end()), cleanEdges.end());
+
+	AssignLayers(items, cleanEdges);
+
+	vector< vector<size_t> > layers;
+	InsertDummies(items, cleanEdges, layers);
+
+	size_t crossings = MinimizeCrossings(items, layers);
+	AssignCoordinates(items, layers);
+
+	//Dummy nodes are no longer needed
+	items.resize(nreal);
+	return crossings;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Layering
+
+/**
+	@brief Assigns each node to a column, reversing edges as needed to break cycles
+ */
+void FilterGraphLayout::AssignLayers(vector<Item>& items, vector< pair<size_t, size_t> >& edges)
+{
+	size_t n = items.size();
+
+	vector< vector<size_t> > out(n);
+	for(size_t i=0; i<edges.size(); i++)
+		out[edges[i].first].push_back(i);
+
+	//Break cycles: any edge pointing back to a node still on the DFS stack gets reversed
+	vector<uint8_t> state(n, 0);		//0 = unvisited, 1 = on stack, 2 = done
+	vector< pair<size_t, size_t> > stack;
+	for(size_t root=0; root<n; root++)
+	{
+		if(state[root] != 0)
+			continue;
+
+		state[root] = 1;
+		stack.push_back(pair<size_t, size_t>(root, 0));
+		while(!stack.empty())
+		{
+			auto& top = stack.back();
+			auto v = top.first;
+			if(top.second >= out[v].size())
+			{
+				state[v] = 2;
+				stack.pop_back();
+				continue;
+			}
+
+			auto& e = edges[out[v][top.second]];
+			top.second ++;
+
+			if(state[e.second] == 1)
+				swap(e.first, e.second);
+			else if(state[e.second] == 0)
+			{
+				state[e.second] = 1;
+				stack.push_back(pair<size_t, size_t>(e.second, 0));
+			}
+		}
+	}
+
+	//Reversing may have created duplicates of existing edges
+	sort(edges.begin(), edges.end());
+	edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+	for(auto& item : items)
+	{
+		item.m_preds.clear();
+		item.m_succs.clear();
+	}
+	vector<size_t> indegree(n, 0);
+	for(auto e : edges)
+	{
+		items[e.first].m_succs.push_back(e.second);
+		indegree[e.second] ++;
+	}
+
+	vector<bool> hasPreds(n);
+	for(size_t i=0; i<n; i++)
+		hasPreds[i] = (indegree[i] != 0);
+
+	//Longest path layering, in topological order
+	vector<size_t> order;
+	order.reserve(n);
+	for(size_t i=0; i<n; i++)
+	{
+		items[i].m_layer = 0;
+		if(indegree[i] == 0)
+			order.push_back(i);
+	}
+	for(size_t i=0; i<order.size(); i++)
+	{
+		auto v = order[i];
+		for(auto s : items[v].m_succs)
+		{
+			items[s].m_layer = max(items[s].m_layer, items[v].m_layer + 1);
+			if(--indegree[s] == 0)
+				order.push_back(s);
+		}
+	}
+
+	//Pull nodes with no inputs over so they sit right before whatever they feed, rather than all in the first column
+	for(size_t i=order.size(); i>0; i--)
+	{
+		auto& item = items[order[i-1]];
+		if(item.m_succs.empty() || hasPreds[order[i-1]])
+			continue;
+
+		size_t layer = SIZE_MAX;
+		for(auto s : item.m_succs)
+			layer = min(layer, items[s].m_layer);
+		item.m_layer = layer - 1;
+	}
+
+	for(auto& item : items)
+		item.m_succs.clear();
+}
+
+/**
+	@brief Splits edges spanning more than one column into chains of dummy nodes, and builds the list of columns
+ */
+void FilterGraphLayout::InsertDummies(
+	vector<Item>& items,
+	const vector< pair<size_t, size_t> >& edges,
+	vector< vector<size_t> >& layers)
+{
+	size_t nlayers = 0;
+	for(auto& item : items)
+		nlayers = max(nlayers, item.m_layer + 1);
+	layers.clear();
+	layers.resize(nlayers);
+	for(size_t i=0; i<items.size(); i++)
+		layers[items[i].m_layer].push_back(i);
+
+	for(auto e : edges)
+	{
+		size_t prev = e.first;
+		for(size_t layer = items[e.first].m_layer + 1; layer < items[e.second].m_layer; layer++)
+		{
+			size_t dummy = items.size();
+			items.push_back(Item());
+			items[dummy].m_layer = layer;
+			layers[layer].push_back(dummy);
+
+			items[prev].m_succs.push_back(dummy);
+			items[dummy].m_preds.push_back(prev);
+			prev = dummy;
+		}
+
+		items[prev].m_succs.push_back(e.second);
+		items[e.second].m_preds.push_back(prev);
+	}
+
+	for(auto& layer : layers)
+	{
+		for(size_t i=0; i<layer.size(); i++)
+			items[layer[i]].m_order = i;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Crossing minimization
+
+/**
+	@brief Reorders nodes within each column to reduce edge crossings, using the barycenter heuristic
+
+	@return Number of crossings in the best ordering found
+ */
+size_t FilterGraphLayout::MinimizeCrossings(vector<Item>& items, vector< vector<size_t> >& layers)
+{
+	auto best = CountCrossings(items, layers);
+	auto bestLayers = layers;
+
+	//Alternate left-to-right and right-to-left sweeps, keeping the best result
+	const size_t maxSweeps = 24;
+	for(size_t sweep=0; (sweep < maxSweeps) && (best > 0); sweep++)
+	{
+		if( (sweep % 2) == 0)
+		{
+			for(size_t i=1; i<layers.size(); i++)
+				OrderLayer(items, layers[i], true);
+		}
+		else
+		{
+			for(size_t i=layers.size()-1; i>0; i--)
+				OrderLayer(items, layers[i-1], false);
+		}
+
+		auto crossings = CountCrossings(items, layers);
+		if(crossings < best)
+		{
+			best = crossings;
+			bestLayers = layers;
+		}
+	}
+
+	layers = bestLayers;
+	for(auto& layer : layers)
+	{
+		for(size_t i=0; i<layer.size(); i++)
+			items[layer[i]].m_order = i;
+	}
+
+	return best;
+}
+
+/**
+	@brief Sorts one column by the average position of each node's neighbors in the adjacent column
+
+	@param items	All nodes
+	@param layer	The column to sort
+	@param usePreds	True to sort by position of inputs (left neighbors), false for outputs (right neighbors)
+ */
+void FilterGraphLayout::OrderLayer(vector<Item>& items, vector<size_t>& layer, bool usePreds)
+{
+	vector< pair<float, size_t> > keys;
+	keys.reserve(layer.size());
+	for(auto i : layer)
+	{
+		auto& neighbors = usePreds ? items[i].m_preds : items[i].m_succs;
+
+		//Nodes not connected to that side stay where they are
+		float barycenter = items[i].m_order;
+		if(!neighbors.empty())
+		{
+			float sum = 0;
+			for(auto n : neighbors)
+				sum += items[n].m_order;
+			barycenter = sum / neighbors.size();
+		}
+		keys.push_back(pair<float, size_t>(barycenter, i));
+	}
+
+	stable_sort(keys.begin(), keys.end(),
+		[](const pair<float, size_t>& a, const pair<float, size_t>& b)
+		{ return a.first < b.first; });
+
+	for(size_t i=0; i<keys.size(); i++)
+	{
+		layer[i] = keys[i].second;
+		items[layer[i]].m_order = i;
+	}
+}
+
+/**
+	@brief Counts the edge crossings between each pair of adjacent columns
+
+	Edges are sorted by their left end, then crossings are the inversions in the order of their right ends, which are
+	counted with a Fenwick tree in O(E log V).
+ */
+size_t FilterGraphLayout::CountCrossings(vector<Item>& items, vector< vector<size_t> >& layers)
+{
+	size_t total = 0;
+	vector<size_t> ends;
+	vector<size_t> tree;
+	for(size_t i=0; i+1<layers.size(); i++)
+	{
+		ends.clear();
+		for(auto v : layers[i])
+		{
+			size_t first = ends.size();
+			for(auto s : items[v].m_succs)
+				ends.push_back(items[s].m_order);
+			sort(ends.begin() + first, ends.end());
+		}
+
+		//For each edge, count the previous edges ending below it
+		size_t width = layers[i+1].size();
+		tree.assign(width + 1, 0);
+		for(size_t j=0; j<ends.size(); j++)
+		{
+			size_t notAbove = 0;
+			for(size_t k = ends[j] + 1; k > 0; k -= (k & (~k + 1)))
+				notAbove += tree[k];
+			total += j - notAbove;
+
+			for(size_t k = ends[j] + 1; k <= width; k += (k & (~k + 1)))
+				tree[k] ++;
+		}
+	}
+	return total;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Coordinate assignment
+
+/**
+	@brief Converts columns and orderings to actual positions
+ */
+void FilterGraphLayout::AssignCoordinates(vector<Item>& items, vector< vector<size_t> >& layers)
+{
+	//Columns are as wide as their widest node
+	float x = 0;
+	for(auto& layer : layers)
+	{
+		float width = 0;
+		for(auto i : layer)
+		{
+			items[i].m_x = x;
+			width = max(width, items[i].m_width);
+		}
+		x += width + m_columnSpacing;
+	}
+
+	//Start out with each column packed from the top
+	for(auto& layer : layers)
+	{
+		float y = 0;
+		for(auto i : layer)
+		{
+			items[i].m_y = y;
+			y += items[i].m_height + m_rowSpacing;
+		}
+	}
+
+	//Then repeatedly line nodes up with their neighbors, sweeping in both directions
+	const size_t iterations = 4;
+	for(size_t it=0; it<iterations; it++)
+	{
+		for(size_t i=1; i<layers.size(); i++)
+			PlaceLayer(items, layers[i], true);
+		for(size_t i=layers.size()-1; i>0; i--)
+			PlaceLayer(items, layers[i-1], false);
+	}
+
+	//Move the top edge back to zero
+	float ymin = FLT_MAX;
+	for(auto& item : items)
+		ymin = min(ymin, item.m_y);
+	for(auto& item : items)
+		item.m_y -= ymin;
+}
+
+/**
+	@brief Moves the nodes in one column as close as possible to the average height of their neighbors
+
+	Nodes keep their order and can't overlap, so this is an isotonic regression (solved with pool adjacent violators):
+	with offset[i] being the total height of everything above node i, we want y[i] - offset[i] to be non-decreasing
+	and as close as possible to desired[i] - offset[i].
+ */
+void FilterGraphLayout::PlaceLayer(vector<Item>& items, const vector<size_t>& layer, bool usePreds)
+{
+	size_t n = layer.size();
+	if(n == 0)
+		return;
+
+	//Figure out where each node wants to go
+	vector<float> target(n);
+	vector<float> offset(n);
+	float off = 0;
+	for(size_t i=0; i<n; i++)
+	{
+		auto& item = items[layer[i]];
+		auto& neighbors = usePreds ? item.m_preds : item.m_succs;
+
+		float desired = item.m_y;
+		if(!neighbors.empty())
+		{
+			float sum = 0;
+			for(auto j : neighbors)
+				sum += items[j].m_y + items[j].m_height/2;
+			desired = sum / neighbors.size() - item.m_height/2;
+		}
+
+		offset[i] = off;
+		target[i] = desired - off;
+		off += item.m_height + m_rowSpacing;
+	}
+
+	//Pool adjacent violators: merge blocks until block means are non-decreasing
+	vector<float> blockSum;
+	vector<size_t> blockCount;
+	for(size_t i=0; i<n; i++)
+	{
+		blockSum.push_back(target[i]);
+		blockCount.push_back(1);
+		while(blockSum.size() > 1)
+		{
+			size_t last = blockSum.size() - 1;
+			if( (blockSum[last-1] / blockCount[last-1]) <= (blockSum[last] / blockCount[last]) )
+				break;
+
+			blockSum[last-1] += blockSum[last];
+			blockCount[last-1] += blockCount[last];
+			blockSum.pop_back();
+			blockCount.pop_back();
+		}
+	}
+
+	size_t i = 0;
+	for(size_t b=0; b<blockSum.size(); b++)
+	{
+		float mean = blockSum[b] / blockCount[b];
+		for(size_t j=0; j<blockCount[b]; j++, i++)
+			items[layer[i]].m_y = mean + offset[i];
+	}
+}
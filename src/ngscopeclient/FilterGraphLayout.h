@@ -0,0 +1,173 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of FilterGraphLayout
+ */
+#ifndef FilterGraphLayout_h
+#define FilterGraphLayout_h
+
+/**
+	@brief A node to be placed by FilterGraphLayout
+ */
+class FilterGraphLayoutNode
+{
+public:
+	FilterGraphLayoutNode(float width = 0, float height = 0, int group = -1)
+	: m_width(width)
+	, m_height(height)
+	, m_group(group)
+	, m_x(0)
+	, m_y(0)
+	{}
+
+	///@brief Size of the node
+	float m_width;
+	float m_height;
+
+	///@brief Index of the group this node is in, or -1 if not in a group
+	int m_group;
+
+	///@brief Top left corner of the node, output from FilterGraphLayout::Run()
+	float m_x;
+	float m_y;
+};
+
+/**
+	@brief A group of nodes to be placed by FilterGraphLayout
+ */
+class FilterGraphLayoutGroup
+{
+public:
+	FilterGraphLayoutGroup()
+	: m_padLeft(0)
+	, m_padRight(0)
+	, m_padTop(0)
+	, m_padBottom(0)
+	, m_x(0)
+	, m_y(0)
+	, m_width(0)
+	, m_height(0)
+	{}
+
+	///@brief Space to leave between the group boundary and its contents (for the title and hierarchical ports)
+	float m_padLeft;
+	float m_padRight;
+	float m_padTop;
+	float m_padBottom;
+
+	///@brief Bounding box of the group, output from FilterGraphLayout::Run()
+	float m_x;
+	float m_y;
+	float m_width;
+	float m_height;
+};
+
+/**
+	@brief Layered (Sugiyama style) automatic layout for the filter graph
+
+	Signals flow left to right: each node goes in a column one past the furthest of its inputs, long edges are routed
+	through invisible dummy nodes, and nodes within each column are reordered to reduce the number of crossing edges.
+
+	Groups are laid out on their own first, then placed in the top level graph as a single big node.
+
+	Doesn't touch ImGui or the node editor, so it's safe to run on a background thread.
+ */
+class FilterGraphLayout
+{
+public:
+	FilterGraphLayout();
+
+	void Run();
+
+	///@brief Nodes to lay out
+	std::vector<FilterGraphLayoutNode> m_nodes;
+
+	///@brief Groups the nodes belong to
+	std::vector<FilterGraphLayoutGroup> m_groups;
+
+	///@brief Edges between nodes (source index, sink index)
+	std::vector< std::pair<size_t, size_t> > m_edges;
+
+	///@brief Horizontal space between columns
+	float m_columnSpacing;
+
+	///@brief Vertical space between nodes in the same column
+	float m_rowSpacing;
+
+	///@brief Minimum size of a group with nothing in it
+	float m_emptyGroupSize;
+
+	///@brief Number of edge crossings in the final layout (top level graph and inside groups), for diagnostics
+	size_t m_crossings;
+
+protected:
+
+	/**
+		@brief A node, compound group node, or dummy node in a single subgraph being laid out
+	 */
+	class Item
+	{
+	public:
+		Item(float width = 0, float height = 0)
+		: m_width(width)
+		, m_height(height)
+		, m_x(0)
+		, m_y(0)
+		, m_layer(0)
+		, m_order(0)
+		{}
+
+		float m_width;
+		float m_height;
+		float m_x;
+		float m_y;
+		size_t m_layer;
+		size_t m_order;
+		std::vector<size_t> m_preds;
+		std::vector<size_t> m_succs;
+	};
+
+	size_t LayoutSubgraph(std::vector<Item>& items, const std::vector< std::pair<size_t, size_t> >& edges);
+
+	void AssignLayers(std::vector<Item>& items, std::vector< std::pair<size_t, size_t> >& edges);
+	void InsertDummies(
+		std::vector<Item>& items,
+		const std::vector< std::pair<size_t, size_t> >& edges,
+		std::vector< std::vector<size_t> >& layers);
+	size_t MinimizeCrossings(std::vector<Item>& items, std::vector< std::vector<size_t> >& layers);
+	void OrderLayer(std::vector<Item>& items, std::vector<size_t>& layer, bool usePreds);
+	size_t CountCrossings(std::vector<Item>& items, std::vector< std::vector<size_t> >& layers);
+	void AssignCoordinates(std::vector<Item>& items, std::vector< std::vector<size_t> >& layers);
+	void PlaceLayer(std::vector<Item>& items, const std::vector<size_t>& layer, bool usePreds);
+};
+
+#endif
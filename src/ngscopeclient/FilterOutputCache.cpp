@@ -0,0 +1,459 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of FilterOutputCache
+ */
+#include "../scopehal/scopehal.h"
+#include "FilterOutputCache.h"
+#include "../scopeprotocols/AverageFilter.h"
+#include "../scopeprotocols/CANDecoder.h"
+#include "../scopeprotocols/ConstellationFilter.h"
+#include "../scopeprotocols/EyePattern.h"
+#include "../scopeprotocols/HistogramFilter.h"
+#include "../scopeprotocols/MaximumFilter.h"
+#include "../scopeprotocols/MemoryFilter.h"
+#include "../scopeprotocols/MinimumFilter.h"
+#include "../scopeprotocols/TrendFilter.h"
+
+using namespace std;
+
+static uint64_t HashCombine(uint64_t h, uint64_t v);
+static uint64_t GetWaveformIdentity(WaveformBase* wfm);
+static size_t GetSampleSize(WaveformBase* wfm);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+FilterOutputCache::FilterOutputCache()
+	: m_budget(0)
+	, m_usage(0)
+	, m_hits(0)
+{
+}
+
+FilterOutputCache::~FilterOutputCache()
+{
+	Clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Cache management
+
+/**
+	@brief Moves the current outputs of a filter into the cache
+
+	On success the filter is left with no output data, so it will allocate fresh waveforms the next time it runs.
+
+	@param f		The filter
+	@param key		Hash of everything the filter's current outputs depend on
+
+	@return True if the outputs were cached, false if they were left attached to the filter (no data, or too big to
+			fit in the budget)
+ */
+bool FilterOutputCache::Stash(Filter* f, uint64_t key)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	Entry entry;
+	bool empty = true;
+	for(size_t i=0; i<f->GetStreamCount(); i++)
+	{
+		auto data = f->GetData(i);
+		if(!IsSizeKnown(data))
+			return false;
+		entry.m_outputs.push_back(data);
+		entry.m_bytes += GetWaveformBytes(data);
+		if(data)
+			empty = false;
+	}
+	if(empty || (entry.m_bytes > m_budget) )
+		return false;
+
+	//Replace any existing entry for the same key (should never happen, but don't leak if it does)
+	CacheKey ckey(f, key);
+	auto it = m_entries.find(ckey);
+	if(it != m_entries.end())
+		EraseEntry(it);
+
+	for(size_t i=0; i<f->GetStreamCount(); i++)
+		f->Detach(i);
+
+	m_lru.push_front(ckey);
+	entry.m_lruPosition = m_lru.begin();
+	m_usage += entry.m_bytes;
+	m_entries[ckey] = entry;
+
+	EvictToBudget();
+	return true;
+}
+
+/**
+	@brief Moves cached outputs back into a filter
+
+	Any output data the filter currently has is deleted, so call Stash() first if it's worth keeping.
+
+	@return True on a cache hit, false if nothing was cached for this key
+ */
+bool FilterOutputCache::Restore(Filter* f, uint64_t key)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	auto it = m_entries.find(CacheKey(f, key));
+	if(it == m_entries.end())
+		return false;
+
+	auto& entry = it->second;
+	for(size_t i=0; i<entry.m_outputs.size(); i++)
+		f->SetData(entry.m_outputs[i], i);
+
+	//Ownership has been passed back to the filter, so don't delete the waveforms with the entry
+	m_usage -= entry.m_bytes;
+	m_lru.erase(entry.m_lruPosition);
+	m_entries.erase(it);
+
+	m_hits ++;
+	return true;
+}
+
+/**
+	@brief Checks if we have cached outputs for a filter
+ */
+bool FilterOutputCache::Contains(Filter* f, uint64_t key)
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_entries.find(CacheKey(f, key)) != m_entries.end();
+}
+
+/**
+	@brief Gets one cached output waveform without removing it from the cache
+
+	The returned pointer is only valid until the next call to any other method of the cache.
+ */
+WaveformBase* FilterOutputCache::Peek(Filter* f, uint64_t key, size_t stream)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	auto it = m_entries.find(CacheKey(f, key));
+	if( (it == m_entries.end()) || (stream >= it->second.m_outputs.size()) )
+		return nullptr;
+	return it->second.m_outputs[stream];
+}
+
+/**
+	@brief Deletes all cached outputs of filters which no longer exist
+ */
+void FilterOutputCache::PurgeStaleFilters(const set<FlowGraphNode*>& liveNodes)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	for(auto it = m_entries.begin(); it != m_entries.end(); )
+	{
+		auto next = it;
+		++next;
+		if(liveNodes.find(it->first.first) == liveNodes.end())
+			EraseEntry(it);
+		it = next;
+	}
+}
+
+/**
+	@brief Deletes everything in the cache
+ */
+void FilterOutputCache::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	while(!m_entries.empty())
+		EraseEntry(m_entries.begin());
+}
+
+/**
+	@brief Sets the maximum total size of cached waveforms, evicting old entries if we're now over budget
+ */
+void FilterOutputCache::SetBudget(size_t bytes)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_budget = bytes;
+	EvictToBudget();
+}
+
+/**
+	@brief Removes an entry and deletes its waveforms
+
+	The caller must hold m_mutex.
+ */
+void FilterOutputCache::EraseEntry(map<CacheKey, Entry>::iterator it)
+{
+	auto& entry = it->second;
+	for(auto w : entry.m_outputs)
+		delete w;
+
+	m_usage -= entry.m_bytes;
+	m_lru.erase(entry.m_lruPosition);
+	m_entries.erase(it);
+}
+
+/**
+	@brief Deletes least recently used entries until we're within the budget
+
+	The caller must hold m_mutex.
+ */
+void FilterOutputCache::EvictToBudget()
+{
+	while( (m_usage > m_budget) && !m_lru.empty() )
+		EraseEntry(m_entries.find(m_lru.back()));
+}
+
+/**
+	@brief Amount of memory used by a waveform's sample data
+
+	Returns zero for sample types IsSizeKnown() doesn't recognize.
+ */
+size_t FilterOutputCache::GetWaveformBytes(WaveformBase* wfm)
+{
+	if(wfm == nullptr)
+		return 0;
+
+	size_t samplesize = GetSampleSize(wfm);
+	if(samplesize == 0)
+		return 0;
+
+	//Sparse waveforms also store offset and duration of each sample
+	if(dynamic_cast<SparseWaveformBase*>(wfm) != nullptr)
+		samplesize += 2*sizeof(int64_t);
+
+	return wfm->size() * samplesize;
+}
+
+/**
+	@brief Checks if GetWaveformBytes() knows how big a waveform is
+
+	Protocol decodes and other custom sample types can't be sized from a WaveformBase, so they're never cached
+	rather than being allowed to slip past the budget. Null waveforms are trivially known.
+ */
+bool FilterOutputCache::IsSizeKnown(WaveformBase* wfm)
+{
+	return (wfm == nullptr) || (GetSampleSize(wfm) != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Cache keys
+
+/**
+	@brief Checks if a filter keeps state from one waveform to the next (anything that implements ClearSweeps())
+
+	The outputs of these filters depend on every waveform they've seen since the last clear, not just the current
+	inputs, so they can't be cached. They also must not be run on history points the user isn't looking at, or their
+	accumulated state would be polluted.
+ */
+bool FilterOutputCache::IsStateful(Filter* f)
+{
+	if( (dynamic_cast<AverageFilter*>(f) != nullptr) ||
+		(dynamic_cast<ConstellationFilter*>(f) != nullptr) ||
+		(dynamic_cast<EyePattern*>(f) != nullptr) ||
+		(dynamic_cast<HistogramFilter*>(f) != nullptr) ||
+		(dynamic_cast<MaximumFilter*>(f) != nullptr) ||
+		(dynamic_cast<MemoryFilter*>(f) != nullptr) ||
+		(dynamic_cast<MinimumFilter*>(f) != nullptr) ||
+		(dynamic_cast<TrendFilter*>(f) != nullptr) )
+	{
+		return true;
+	}
+
+	//Catch anything else that integrates data across multiple waveforms
+	for(size_t i=0; i<f->GetStreamCount(); i++)
+	{
+		switch(StreamDescriptor(f, i).GetType())
+		{
+			case Stream::STREAM_TYPE_EYE:
+			case Stream::STREAM_TYPE_SPECTROGRAM:
+			case Stream::STREAM_TYPE_WATERFALL:
+				return true;
+
+			default:
+				break;
+		}
+	}
+
+	return false;
+}
+
+/**
+	@brief Checks if a filter's outputs depend only on its inputs and parameters, and are all stored in waveforms
+ */
+bool FilterOutputCache::IsCacheable(Filter* f)
+{
+	//No inputs means the filter is generating or importing data from somewhere we can't track
+	if(f->GetInputCount() == 0)
+		return false;
+
+	if(IsStateful(f))
+		return false;
+
+	//Scalar values aren't stored in a waveform so can't be moved in and out of the cache
+	for(size_t i=0; i<f->GetStreamCount(); i++)
+	{
+		if(StreamDescriptor(f, i).GetType() == Stream::STREAM_TYPE_ANALOG_SCALAR)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+	@brief Computes the cache key of every cacheable filter in a graph
+
+	Each filter's key hashes its type, parameters, and the keys of its inputs. Instrument channels are identified by
+	the waveforms (or scalar values) they currently hold. Filters which aren't cacheable, or which have an uncacheable
+	filter anywhere upstream of them, don't get a key.
+
+	@param order	All nodes of the graph, in dependency order
+	@param keys		Output keys, indexed by filter
+ */
+void FilterOutputCache::GetKeys(const vector<FlowGraphNode*>& order, map<FlowGraphNode*, uint64_t>& keys)
+{
+	map<FlowGraphNode*, uint64_t> hashes;
+	hash<string> strhash;
+
+	for(auto node : order)
+	{
+		auto f = dynamic_cast<Filter*>(node);
+
+		//Instrument channels are identified by the data they currently hold
+		if(!f)
+		{
+			uint64_t h = reinterpret_cast<uintptr_t>(node);
+			auto chan = dynamic_cast<InstrumentChannel*>(node);
+			for(size_t i=0; chan && (i<chan->GetStreamCount()); i++)
+			{
+				StreamDescriptor stream(chan, i);
+				if(stream.GetType() == Stream::STREAM_TYPE_ANALOG_SCALAR)
+				{
+					float v = stream.GetScalarValue();
+					uint32_t bits;
+					memcpy(&bits, &v, sizeof(bits));
+					h = HashCombine(h, bits);
+				}
+				else
+					h = HashCombine(h, GetWaveformIdentity(stream.GetData()));
+			}
+			hashes[node] = h;
+			continue;
+		}
+
+		//Filters are identified by type, configuration, and inputs
+		if(!IsCacheable(f))
+			continue;
+		bool cacheable = true;
+		uint64_t h = HashCombine(reinterpret_cast<uintptr_t>(f), strhash(f->GetProtocolDisplayName()));
+		for(auto it = f->GetParamBegin(); it != f->GetParamEnd(); it++)
+		{
+			h = HashCombine(h, strhash(it->first));
+			h = HashCombine(h, strhash(it->second.ToString()));
+		}
+		for(size_t i=0; i<f->GetInputCount(); i++)
+		{
+			auto in = f->GetInput(i);
+			if(in.m_channel == nullptr)
+			{
+				h = HashCombine(h, 0);
+				continue;
+			}
+
+			//Anything we don't have a hash for is uncacheable (or not in the graph)
+			auto jt = hashes.find(in.m_channel);
+			if(jt == hashes.end())
+			{
+				cacheable = false;
+				break;
+			}
+			h = HashCombine(h, HashCombine(jt->second, in.m_stream));
+		}
+		if(!cacheable)
+			continue;
+
+		hashes[node] = h;
+		keys[node] = h;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+/**
+	@brief Mixes a value into a 64-bit hash
+ */
+static uint64_t HashCombine(uint64_t h, uint64_t v)
+{
+	//splitmix64 finalizer on the combined value
+	uint64_t x = h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/**
+	@brief Hash identifying a specific version of a specific waveform
+
+	Pooled waveforms get reused for new acquisitions, so the timestamp is included as well as the pointer and revision.
+ */
+static uint64_t GetWaveformIdentity(WaveformBase* wfm)
+{
+	if(wfm == nullptr)
+		return 0;
+
+	uint64_t h = HashCombine(reinterpret_cast<uintptr_t>(wfm), wfm->m_revision);
+	h = HashCombine(h, static_cast<uint64_t>(wfm->m_startTimestamp));
+	h = HashCombine(h, static_cast<uint64_t>(wfm->m_startFemtoseconds));
+	return HashCombine(h, wfm->size());
+}
+
+/**
+	@brief Gets the size of one sample (not including sparse offset/duration) for the sample types we know about
+
+	@return Size in bytes, or zero if unknown
+ */
+static size_t GetSampleSize(WaveformBase* wfm)
+{
+	if( (dynamic_cast<UniformAnalogWaveform*>(wfm) != nullptr) || (dynamic_cast<SparseAnalogWaveform*>(wfm) != nullptr) )
+		return sizeof(float);
+	else if( (dynamic_cast<UniformDigitalWaveform*>(wfm) != nullptr) ||
+			 (dynamic_cast<SparseDigitalWaveform*>(wfm) != nullptr) )
+	{
+		return sizeof(bool);
+	}
+	else if(dynamic_cast<CANWaveform*>(wfm) != nullptr)
+		return sizeof(CANSymbol);
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of FilterOutputCache
+ */
+#ifndef FilterOutputCache_h
+#define FilterOutputCache_h
+
+#include <list>
+
+/**
+	@brief Bounded LRU cache of filter output waveforms
+
+	Each entry holds the complete set of output waveforms of one filter, keyed by the filter and a hash of everything
+	the outputs depend on (filter type, parameter values, and the identity of every waveform upstream of it). This
+	lets us switch back to a previously viewed history point without recomputing the filter graph.
+
+	Waveforms are moved, not copied: Stash() detaches the outputs from the filter and takes ownership of them, and
+	Restore() hands them back to the filter and removes the entry. A waveform is therefore never owned by both the
+	cache and a filter, so it's safe for filters to overwrite their outputs in place the next time they run.
+
+	All methods are thread safe.
+ */
+class FilterOutputCache
+{
+public:
+	FilterOutputCache();
+	~FilterOutputCache();
+
+	bool Stash(Filter* f, uint64_t key);
+	bool Restore(Filter* f, uint64_t key);
+	bool Contains(Filter* f, uint64_t key);
+	WaveformBase* Peek(Filter* f, uint64_t key, size_t stream);
+
+	void PurgeStaleFilters(const std::set<FlowGraphNode*>& liveNodes);
+	void Clear();
+
+	void SetBudget(size_t bytes);
+
+	///@brief Gets the total size of all cached waveforms, in bytes
+	size_t GetUsage()
+	{ return m_usage.load(); }
+
+	///@brief Gets the number of successful Restore() calls
+	size_t GetHitCount()
+	{ return m_hits.load(); }
+
+	static size_t GetWaveformBytes(WaveformBase* wfm);
+	static bool IsSizeKnown(WaveformBase* wfm);
+	static bool IsStateful(Filter* f);
+	static bool IsCacheable(Filter* f);
+	static void GetKeys(const std::vector<FlowGraphNode*>& order, std::map<FlowGraphNode*, uint64_t>& keys);
+
+protected:
+	typedef std::pair<Filter*, uint64_t> CacheKey;
+
+	/**
+		@brief Outputs of one filter for one set of inputs
+	 */
+	class Entry
+	{
+	public:
+		Entry()
+		: m_bytes(0)
+		{}
+
+		///@brief Output waveforms, indexed by stream
+		std::vector<WaveformBase*> m_outputs;
+
+		///@brief Total size of m_outputs
+		size_t m_bytes;
+
+		///@brief Position of this entry in m_lru
+		std::list<CacheKey>::iterator m_lruPosition;
+	};
+
+	void EraseEntry(std::map<CacheKey, Entry>::iterator it);
+	void EvictToBudget();
+
+	///@brief Mutex to interlock access to everything else
+	std::mutex m_mutex;
+
+	///@brief The cached outputs
+	std::map<CacheKey, Entry> m_entries;
+
+	///@brief Keys in order of use, most recently used first
+	std::list<CacheKey> m_lru;
+
+	///@brief Maximum total size of all cached waveforms, in bytes
+	size_t m_budget;
+
+	///@brief Current total size of all cached waveforms, in bytes
+	std::atomic<size_t> m_usage;
+
+	///@brief Number of successful Restore() calls
+	std::atomic<size_t> m_hits;
+};
+
+#endif
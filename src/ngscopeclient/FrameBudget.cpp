@@ -0,0 +1,201 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of PanelBudget and FrameBudget
+ */
+#include "ngscopeclient.h"
+#include "FrameBudget.h"
+
+using namespace std;
+
+///@brief Weight of the newest measurement in the moving average
+#define PANEL_TIME_ALPHA 0.1
+
+///@brief Minimum number of frames between refresh interval changes, so the averages can settle
+#define BUDGET_ADJUST_FRAMES 15
+
+///@brief Upper bound on refresh interval, so throttled panels still update several times a second
+#define MAX_REFRESH_INTERVAL 8
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PanelBudget
+
+PanelBudget::PanelBudget()
+	: m_frameStart(0)
+	, m_averageTime(0)
+	, m_visible(false)
+	, m_interacting(false)
+	, m_throttleable(false)
+	, m_refresh(true)
+	, m_refreshInterval(1)
+	, m_framesSinceRefresh(0)
+{
+}
+
+/**
+	@brief Starts timing the panel for this frame
+ */
+void PanelBudget::BeginFrame()
+{
+	m_frameStart = GetTime();
+}
+
+/**
+	@brief Decides whether expensive content should be refreshed this frame
+
+	Must be called after the panel's window has been started, and before any work is done.
+
+	@param interacting	True if the user is hovering over or focused on the panel. Panels being interacted with always
+						refresh every frame so the UI stays responsive.
+ */
+void PanelBudget::UpdateRefresh(bool interacting)
+{
+	m_interacting = interacting;
+	m_framesSinceRefresh ++;
+
+	if(interacting || (m_framesSinceRefresh >= m_refreshInterval) )
+	{
+		m_refresh = true;
+		m_framesSinceRefresh = 0;
+	}
+	else
+		m_refresh = false;
+}
+
+/**
+	@brief Finishes timing the panel for this frame
+
+	@param visible	True if the panel's contents were drawn, false if it's tabbed out or collapsed
+ */
+void PanelBudget::EndFrame(bool visible)
+{
+	m_visible = visible;
+
+	//Hidden panels cost nothing, and should come back at full rate when shown again
+	if(!visible)
+	{
+		m_averageTime = 0;
+		m_refreshInterval = 1;
+		m_framesSinceRefresh = 0;
+		m_refresh = true;
+		m_interacting = false;
+		return;
+	}
+
+	double dt = GetTime() - m_frameStart;
+	m_averageTime = m_averageTime*(1 - PANEL_TIME_ALPHA) + dt*PANEL_TIME_ALPHA;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FrameBudget
+
+FrameBudget::FrameBudget()
+	: m_targetFrameTime(1.0 / 60)
+	, m_budgetFraction(0.75)
+	, m_totalTime(0)
+	, m_framesSinceAdjust(0)
+{
+}
+
+/**
+	@brief Updates statistics and adjusts refresh intervals after a frame has been drawn
+
+	@param panels	Display name and budget of every panel drawn this frame
+ */
+void FrameBudget::Update(const vector< pair<string, PanelBudget*> >& panels)
+{
+	m_stats.clear();
+	m_totalTime = 0;
+	for(auto& it : panels)
+	{
+		auto p = it.second;
+
+		PanelBudgetStats s;
+		s.m_name = it.first;
+		s.m_averageTime = p->GetAverageTime();
+		s.m_refreshInterval = p->GetRefreshInterval();
+		s.m_visible = p->IsVisible();
+		s.m_throttleable = p->IsThrottleable();
+		m_stats.push_back(s);
+
+		if(p->IsVisible())
+			m_totalTime += p->GetAverageTime();
+	}
+
+	//Don't make another change until the last one has had time to show up in the averages
+	m_framesSinceAdjust ++;
+	if(m_framesSinceAdjust < BUDGET_ADJUST_FRAMES)
+		return;
+
+	double budget = GetBudget();
+	if(m_totalTime > budget)
+	{
+		//Over budget: slow down the most expensive panel we're allowed to
+		PanelBudget* worst = nullptr;
+		for(auto& it : panels)
+		{
+			auto p = it.second;
+			if(!p->IsVisible() || !p->IsThrottleable() || p->IsInteracting())
+				continue;
+			if(p->GetRefreshInterval() >= MAX_REFRESH_INTERVAL)
+				continue;
+			if(!worst || (p->GetAverageTime() > worst->GetAverageTime()) )
+				worst = p;
+		}
+
+		if(worst)
+		{
+			worst->SetRefreshInterval(worst->GetRefreshInterval() * 2);
+			m_framesSinceAdjust = 0;
+		}
+	}
+
+	//Well under budget (leave some hysteresis so we don't oscillate): speed up the most throttled panel
+	else if(m_totalTime < 0.5*budget)
+	{
+		PanelBudget* slowest = nullptr;
+		for(auto& it : panels)
+		{
+			auto p = it.second;
+			if(p->GetRefreshInterval() <= 1)
+				continue;
+			if(!slowest || (p->GetRefreshInterval() > slowest->GetRefreshInterval()) )
+				slowest = p;
+		}
+
+		if(slowest)
+		{
+			slowest->SetRefreshInterval(slowest->GetRefreshInterval() / 2);
+			m_framesSinceAdjust = 0;
+		}
+	}
+}
@@ -0,0 +1,178 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of PanelBudget and FrameBudget
+ */
+#ifndef FrameBudget_h
+#define FrameBudget_h
+
+/**
+	@brief Frame time accounting for a single dockable panel (dialog or waveform group)
+
+	Each panel times its own rendering and asks IsRefreshFrame() before doing expensive work that can tolerate running
+	less often than every frame. The refresh interval is chosen by the FrameBudget.
+ */
+class PanelBudget
+{
+public:
+	PanelBudget();
+
+	void BeginFrame();
+	void UpdateRefresh(bool interacting);
+	void EndFrame(bool visible);
+
+	/**
+		@brief Returns true if expensive work should be done this frame
+	 */
+	bool IsRefreshFrame() const
+	{ return m_refresh; }
+
+	///@brief Returns the smoothed render time for this panel, in seconds
+	double GetAverageTime() const
+	{ return m_averageTime; }
+
+	///@brief Returns true if the panel's contents were drawn in the most recent frame
+	bool IsVisible() const
+	{ return m_visible; }
+
+	///@brief Returns true if the mouse or keyboard focus is on this panel
+	bool IsInteracting() const
+	{ return m_interacting; }
+
+	///@brief Returns true if this panel has work that can be deferred when we're over budget
+	bool IsThrottleable() const
+	{ return m_throttleable; }
+
+	void SetThrottleable(bool throttleable)
+	{ m_throttleable = throttleable; }
+
+	///@brief Returns the number of frames between refreshes of expensive content
+	unsigned int GetRefreshInterval() const
+	{ return m_refreshInterval; }
+
+	void SetRefreshInterval(unsigned int interval)
+	{ m_refreshInterval = std::max(interval, 1u); }
+
+protected:
+
+	///@brief Time at which the current frame started rendering
+	double m_frameStart;
+
+	///@brief Exponential moving average of render time
+	double m_averageTime;
+
+	///@brief True if the panel was visible last frame
+	bool m_visible;
+
+	///@brief True if the user is hovering over or typing into the panel
+	bool m_interacting;
+
+	///@brief True if the panel checks IsRefreshFrame() at all
+	bool m_throttleable;
+
+	///@brief True if expensive content should be refreshed this frame
+	bool m_refresh;
+
+	///@brief Number of frames between refreshes
+	unsigned int m_refreshInterval;
+
+	///@brief Number of frames since the last refresh
+	unsigned int m_framesSinceRefresh;
+};
+
+/**
+	@brief Snapshot of a panel's frame time, for display
+ */
+class PanelBudgetStats
+{
+public:
+	std::string m_name;
+	double m_averageTime;
+	unsigned int m_refreshInterval;
+	bool m_visible;
+	bool m_throttleable;
+};
+
+/**
+	@brief Divides the GUI frame time between panels
+
+	Once per frame, the main window hands over the list of panels it just drew. If the total time spent drawing panels
+	exceeds the budget, the most expensive panel that can be throttled has its refresh interval doubled. If we're
+	comfortably under budget, the most throttled panel is relaxed again.
+ */
+class FrameBudget
+{
+public:
+	FrameBudget();
+
+	void SetTargetFrameTime(double t)
+	{ m_targetFrameTime = t; }
+
+	void SetBudgetFraction(double f)
+	{ m_budgetFraction = f; }
+
+	///@brief Returns the refresh period of the display, in seconds
+	double GetTargetFrameTime() const
+	{ return m_targetFrameTime; }
+
+	///@brief Returns the time available for drawing panels each frame, in seconds
+	double GetBudget() const
+	{ return m_targetFrameTime * m_budgetFraction; }
+
+	///@brief Returns the smoothed total time spent drawing all visible panels, in seconds
+	double GetTotalTime() const
+	{ return m_totalTime; }
+
+	const std::vector<PanelBudgetStats>& GetStats() const
+	{ return m_stats; }
+
+	void Update(const std::vector< std::pair<std::string, PanelBudget*> >& panels);
+
+protected:
+
+	///@brief Display refresh period, in seconds
+	double m_targetFrameTime;
+
+	///@brief Fraction of the refresh period we're willing to spend drawing panels
+	double m_budgetFraction;
+
+	///@brief Total time spent drawing visible panels
+	double m_totalTime;
+
+	///@brief Number of frames since we last changed a refresh interval
+	unsigned int m_framesSinceAdjust;
+
+	///@brief Per-panel stats from the most recent frame
+	std::vector<PanelBudgetStats> m_stats;
+};
+
+#endif
@@ -45,6 +45,8 @@ HistoryPoint::HistoryPoint()
 	: m_time(0, 0)
 	, m_pinned(false)
 	, m_nickname("")
+	, m_dirty(true)
+	, m_savedId(-1)
 {
 }
 
@@ -104,6 +106,17 @@ void HistoryPoint::LoadHistoryToSession(Session& session)
 	//We don't want to keep capturing if we're trying to look at a historical waveform. That would be a bit silly.
 	session.StopTrigger();
 
+	lock_guard<shared_mutex> lock(session.GetWaveformDataMutex());
+	AttachToSession(session);
+}
+
+/**
+	@brief Attaches our saved waveforms to the instruments in the specified session, without stopping the trigger
+
+	The caller must hold the session's waveform data mutex.
+ */
+void HistoryPoint::AttachToSession(Session& session)
+{
 	//Go over each scope in the session and load the relevant history
 	//We do this rather than just looping over the scopes in the history so that we can handle missing data.
 	auto scopes = session.GetScopes();
@@ -196,6 +209,8 @@ void HistoryManager::LoadEmptyHistoryToSession(Session& session)
 	//We don't want to keep capturing if we're trying to look at a historical waveform. That would be a bit silly.
 	session.StopTrigger();
 
+	lock_guard<shared_mutex> lock(session.GetWaveformDataMutex());
+
 	//Set all channels' data to null
 	auto scopes = session.GetScopes();
 	for(auto scope : scopes)
@@ -350,6 +365,43 @@ shared_ptr<HistoryPoint> HistoryManager::GetHistory(TimePoint t)
 	return nullptr;
 }
 
+/**
+	@brief Gets the points around a given point of history, nearest first
+
+	@param point	The point to start from
+	@param radius	Maximum distance from the point to look in each direction
+
+	@return The neighboring points, alternating between later and earlier ones
+ */
+vector<shared_ptr<HistoryPoint>> HistoryManager::GetNeighbors(shared_ptr<HistoryPoint> point, size_t radius)
+{
+	vector<shared_ptr<HistoryPoint>> ret;
+
+	auto it = find(m_history.begin(), m_history.end(), point);
+	if(it == m_history.end())
+		return ret;
+
+	auto later = it;
+	auto earlier = it;
+	for(size_t i=0; i<radius; i++)
+	{
+		if(later != m_history.end())
+		{
+			++later;
+			if(later != m_history.end())
+				ret.push_back(*later);
+		}
+
+		if(earlier != m_history.begin())
+		{
+			--earlier;
+			ret.push_back(*earlier);
+		}
+	}
+
+	return ret;
+}
+
 /**
 	@brief Checks if we have a history point for a specific timestamp
  */
@@ -63,7 +63,14 @@ public:
 	///@brief Waveform data
 	std::map<std::shared_ptr<Oscilloscope>, WaveformHistory> m_history;
 
+	///@brief True if the waveform data has changed since it was last written to the session data directory
+	bool m_dirty;
+
+	///@brief Index of the waveform_N directory this point was last saved to (negative if never saved)
+	int64_t m_savedId;
+
 	void LoadHistoryToSession(Session& session);
+	void AttachToSession(Session& session);
 };
 
 /**
@@ -90,6 +97,7 @@ public:
 	{ m_maxDepth = m_history.size(); }
 
 	std::shared_ptr<HistoryPoint> GetHistory(TimePoint t);
+	std::vector<std::shared_ptr<HistoryPoint>> GetNeighbors(std::shared_ptr<HistoryPoint> point, size_t radius);
 
 	bool HasHistory(TimePoint t);
 
@@ -152,6 +152,16 @@
 using namespace std;
 
 extern Event g_rerenderRequestedEvent;
+extern Event g_rerenderDoneEvent;
+extern Event g_refilterDoneEvent;
+extern Event g_waveformReadyEvent;
+
+/**
+	@brief How long to keep drawing after the last change, in seconds
+
+	Tooltip delays, fades, and windows that take a few frames to lay out all need frames with no input to complete.
+ */
+#define DAMAGE_LINGER_TIME 0.5
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
@@ -183,6 +193,8 @@ MainWindow::MainWindow(shared_ptr<QueueHandle> queue)
 	, m_loadConfirmationChecked(false)
 	, m_texmgr(queue)
 	, m_needRender(false)
+	, m_redrawRequested(true)
+	, m_lastDamageTime(0)
 	, m_toneMapTime(0)
 {
 	LoadRecentInstrumentList();
@@ -234,6 +246,15 @@ MainWindow::MainWindow(shared_ptr<QueueHandle> queue)
 		ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
 	else
 		ImGui::GetIO().ConfigFlags &= ~ImGuiConfigFlags_ViewportsEnable;
+
+	//Panel time budget is based on the display refresh rate
+	auto mon = glfwGetPrimaryMonitor();
+	if(mon)
+	{
+		auto mode = glfwGetVideoMode(mon);
+		if(mode && (mode->refreshRate > 0) )
+			m_frameBudget.SetTargetFrameTime(1.0 / mode->refreshRate);
+	}
 }
 
 MainWindow::~MainWindow()
@@ -585,12 +606,82 @@ void MainWindow::Render()
 		InitializeDefaultSession();
 	}
 
+	//In event driven mode, don't build or present a frame at all unless something changed since the last one
+	if( (m_session.GetPreferences().GetEnumRaw("Power.Events.event_driven_ui") == 1) && !IsFrameDamaged())
+		return;
+
 	//Load all of our fonts
 	UpdateFonts();
 
 	VulkanWindow::Render();
 }
 
+/**
+	@brief Asks for another frame to be drawn, even if there's been no user input
+
+	Safe to call from any thread.
+ */
+void MainWindow::RequestRedraw()
+{
+	m_redrawRequested = true;
+	glfwPostEmptyEvent();
+}
+
+/**
+	@brief Checks if anything on screen may have changed since the last frame we drew
+
+	Must be called before starting the frame, since ImGui consumes queued input events in NewFrame().
+ */
+bool MainWindow::IsFrameDamaged()
+{
+	double now = GetTime();
+
+	//Main window size isn't delivered to ImGui as an event, so check it ourselves
+	int width;
+	int height;
+	glfwGetFramebufferSize(m_window, &width, &height);
+
+	bool damaged =
+		m_redrawRequested.exchange(false) ||
+
+		//Mouse, keyboard, focus, and similar events
+		(GImGui->InputEventsQueue.Size > 0) ||
+
+		//Window resized
+		m_resizeEventPending || m_softwareResizeRequested || (width != m_width) || (height != m_height) ||
+
+		//New waveform, or re-filtering / re-rasterizing of the existing one finished
+		//(don't clear them, Session::CheckForWaveforms() needs to see them)
+		g_waveformReadyEvent.Peek(false) || g_rerenderDoneEvent.Peek(false) || g_refilterDoneEvent.Peek(false) ||
+
+		//Something drawn last frame wants waveforms re-rasterized
+		m_needRender ||
+
+		//Instrument threads published new readouts (meter, PSU, BERT, etc).
+		//They don't wake the event loop, so this is picked up at the polling timeout.
+		//Drawing the frame kicks off the partial refresh, and its completion damages the next one.
+		m_session.HasDirtyChannels() ||
+
+		//Progress bar is moving
+		m_session.IsLoadingWaveforms();
+
+	if(damaged)
+	{
+		m_lastDamageTime = now;
+		return true;
+	}
+
+	//Let animations and multi-frame layout finish after the last change
+	if( (now - m_lastDamageTime) < DAMAGE_LINGER_TIME)
+		return true;
+
+	//Something is being dragged or edited
+	if(ImGui::IsAnyItemActive())
+		return true;
+
+	return false;
+}
+
 void MainWindow::DoRender(vk::raii::CommandBuffer& /*cmdBuf*/)
 {
 
@@ -678,6 +769,19 @@ void MainWindow::RenderUI()
 	//Request a refresh of any dirty filters next frame
 	m_session.RefreshDirtyFiltersNonblocking();
 
+	//If a session file just finished loading in the background, show the most recent waveform
+	if(m_session.FinishLoadingWaveforms())
+	{
+		if(m_historyDialog != nullptr)
+			m_historyDialog->UpdateSelectionToLatest();
+
+		auto t = m_session.GetHistory().GetMostRecentPoint();
+		for(auto it : m_protocolAnalyzerDialogs)
+			it.second->OnWaveformLoaded(t);
+
+		m_needRender = true;
+	}
+
 	//See if we have new waveform data to look at.
 	//If we got one, highlight the new waveform in history
 	if(m_session.CheckForWaveforms(*m_cmdBuffer))
@@ -747,6 +851,9 @@ void MainWindow::RenderUI()
 	for(auto& dlg : dlgsToClose)
 		OnDialogClosed(dlg);
 
+	//Now that all panels have been drawn, see how long they took
+	UpdateFrameBudget();
+
 	//If we had a history dialog, check if we changed the selection
 	if( (m_historyDialog != nullptr) && (m_historyDialog->PollForSelectionChanges()))
 	{
@@ -761,6 +868,7 @@ void MainWindow::RenderUI()
 		}
 
 		m_session.RefreshAllFiltersNonblocking();
+		m_session.RequestHistoryPrefetch(m_session.GetHistory().GetHistory(t));
 		m_needRender = true;
 	}
 
@@ -785,12 +893,14 @@ void MainWindow::RenderUI()
 				m_needRender = true;
 			}
 			m_session.RefreshAllFiltersNonblocking();
+			m_session.RequestHistoryPrefetch(hpt);
 		}
 	}
 
 	//Handle error messages
 	RenderErrorPopup();
 	RenderLoadWarningPopup();
+	RenderWaveformLoadProgress();
 
 	if(m_needRender)
 		g_rerenderRequestedEvent.Signal();
@@ -800,6 +910,25 @@ void MainWindow::RenderUI()
 		ImGui::ShowDemoWindow(&m_showDemo);
 }
 
+/**
+	@brief Collects render times from every panel drawn this frame and throttles expensive ones if we're over budget
+ */
+void MainWindow::UpdateFrameBudget()
+{
+	m_frameBudget.SetBudgetFraction(m_session.GetPreferences().GetReal("Appearance.Windowing.panel_time_budget"));
+
+	vector< pair<string, PanelBudget*> > panels;
+	{
+		lock_guard<recursive_mutex> lock(m_waveformGroupsMutex);
+		for(auto& g : m_waveformGroups)
+			panels.push_back(pair<string, PanelBudget*>(g->GetTitle(), &g->GetBudget()));
+	}
+	for(auto& dlg : m_dialogs)
+		panels.push_back(pair<string, PanelBudget*>(dlg->GetTitle(), &dlg->GetBudget()));
+
+	m_frameBudget.Update(panels);
+}
+
 void MainWindow::Toolbar()
 {
 	//Update icons, if needed
@@ -1854,6 +1983,50 @@ void MainWindow::RenderErrorPopup()
 	}
 }
 
+/**
+	@brief Progress display while waveform data from a session file is loading in the background
+ */
+void MainWindow::RenderWaveformLoadProgress()
+{
+	const char* title = "Loading Waveforms";
+
+	auto loader = m_session.GetWaveformLoader();
+	if(loader)
+		ImGui::OpenPopup(title);
+
+	if(ImGui::BeginPopupModal(title, nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+	{
+		if(!loader)
+			ImGui::CloseCurrentPopup();
+
+		else
+		{
+			Unit bytes(Unit::UNIT_BYTES);
+			size_t total = loader->GetBytesTotal();
+			size_t done = loader->GetBytesLoaded();
+			double dt = loader->GetElapsedTime();
+
+			float frac = 1;
+			if(total)
+				frac = static_cast<float>(done) / total;
+			string progress = bytes.PrettyPrint(done) + " / " + bytes.PrettyPrint(total);
+			ImGui::ProgressBar(frac, ImVec2(30 * ImGui::GetFontSize(), 0), progress.c_str());
+
+			string rate = bytes.PrettyPrint( (dt > 0) ? (done / dt) : 0) + "/s";
+			ImGui::TextUnformatted(rate.c_str());
+
+			if(ImGui::Button("Cancel"))
+				m_sessionClosing = true;
+		}
+
+		ImGui::EndPopup();
+	}
+
+	//Keep frames coming so the progress bar updates, even if the UI is in event driven mode
+	if(loader)
+		glfwPostEmptyEvent();
+}
+
 /**
 	@brief Popup message when loading a file that might not match the current hardware setup
  */
@@ -2083,6 +2256,7 @@ Filter* MainWindow::CreateFilter(
 
 	//Give it an initial name, may change later
 	f->SetDefaultName();
+	m_session.InvalidateGraph();
 
 	//Find a home for each of its streams
 	if(addToArea)
@@ -2300,19 +2474,20 @@ void MainWindow::FindAreaForStream(WaveformArea* area, StreamDescriptor stream)
 
 /**
 	@brief Handle a filter being reconfigured
-
-	TODO: push this to a background thread to avoid hanging the UI thread
  */
 void MainWindow::OnFilterReconfigured(Filter* f)
 {
+	//Input or output count may have changed
+	m_session.InvalidateGraph();
+
 	//Remove any saved configuration, eye patterns, etc
 	{
 		lock_guard lock(m_session.GetWaveformDataMutex());
 		f->ClearSweeps();
 	}
 
-	//Re-run the filter
-	m_session.RefreshAllFiltersNonblocking();
+	//Re-run the filter (and anything downstream of it) once the user stops fiddling with it
+	m_session.RequestFilterReconfigure(f);
 
 	//Clear persistence of any waveform areas showing this waveform
 	lock_guard<recursive_mutex> lock(m_waveformGroupsMutex);
@@ -2943,7 +3118,7 @@ bool MainWindow::LoadDialogs(const YAML::Node& node)
 	auto metrics = node["metrics"];
 	if(metrics && metrics.as<bool>())
 	{
-		m_metricsDialog = make_shared<MetricsDialog>(&m_session);
+		m_metricsDialog = make_shared<MetricsDialog>(&m_session, this);
 		AddDialog(m_metricsDialog);
 	}
 
@@ -165,6 +165,8 @@ public:
 	void SetNeedRender()
 	{ m_needRender = true; }
 
+	void RequestRedraw();
+
 	void ClearPersistence()
 	{
 		m_clearPersistence = true;
@@ -503,6 +505,7 @@ protected:
 
 	void RenderErrorPopup();
 	void RenderLoadWarningPopup();
+	void RenderWaveformLoadProgress();
 public:
 	void ShowErrorPopup(const std::string& title, const std::string& msg);
 
@@ -519,6 +522,19 @@ protected:
 	 */
 	bool m_needRender;
 
+	///@brief Per-panel frame time accounting
+	FrameBudget m_frameBudget;
+
+	bool IsFrameDamaged();
+
+	///@brief Set by anything that needs another frame drawn even if there's no user input
+	std::atomic<bool> m_redrawRequested;
+
+	///@brief Time at which we last had a reason to redraw
+	double m_lastDamageTime;
+
+	void UpdateFrameBudget();
+
 	/**
 		@brief True if we should clear persistence on the next render pass
 	 */
@@ -546,6 +562,9 @@ public:
 	TextureManager* GetTextureManager()
 	{ return &m_texmgr; }
 
+	const FrameBudget& GetFrameBudget()
+	{ return m_frameBudget; }
+
 	std::string GetIconForFilter(Filter* f);
 
 protected:
@@ -596,7 +596,7 @@ void MainWindow::WindowMenu()
 
 		if(ImGui::MenuItem("Performance Metrics"))
 		{
-			m_metricsDialog = make_shared<MetricsDialog>(&m_session);
+			m_metricsDialog = make_shared<MetricsDialog>(&m_session, this);
 			AddDialog(m_metricsDialog);
 		}
 
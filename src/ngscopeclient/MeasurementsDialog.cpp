@@ -195,7 +195,10 @@ void MeasurementsDialog::RemoveStream(size_t i)
 	auto ochan = dynamic_cast<OscilloscopeChannel*>(m_streams[i].m_channel);
 	m_streamset.erase(ochan);
 	if(ochan)
+	{
 		ochan->Release();
+		m_session.InvalidateGraph();
+	}
 	m_streams.erase(m_streams.begin() + i);
 }
 
@@ -213,5 +216,8 @@ void MeasurementsDialog::AddStream(StreamDescriptor stream)
 
 	auto ochan = dynamic_cast<OscilloscopeChannel*>(stream.m_channel);
 	if(ochan)
+	{
 		ochan->AddRef();
+		m_session.InvalidateGraph();
+	}
 }
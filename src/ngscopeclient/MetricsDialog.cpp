@@ -36,15 +36,17 @@
 #include "ngscopeclient.h"
 #include "MetricsDialog.h"
 #include "Session.h"
+#include "MainWindow.h"
 
 using namespace std;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
-MetricsDialog::MetricsDialog(Session* session)
+MetricsDialog::MetricsDialog(Session* session, MainWindow* parent)
 	: Dialog("Performance Metrics", "Metrics", ImVec2(300, 400))
 	, m_session(session)
+	, m_parent(parent)
 {
 	m_displayRefreshRate = 0;
 
@@ -148,6 +150,9 @@ bool MetricsDialog::DoRender()
 			"Waveform samples are drawn by a compute shader and not included in this total");
 	}
 
+	if(ImGui::CollapsingHeader("Frame budget"))
+		DoFrameBudget();
+
 	if(ImGui::CollapsingHeader("Filter graph"))
 	{
 		ImGui::BeginDisabled();
@@ -167,6 +172,33 @@ bool MetricsDialog::DoRender()
 		HelpMarker("Update time for the last evaluation of the filter graph");
 	}
 
+	if(ImGui::CollapsingHeader("Startup"))
+	{
+		ImGui::BeginDisabled();
+			str = fs.PrettyPrint(g_startupInitTime * FS_PER_SECOND);
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Library init", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker("Time spent initializing Vulkan, drivers, and plugins at startup");
+
+		ImGui::BeginDisabled();
+			str = fs.PrettyPrint(g_startupTime * FS_PER_SECOND);
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("First frame", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker("Time from launch until the first frame was rendered");
+
+		ImGui::BeginDisabled();
+			str = fs.PrettyPrint(m_session->GetInstrumentConnectTime() * FS_PER_SECOND);
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Instrument connect", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker("Time taken to connect to all instruments when the current session was loaded");
+	}
+
 	if(ImGui::CollapsingHeader("Acquisition"))
 	{
 		ImGui::BeginDisabled();
@@ -297,3 +329,80 @@ bool MetricsDialog::DoRender()
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // UI event handlers
+
+/**
+	@brief Shows how long each panel is taking to draw, and which ones are being throttled
+ */
+void MetricsDialog::DoFrameBudget()
+{
+	Unit fs(Unit::UNIT_FS);
+	auto& budget = m_parent->GetFrameBudget();
+
+	string str;
+	float width = ImGui::GetFontSize() * 7;
+
+	ImGui::BeginDisabled();
+		str = fs.PrettyPrint(budget.GetBudget() * FS_PER_SECOND);
+		ImGui::SetNextItemWidth(width);
+		ImGui::InputText("Budget", &str);
+	ImGui::EndDisabled();
+
+	HelpMarker(
+		"Time available for drawing panels each frame.\n\n"
+		"This is a fraction of the display refresh interval, set by the Appearance | Windowing | Panel time budget "
+		"preference.");
+
+	ImGui::BeginDisabled();
+		str = fs.PrettyPrint(budget.GetTotalTime() * FS_PER_SECOND);
+		ImGui::SetNextItemWidth(width);
+		ImGui::InputText("Panel time", &str);
+	ImGui::EndDisabled();
+
+	HelpMarker(
+		"Average time spent drawing all visible panels each frame.\n\n"
+		"If this exceeds the budget, expensive panels which are not being interacted with will refresh their "
+		"contents less often.");
+
+	static ImGuiTableFlags flags =
+		ImGuiTableFlags_Resizable |
+		ImGuiTableFlags_BordersOuter |
+		ImGuiTableFlags_BordersV |
+		ImGuiTableFlags_RowBg |
+		ImGuiTableFlags_SizingFixedFit;
+
+	auto& stats = budget.GetStats();
+	if(ImGui::BeginTable("panels", 3, flags))
+	{
+		ImGui::TableSetupColumn("Panel", ImGuiTableColumnFlags_WidthStretch, 0.0f);
+		ImGui::TableSetupColumn("Time", ImGuiTableColumnFlags_WidthFixed, 0.0f);
+		ImGui::TableSetupColumn("Refresh", ImGuiTableColumnFlags_WidthFixed, 0.0f);
+		ImGui::TableHeadersRow();
+
+		for(auto& s : stats)
+		{
+			ImGui::PushID(&s);
+			ImGui::TableNextRow(ImGuiTableRowFlags_None);
+
+			ImGui::TableSetColumnIndex(0);
+			ImGui::TextUnformatted(s.m_name.c_str());
+
+			ImGui::TableSetColumnIndex(1);
+			if(s.m_visible)
+				ImGui::TextUnformatted(fs.PrettyPrint(s.m_averageTime * FS_PER_SECOND).c_str());
+			else
+				ImGui::TextUnformatted("hidden");
+
+			ImGui::TableSetColumnIndex(2);
+			if(!s.m_visible || !s.m_throttleable)
+				ImGui::TextUnformatted("");
+			else if(s.m_refreshInterval <= 1)
+				ImGui::TextUnformatted("every frame");
+			else
+				ImGui::Text("1 / %u frames", s.m_refreshInterval);
+
+			ImGui::PopID();
+		}
+
+		ImGui::EndTable();
+	}
+}
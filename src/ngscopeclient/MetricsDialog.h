@@ -37,16 +37,21 @@
 
 #include "Dialog.h"
 
+class MainWindow;
+
 class MetricsDialog : public Dialog
 {
 public:
-	MetricsDialog(Session* session);
+	MetricsDialog(Session* session, MainWindow* parent);
 	virtual ~MetricsDialog();
 
 	virtual bool DoRender();
 
 protected:
+	void DoFrameBudget();
+
 	Session* m_session;
+	MainWindow* m_parent;
 
 	int m_displayRefreshRate;
 };
@@ -0,0 +1,296 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of NodeCollisionSolver
+ */
+
+#include "../scopehal/scopehal.h"
+#include "NodeCollisionSolver.h"
+
+using namespace std;
+
+//Bounding boxes are enlarged by this much on each side to keep some spacing between nodes
+static const float g_nodeMargin = 5;
+
+//Bodies touching more than this many grid cells are tested against everything instead of going in the grid
+static const int64_t g_maxCellsPerBody = 256;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+NodeCollisionSolver::NodeCollisionSolver()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Geometry helpers
+
+/**
+	@brief Check if two bodies overlap, including the spacing margin (same test as RectIntersect())
+ */
+bool NodeCollisionSolver::Intersects(const NodeCollisionBody& a, const NodeCollisionBody& b)
+{
+	float ax0 = a.m_x - g_nodeMargin;
+	float ay0 = a.m_y - g_nodeMargin;
+	float ax1 = a.m_x + a.m_width + g_nodeMargin;
+	float ay1 = a.m_y + a.m_height + g_nodeMargin;
+
+	float bx0 = b.m_x - g_nodeMargin;
+	float by0 = b.m_y - g_nodeMargin;
+	float bx1 = b.m_x + b.m_width + g_nodeMargin;
+	float by1 = b.m_y + b.m_height + g_nodeMargin;
+
+	if( (ay1 < by0) || (by1 < ay0) )
+		return false;
+	if( (ax1 < bx0) || (bx1 < ax0) )
+		return false;
+	return true;
+}
+
+/**
+	@brief Check if one body is completely inside another (same test as RectContains())
+ */
+bool NodeCollisionSolver::Contains(const NodeCollisionBody& outer, const NodeCollisionBody& inner)
+{
+	float ox1 = outer.m_x + outer.m_width;
+	float oy1 = outer.m_y + outer.m_height;
+	float ix1 = inner.m_x + inner.m_width;
+	float iy1 = inner.m_y + inner.m_height;
+
+	if( (inner.m_x < outer.m_x) || (inner.m_x >= ox1) )
+		return false;
+	if( (inner.m_y < outer.m_y) || (inner.m_y >= oy1) )
+		return false;
+	if( (ix1 < outer.m_x) || (ix1 >= ox1) )
+		return false;
+	if( (iy1 < outer.m_y) || (iy1 >= oy1) )
+		return false;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Force calculation
+
+/**
+	@brief Calculates the net force on each body from collisions with its neighbors
+
+	Forces are written to m_forceX / m_forceY of each body (bodies with m_collide clear get zero).
+ */
+void NodeCollisionSolver::CalculateForces(vector<NodeCollisionBody>& bodies)
+{
+	size_t nbodies = bodies.size();
+	for(auto& b : bodies)
+	{
+		b.m_forceX = 0;
+		b.m_forceY = 0;
+	}
+
+	//Pick a cell size a bit larger than a typical node, so most nodes only touch a handful of cells.
+	//Groups are much bigger than anything else, so leave them out of the average.
+	double total = 0;
+	size_t count = 0;
+	for(auto& b : bodies)
+	{
+		if(!b.m_collide || b.m_isGroup)
+			continue;
+		total += max(b.m_width, b.m_height);
+		count ++;
+	}
+	float cellSize = 128;
+	if(count)
+		cellSize = max(32.0, 2 * total / count);
+
+	//Figure out which cells each body touches
+	m_entries.clear();
+	m_largeBodies.clear();
+	m_cellBounds.resize(nbodies * 4);
+	for(size_t i=0; i<nbodies; i++)
+	{
+		auto& b = bodies[i];
+		if(!b.m_collide)
+			continue;
+
+		int32_t x0 = floor((b.m_x - g_nodeMargin) / cellSize);
+		int32_t y0 = floor((b.m_y - g_nodeMargin) / cellSize);
+		int32_t x1 = floor((b.m_x + b.m_width + g_nodeMargin) / cellSize);
+		int32_t y1 = floor((b.m_y + b.m_height + g_nodeMargin) / cellSize);
+		m_cellBounds[i*4 + 0] = x0;
+		m_cellBounds[i*4 + 1] = y0;
+		m_cellBounds[i*4 + 2] = x1;
+		m_cellBounds[i*4 + 3] = y1;
+
+		int64_t ncells = (int64_t)(x1 - x0 + 1) * (y1 - y0 + 1);
+		if(ncells > g_maxCellsPerBody)
+		{
+			m_largeBodies.push_back(i);
+			continue;
+		}
+
+		for(int32_t y=y0; y<=y1; y++)
+		{
+			for(int32_t x=x0; x<=x1; x++)
+			{
+				uint64_t cell = (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+				m_entries.push_back(GridEntry(cell, i));
+			}
+		}
+	}
+
+	//Sort so everything in the same cell is adjacent, in ascending body order
+	sort(m_entries.begin(), m_entries.end());
+
+	//Test each pair of bodies sharing a cell
+	size_t nentries = m_entries.size();
+	size_t start = 0;
+	while(start < nentries)
+	{
+		size_t end = start + 1;
+		while( (end < nentries) && (m_entries[end].m_cell == m_entries[start].m_cell) )
+			end ++;
+
+		int32_t cx = static_cast<int32_t>(static_cast<uint32_t>(m_entries[start].m_cell >> 32));
+		int32_t cy = static_cast<int32_t>(static_cast<uint32_t>(m_entries[start].m_cell));
+
+		for(size_t a=start; a<end; a++)
+		{
+			auto i = m_entries[a].m_body;
+			for(size_t b=a+1; b<end; b++)
+			{
+				auto j = m_entries[b].m_body;
+
+				//Only test the pair in the top left cell the two have in common, so each pair is seen once
+				int32_t firstX = max(m_cellBounds[i*4 + 0], m_cellBounds[j*4 + 0]);
+				int32_t firstY = max(m_cellBounds[i*4 + 1], m_cellBounds[j*4 + 1]);
+				if( (firstX != cx) || (firstY != cy) )
+					continue;
+
+				TestPair(bodies, i, j);
+			}
+		}
+
+		start = end;
+	}
+
+	TestLargeBodies(bodies);
+}
+
+/**
+	@brief Brute force test of the bodies too big for the grid against everything else
+ */
+void NodeCollisionSolver::TestLargeBodies(vector<NodeCollisionBody>& bodies)
+{
+	if(m_largeBodies.empty())
+		return;
+
+	vector<bool> isLarge(bodies.size(), false);
+	for(auto i : m_largeBodies)
+		isLarge[i] = true;
+
+	for(auto i : m_largeBodies)
+	{
+		for(uint32_t j=0; j<bodies.size(); j++)
+		{
+			if( (i == j) || !bodies[j].m_collide)
+				continue;
+
+			//Large-large pairs would otherwise be seen from both sides
+			if(isLarge[j] && (j < i) )
+				continue;
+
+			if(i < j)
+				TestPair(bodies, i, j);
+			else
+				TestPair(bodies, j, i);
+		}
+	}
+}
+
+/**
+	@brief Checks if two bodies collide, and adds the resulting forces if so
+
+	@param bodies	The bodies
+	@param i		Index of the first body
+	@param j		Index of the second body (j > i)
+ */
+void NodeCollisionSolver::TestPair(vector<NodeCollisionBody>& bodies, uint32_t i, uint32_t j)
+{
+	auto& a = bodies[i];
+	auto& b = bodies[j];
+
+	//Node-group collisions are special: nodes are allowed inside groups.
+	//Node-node is normal code path, group-group also repels
+	if(a.m_isGroup != b.m_isGroup)
+	{
+		auto& group = a.m_isGroup ? a : b;
+		auto& node = a.m_isGroup ? b : a;
+
+		//If node is completely INSIDE the group, don't repel
+		if(Contains(group, node))
+			return;
+
+		//If dragging group, we should push nodes away
+		//But if dragging the node, allow it to go into the group
+		if(node.m_dragging)
+			return;
+	}
+
+	//If no overlap, no action required
+	if(!Intersects(a, b))
+		return;
+
+	//We have an overlap!
+	//Find the unit vector between the node positions
+	float dx = b.m_x - a.m_x;
+	float dy = b.m_y - a.m_y;
+	float mag = sqrt(dx*dx + dy*dy);
+	float fx;
+	float fy;
+	if(mag > 1e-2)
+	{
+		fx = dx / mag;
+		fy = dy / mag;
+	}
+
+	//If nodes are exactly on top of each other apply a force in a random direction
+	else
+	{
+		float theta = fmodf(rand() * 1e-3f, 2*M_PI);
+		fx = sin(theta);
+		fy = cos(theta);
+	}
+
+	//Add this to the existing force vectors
+	a.m_forceX -= fx;
+	a.m_forceY -= fy;
+	b.m_forceX += fx;
+	b.m_forceY += fy;
+}
@@ -0,0 +1,131 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of NodeCollisionSolver
+ */
+#ifndef NodeCollisionSolver_h
+#define NodeCollisionSolver_h
+
+/**
+	@brief Geometry and state of one node in the filter graph, as seen by the collision solver
+ */
+class NodeCollisionBody
+{
+public:
+	NodeCollisionBody()
+	: m_x(0)
+	, m_y(0)
+	, m_width(0)
+	, m_height(0)
+	, m_isGroup(false)
+	, m_dragging(false)
+	, m_collide(true)
+	, m_forceX(0)
+	, m_forceY(0)
+	{}
+
+	///@brief Top left corner of the node
+	float m_x;
+	float m_y;
+
+	///@brief Size of the node
+	float m_width;
+	float m_height;
+
+	///@brief True if the node is a group rather than a filter/channel node
+	bool m_isGroup;
+
+	///@brief True if the node is being dragged by the user
+	bool m_dragging;
+
+	///@brief False if the node should be ignored entirely (e.g. virtual nodes for group input/output regions)
+	bool m_collide;
+
+	///@brief Net force on the node, output from CalculateForces()
+	float m_forceX;
+	float m_forceY;
+};
+
+/**
+	@brief Finds overlapping nodes in the filter graph and calculates forces to push them apart
+
+	Uses a uniform grid as a broadphase so only nodes which are close to each other are tested, rather than every pair.
+	Each body is added to every grid cell its (margin-expanded) bounding box touches, and a pair is only tested in the
+	first cell the two have in common so nothing is counted twice.
+ */
+class NodeCollisionSolver
+{
+public:
+	NodeCollisionSolver();
+
+	void CalculateForces(std::vector<NodeCollisionBody>& bodies);
+
+	static bool Intersects(const NodeCollisionBody& a, const NodeCollisionBody& b);
+	static bool Contains(const NodeCollisionBody& outer, const NodeCollisionBody& inner);
+
+protected:
+	void TestPair(std::vector<NodeCollisionBody>& bodies, uint32_t i, uint32_t j);
+	void TestLargeBodies(std::vector<NodeCollisionBody>& bodies);
+
+	/**
+		@brief One cell of the grid touched by a body
+	 */
+	class GridEntry
+	{
+	public:
+		GridEntry(uint64_t cell, uint32_t body)
+		: m_cell(cell)
+		, m_body(body)
+		{}
+
+		bool operator<(const GridEntry& rhs) const
+		{
+			if(m_cell != rhs.m_cell)
+				return m_cell < rhs.m_cell;
+			return m_body < rhs.m_body;
+		}
+
+		uint64_t m_cell;
+		uint32_t m_body;
+	};
+
+	///@brief Grid occupancy, sorted by cell (kept around between calls to avoid reallocating every frame)
+	std::vector<GridEntry> m_entries;
+
+	///@brief Bounding box of each body in grid cells (x0, y0, x1, y1)
+	std::vector<int32_t> m_cellBounds;
+
+	///@brief Bodies covering too many cells to be worth putting in the grid, tested against everything instead
+	std::vector<uint32_t> m_largeBodies;
+};
+
+#endif
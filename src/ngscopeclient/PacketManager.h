@@ -37,6 +37,7 @@
 
 #include "../../lib/scopehal/PacketDecoder.h"
 #include "Marker.h"
+#include "ProtocolDisplayFilter.h"
 
 class Session;
 
@@ -86,62 +87,6 @@ public:
 	Marker m_marker;
 };
 
-class ProtocolDisplayFilter;
-
-class ProtocolDisplayFilterClause
-{
-public:
-	ProtocolDisplayFilterClause(std::string str, size_t& i);
-	ProtocolDisplayFilterClause(const ProtocolDisplayFilterClause&) =delete;
-	ProtocolDisplayFilterClause& operator=(const ProtocolDisplayFilterClause&) =delete;
-
-	virtual ~ProtocolDisplayFilterClause();
-
-	bool Validate(std::vector<std::string> headers);
-
-	std::string Evaluate(const Packet* pack);
-
-	static std::string EatSpaces(std::string str);
-
-	enum
-	{
-		TYPE_DATA,
-		TYPE_IDENTIFIER,
-		TYPE_STRING,
-		TYPE_REAL,
-		TYPE_INT,
-		TYPE_EXPRESSION,
-		TYPE_ERROR
-	} m_type;
-
-	std::string m_identifier;
-	std::string m_string;
-	float m_real;
-	long m_long;
-	ProtocolDisplayFilter* m_expression;
-	bool m_invert;
-};
-
-class ProtocolDisplayFilter
-{
-public:
-	ProtocolDisplayFilter(std::string str, size_t& i);
-	ProtocolDisplayFilter(const ProtocolDisplayFilterClause&) =delete;
-	ProtocolDisplayFilter& operator=(const ProtocolDisplayFilter&) =delete;
-	virtual ~ProtocolDisplayFilter();
-
-	static void EatSpaces(std::string str, size_t& i);
-
-	bool Validate(std::vector<std::string> headers, bool nakedLiteralOK = false);
-
-	bool Match(const Packet* pack);
-	std::string Evaluate(const Packet* pack);
-
-protected:
-	std::vector<ProtocolDisplayFilterClause*> m_clauses;
-	std::vector<std::string> m_operators;
-};
-
 /**
 	@brief Keeps track of packetized data history from a single protocol analyzer filter
  */
@@ -153,6 +98,8 @@ public:
 
 	void Update();
 	void RemoveHistoryFrom(TimePoint timestamp);
+	bool HasPacketsFor(TimePoint timestamp);
+	void AdoptCurrentWaveform();
 
 	std::recursive_mutex& GetMutex()
 	{ return m_mutex; }
@@ -269,6 +269,16 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 			}
 			break;
 
+		//String: show a text box
+		case PreferenceType::String:
+			{
+				string s = pref.GetString();
+				ImGui::SetNextItemWidth(ImGui::GetFontSize() * 20);
+				if(ImGui::InputText(label.c_str(), &s))
+					pref.SetString(s);
+			}
+			break;
+
 		//Int: show a text box
 		case PreferenceType::Int:
 			{
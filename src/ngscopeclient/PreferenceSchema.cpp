@@ -163,6 +163,13 @@ void PreferenceManager::InitializeDefaults()
 				Preference::Color("icon_caption_color", ColorFromString("#ffffff"))
 				.Label("Icon color")
 				.Description("Color for icon captions"));
+			graph.AddPreference(
+				Preference::Real("cost_warning_threshold", FS_PER_SECOND / 2)
+				.Label("Cost warning threshold")
+				.Unit(Unit::UNIT_FS)
+				.Description(
+					"Predicted run time of a chain of filters above which the node cost display is highlighted.\n\n"
+					"Only used when \"Show Node Cost\" is enabled in the filter graph editor."));
 
 		auto& general = appearance.AddCategory("General");
 			general.AddPreference(
@@ -342,6 +349,16 @@ void PreferenceManager::InitializeDefaults()
 					.EnumValue("Multi window", VIEWPORT_ENABLE)
 					.EnumValue("Single window", VIEWPORT_DISABLE)
 				);
+			windows.AddPreference(
+				Preference::Real("panel_time_budget", 0.75)
+				.Label("Panel time budget")
+				.Unit(Unit::UNIT_PERCENT)
+				.Description(
+					"Fraction of the display refresh interval that may be spent drawing dialogs and waveform groups.\n"
+					"\n"
+					"If drawing takes longer than this, expensive panels (such as protocol analyzers) which are not\n"
+					"being interacted with update their contents less often until the frame rate recovers.")
+				);
 
 	auto& drivers = this->m_treeRoot.AddCategory("Drivers");
 		auto& dgeneral = drivers.AddCategory("General");
@@ -393,8 +410,48 @@ void PreferenceManager::InitializeDefaults()
 			.Label("Max recent files")
 			.Description("Maximum number of recent .scopesession file paths to save in history")
 			.Unit(Unit::UNIT_COUNTS));
+		auto& journal = files.AddCategory("Journal");
+			journal.AddPreference(
+				Preference::Bool("enable", false)
+				.Label("Journal acquisitions")
+				.Description(
+					"Write every new waveform to a journal on disk in the background, so that history can be\n"
+					"recovered if ngscopeclient crashes before the session is saved.\n\n"
+					"The journal is an ordinary .scopesession file, open it to recover. It's deleted when the\n"
+					"session is closed normally, and old waveforms are removed from it along with history."));
+			journal.AddPreference(
+				Preference::String("path", "")
+				.Label("Journal directory")
+				.Description(
+					"Directory to write journals to.\n\n"
+					"If blank, a \"journal\" directory under the ngscopeclient configuration directory is used."));
 
 	auto& misc = this->m_treeRoot.AddCategory("Miscellaneous");
+		auto& filters = misc.AddCategory("Filter Graph");
+			filters.AddPreference(
+				Preference::Real("reconfigure_delay", FS_PER_SECOND / 20)
+				.Label("Reconfigure delay")
+				.Unit(Unit::UNIT_FS)
+				.Description(
+					"Time to wait after a filter is reconfigured before re-running it.\n\n"
+					"Further changes within this time (for example, dragging a slider) are merged into a single\n"
+					"update. Any change also abandons an update which is already in progress."));
+		auto& history = misc.AddCategory("History");
+			history.AddPreference(
+				Preference::Real("filter_cache_size", 1024.0 * 1024 * 1024)
+				.Label("Filter output cache size")
+				.Unit(Unit::UNIT_BYTES)
+				.Description(
+					"Maximum amount of memory used to keep filter results for previously viewed history points.\n\n"
+					"Switching back to a cached history point displays it without re-running the filter graph.\n"
+					"Set to zero to disable the cache."));
+			history.AddPreference(
+				Preference::Int("prefetch_depth", 1)
+				.Label("Prefetch depth")
+				.Description(
+					"Number of history points on each side of the selected one to filter in the background.\n\n"
+					"Results are kept in the filter output cache, so stepping to a neighboring point displays\n"
+					"immediately. Set to zero to disable prefetching."));
 		auto& menus = misc.AddCategory("Menus");
 			menus.AddPreference(
 				Preference::Int("recent_instrument_count", 20)
@@ -414,8 +471,9 @@ void PreferenceManager::InitializeDefaults()
 						"constant redraws increase power consumption.\n"
 						"\n"
 						"In Power mode, the event loop blocks until a GUI event (keystroke, mouse movement, etc.)\n"
-						"occurs, or a user-specified timeout elapses. This results in more jerky display updates\n"
-						"but keeps the CPU idle most of the time, saving power."
+						"occurs, a new waveform arrives, or a user-specified timeout elapses. Frames are only\n"
+						"drawn when something on screen may have changed, so an idle window uses almost no CPU or\n"
+						"GPU time. Readouts from meters and power supplies update at the polling timeout rate."
 						)
 					.EnumValue("Performance", 0)
 					.EnumValue("Power", 1)
@@ -426,7 +484,7 @@ void PreferenceManager::InitializeDefaults()
 				.Unit(Unit::UNIT_FS)
 				.Description(
 					"Polling timeout for event loop in power-optimized mode.\n\n"
-					"Longer timeout values reduce power consumption, but also slows display updates.\n")
+					"Longer timeout values reduce power consumption, but also slow updates of instrument readouts.\n")
 				);
 
 
@@ -59,9 +59,13 @@ ProtocolAnalyzerDialog::ProtocolAnalyzerDialog(
 	, m_needToScrollToSelectedPacket(false)
 	, m_firstDataBlockOfFrame(true)
 	, m_bytesPerLine(1)
+	, m_filterColor(0)
 {
 	//Hold a reference open to the filter so it doesn't disappear on us
 	m_filter->AddRef();
+
+	//Filter validation and packet merging can be deferred if the frame is running long
+	m_budget.SetThrottleable(true);
 }
 
 ProtocolAnalyzerDialog::~ProtocolAnalyzerDialog()
@@ -118,17 +122,21 @@ bool ProtocolAnalyzerDialog::DoRender()
 	auto& prefs = m_parent.GetSession().GetPreferences();
 
 	//Figure out color for filter expression
-	ImU32 bgcolor;
+	//(parsing is expensive, so only do it on refresh frames. The expression can't change unless we have focus anyway)
 	size_t ifilter = 0;
-	ProtocolDisplayFilter filter(m_filterExpression, ifilter);
-	if(m_filterExpression == "")
-		bgcolor = ImGui::ColorConvertFloat4ToU32(ImGui::GetStyle().Colors[ImGuiCol_FrameBg]);
-	else if(filter.Validate(cols))
-		bgcolor = ColorFromString("#008000");
-	else
-		bgcolor = ColorFromString("#800000");
-	//TODO: yellow for possibly wrong stuff?
-	//TODO: allow configuration under preferences
+	if(m_budget.IsRefreshFrame())
+	{
+		ProtocolDisplayFilter filter(m_filterExpression, ifilter);
+		if(m_filterExpression == "")
+			m_filterColor = ImGui::ColorConvertFloat4ToU32(ImGui::GetStyle().Colors[ImGuiCol_FrameBg]);
+		else if(filter.Validate(cols))
+			m_filterColor = ColorFromString("#008000");
+		else
+			m_filterColor = ColorFromString("#800000");
+		//TODO: yellow for possibly wrong stuff?
+		//TODO: allow configuration under preferences
+	}
+	ImU32 bgcolor = m_filterColor;
 
 	//Filter expression
 	float boxwidth = ImGui::GetContentRegionAvail().x;
@@ -177,7 +185,14 @@ bool ProtocolAnalyzerDialog::DoRender()
 	}
 
 	//Do an update cycle to make sure any recently acquired packets are captured
-	m_mgr->Update();
+	//(the session already does this after every filter graph run, so it's safe to skip when over budget, or when
+	//the waveform thread is busy with the filter outputs and they may not belong to the point on screen)
+	if(m_budget.IsRefreshFrame())
+	{
+		shared_lock<shared_mutex> lock(m_session.GetWaveformDataMutex(), try_to_lock);
+		if(lock.owns_lock())
+			m_mgr->Update();
+	}
 
 	lock_guard<recursive_mutex> lock(m_mgr->GetMutex());
 	auto& rows = m_mgr->GetRows();
@@ -231,9 +246,30 @@ bool ProtocolAnalyzerDialog::DoRender()
 				//Is it a packet?
 				auto pack = row.m_packet;
 
-				//Make sure we have the packed colors cached
+				//Formatting text is most of the cost of drawing a row, so between refresh frames reuse whatever was
+				//formatted for the rows we drew last frame
+				ProtocolAnalyzerCachedRow* cache = nullptr;
 				if(pack)
-					pack->RefreshColors();
+				{
+					cache = &m_nextRowCache[pack];
+					auto it = m_rowCache.find(pack);
+					//Packet pointers may be reused after a packet is freed, so also check offset and waveform timestamp
+					if(!m_budget.IsRefreshFrame() &&
+						(it != m_rowCache.end()) &&
+						(it->second.m_offset == pack->m_offset) &&
+						(it->second.m_stamp == row.m_stamp) )
+					{
+						*cache = std::move(it->second);
+					}
+					else
+					{
+						//Make sure we have the packed colors cached
+						pack->RefreshColors();
+						*cache = ProtocolAnalyzerCachedRow();
+						cache->m_offset = pack->m_offset;
+						cache->m_stamp = row.m_stamp;
+					}
+				}
 
 				//Instead of using packet pointer as identifier (can change if filter graph re-runs for
 				//unrelated reasons), use timestamp instead.
@@ -304,8 +340,11 @@ bool ProtocolAnalyzerDialog::DoRender()
 				bool rowIsSelected = pack && (m_selectedPacket == pack);
 				TimePoint packtime(row.m_stamp.GetSec(), row.m_stamp.GetFs() + offset);
 
+				if(cache && cache->m_timestamp.empty())
+					cache->m_timestamp = packtime.PrettyPrint();
+
 				if(ImGui::Selectable(
-					packtime.PrettyPrint().c_str(),
+					cache ? cache->m_timestamp.c_str() : packtime.PrettyPrint().c_str(),
 					rowIsSelected,
 					ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowItemOverlap,
 					ImVec2(0, 0)))
@@ -350,7 +389,7 @@ bool ProtocolAnalyzerDialog::DoRender()
 							if(firstRow)
 								ImGui::SetCursorPosY(ImGui::GetCursorPosY() - (ImGui::GetScrollY() - rowStart));
 
-							DoDataColumn(pack, dataFont, rows, i);
+							DoDataColumn(pack, *cache, dataFont, rows, i);
 						}
 					}
 				}
@@ -401,6 +440,10 @@ bool ProtocolAnalyzerDialog::DoRender()
 		g.NavId = navId;
 	}
 
+	//Only keep cached text for rows which are still on screen
+	m_rowCache.swap(m_nextRowCache);
+	m_nextRowCache.clear();
+
 	//Apply filter expressions
 	if( (updated && filterDirty) || forceRefresh)
 	{
@@ -427,7 +470,12 @@ bool ProtocolAnalyzerDialog::DoRender()
 /**
 	@brief Handles the "data" column for packets
  */
-void ProtocolAnalyzerDialog::DoDataColumn(Packet* pack, ImFont* dataFont, vector<RowData>& rows, size_t nrow)
+void ProtocolAnalyzerDialog::DoDataColumn(
+	Packet* pack,
+	ProtocolAnalyzerCachedRow& cache,
+	ImFont* dataFont,
+	vector<RowData>& rows,
+	size_t nrow)
 {
 	//When drawing the first cell, figure out dimensions for subsequent stuff
 	if(m_firstDataBlockOfFrame)
@@ -470,13 +518,8 @@ void ProtocolAnalyzerDialog::DoDataColumn(Packet* pack, ImFont* dataFont, vector
 			return;
 	}
 
-	string firstLine;
-
 	auto& bytes = pack->m_data;
 
-	string lineHex;
-	string lineAscii;
-
 	//Create the tree node early - before we've even rendered any data - so we know the open / closed state
 	ImGui::PushFont(dataFont);
 	bool open = false;
@@ -490,8 +533,71 @@ void ProtocolAnalyzerDialog::DoDataColumn(Packet* pack, ImFont* dataFont, vector
 		}
 	}
 
-	//Format the data
-	string data;
+	//Format the data, unless we still have it from last frame
+	if( !cache.m_dataValid || (cache.m_open != open) || (cache.m_bytesPerLine != m_bytesPerLine) ||
+		(cache.m_format != (int)m_dataFormat) )
+	{
+		FormatData(bytes, open, cache.m_firstLine, cache.m_data);
+		cache.m_dataValid = true;
+		cache.m_open = open;
+		cache.m_bytesPerLine = m_bytesPerLine;
+		cache.m_format = (int)m_dataFormat;
+	}
+	auto& firstLine = cache.m_firstLine;
+	auto& data = cache.m_data;
+
+	auto firstPos = ImGui::GetCursorScreenPos();
+	ImGui::TextUnformatted(firstLine.c_str());
+
+	//Multiple lines? Only show if open
+	if(open)
+	{
+		//align vertically to previous line
+		auto nextPos = ImGui::GetCursorScreenPos();
+		nextPos.x = firstPos.x;
+		ImGui::SetCursorScreenPos(nextPos);
+
+		ImGui::TextUnformatted(data.c_str());
+		ImGui::TreePop();
+	}
+
+	ImGui::PopFont();
+	m_firstDataBlockOfFrame = false;
+
+	//Recompute height of THIS cell and apply changes if we've expanded
+	double padding = ImGui::GetStyle().CellPadding.y;
+	double height = padding*2 + ImGui::CalcTextSize(firstLine.c_str()).y;
+	if(open)
+		height += ImGui::CalcTextSize(data.c_str()).y;
+	double oldheight = rows[nrow].m_height;
+	double delta = height - oldheight;
+	if(abs(delta) > 0.001)
+	{
+		//Apply the changed height
+		rows[nrow].m_height = height;
+
+		//Move every impacted row up or down as appropriate
+		for(size_t i=nrow; i<rows.size(); i++)
+			rows[i].m_totalHeight += delta;
+	}
+}
+
+/**
+	@brief Formats a packet's data bytes for display in the data column
+
+	@param bytes		The data to format
+	@param open			True if the tree is open, so every line is shown
+	@param firstLine	Output for the first line
+	@param data			Output for the remaining lines
+ */
+void ProtocolAnalyzerDialog::FormatData(const vector<uint8_t>& bytes, bool open, string& firstLine, string& data)
+{
+	firstLine = "";
+	data = "";
+
+	string lineHex;
+	string lineAscii;
+
 	char tmp[32];
 	for(size_t i=0; i<bytes.size(); i++)
 	{
@@ -576,41 +682,6 @@ void ProtocolAnalyzerDialog::DoDataColumn(Packet* pack, ImFont* dataFont, vector
 			data += lineHex + "   " + lineAscii;
 		}
 	}
-
-	auto firstPos = ImGui::GetCursorScreenPos();
-	ImGui::TextUnformatted(firstLine.c_str());
-
-	//Multiple lines? Only show if open
-	if(open)
-	{
-		//align vertically to previous line
-		auto nextPos = ImGui::GetCursorScreenPos();
-		nextPos.x = firstPos.x;
-		ImGui::SetCursorScreenPos(nextPos);
-
-		ImGui::TextUnformatted(data.c_str());
-		ImGui::TreePop();
-	}
-
-	ImGui::PopFont();
-	m_firstDataBlockOfFrame = false;
-
-	//Recompute height of THIS cell and apply changes if we've expanded
-	double padding = ImGui::GetStyle().CellPadding.y;
-	double height = padding*2 + ImGui::CalcTextSize(firstLine.c_str()).y;
-	if(open)
-		height += ImGui::CalcTextSize(data.c_str()).y;
-	double oldheight = rows[nrow].m_height;
-	double delta = height - oldheight;
-	if(abs(delta) > 0.001)
-	{
-		//Apply the changed height
-		rows[nrow].m_height = height;
-
-		//Move every impacted row up or down as appropriate
-		for(size_t i=nrow; i<rows.size(); i++)
-			rows[i].m_totalHeight += delta;
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -42,6 +42,49 @@
 
 class MainWindow;
 
+/**
+	@brief Formatted text for one packet row, kept between refresh frames
+ */
+class ProtocolAnalyzerCachedRow
+{
+public:
+	ProtocolAnalyzerCachedRow()
+	: m_offset(0)
+	, m_stamp(0, 0)
+	, m_dataValid(false)
+	, m_open(false)
+	, m_bytesPerLine(0)
+	, m_format(0)
+	{}
+
+	///@brief Offset of the packet the text was formatted for
+	int64_t m_offset;
+
+	///@brief Timestamp of the waveform the packet came from
+	TimePoint m_stamp;
+
+	///@brief Timestamp column text (empty if not yet formatted)
+	std::string m_timestamp;
+
+	///@brief True if m_firstLine and m_data are up to date for the settings below
+	bool m_dataValid;
+
+	///@brief True if the data was formatted for an open tree
+	bool m_open;
+
+	///@brief Bytes per line the data was formatted for
+	size_t m_bytesPerLine;
+
+	///@brief Data format the data was formatted in
+	int m_format;
+
+	///@brief First line of the data column
+	std::string m_firstLine;
+
+	///@brief Remaining lines of the data column
+	std::string m_data;
+};
+
 /**
 	@brief UI for the history system
  */
@@ -110,7 +153,13 @@ protected:
 	///@brief True if the selected packet should be scrolled to
 	bool m_needToScrollToSelectedPacket;
 
-	void DoDataColumn(Packet* pack, ImFont* dataFont, std::vector<RowData>& rows, size_t nrow);
+	void DoDataColumn(
+		Packet* pack,
+		ProtocolAnalyzerCachedRow& cache,
+		ImFont* dataFont,
+		std::vector<RowData>& rows,
+		size_t nrow);
+	void FormatData(const std::vector<uint8_t>& bytes, bool open, std::string& firstLine, std::string& data);
 
 	///@brief True the first time DoDataColumn() is called in a given frame
 	bool m_firstDataBlockOfFrame;
@@ -123,6 +172,15 @@ protected:
 
 	///@brief Filter expression we're actually using
 	std::string m_committedFilterExpression;
+
+	///@brief Background color of the filter box, showing whether the expression is valid
+	ImU32 m_filterColor;
+
+	///@brief Formatted text for the rows drawn last frame
+	std::map<Packet*, ProtocolAnalyzerCachedRow> m_rowCache;
+
+	///@brief Formatted text for the rows drawn so far this frame
+	std::map<Packet*, ProtocolAnalyzerCachedRow> m_nextRowCache;
 };
 
 #endif
@@ -0,0 +1,430 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of ProtocolDisplayFilter
+ */
+#include "../scopehal/scopehal.h"
+#include "ProtocolDisplayFilter.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ProtocolDisplayFilter
+
+ProtocolDisplayFilter::ProtocolDisplayFilter(string str, size_t& i)
+{
+	//One or more clauses separated by operators
+	while(i < str.length())
+	{
+		//Read the clause
+		m_clauses.push_back(new ProtocolDisplayFilterClause(str, i));
+
+		//Remove spaces before the operator
+		EatSpaces(str, i);
+		if( (i >= str.length()) || (str[i] == ')') || (str[i] == ']') )
+			break;
+
+		//Read the operator, if any
+		string tmp;
+		while(i < str.length())
+		{
+			if(isspace(str[i]) || (str[i] == '\"') || (str[i] == '(') || (str[i] == ')') )
+				break;
+
+			//An alphanumeric character after an operator other than text terminates it
+			if( (tmp != "") && !isalnum(tmp[0]) && isalnum(str[i]) )
+				break;
+
+			tmp += str[i];
+			i++;
+		}
+		m_operators.push_back(tmp);
+	}
+}
+
+ProtocolDisplayFilter::~ProtocolDisplayFilter()
+{
+	for(auto c : m_clauses)
+		delete c;
+}
+
+bool ProtocolDisplayFilter::Validate(vector<string> headers, bool nakedLiteralOK)
+{
+	//No clauses? valid all-pass filter
+	if(m_clauses.empty())
+		return true;
+
+	//We should always have one more clause than operator
+	if( (m_operators.size() + 1) != m_clauses.size())
+		return false;
+
+	//Operators must make sense. For now only equal/unequal and boolean and/or allowed
+	for(auto op : m_operators)
+	{
+		if( (op != "==") &&
+			(op != "!=") &&
+			(op != "||") &&
+			(op != "&&") &&
+			(op != "startswith") &&
+			(op != "contains")
+		)
+		{
+			return false;
+		}
+	}
+
+	//If any clause is invalid, we're invalid
+	for(auto c : m_clauses)
+	{
+		if(!c->Validate(headers))
+			return false;
+	}
+
+	//A single literal is not a legal filter, it has to be compared to something
+	//(But for sub-expressions used as indexes etc, it's OK)
+	if(!nakedLiteralOK)
+	{
+		if(m_clauses.size() == 1)
+		{
+			if(m_clauses[0]->m_type != ProtocolDisplayFilterClause::TYPE_EXPRESSION)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void ProtocolDisplayFilter::EatSpaces(string str, size_t& i)
+{
+	while( (i < str.length()) && isspace(str[i]) )
+		i++;
+}
+
+bool ProtocolDisplayFilter::Match(const Packet* pack)
+{
+	if(m_clauses.empty())
+		return true;
+	else
+		return Evaluate(pack) != "0";
+}
+
+string ProtocolDisplayFilter::Evaluate(const Packet* pack)
+{
+	//Calling code checks for validity so no need to verify here
+
+	//For now, all operators have equal precedence and are evaluated left to right.
+	string current = m_clauses[0]->Evaluate(pack);
+	for(size_t i=1; i<m_clauses.size(); i++)
+	{
+		string rhs = m_clauses[i]->Evaluate(pack);
+		string op = m_operators[i-1];
+
+		bool a = (current != "0");
+		bool b = (rhs != "0");
+
+		//== and != do exact string equality checks
+		bool temp = false;
+		if(op == "==")
+			temp = (current == rhs);
+		else if(op == "!=")
+			temp = (current != rhs);
+
+		//&& and || do boolean operations
+		else if(op == "&&")
+			temp = (a && b);
+		else if(op == "||")
+			temp = (a || b);
+
+		//String prefix
+		else if(op == "startswith")
+			temp = (current.find(rhs) == 0);
+		else if(op == "contains")
+			temp = (current.find(rhs) != string::npos);
+
+		//done, convert back to string
+		current = temp ? "1" : "0";
+	}
+	return current;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ProtocolDisplayFilterClause
+
+ProtocolDisplayFilterClause::ProtocolDisplayFilterClause(string str, size_t& i)
+{
+	ProtocolDisplayFilter::EatSpaces(str, i);
+
+	m_real = 0;
+	m_long = 0;
+	m_expression = 0;
+	m_invert = false;
+
+	//Parenthetical expression
+	if( (str[i] == '(') || (str[i] == '!') )
+	{
+		//Inversion
+		if(str[i] == '!')
+		{
+			m_invert = true;
+			i++;
+
+			if(str[i] != '(')
+			{
+				m_type = TYPE_ERROR;
+				i++;
+				return;
+			}
+		}
+
+		i++;
+		m_type = TYPE_EXPRESSION;
+		m_expression = new ProtocolDisplayFilter(str, i);
+
+		//eat trailing spaces
+		ProtocolDisplayFilter::EatSpaces(str, i);
+
+		//expect closing parentheses
+		if(str[i] != ')')
+			m_type = TYPE_ERROR;
+		i++;
+	}
+
+	//Quoted string
+	else if(str[i] == '\"')
+	{
+		m_type = TYPE_STRING;
+		i++;
+
+		while( (i < str.length()) && (str[i] != '\"') )
+		{
+			m_string += str[i];
+			i++;
+		}
+
+		if(str[i] != '\"')
+			m_type = TYPE_ERROR;
+
+		i++;
+	}
+
+	//Number
+	else if(isdigit(str[i]) || (str[i] == '-') || (str[i] == '.') )
+	{
+		string tmp;
+		while( (i < str.length()) && (isdigit(str[i]) || (str[i] == '-')  || (str[i] == '.') || (str[i] == 'x')) )
+		{
+			tmp += str[i];
+			i++;
+		}
+
+		//Hex string
+		if(tmp.find("0x") == 0)
+		{
+			sscanf(tmp.c_str(), "%lx", (unsigned long*)&m_long);
+			m_type = TYPE_INT;
+		}
+
+		//Number with decimal point
+		else if(tmp.find('.') != string::npos)
+		{
+			m_real = atof(tmp.c_str());
+			m_type = TYPE_REAL;
+		}
+
+		//Number without decimal point
+		else
+		{
+			m_real = atol(tmp.c_str());
+			m_type = TYPE_INT;
+		}
+	}
+
+	//Identifier (or data)
+	else
+	{
+		m_type = TYPE_IDENTIFIER;
+
+		while( (i < str.length()) && isalnum(str[i]) )
+		{
+			m_identifier += str[i];
+			i++;
+		}
+
+		//Opening square bracket
+		if(str[i] == '[')
+		{
+			if(m_identifier == "data")
+			{
+				m_type = TYPE_DATA;
+				i++;
+
+				//Read the index expression
+				m_expression = new ProtocolDisplayFilter(str, i);
+
+				//eat trailing spaces
+				ProtocolDisplayFilter::EatSpaces(str, i);
+
+				//expect closing square bracket
+				if(str[i] != ']')
+					m_type = TYPE_ERROR;
+				i++;
+			}
+
+			else
+			{
+				m_type = TYPE_ERROR;
+				i++;
+			}
+		}
+
+		if(m_identifier == "")
+		{
+			i++;
+			m_type = TYPE_ERROR;
+		}
+	}
+}
+
+/**
+	@brief Returns a copy of the input string with spaces removed
+ */
+string ProtocolDisplayFilterClause::EatSpaces(string str)
+{
+	string ret;
+	for(auto c : str)
+	{
+		if(!isspace(c))
+			ret += c;
+	}
+	return ret;
+}
+
+string ProtocolDisplayFilterClause::Evaluate(const Packet* pack)
+{
+	char tmp[32];
+
+	switch(m_type)
+	{
+		case TYPE_DATA:
+			{
+				string sindex = m_expression->Evaluate(pack);
+				int index = atoi(sindex.c_str());
+
+				//Bounds check
+				if(pack->m_data.size() <= (size_t)index)
+					return "NaN";
+
+				return to_string(pack->m_data[index]);
+			}
+			break;
+
+		case TYPE_IDENTIFIER:
+			{
+				auto it = pack->m_headers.find(m_identifier);
+				if(it != pack->m_headers.end())
+					return it->second;
+				else
+					return "NaN";
+			}
+
+		case TYPE_STRING:
+			return m_string;
+
+		case TYPE_REAL:
+			snprintf(tmp, sizeof(tmp), "%f", m_real);
+			return tmp;
+
+		case TYPE_INT:
+			snprintf(tmp, sizeof(tmp), "%ld", m_long);
+			return tmp;
+
+		case TYPE_EXPRESSION:
+			if(m_invert)
+			{
+				if(m_expression->Evaluate(pack) == "1")
+					return "0";
+				else
+					return "1";
+			}
+			else
+				return m_expression->Evaluate(pack);
+
+		case TYPE_ERROR:
+		default:
+			return "NaN";
+	}
+
+	//never happens because of the 'default" clause, but prevents -Wreturn-type warning with some gcc versions
+	return "NaN";
+}
+
+ProtocolDisplayFilterClause::~ProtocolDisplayFilterClause()
+{
+	if(m_expression)
+		delete m_expression;
+}
+
+bool ProtocolDisplayFilterClause::Validate(vector<string> headers)
+{
+	switch(m_type)
+	{
+		case TYPE_ERROR:
+			return false;
+
+		case TYPE_DATA:
+			return m_expression->Validate(headers, true);
+
+		//If we're an identifier, we must be a valid header field
+		//TODO: support comparisons on data
+		case TYPE_IDENTIFIER:
+			for(auto h : headers)
+			{
+				//Match, removing spaces from header names if needed
+				//Note that m_identifier is now the real, un-spaced version of the identifier name
+				//so we can look it up in the packet
+				if(EatSpaces(h) == m_identifier)
+				{
+					m_identifier = h;
+					return true;
+				}
+			}
+
+			return false;
+
+		//If we're an expression, it must be valid
+		case TYPE_EXPRESSION:
+			return m_expression->Validate(headers);
+
+		default:
+			return true;
+	}
+}
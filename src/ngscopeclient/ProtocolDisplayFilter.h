@@ -0,0 +1,96 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of ProtocolDisplayFilter
+ */
+#ifndef ProtocolDisplayFilter_h
+#define ProtocolDisplayFilter_h
+
+#include "../../lib/scopehal/PacketDecoder.h"
+
+class ProtocolDisplayFilter;
+
+class ProtocolDisplayFilterClause
+{
+public:
+	ProtocolDisplayFilterClause(std::string str, size_t& i);
+	ProtocolDisplayFilterClause(const ProtocolDisplayFilterClause&) =delete;
+	ProtocolDisplayFilterClause& operator=(const ProtocolDisplayFilterClause&) =delete;
+
+	virtual ~ProtocolDisplayFilterClause();
+
+	bool Validate(std::vector<std::string> headers);
+
+	std::string Evaluate(const Packet* pack);
+
+	static std::string EatSpaces(std::string str);
+
+	enum
+	{
+		TYPE_DATA,
+		TYPE_IDENTIFIER,
+		TYPE_STRING,
+		TYPE_REAL,
+		TYPE_INT,
+		TYPE_EXPRESSION,
+		TYPE_ERROR
+	} m_type;
+
+	std::string m_identifier;
+	std::string m_string;
+	float m_real;
+	long m_long;
+	ProtocolDisplayFilter* m_expression;
+	bool m_invert;
+};
+
+class ProtocolDisplayFilter
+{
+public:
+	ProtocolDisplayFilter(std::string str, size_t& i);
+	ProtocolDisplayFilter(const ProtocolDisplayFilterClause&) =delete;
+	ProtocolDisplayFilter& operator=(const ProtocolDisplayFilter&) =delete;
+	virtual ~ProtocolDisplayFilter();
+
+	static void EatSpaces(std::string str, size_t& i);
+
+	bool Validate(std::vector<std::string> headers, bool nakedLiteralOK = false);
+
+	bool Match(const Packet* pack);
+	std::string Evaluate(const Packet* pack);
+
+protected:
+	std::vector<ProtocolDisplayFilterClause*> m_clauses;
+	std::vector<std::string> m_operators;
+};
+
+#endif
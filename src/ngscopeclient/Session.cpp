@@ -43,6 +43,7 @@
 #include "MultimeterDialog.h"
 #include "PowerSupplyDialog.h"
 #include "RFGeneratorDialog.h"
+#include "WaveformFileIO.h"
 #include "PreferenceTypes.h"
 
 #include "../scopehal/LeCroyOscilloscope.h"
@@ -56,9 +57,11 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <shlwapi.h>
+#include <direct.h>
 #else
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 extern Event g_waveformReadyEvent;
@@ -72,6 +75,10 @@ extern std::shared_mutex g_vulkanActivityMutex;
 
 using namespace std;
 
+static void RemoveWaveformDirectory(const string& path);
+static vector<FlowGraphNode*> GetNodesInDependencyOrder(const set<FlowGraphNode*>& nodes);
+static string GetIdentityMismatch(const string& name, const string& vendor, const string& serial, Instrument* inst);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
@@ -86,12 +93,18 @@ Session::Session(MainWindow* wnd)
 	, m_triggerOneShot(false)
 	, m_graphExecutor(/*8*/1)
 	, m_lastFilterGraphExecTime(0)
+	, m_graphRevision(0)
+	, m_filterProfilingEnabled(false)
+	, m_forceUncachedRefresh(false)
+	, m_prefetchSteps(0)
+	, m_instrumentConnectTime(0)
 	, m_history(*this)
 	, m_multiScope(false)
 	, m_nextMarkerNum(1)
+	, m_reconfigureDeadline(0)
+	, m_reconfigureGeneration(0)
+	, m_referenceFiltersCreated(false)
 {
-	CreateReferenceFilters();
-
 	SCPIOscilloscope::EnumDrivers(m_driverNamesByType["oscilloscope"]);
 	SCPIPowerSupply::EnumDrivers(m_driverNamesByType["psu"]);
 	SCPIRFSignalGenerator::EnumDrivers(m_driverNamesByType["rfgen"]);
@@ -145,6 +158,12 @@ void Session::ClearBackgroundThreads()
 		m_waveformThread->join();
 	m_waveformThread = nullptr;
 
+	//Stop loading waveforms from a file, if we were in the middle of it.
+	//Anything which hasn't made it into history yet is freed by the loader.
+	m_waveformLoader = nullptr;
+	m_pendingHistory.clear();
+	m_pendingMarkers.clear();
+
 	//Clear shutdown flag in case we're reusing the session object
 	m_shuttingDown = false;
 }
@@ -171,6 +190,12 @@ void Session::Clear()
 	//and can't happen after we hold the lock
 	ClearBackgroundThreads();
 
+	//Closing normally, so there's nothing to recover
+	CloseJournal();
+
+	//Don't hang on to any history points
+	CancelHistoryPrefetch();
+
 	lock_guard<shared_mutex> lock(m_waveformDataMutex);
 
 	//HACK: for now, export filters keep an open reference to themselves to avoid memory leaks
@@ -208,6 +233,12 @@ void Session::Clear()
 	//This ordering is important since waveforms removed from history get pushed into the WaveformPool of the scopes,
 	//so the scopes must not have been destroyed yet.
 	m_history.clear();
+	m_filterCache.Clear();
+	m_filterCacheKeys.clear();
+	m_prefetchTarget = nullptr;
+	m_savedDataDir = "";
+	m_savedWaveformIds.clear();
+	m_unloadedWaveformIds.clear();
 
 	m_oscilloscopes.clear();
 	m_psus.clear();
@@ -217,6 +248,7 @@ void Session::Clear()
 	m_scopeDeskewCal.clear();
 	m_markers.clear();
 	m_instrumentStates.clear();
+	InvalidateGraph();
 
 	//Remove all trigger groups
 	m_triggerGroups.clear();
@@ -247,6 +279,18 @@ vector<TimePoint> Session::GetMarkerTimes()
 	return ret;
 }
 
+/**
+	@brief Adds markers from the session file being loaded, once the history points they refer to exist
+ */
+void Session::LoadPendingMarkers()
+{
+	for(auto& m : m_pendingMarkers)
+		AddMarker(m);
+	m_pendingMarkers.clear();
+
+	OnMarkerChanged();
+}
+
 void Session::AddMarker(Marker m)
 {
 	//If we don't have history, add a dummy entry
@@ -313,8 +357,10 @@ bool Session::PreLoadFromYaml(const YAML::Node& node, const std::string& /*dataD
 		m_fileLoadVersion = 0;
 	}
 
-	//Preload our instruments
-	if(!PreLoadInstruments(m_fileLoadVersion, node["instruments"], online))
+	//Preload our instruments, then free anything that was connected in the background but never used
+	bool ok = PreLoadInstruments(m_fileLoadVersion, node["instruments"], online);
+	ClearPreconnectedInstruments();
+	if(!ok)
 		return false;
 
 	return true;
@@ -340,6 +386,10 @@ bool Session::LoadFromYaml(const YAML::Node& node, const string& dataDir, bool o
 		return false;
 	if(!LoadInstrumentInputs(m_fileLoadVersion, node["instruments"]))
 		return false;
+
+	//Channel configuration (visibility, enables, inputs) all just changed
+	InvalidateGraph();
+
 	if(!m_mainWindow->LoadUIConfiguration(m_fileLoadVersion, node["ui_config"]))
 		return false;
 	if(!LoadTriggerGroups(node["triggergroups"]))
@@ -347,24 +397,16 @@ bool Session::LoadFromYaml(const YAML::Node& node, const string& dataDir, bool o
 	if(!LoadWaveformData(m_fileLoadVersion, dataDir))
 		return false;
 
-	//Markers
-	auto markers = node["ui_config"]["markers"];
-	if(markers)
-	{
-		for(auto it : markers)
-		{
-			auto inode = it.second;
-			TimePoint timestamp(inode["timestamp"].as<int64_t>(), inode["time_fsec"].as<int64_t>());
-			for(auto jt : inode["markers"])
-				AddMarker(Marker(timestamp, jt.second["offset"].as<int64_t>(), jt.second["name"].as<string>()));
-		}
-	}
-
-	OnMarkerChanged();
+	//Markers. AddMarker() creates a placeholder history point if there's no waveform at the marker's timestamp,
+	//so they can't be added until the waveforms they're attached to are in history.
+	m_pendingMarkers.clear();
+	ParseSessionMarkers(node["ui_config"]["markers"], m_pendingMarkers);
+	if(!IsLoadingWaveforms())
+		LoadPendingMarkers();
 
 	//If we have no waveform data (filter-only session) create a WaveformThread to do rendering,
 	//then refresh the filter graph
-	if(m_history.empty())
+	if(m_history.empty() && !IsLoadingWaveforms())
 	{
 		StartWaveformThreadIfNeeded();
 		RefreshAllFiltersNonblocking();
@@ -373,11 +415,21 @@ bool Session::LoadFromYaml(const YAML::Node& node, const string& dataDir, bool o
 	return true;
 }
 
-//TODO: this should run in a background thread or something to keep the UI responsive
+/**
+	@brief Starts loading waveform data from the session's data directory
+
+	Filter waveforms are loaded immediately. Scope waveforms are read by a pool of background threads; once
+	FinishLoadingWaveforms() returns true they have been added to history.
+ */
 bool Session::LoadWaveformData(int version, const string& dataDir)
 {
 	LogTrace("Loading waveform data\n");
 
+	//Waveforms loaded from the data directory don't need to be written back to it on the next save
+	m_savedDataDir = dataDir;
+	m_savedWaveformIds.clear();
+	m_unloadedWaveformIds.clear();
+
 	//Load filter waveforms *before* scope data
 	//(we don't want any filters to be updated from nonexistent inputs and change state prior to getting output loaded)
 	string fname = dataDir + "/filter_metadata.yml";
@@ -394,29 +446,142 @@ bool Session::LoadWaveformData(int version, const string& dataDir)
 		}
 	}
 
-	//Load data for each scope
+	//Queue up data for each scope
+	m_waveformLoader = make_unique<WaveformLoader>();
+	m_pendingHistory.clear();
 	for(size_t i=0; i<m_oscilloscopes.size(); i++)
 	{
 		auto scope = m_oscilloscopes[i];
 		int id = m_idtable[(Instrument*)scope.get()];
 
-		char tmp[512] = {0};
-		snprintf(tmp, sizeof(tmp), "%s/scope_%d_metadata.yml", dataDir.c_str(), id);
-		auto docs = YAML::LoadAllFromFile(tmp);
-
 		//Nothing there? No waveforms at all, skip loading
-		if(docs.empty())
-			return true;
+		vector<WaveformMetadata> waveforms;
+		if(!LoadScopeMetadata(dataDir, id, version, waveforms))
+			break;
+
+		//Nothing in the directory belongs to us until it's actually been loaded into history
+		for(auto& w : waveforms)
+			m_unloadedWaveformIds.emplace(w.m_id);
 
-		if(!LoadWaveformDataForScope(version, docs[0], scope, dataDir))
+		if(!LoadWaveformDataForScope(waveforms, scope, dataDir))
 		{
 			LogTrace("Waveform data loading failed\n");
+			m_waveformLoader = nullptr;
+			m_pendingHistory.clear();
 			return false;
 		}
+
+		//The newest waveform from each scope is what will be on screen once loading finishes,
+		//so have the loader push it to the GPU in the background
+		if(!m_pendingHistory.empty() && (m_pendingHistory.back().m_scope == scope) )
+		{
+			for(auto& s : m_pendingHistory.back().m_streams)
+				m_waveformLoader->RequestUpload(s.m_job);
+		}
+	}
+
+	//Nothing to load? We're done
+	if(m_pendingHistory.empty())
+	{
+		m_waveformLoader = nullptr;
+		m_history.SetMaxToCurrentDepth();
+		return true;
+	}
+
+	//Start the actual file I/O, then wait for FinishLoadingWaveforms()
+	m_waveformLoader->Start();
+	return true;
+}
+
+/**
+	@brief Adds waveforms from the session file to history, once the background loader has finished with them
+
+	Called once per frame by the GUI thread.
+
+	@return True if loading completed during this call
+ */
+bool Session::FinishLoadingWaveforms()
+{
+	if(!m_waveformLoader || !m_waveformLoader->IsDone())
+		return false;
+
+	LogTrace("Waveform loading complete, adding to history\n");
+	LogIndenter li;
+
+	//Attach each point's waveforms to the scope, then record it in history and run the filter graph on it.
+	//This needs to be done in file order, same as if it was loaded synchronously.
+	set<int64_t> skippedIds;
+	for(auto& point : m_pendingHistory)
+	{
+		//AddHistory() ignores a second point at the same timestamp (corrupted or hand-edited metadata).
+		//Free the data rather than leaking it, and don't mark the existing point as coming from this directory.
+		if(m_history.HasHistory(point.m_time))
+		{
+			LogWarning("Duplicate waveform timestamp %s in session file, ignoring\n", point.m_time.PrettyPrint().c_str());
+			for(auto& s : point.m_streams)
+				delete m_waveformLoader->Detach(s.m_job);
+			skippedIds.emplace(point.m_waveformId);
+			continue;
+		}
+
+		//Same if any of the data files were truncated or unreadable, a partial point is worse than none
+		bool failed = false;
+		for(auto& s : point.m_streams)
+			failed |= m_waveformLoader->IsFailed(s.m_job);
+		if(failed)
+		{
+			LogWarning("Couldn't load waveform %s from session file, ignoring\n", point.m_time.PrettyPrint().c_str());
+			for(auto& s : point.m_streams)
+				delete m_waveformLoader->Detach(s.m_job);
+			skippedIds.emplace(point.m_waveformId);
+			continue;
+		}
+
+		for(auto& s : point.m_streams)
+		{
+			s.m_chan->Detach(s.m_stream);
+			s.m_chan->SetData(m_waveformLoader->Detach(s.m_job), s.m_stream);
+		}
+
+		vector<shared_ptr<Oscilloscope>> temp;
+		temp.push_back(point.m_scope);
+		m_history.AddHistory(temp, false, point.m_pinned, point.m_label);
+
+		//Remember where the data came from so it's not rewritten if we save back to the same place
+		auto hpoint = m_history.GetHistory(point.m_time);
+		if(hpoint)
+		{
+			hpoint->m_dirty = false;
+			hpoint->m_savedId = point.m_waveformId;
+			m_savedWaveformIds.emplace(point.m_waveformId);
+			m_unloadedWaveformIds.erase(point.m_waveformId);
+		}
 	}
 
+	//Directories we skipped still hold data that isn't in history, so they must never be deleted or reused
+	for(auto id : skippedIds)
+		m_unloadedWaveformIds.emplace(id);
+
 	m_history.SetMaxToCurrentDepth();
 
+	//Now that every point is in history, markers can be attached to them
+	LoadPendingMarkers();
+
+	//Only the newest point is on screen, so that's all the filter graph needs to run on now.
+	//Older points get filtered when the user navigates to them in history, same as for live acquisitions.
+	//TODO: handle eye patterns (need to know window size for it to work right)
+	StartWaveformThreadIfNeeded();
+	RefreshAllFiltersNonblocking();
+
+	Unit bytes(Unit::UNIT_BYTES);
+	double dt = m_waveformLoader->GetElapsedTime();
+	LogDebug("Loaded %s of waveform data in %.3f sec (%s/s)\n",
+		bytes.PrettyPrint(m_waveformLoader->GetBytesTotal()).c_str(),
+		dt,
+		bytes.PrettyPrint(m_waveformLoader->GetBytesTotal() / dt).c_str());
+
+	m_pendingHistory.clear();
+	m_waveformLoader = nullptr;
 	return true;
 }
 
@@ -494,7 +659,7 @@ bool Session::LoadWaveformDataForFilters(
 
 			//Actually load the waveform
 			string fname = datdir + "/stream" + to_string(i) + ".bin";
-			DoLoadWaveformDataForStream(f, i, fmt, fname);
+			LoadWaveformDataForStream(f, i, fmt, fname);
 		}
 	}
 
@@ -502,26 +667,19 @@ bool Session::LoadWaveformDataForFilters(
 }
 
 /**
-	@brief Loads waveform data for a single scope
+	@brief Queues waveform data for a single scope to be loaded in the background
  */
 bool Session::LoadWaveformDataForScope(
-	int version,
-	const YAML::Node& node,
+	const vector<WaveformMetadata>& waveforms,
 	shared_ptr<Oscilloscope> scope,
 	const std::string& dataDir)
 {
 	LogTrace("Loading waveform data for scope \"%s\"\n", scope->m_nickname.c_str());
 	LogIndenter li;
 
-	TimePoint time(0, 0);
-	TimePoint newest(0, 0);
-
-	auto wavenode = node["waveforms"];
-	if(!wavenode)
-	{
-		//No waveforms
+	//No waveforms
+	if(waveforms.empty())
 		return true;
-	}
 	int scope_id = m_idtable[(Instrument*)scope.get()];
 
 	//Clear out any old waveforms the instrument may have
@@ -538,64 +696,33 @@ bool Session::LoadWaveformDataForScope(
 	}
 
 	//Load the data for each waveform
-	for(auto it : wavenode)
+	set<TimePoint> queuedTimes;
+	for(auto& wfm : waveforms)
 	{
-		//Top level metadata
-		bool timebase_is_ps = true;
-		auto wfm = it.second;
-		time.first = wfm["timestamp"].as<long long>();
-		if(wfm["time_psec"])
-		{
-			time.second = wfm["time_psec"].as<long long>() * 1000;
-			timebase_is_ps = true;
-		}
-		else
-		{
-			time.second = wfm["time_fsec"].as<long long>();
-			timebase_is_ps = false;
-		}
-		int waveform_id = wfm["id"].as<int>();
-		bool pinned = false;
-		if(wfm["pinned"])
-		{
-			if(version <= 1)
-				pinned = wfm["pinned"].as<int>();
-			else
-				pinned = wfm["pinned"].as<bool>();
-		}
-		string label;
-		if(wfm["label"])
-			label = wfm["label"].as<string>();
-
+		auto time = wfm.m_time;
 		LogTrace("Loading waveform data at time %s\n", time.PrettyPrint().c_str());
 
 		//If we already have historical data from this timestamp, warn and drop the duplicate data
 		auto hist = m_history.GetHistory(time);
-		if(hist && (hist->m_history.find(scope) != hist->m_history.end()))
+		bool duplicate = (hist && (hist->m_history.find(scope) != hist->m_history.end()));
+		if(duplicate || (queuedTimes.find(time) != queuedTimes.end()) )
 		{
 			LogWarning("Session contains duplicate data for time %" PRId64 ".%" PRId64 ", discarding\n", static_cast<int64_t>(time.first), time.second);
 			continue;
 		}
 
 		//Set up channel metadata first (serialized)
-		auto chans = wfm["channels"];
 		vector<pair<int, int>> channels;	//pair<channel, stream>
 		vector<string> formats;
-		for(auto jt : chans)
+		vector<WaveformBase*> caps;
+		for(auto& ch : wfm.m_streams)
 		{
-			auto ch = jt.second;
-			int channel_index = ch["index"].as<int>();
-			int stream = 0;
-			if(ch["stream"])
-				stream = ch["stream"].as<int>();
+			int channel_index = ch.m_channel;
+			int stream = ch.m_stream;
 			auto chan = scope->GetOscilloscopeChannel(channel_index);
 			channels.push_back(pair<int, int>(channel_index, stream));
 
-			//Waveform format defaults to sparsev1 as that's what was used before
-			//the metadata file contained a format ID at all
-			string format = "sparsev1";
-			if(ch["format"])
-				format = ch["format"].as<string>();
+			auto& format = ch.m_format;
 			formats.push_back(format);
 
 			bool dense = (format == "densev1");
@@ -609,9 +736,9 @@ bool Session::LoadWaveformDataForScope(
 			CANWaveform* sccap = nullptr;
 
 			//if datatype is specified, use that
-			if( (format == "sparsev1") && ch["datatype"] )
+			if( (format == "sparsev1") && !ch.m_datatype.empty() )
 			{
-				auto dtype = ch["datatype"].as<string>();
+				auto& dtype = ch.m_datatype;
 				if(dtype == "analog")
 					cap = sacap = new SparseAnalogWaveform;
 				else if(dtype == "digital")
@@ -639,22 +766,21 @@ bool Session::LoadWaveformDataForScope(
 			}
 
 			//Channel waveform metadata
-			cap->m_timescale = ch["timescale"].as<long>();
+			cap->m_timescale = ch.m_timescale;
 			cap->m_startTimestamp = time.first;
 			cap->m_startFemtoseconds = time.second;
-			if(timebase_is_ps)
-			{
-				cap->m_timescale *= 1000;
-				cap->m_triggerPhase = ch["trigphase"].as<float>() * 1000;
-			}
-			else
-				cap->m_triggerPhase = ch["trigphase"].as<long long>();
+			cap->m_triggerPhase = ch.m_triggerPhase;
 
-			chan->Detach(stream);
-			chan->SetData(cap, stream);
+			caps.push_back(cap);
 		}
 
-		//Actually load the data for each channel
+		//Queue the data for each channel to be loaded
+		PendingHistoryPoint point;
+		point.m_time = time;
+		point.m_scope = scope;
+		point.m_pinned = wfm.m_pinned;
+		point.m_label = wfm.m_label;
+		point.m_waveformId = wfm.m_id;
 		size_t nchans = channels.size();
 		char tmp[512];
 		for(size_t i=0; i<nchans; i++)
@@ -667,7 +793,7 @@ bool Session::LoadWaveformDataForScope(
 				snprintf(tmp, sizeof(tmp), "%s/scope_%d_waveforms/waveform_%d/channel_%d.bin",
 					dataDir.c_str(),
 					scope_id,
-					waveform_id,
+					wfm.m_id,
 					nchan);
 			}
 			else
@@ -675,194 +801,23 @@ bool Session::LoadWaveformDataForScope(
 				snprintf(tmp, sizeof(tmp), "%s/scope_%d_waveforms/waveform_%d/channel_%d_stream%d.bin",
 					dataDir.c_str(),
 					scope_id,
-					waveform_id,
+					wfm.m_id,
 					nchan,
 					nstream);
 			}
 
-			DoLoadWaveformDataForStream(
+			point.m_streams.push_back(PendingStream(
 				scope->GetOscilloscopeChannel(nchan),
 				nstream,
-				formats[i],
-				tmp);
+				m_waveformLoader->Add(caps[i], formats[i], tmp)));
 		}
 
-		vector<shared_ptr<Oscilloscope>> temp;
-		temp.push_back(scope);
-		m_history.AddHistory(temp, false, pinned, label);
-
-		//TODO: this is not good for multiscope
-		//TODO: handle eye patterns (need to know window size for it to work right)
-		RefreshAllFilters();
+		queuedTimes.emplace(time);
+		m_pendingHistory.push_back(point);
 	}
 	return true;
 }
 
-void Session::DoLoadWaveformDataForStream(
-	OscilloscopeChannel* chan,
-	int stream,
-	string format,
-	string fname
-	)
-{
-	auto cap = chan->GetData(stream);
-	auto sacap = dynamic_cast<SparseAnalogWaveform*>(cap);
-	auto uacap = dynamic_cast<UniformAnalogWaveform*>(cap);
-	auto sdcap = dynamic_cast<SparseDigitalWaveform*>(cap);
-	auto udcap = dynamic_cast<UniformDigitalWaveform*>(cap);
-	auto ccap = dynamic_cast<CANWaveform*>(cap);
-
-	cap->PrepareForCpuAccess();
-
-	//Load samples into memory
-	unsigned char* buf = NULL;
-
-	//Windows: use generic file reads for now
-	#ifdef _WIN32
-		FILE* fp = fopen(fname.c_str(), "rb");
-		if(!fp)
-		{
-			LogError("couldn't open %s\n", fname.c_str());
-			return;
-		}
-
-		//Read the whole file into a buffer a megabyte at a time
-		fseek(fp, 0, SEEK_END);
-		long len = ftell(fp);
-		fseek(fp, 0, SEEK_SET);
-		buf = new unsigned char[len];
-		long len_remaining = len;
-		long blocksize = 1024*1024;
-		long read_offset = 0;
-		while(len_remaining > 0)
-		{
-			if(blocksize > len_remaining)
-				blocksize = len_remaining;
-
-			//Most time is spent on the fread's when using this path
-			fread(buf + read_offset, 1, blocksize, fp);
-
-			len_remaining -= blocksize;
-			read_offset += blocksize;
-		}
-		fclose(fp);
-
-	//On POSIX, just memory map the file
-	#else
-		int fd = open(fname.c_str(), O_RDONLY);
-		if(fd < 0)
-		{
-			LogError("couldn't open %s\n", fname.c_str());
-			return;
-		}
-		size_t len = lseek(fd, 0, SEEK_END);
-		buf = (unsigned char*)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
-	#endif
-
-	//Sparse interleaved
-	if(format == "sparsev1")
-	{
-		//Figure out how many samples we have
-		size_t samplesize = 2*sizeof(int64_t);
-		if(sacap)
-			samplesize += sizeof(float);
-		else if(sdcap)
-			samplesize += sizeof(bool);
-		else if(ccap)
-			samplesize += 2*sizeof(int32_t);
-		size_t nsamples = len / samplesize;
-		cap->Resize(nsamples);
-
-		//TODO: AVX this?
-		for(size_t j=0; j<nsamples; j++)
-		{
-			size_t offset = j*samplesize;
-
-			//Read start time and duration
-			int64_t* stime = reinterpret_cast<int64_t*>(buf+offset);
-			offset += 2*sizeof(int64_t);
-
-			//Read sample data
-			if(sacap)
-			{
-				//The file format assumes "float" is IEEE754 32-bit float.
-				//If your platform doesn't do that, good luck.
-				//cppcheck-suppress invalidPointerCast
-				sacap->m_samples[j] = *reinterpret_cast<float*>(buf+offset);
-
-				sacap->m_offsets[j] = stime[0];
-				sacap->m_durations[j] = stime[1];
-			}
-
-			else if(sdcap)
-			{
-				sdcap->m_samples[j] = *reinterpret_cast<bool*>(buf+offset);
-				sdcap->m_offsets[j] = stime[0];
-				sdcap->m_durations[j] = stime[1];
-			}
-
-			//CAN capture
-			else if(ccap)
-			{
-				uint32_t* p = reinterpret_cast<uint32_t*>(buf+offset);
-
-				ccap->m_samples[j] = CANSymbol((CANSymbol::stype)p[1], p[0]);
-				ccap->m_offsets[j] = stime[0];
-				ccap->m_durations[j] = stime[1];
-			}
-		}
-
-		//Quickly check if the waveform is dense packed, even if it was stored as sparse.
-		//Since we know samples must be monotonic and non-overlapping, we don't have to check every single one!
-		int64_t nlast = nsamples - 1;
-		if(sacap)
-		{
-			if( (sacap->m_offsets[0] == 0) &&
-				(sacap->m_offsets[nlast] == nlast) &&
-				(sacap->m_durations[nlast] == 1) )
-			{
-				//Waveform was actually uniform, so convert it
-				cap = new UniformAnalogWaveform(*sacap);
-				chan->SetData(cap, stream);
-			}
-		}
-	}
-
-	//Dense packed
-	else if(format == "densev1")
-	{
-		//Figure out length
-		size_t nsamples = 0;
-		if(uacap)
-			nsamples = len / sizeof(float);
-		else if(udcap)
-			nsamples = len / sizeof(bool);
-		cap->Resize(nsamples);
-
-		//Read sample data
-		if(uacap)
-			memcpy(uacap->m_samples.GetCpuPointer(), buf, nsamples*sizeof(float));
-		else
-			memcpy(udcap->m_samples.GetCpuPointer(), buf, nsamples*sizeof(bool));
-	}
-
-	else
-	{
-		LogError(
-			"Unknown waveform format \"%s\", perhaps this file was created by a newer version of ngscopeclient?\n",
-			format.c_str());
-	}
-
-	cap->MarkModifiedFromCpu();
-
-	#ifdef _WIN32
-		delete[] buf;
-	#else
-		munmap(buf, len);
-		::close(fd);
-	#endif
-}
-
 /**
 	@brief Performs an exhaustive search of the driver list to see which type this instrument is
 
@@ -898,6 +853,11 @@ bool Session::PreLoadInstruments(int version, const YAML::Node& node, bool onlin
 		return false;
 	}
 
+	//Connect to everything in parallel first, since some transports and drivers take a long time to come up
+	double tstart = GetTime();
+	if(online)
+		PreconnectInstruments(node);
+
 	//Load each instrument
 	for(auto it : node)
 	{
@@ -969,9 +929,127 @@ bool Session::PreLoadInstruments(int version, const YAML::Node& node, bool onlin
 		}
 	}
 
+	m_instrumentConnectTime = GetTime() - tstart;
+	LogDebug("Connected to instruments in %.3f ms\n", m_instrumentConnectTime * 1000);
+
 	return true;
 }
 
+/**
+	@brief Connects to every instrument in a session file in parallel
+
+	Each instrument gets its own thread which opens the transport, creates the driver and checks its identity against
+	the session file. The results are stored in m_preconnected and picked up by CreateTransportForNode(),
+	TakePreconnectedInstrument() and VerifyInstrument() during the (serial) preload, which reports any errors from
+	the GUI thread.
+ */
+void Session::PreconnectInstruments(const YAML::Node& node)
+{
+	vector<uintptr_t> ids;
+	vector<string> types;
+	vector<string> drivers;
+	vector<string> transports;
+	vector<string> args;
+	vector<string> names;
+	vector<string> vendors;
+	vector<string> serials;
+	for(auto it : node)
+	{
+		auto inst = it.second;
+
+		//Instruments without connection info (demo drivers etc) are quick to create, do them inline
+		auto transtype = inst["transport"].as<string>();
+		if(transtype == "null")
+			continue;
+
+		auto driver = inst["driver"].as<string>();
+		auto type = GetRegisteredTypeOfDriver(driver);
+		if(type == "unknown")
+			continue;
+
+		ids.push_back(inst["id"].as<uintptr_t>());
+		types.push_back(type);
+		drivers.push_back(driver);
+		transports.push_back(transtype);
+		args.push_back(inst["args"].as<string>());
+		names.push_back(inst["name"].as<string>());
+		vendors.push_back(inst["vendor"].as<string>());
+		serials.push_back(inst["serial"].as<string>());
+	}
+
+	if(ids.empty())
+		return;
+	LogTrace("Connecting to %zu instruments in parallel\n", ids.size());
+
+	vector<PreconnectedInstrument> results(ids.size());
+	vector<thread> threads;
+	for(size_t i=0; i<ids.size(); i++)
+	{
+		threads.push_back(thread([&, i]
+		{
+			auto& result = results[i];
+			result.m_transport = SCPITransport::CreateTransport(transports[i], args[i]);
+			if(result.m_transport && result.m_transport->IsConnected())
+				result.m_instrument = CreateInstrumentOfType(types[i], drivers[i], result.m_transport);
+			if(result.m_instrument)
+			{
+				result.m_verifiedInstrument = result.m_instrument.get();
+				result.m_verifyError = GetIdentityMismatch(names[i], vendors[i], serials[i], result.m_verifiedInstrument);
+			}
+		}));
+	}
+	for(auto& t : threads)
+		t.join();
+
+	for(size_t i=0; i<ids.size(); i++)
+		m_preconnected[ids[i]] = results[i];
+}
+
+/**
+	@brief Frees any instruments or transports from PreconnectInstruments() which were never used
+ */
+void Session::ClearPreconnectedInstruments()
+{
+	for(auto& it : m_preconnected)
+	{
+		//If a driver was created it owns the transport, otherwise we do
+		if(!it.second.m_instrument)
+			delete it.second.m_transport;
+	}
+	m_preconnected.clear();
+}
+
+/**
+	@brief Creates a driver instance for an instrument of a given type (as returned by GetRegisteredTypeOfDriver())
+
+	Safe to call from any thread.
+ */
+shared_ptr<Instrument> Session::CreateInstrumentOfType(const string& type, const string& driver, SCPITransport* transport)
+{
+	if(type == "oscilloscope")
+		return Oscilloscope::CreateOscilloscope(driver, transport);
+	else if(type == "psu")
+		return SCPIPowerSupply::CreatePowerSupply(driver, transport);
+	else if(type == "rfgen")
+		return SCPIRFSignalGenerator::CreateRFSignalGenerator(driver, transport);
+	else if(type == "funcgen")
+		return SCPIFunctionGenerator::CreateFunctionGenerator(driver, transport);
+	else if(type == "multimeter")
+		return SCPIMultimeter::CreateMultimeter(driver, transport);
+	else if(type == "spectrometer")
+		return SCPISpectrometer::CreateSpectrometer(driver, transport);
+	else if(type == "sdr")
+		return SCPISDR::CreateSDR(driver, transport);
+	else if(type == "load")
+		return SCPILoad::CreateLoad(driver, transport);
+	else if(type == "bert")
+		return SCPIBERT::CreateBERT(driver, transport);
+	else if(type == "misc")
+		return SCPIMiscInstrument::CreateInstrument(driver, transport);
+
+	return nullptr;
+}
+
 bool Session::LoadInstruments(int version, const YAML::Node& node, bool /*online*/)
 {
 	LogTrace("Loading saved instruments\n");
@@ -996,8 +1074,16 @@ bool Session::LoadInstruments(int version, const YAML::Node& node, bool /*online
 
 SCPITransport* Session::CreateTransportForNode(const YAML::Node& node)
 {
-	//Create the scope
-	auto transport = SCPITransport::CreateTransport(node["transport"].as<string>(), node["args"].as<string>());
+	//Use the transport from PreconnectInstruments() if we have one, otherwise create it now
+	SCPITransport* transport = nullptr;
+	auto it = m_preconnected.find(node["id"].as<uintptr_t>());
+	if( (it != m_preconnected.end()) && it->second.m_transport)
+	{
+		transport = it->second.m_transport;
+		it->second.m_transport = nullptr;
+	}
+	else
+		transport = SCPITransport::CreateTransport(node["transport"].as<string>(), node["args"].as<string>());
 
 	//Check if the transport failed to initialize
 	if((transport == nullptr) || !transport->IsConnected())
@@ -1011,32 +1097,56 @@ SCPITransport* Session::CreateTransportForNode(const YAML::Node& node)
 	return transport;
 }
 
-bool Session::VerifyInstrument(const YAML::Node& node, shared_ptr<Instrument> inst)
+/**
+	@brief Sanity checks an instrument's make/model/serial against the session file
+
+	Safe to call from any thread.
+
+	@return Error message, or an empty string if everything matches
+ */
+static string GetIdentityMismatch(const string& name, const string& vendor, const string& serial, Instrument* inst)
 {
-	//Sanity check make/model/serial. If mismatch, stop
 	//TODO: preference to enforce serial match?
-	if(node["name"].as<string>() != inst->GetName())
+	if(name != inst->GetName())
 	{
-		m_mainWindow->ShowErrorPopup(
-			"Unable to reconnect",
-			string("Unable to connect to oscilloscope: instrument has model name \"") +
-			inst->GetName() + "\", save file has model name \"" + node["name"].as<string>()  + "\"");
-		return false;
+		return string("Unable to connect to oscilloscope: instrument has model name \"") +
+			inst->GetName() + "\", save file has model name \"" + name  + "\"";
 	}
-	else if(node["vendor"].as<string>() != inst->GetVendor())
+	else if(vendor != inst->GetVendor())
 	{
-		m_mainWindow->ShowErrorPopup(
-			"Unable to reconnect",
-			string("Unable to connect to oscilloscope: instrument has vendor \"") +
-			inst->GetVendor() + "\", save file has vendor \"" + node["vendor"].as<string>()  + "\"");
-		return false;
+		return string("Unable to connect to oscilloscope: instrument has vendor \"") +
+			inst->GetVendor() + "\", save file has vendor \"" + vendor  + "\"";
 	}
-	else if(node["serial"].as<string>() != inst->GetSerial())
+	else if(serial != inst->GetSerial())
 	{
-		m_mainWindow->ShowErrorPopup(
-			"Unable to reconnect",
-			string("Unable to connect to oscilloscope: instrument has serial \"") +
-			inst->GetSerial() + "\", save file has serial \"" + node["serial"].as<string>()  + "\"");
+		return string("Unable to connect to oscilloscope: instrument has serial \"") +
+			inst->GetSerial() + "\", save file has serial \"" + serial  + "\"";
+	}
+
+	return "";
+}
+
+bool Session::VerifyInstrument(const YAML::Node& node, shared_ptr<Instrument> inst)
+{
+	//Use the result from PreconnectInstruments() if this instrument was checked there, otherwise check it now
+	string err;
+	auto it = m_preconnected.find(node["id"].as<uintptr_t>());
+	if( (it != m_preconnected.end()) && it->second.m_verifiedInstrument &&
+		(it->second.m_verifiedInstrument == inst.get()) )
+		err = it->second.m_verifyError;
+	else
+	{
+		err = GetIdentityMismatch(
+			node["name"].as<string>(),
+			node["vendor"].as<string>(),
+			node["serial"].as<string>(),
+			inst.get());
+	}
+
+	//If mismatch, stop
+	if(!err.empty())
+	{
+		m_mainWindow->ShowErrorPopup("Unable to reconnect", err);
 		return false;
 	}
 
@@ -1068,7 +1178,8 @@ bool Session::PreLoadOscilloscope(int version, const YAML::Node& node, bool onli
 
 			if(transport && transport->IsConnected())
 			{
-				scope = Oscilloscope::CreateOscilloscope(driver, transport);
+				if(!TakePreconnectedInstrument(node, scope))
+					scope = Oscilloscope::CreateOscilloscope(driver, transport);
 				if(!VerifyInstrument(node, scope))
 					scope = nullptr;
 			}
@@ -1139,7 +1250,8 @@ bool Session::PreLoadLoad(int version, const YAML::Node& node, bool online)
 
 			if(transport && transport->IsConnected())
 			{
-				load = SCPILoad::CreateLoad(driver, transport);
+				if(!TakePreconnectedInstrument(node, load))
+					load = SCPILoad::CreateLoad(driver, transport);
 				if(!VerifyInstrument(node, load))
 					load = nullptr;
 			}
@@ -1211,7 +1323,8 @@ bool Session::PreLoadMisc(int version, const YAML::Node& node, bool online)
 
 			if(transport && transport->IsConnected())
 			{
-				misc = SCPIMiscInstrument::CreateInstrument(driver, transport);
+				if(!TakePreconnectedInstrument(node, misc))
+					misc = SCPIMiscInstrument::CreateInstrument(driver, transport);
 				if(!VerifyInstrument(node, misc))
 					misc = nullptr;
 			}
@@ -1283,7 +1396,8 @@ bool Session::PreLoadBERT(int version, const YAML::Node& node, bool online)
 
 			if(transport && transport->IsConnected())
 			{
-				bert = SCPIBERT::CreateBERT(driver, transport);
+				if(!TakePreconnectedInstrument(node, bert))
+					bert = SCPIBERT::CreateBERT(driver, transport);
 				if(!VerifyInstrument(node, bert))
 					bert = nullptr;
 			}
@@ -1355,7 +1469,8 @@ bool Session::PreLoadSDR(int version, const YAML::Node& node, bool online)
 
 			if(transport && transport->IsConnected())
 			{
-				sdr = SCPISDR::CreateSDR(driver, transport);
+				if(!TakePreconnectedInstrument(node, sdr))
+					sdr = SCPISDR::CreateSDR(driver, transport);
 				if(!VerifyInstrument(node, sdr))
 					sdr = nullptr;
 			}
@@ -1427,7 +1542,8 @@ bool Session::PreLoadSpectrometer(int version, const YAML::Node& node, bool onli
 
 			if(transport && transport->IsConnected())
 			{
-				spec = SCPISpectrometer::CreateSpectrometer(driver, transport);
+				if(!TakePreconnectedInstrument(node, spec))
+					spec = SCPISpectrometer::CreateSpectrometer(driver, transport);
 				if(!VerifyInstrument(node, spec))
 					spec = nullptr;
 			}
@@ -1499,7 +1615,8 @@ bool Session::PreLoadMultimeter(int version, const YAML::Node& node, bool online
 
 			if(transport && transport->IsConnected())
 			{
-				meter = SCPIMultimeter::CreateMultimeter(driver, transport);
+				if(!TakePreconnectedInstrument(node, meter))
+					meter = SCPIMultimeter::CreateMultimeter(driver, transport);
 				if(!VerifyInstrument(node, meter))
 					meter = nullptr;
 			}
@@ -1571,7 +1688,8 @@ bool Session::PreLoadPowerSupply(int version, const YAML::Node& node, bool onlin
 
 			if(transport && transport->IsConnected())
 			{
-				psu = SCPIPowerSupply::CreatePowerSupply(driver, transport);
+				if(!TakePreconnectedInstrument(node, psu))
+					psu = SCPIPowerSupply::CreatePowerSupply(driver, transport);
 				if(!VerifyInstrument(node, psu))
 					psu = nullptr;
 			}
@@ -1643,7 +1761,8 @@ bool Session::PreLoadRFSignalGenerator(int version, const YAML::Node& node, bool
 
 			if(transport && transport->IsConnected())
 			{
-				gen = SCPIRFSignalGenerator::CreateRFSignalGenerator(driver, transport);
+				if(!TakePreconnectedInstrument(node, gen))
+					gen = SCPIRFSignalGenerator::CreateRFSignalGenerator(driver, transport);
 				if(!VerifyInstrument(node, gen))
 					gen = nullptr;
 			}
@@ -1715,7 +1834,8 @@ bool Session::PreLoadFunctionGenerator(int version, const YAML::Node& node, bool
 
 			if(transport && transport->IsConnected())
 			{
-				gen = SCPIFunctionGenerator::CreateFunctionGenerator(driver, transport);
+				if(!TakePreconnectedInstrument(node, gen))
+					gen = SCPIFunctionGenerator::CreateFunctionGenerator(driver, transport);
 				if(!VerifyInstrument(node, gen))
 					gen = nullptr;
 			}
@@ -2111,17 +2231,55 @@ YAML::Node Session::SerializeMarkers()
 	return node;
 }
 
+/**
+	@brief Saves waveform data for all history points and persistent filters to the session data directory
+
+	If the session was last saved to (or loaded from) the same directory, history points which are already on disk
+	keep their existing waveform directories and only new or modified points are written. Directories belonging to
+	points which have since been removed from history are deleted. Directories whose data was never loaded into
+	history (e.g. still being loaded, or skipped as duplicates) are left alone and their IDs are not reused.
+
+	@param dataDir	Path to the _data directory
+ */
 bool Session::SerializeWaveforms(const string& dataDir)
 {
 	//Metadata nodes for each scope
 	std::map<std::shared_ptr<Oscilloscope>, YAML::Node> metadataNodes;
 
+	//If saving somewhere new, nothing is on disk yet so everything gets renumbered
+	bool incremental = (dataDir == m_savedDataDir);
+	int64_t nextId = 0;
+	if(!incremental)
+	{
+		for(auto& hpoint : m_history.m_history)
+			hpoint->m_savedId = -1;
+		m_savedWaveformIds.clear();
+		m_unloadedWaveformIds.clear();
+	}
+	else
+	{
+		if(!m_savedWaveformIds.empty())
+			nextId = *m_savedWaveformIds.rbegin() + 1;
+		if(!m_unloadedWaveformIds.empty())
+			nextId = max(nextId, *m_unloadedWaveformIds.rbegin() + 1);
+	}
+
 	//Serialize data from each history point
-	size_t numwfm = 0;
+	set<int64_t> liveIds;
+	size_t nwritten = 0;
 	for(auto& hpoint : m_history.m_history)
 	{
 		auto timestamp = hpoint->m_time;
 
+		//Allocate a directory for points we haven't saved here before
+		bool writeData = hpoint->m_dirty || (hpoint->m_savedId < 0);
+		if(hpoint->m_savedId < 0)
+			hpoint->m_savedId = nextId ++;
+		auto numwfm = hpoint->m_savedId;
+		liveIds.emplace(numwfm);
+		if(writeData)
+			nwritten ++;
+
 		//Save each scope
 		//TODO: Do we want to change the directory hierarchy in a future file format schema?
 		//For now, we stick with scope / waveform.
@@ -2172,38 +2330,11 @@ bool Session::SerializeWaveforms(const string& dataDir)
 					YAML::Node chnode;
 					chnode["index"] = i;
 					chnode["stream"] = j;
-					chnode["timescale"] = data->m_timescale;
-					chnode["trigphase"] = data->m_triggerPhase;
-					chnode["flags"] = (int)data->m_flags;
-					//don't serialize revision
+					SerializeWaveformMetadata(data, chnode);
 
 					//Save the actual waveform data
-					string datapath = datdir;
-					if(j == 0)
-						datapath += string("/channel_") + to_string(i) + ".bin";
-					else
-						datapath += string("/channel_") + to_string(i) + "_stream" + to_string(j) + ".bin";
-					auto sparse = dynamic_cast<SparseWaveformBase*>(data);
-					auto uniform = dynamic_cast<UniformWaveformBase*>(data);
-					if(sparse)
-					{
-						chnode["format"] = "sparsev1";
-						SerializeSparseWaveform(sparse, datapath);
-
-						//Save type if it's a protocol waveform
-						//so if we do an offline load, we know what type of waveform to make
-						if(dynamic_cast<SparseAnalogWaveform*>(sparse) != nullptr)
-							chnode["datatype"] = "analog";
-						else if(dynamic_cast<SparseDigitalWaveform*>(sparse) != nullptr)
-							chnode["datatype"] = "digital";
-						else if(dynamic_cast<CANWaveform*>(sparse) != nullptr)
-							chnode["datatype"] = "can";
-					}
-					else
-					{
-						chnode["format"] = "densev1";
-						SerializeUniformWaveform(uniform, datapath);
-					}
+					if(writeData)
+						SerializeWaveform(data, datdir + "/" + GetWaveformFileName(i, j));
 
 					mnode["channels"][string("ch") + to_string(i) + "s" + to_string(j)] = chnode;
 				}
@@ -2212,8 +2343,9 @@ bool Session::SerializeWaveforms(const string& dataDir)
 			metadataNodes[scope]["waveforms"][string("wfm") + to_string(numwfm)] = mnode;
 		}
 
-		numwfm ++;
+		hpoint->m_dirty = false;
 	}
+	LogTrace("Wrote waveform data for %zu of %zu history points\n", nwritten, m_history.m_history.size());
 
 	//Write metadata files (by this point, data directories should have been created)
 	for(size_t i=0; i<m_oscilloscopes.size(); i++)
@@ -2226,7 +2358,28 @@ bool Session::SerializeWaveforms(const string& dataDir)
 			return false;
 		outfs << metadataNodes[scope];
 		outfs.close();
+
+		//Binary copy of the same metadata, for fast loading
+		UpdateScopeMetadataSidecar(fname, metadataNodes[scope]);
+	}
+
+	//Now that the metadata no longer refers to them, clean up directories for points that have left history
+	for(auto id : m_savedWaveformIds)
+	{
+		if(liveIds.find(id) != liveIds.end())
+			continue;
+		if(m_unloadedWaveformIds.find(id) != m_unloadedWaveformIds.end())
+			continue;
+
+		for(auto scope : m_oscilloscopes)
+		{
+			RemoveWaveformDirectory(
+				dataDir + "/scope_" + to_string(m_idtable[(Instrument*)scope.get()]) + "_waveforms/waveform_" +
+				to_string(id));
+		}
 	}
+	m_savedDataDir = dataDir;
+	m_savedWaveformIds = liveIds;
 
 	//Make directory for filters
 	string filtdir = dataDir + "/filter_waveforms";
@@ -2317,204 +2470,115 @@ bool Session::SerializeWaveforms(const string& dataDir)
 }
 
 /**
-	@brief Saves waveform sample data in the "sparsev1" file format.
+	@brief Deletes a waveform_N directory and the sample data files inside it
 
-	Interleaved (slow):
-		int64 offset
-		int64 len
-		for analog
-			float voltage
-		for digital
-			bool voltage
+	@param path	Path to the directory (it's not an error if it doesn't exist)
  */
-bool Session::SerializeSparseWaveform(SparseWaveformBase* wfm, const string& path)
+static void RemoveWaveformDirectory(const string& path)
 {
-	FILE* fp = fopen(path.c_str(), "wb");
-	if(!fp)
-		return false;
+	auto files = Glob(path + "/*", false);
+	for(auto& f : files)
+		remove(f.c_str());
 
-	wfm->PrepareForCpuAccess();
-	auto achan = dynamic_cast<SparseAnalogWaveform*>(wfm);
-	auto dchan = dynamic_cast<SparseDigitalWaveform*>(wfm);
-	auto cchan = dynamic_cast<CANWaveform*>(wfm);
-	size_t len = wfm->size();
-
-	//Analog channels
-	const size_t samples_per_block = 10000;
-	if(achan)
-	{
-		#pragma pack(push, 1)
-		class asample_t
-		{
-		public:
-			int64_t off;
-			int64_t dur;
-			float voltage;
-
-			asample_t(int64_t o=0, int64_t d=0, float v=0)
-			: off(o), dur(d), voltage(v)
-			{}
-		};
-		#pragma pack(pop)
-
-		//Copy sample data
-		vector<asample_t,	AlignedAllocator<asample_t, 64 > > samples;
-		samples.reserve(len);
-		for(size_t i=0; i<len; i++)
-			samples.push_back(asample_t(achan->m_offsets[i], achan->m_durations[i], achan->m_samples[i]));
-
-		//Write it
-		for(size_t i=0; i<len; i+= samples_per_block)
-		{
-			size_t blocklen = min(len-i, samples_per_block);
-			if(blocklen != fwrite(&samples[i], sizeof(asample_t), blocklen, fp))
-			{
-				LogError("file write error\n");
-				fclose(fp);
-				return false;
-			}
-		}
-	}
-	else if(dchan)
-	{
-		#pragma pack(push, 1)
-		class dsample_t
-		{
-		public:
-			int64_t off;
-			int64_t dur;
-			bool voltage;
+	#ifdef _WIN32
+		_rmdir(path.c_str());
+	#else
+		rmdir(path.c_str());
+	#endif
+}
 
-			dsample_t(int64_t o=0, int64_t d=0, bool v=0)
-			: off(o), dur(d), voltage(v)
-			{}
-		};
-		#pragma pack(pop)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Crash recovery journal
 
-		//Copy sample data
-		vector<dsample_t,	AlignedAllocator<dsample_t, 64 > > samples;
-		samples.reserve(len);
-		for(size_t i=0; i<len; i++)
-			samples.push_back(dsample_t(dchan->m_offsets[i], dchan->m_durations[i], dchan->m_samples[i]));
+/**
+	@brief Adds a newly acquired history point to the journal, if journaling is enabled
 
-		//Write it
-		for(size_t i=0; i<len; i+= samples_per_block)
-		{
-			size_t blocklen = min(len-i, samples_per_block);
-			if(blocklen != fwrite(&samples[i], sizeof(dsample_t), blocklen, fp))
-			{
-				LogError("file write error\n");
-				fclose(fp);
-			}
-		}
-	}
-	else if(cchan)
-	{
-		#pragma pack(push, 1)
-		class csample_t
-		{
-		public:
-			int64_t off;
-			int64_t dur;
-			uint32_t data;
-			uint32_t type;
-
-			csample_t(int64_t o=0, int64_t d=0, CANSymbol s = CANSymbol())
-			: off(o), dur(d), data(s.m_data), type(s.m_stype)
-			{}
-		};
-		#pragma pack(pop)
-
-		//Copy sample data
-		vector<csample_t,	AlignedAllocator<csample_t, 64 > > samples;
-		samples.reserve(len);
-		for(size_t i=0; i<len; i++)
-			samples.push_back(csample_t(cchan->m_offsets[i], cchan->m_durations[i], cchan->m_samples[i]));
-
-		//Write it
-		for(size_t i=0; i<len; i+= samples_per_block)
-		{
-			size_t blocklen = min(len-i, samples_per_block);
-			if(blocklen != fwrite(&samples[i], sizeof(csample_t), blocklen, fp))
-			{
-				LogError("file write error\n");
-				fclose(fp);
-				return false;
-			}
-		}
-	}
-	else
+	The journal is created the first time this is called after journaling is enabled. The actual file I/O happens in
+	the background; this only has to serialize the instrument configuration when a new scope shows up.
+ */
+void Session::JournalHistoryPoint(shared_ptr<HistoryPoint> point)
+{
+	if(!m_preferences.GetBool("Files.Journal.enable"))
 	{
-		//TODO: support other waveform types (buses, eyes, etc)
-		LogError("unrecognized sample type\n");
-		fclose(fp);
-		return false;
+		//Journal was turned off, so the existing one is no longer being kept up to date
+		CloseJournal();
+		return;
 	}
 
-	fclose(fp);
-	return true;
-}
-
-/**
-	@brief Saves waveform sample data in the "densev1" file format.
-
-	for analog
-		float[] voltage
-	for digital
-		bool[] voltage
+	//AddHistory() doesn't add anything if the timestamp is a duplicate
+	if(m_lastJournalPoint.lock() == point)
+		return;
+	m_lastJournalPoint = point;
 
-	Durations are implied {1....1} and offsets are implied {0...n-1}.
- */
-bool Session::SerializeUniformWaveform(UniformWaveformBase* wfm, const string& path)
-{
-	FILE* fp = fopen(path.c_str(), "wb");
-	if(!fp)
-		return false;
+	if(!m_journal)
+	{
+		string dir = m_preferences.GetString("Files.Journal.path");
+		if(dir.empty())
+			dir = m_preferences.GetConfigDirectory() + "/journal";
+		#ifdef _WIN32
+			mkdir(dir.c_str());
+		#else
+			mkdir(dir.c_str(), 0755);
+		#endif
 
-	wfm->PrepareForCpuAccess();
-	auto achan = dynamic_cast<UniformAnalogWaveform*>(wfm);
-	auto dchan = dynamic_cast<UniformDigitalWaveform*>(wfm);
-	size_t len = wfm->size();
+		char tmp[64];
+		time_t now = time(nullptr);
+		strftime(tmp, sizeof(tmp), "%Y%m%d_%H%M%S", localtime(&now));
+		m_journal = make_unique<AcquisitionJournal>(
+			dir + "/journal_" + tmp + ".scopesession", m_history.m_maxDepth, m_waveformDataMutex);
+		m_journalScopes.clear();
+	}
+	m_journal->SetMaxDepth(m_history.m_maxDepth);
 
-	//Analog channels
-	const size_t samples_per_block = 10000;
-	if(achan)
+	JournalEntry entry(point);
+	bool newScopes = false;
+	for(auto& it : point->m_history)
 	{
-		//Write it
-		for(size_t i=0; i<len; i+= samples_per_block)
+		auto scope = it.first.get();
+		entry.m_scopeIDs[scope] = m_idtable[(Instrument*)scope];
+		if(m_journalScopes.find(scope) == m_journalScopes.end())
 		{
-			size_t blocklen = min(len-i, samples_per_block);
-
-			if(blocklen != fwrite(achan->m_samples.GetCpuPointer() + i, sizeof(float), blocklen, fp))
-			{
-				LogError("file write error\n");
-				return false;
-			}
+			m_journalScopes.emplace(scope);
+			newScopes = true;
 		}
 	}
-	else if(dchan)
-	{
-		//Write it
-		for(size_t i=0; i<len; i+= samples_per_block)
-		{
-			size_t blocklen = min(len-i, samples_per_block);
 
-			if(blocklen != fwrite(dchan->m_samples.GetCpuPointer() + i, sizeof(bool), blocklen, fp))
-			{
-				LogError("file write error\n");
-				return false;
-			}
-		}
+	//Make sure the journal's session file knows about every scope we have waveforms from.
+	//No UI configuration; recovered sessions come up with default views.
+	if(newScopes)
+	{
+		YAML::Node node;
+		node["version"] = 2;
+		node["metadata"] = SerializeMetadata();
+		node["instruments"] = SerializeInstrumentConfiguration();
+		node["triggergroups"] = SerializeTriggerGroups();
+		if(!Filter::GetAllInstances().empty())
+			node["decodes"] = SerializeFilterConfiguration();
+		m_journal->WriteHeader(node);
 	}
-	else
+
+	//Pins can be changed at any time from the history dialog, so send the current state along with every point
+	set<TimePoint> pinned;
+	for(auto& p : m_history.m_history)
 	{
-		//TODO: support other waveform types (buses, eyes, etc)
-		LogError("unrecognized sample type\n");
-		return false;
+		if(p->m_pinned)
+			pinned.emplace(p->m_time);
 	}
+	m_journal->SetPinned(pinned);
 
-	fclose(fp);
-	return true;
+	m_journal->Append(entry);
+}
+
+/**
+	@brief Flushes and deletes the journal
+ */
+void Session::CloseJournal()
+{
+	if(m_journal)
+		m_journal->Close(true);
+	m_journal = nullptr;
+	m_journalScopes.clear();
+	m_lastJournalPoint.reset();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2750,6 +2814,7 @@ void Session::CreateAndAddInstrument(const string& driver, SCPITransport* transp
 void Session::AddInstrument(shared_ptr<Instrument> inst, bool createDialogs)
 {
 	m_modifiedSinceLastSave = true;
+	InvalidateGraph();
 
 	lock_guard<mutex> lock(m_scopeMutex);
 
@@ -2839,6 +2904,7 @@ void Session::AddInstrument(shared_ptr<Instrument> inst, bool createDialogs)
 void Session::RemoveInstrument(shared_ptr<Instrument> inst)
 {
 	m_modifiedSinceLastSave = true;
+	InvalidateGraph();
 
 	//Remove instrument-specific state
 	auto psu = dynamic_pointer_cast<SCPIPowerSupply>(inst);
@@ -3117,6 +3183,8 @@ bool Session::CheckForWaveforms(vk::raii::CommandBuffer& cmdbuf)
 			m_recentlyTriggeredGroups.clear();
 
 			m_history.AddHistory(scopes);
+			if(!m_history.m_history.empty())
+				JournalHistoryPoint(m_history.m_history.back());
 		}
 
 		//Tone-map all of our waveforms
@@ -3217,7 +3285,13 @@ void Session::RefreshAllFilters()
 		//Must lock mutexes in this order to avoid deadlock
 		lock_guard<shared_mutex> lock(m_waveformDataMutex);
 		//shared_lock<shared_mutex> lock3(g_vulkanActivityMutex);
-		m_graphExecutor.RunBlocking(nodes);
+
+		//Outputs can only be reused while we're looking at history, not while new data is arriving
+		//(or if we need everything to actually run so it can be profiled)
+		if(m_triggerArmed || m_forceUncachedRefresh.exchange(false))
+			RunFilterGraph(nodes);
+		else
+			RunFilterGraphCached(nodes, false);
 		UpdatePacketManagers(nodes);
 	}
 
@@ -3269,7 +3343,7 @@ bool Session::RefreshDirtyFilters()
 		//Must lock mutexes in this order to avoid deadlock
 		lock_guard<shared_mutex> lock(m_waveformDataMutex);
 		shared_lock<shared_mutex> lock3(g_vulkanActivityMutex);
-		m_graphExecutor.RunBlocking(nodesToUpdate);
+		RunFilterGraph(nodesToUpdate);
 		UpdatePacketManagers(nodesToUpdate);
 	}
 
@@ -3278,6 +3352,470 @@ bool Session::RefreshDirtyFilters()
 	return true;
 }
 
+/**
+	@brief Runs the filter graph executor on a set of nodes, timing each filter individually if profiling is enabled
+
+	The caller is expected to hold m_waveformDataMutex.
+ */
+void Session::RunFilterGraph(const set<FlowGraphNode*>& nodes)
+{
+	//Whatever these nodes output after this point doesn't match their old cache keys
+	for(auto n : nodes)
+		m_filterCacheKeys.erase(n);
+
+	if(m_filterProfilingEnabled)
+		RunFilterGraphProfiled(nodes);
+	else
+		m_graphExecutor.RunBlocking(nodes);
+}
+
+/**
+	@brief Runs filters one at a time, in dependency order, and records the cost of each in m_filterCostModel
+
+	Nodes outside the set are treated as already up to date by the executor, so running a single node at a time
+	gives the same result as running the whole set at once.
+ */
+void Session::RunFilterGraphProfiled(const set<FlowGraphNode*>& nodes)
+{
+	auto order = GetNodesInDependencyOrder(nodes);
+
+	//Run and time each filter
+	set<FlowGraphNode*> single;
+	for(auto node : order)
+	{
+		single.clear();
+		single.emplace(node);
+
+		double tstart = GetTime();
+		m_graphExecutor.RunBlocking(single);
+		double dt = GetTime() - tstart;
+
+		auto f = dynamic_cast<Filter*>(node);
+		if(!f)
+			continue;
+
+		FilterCostSample sample;
+		sample.m_execTime = dt * FS_PER_SECOND;
+		for(size_t i=0; i<f->GetInputCount(); i++)
+		{
+			auto data = f->GetInput(i).GetData();
+			if(data)
+				sample.m_inputDepth = max(sample.m_inputDepth, data->size());
+		}
+		for(size_t i=0; i<f->GetStreamCount(); i++)
+		{
+			auto data = f->GetData(i);
+			if(data)
+				sample.m_outputDepth = max(sample.m_outputDepth, data->size());
+			sample.m_outputBytes += FilterOutputCache::GetWaveformBytes(data);
+		}
+
+		m_filterCostModel.AddSample(f, f->GetProtocolDisplayName(), sample);
+	}
+}
+
+/**
+	@brief Sorts a set of graph nodes so that every node comes after all of its inputs which are also in the set
+ */
+static vector<FlowGraphNode*> GetNodesInDependencyOrder(const set<FlowGraphNode*>& nodes)
+{
+	//Post-order DFS over inputs, restricted to the set
+	vector<FlowGraphNode*> order;
+	set<FlowGraphNode*> visited;
+	vector< pair<FlowGraphNode*, size_t> > stack;
+	for(auto root : nodes)
+	{
+		if(!visited.emplace(root).second)
+			continue;
+		stack.push_back(pair<FlowGraphNode*, size_t>(root, 0));
+
+		while(!stack.empty())
+		{
+			auto& top = stack.back();
+			auto node = top.first;
+			if(top.second < node->GetInputCount())
+			{
+				FlowGraphNode* in = node->GetInput(top.second).m_channel;
+				top.second ++;
+				if( (in != nullptr) && (nodes.find(in) != nodes.end()) && visited.emplace(in).second)
+					stack.push_back(pair<FlowGraphNode*, size_t>(in, 0));
+			}
+			else
+			{
+				order.push_back(node);
+				stack.pop_back();
+			}
+		}
+	}
+
+	return order;
+}
+
+/**
+	@brief Runs the filter graph, reusing cached outputs where the inputs and configuration of a filter haven't changed
+
+	This is used while the trigger is stopped, so that flipping between history points doesn't recompute everything
+	from scratch. Each filter gets a key from FilterOutputCache::GetKeys(), which hashes its type, parameters, and the
+	keys of its inputs (or, for instrument channels, the identity of the current waveforms). Before a filter's outputs
+	are replaced, they are stashed in m_filterCache under the key they were computed with, and if the new key is in
+	the cache the filter isn't run at all.
+
+	Stateful filters (see FilterOutputCache::IsStateful()), or filters that depend on one, are always run unless
+	we're prefetching, in which case they're not run at all so that their state isn't polluted by data the user
+	isn't looking at.
+
+	The caller is expected to hold m_waveformDataMutex.
+
+	@param nodes		Nodes to update
+	@param prefetching	True if filtering a history point the user isn't looking at
+	@param maxRun		Maximum number of filters to actually run. Filters past the limit keep their previous
+						outputs (or none, if they were stashed) and are run by a later call.
+
+	@return True if every filter that missed the cache was run
+ */
+bool Session::RunFilterGraphCached(const set<FlowGraphNode*>& nodes, bool prefetching, size_t maxRun)
+{
+	m_filterCache.SetBudget(m_preferences.GetReal("Miscellaneous.History.filter_cache_size"));
+	m_filterCache.PurgeStaleFilters(nodes);
+
+	map<FlowGraphNode*, uint64_t> keys;
+	set<FlowGraphNode*> toRun;
+	map<FlowGraphNode*, uint64_t> unstashed;
+	vector<PacketDecoder*> restoredDecoders;
+
+	auto order = GetNodesInDependencyOrder(nodes);
+	FilterOutputCache::GetKeys(order, keys);
+	for(auto node : order)
+	{
+		//Instrument channels always "run" (this just picks up the current data)
+		auto f = dynamic_cast<Filter*>(node);
+		if(!f)
+		{
+			toRun.emplace(node);
+			continue;
+		}
+
+		//Filters that can't be cached (stateful, no inputs, etc), and anything downstream of them, have no key
+		auto kt = keys.find(node);
+		if(kt == keys.end())
+		{
+			if(!prefetching)
+				toRun.emplace(node);
+			continue;
+		}
+		auto h = kt->second;
+
+		//If the current outputs were computed from exactly this configuration, there's nothing to do
+		auto cur = m_filterCacheKeys.find(node);
+		if( (cur != m_filterCacheKeys.end()) && (cur->second == h) )
+			continue;
+
+		//Hang on to the current outputs in case we come back to them
+		if( (cur != m_filterCacheKeys.end()) && !m_filterCache.Stash(f, cur->second) )
+			unstashed[node] = cur->second;
+
+		//Use cached outputs if we have them
+		if(CanRestoreFilter(f, h) && m_filterCache.Restore(f, h))
+		{
+			auto pd = dynamic_cast<PacketDecoder*>(f);
+			if(pd)
+				restoredDecoders.push_back(pd);
+			continue;
+		}
+
+		toRun.emplace(node);
+	}
+
+	//Put off anything over the limit until next time (upstream filters come first, so they're never put off
+	//while something downstream of them is run). Outputs that couldn't be stashed are still the old ones.
+	bool complete = true;
+	size_t nrun = 0;
+	for(auto node : order)
+	{
+		if( (toRun.find(node) == toRun.end()) || !dynamic_cast<Filter*>(node) )
+			continue;
+
+		nrun ++;
+		if(nrun > maxRun)
+		{
+			toRun.erase(node);
+			auto it = unstashed.find(node);
+			if(it != unstashed.end())
+				keys[node] = it->second;
+			else
+				keys.erase(node);
+			complete = false;
+		}
+	}
+
+	//Run everything that missed the cache
+	RunFilterGraph(toRun);
+	m_filterCacheKeys = keys;
+
+	//Restored decoders didn't regenerate their packets, so make sure the packet managers don't pull the stale ones
+	lock_guard<mutex> lock(m_packetMgrMutex);
+	for(auto pd : restoredDecoders)
+	{
+		auto it = m_packetmgrs.find(pd);
+		if(it != m_packetmgrs.end())
+			it->second->AdoptCurrentWaveform();
+	}
+
+	return complete;
+}
+
+/**
+	@brief Checks if cached outputs for a filter can be restored
+
+	Protocol decoders also produce a list of packets which isn't cached. These can only be restored if the packet
+	manager still has the packets from when the waveform was originally decoded.
+ */
+bool Session::CanRestoreFilter(Filter* f, uint64_t key)
+{
+	if(!m_filterCache.Contains(f, key))
+		return false;
+
+	auto pd = dynamic_cast<PacketDecoder*>(f);
+	if(!pd)
+		return true;
+
+	lock_guard<mutex> lock(m_packetMgrMutex);
+	auto it = m_packetmgrs.find(pd);
+	if(it == m_packetmgrs.end())
+		return true;
+
+	auto data = m_filterCache.Peek(f, key, 0);
+	if(!data)
+		return false;
+	return it->second->HasPacketsFor(TimePoint(data->m_startTimestamp, data->m_startFemtoseconds));
+}
+
+/**
+	@brief Queues a filter to be re-run after its configuration was changed by the user
+
+	The refresh is delayed slightly so that a burst of changes (e.g. dragging a slider) only causes one update, and
+	any refresh already in progress is abandoned since its results are about to be stale anyway.
+ */
+void Session::RequestFilterReconfigure(Filter* f)
+{
+	lock_guard<mutex> lock(m_reconfiguredFiltersMutex);
+
+	m_reconfiguredFilters.emplace(f);
+	m_reconfigureDeadline = GetTime() +
+		m_preferences.GetReal("Miscellaneous.Filter Graph.reconfigure_delay") / FS_PER_SECOND;
+	m_reconfigureGeneration ++;
+}
+
+/**
+	@brief Re-runs filters queued by RequestFilterReconfigure(), and everything downstream of them
+
+	Called by the waveform thread. Filters are run one at a time and the waveform data lock is released in between,
+	so the UI keeps drawing (the previously rendered waveforms) while a long refresh is in progress. If another filter
+	is reconfigured, or the graph changes, the refresh is abandoned between filters and requeued.
+
+	@return True if the refresh ran to completion and waveforms need to be re-rendered
+ */
+bool Session::RefreshReconfiguredFilters()
+{
+	set<FlowGraphNode*> roots;
+	uint64_t generation;
+	{
+		lock_guard<mutex> lock(m_reconfiguredFiltersMutex);
+		if(m_reconfiguredFilters.empty() || (GetTime() < m_reconfigureDeadline) )
+			return false;
+
+		roots = m_reconfiguredFilters;
+		m_reconfiguredFilters.clear();
+		generation = m_reconfigureGeneration;
+	}
+
+	double tstart = GetTime();
+	auto revision = GetGraphRevision();
+	auto ninstances = Filter::GetNumInstances();
+
+	//Figure out what needs updating, ignoring anything deleted since it was queued
+	auto nodes = GetAllGraphNodes();
+	set<FlowGraphNode*> liveRoots;
+	for(auto node : roots)
+	{
+		if(nodes.find(node) != nodes.end())
+			liveRoots.emplace(node);
+	}
+	set<FlowGraphNode*> nodesToUpdate = liveRoots;
+	for(auto node : nodes)
+	{
+		if(node->IsDownstreamOf(liveRoots))
+			nodesToUpdate.emplace(node);
+	}
+	auto order = GetNodesInDependencyOrder(nodesToUpdate);
+
+	set<FlowGraphNode*> single;
+	for(auto node : order)
+	{
+		lock_guard<shared_mutex> lock(m_waveformDataMutex);
+
+		//Stop if anything changed while we didn't hold the lock
+		if( (m_reconfigureGeneration != generation) ||
+			(GetGraphRevision() != revision) ||
+			(Filter::GetNumInstances() != ninstances) )
+		{
+			LogTrace("Filter graph changed, abandoning refresh\n");
+
+			//Run everything again along with whatever was just changed.
+			//Filters we already ran get run twice, but that's cheap compared to the ones we didn't get to.
+			lock_guard<mutex> lock2(m_reconfiguredFiltersMutex);
+			m_reconfiguredFilters.insert(roots.begin(), roots.end());
+			if(m_reconfigureGeneration == generation)
+				m_reconfigureDeadline = GetTime();
+			return false;
+		}
+
+		single.clear();
+		single.emplace(node);
+		RunFilterGraph(single);
+	}
+
+	{
+		lock_guard<shared_mutex> lock(m_waveformDataMutex);
+		UpdatePacketManagers(nodes);
+	}
+
+	m_lastFilterGraphExecTime = (GetTime() - tstart) * FS_PER_SECOND;
+	return true;
+}
+
+/**
+	@brief Requests that history points around the given one be filtered in the background
+
+	Any previous request is discarded. Pass null to just cancel prefetching.
+ */
+void Session::RequestHistoryPrefetch(shared_ptr<HistoryPoint> point)
+{
+	lock_guard<mutex> lock(m_prefetchMutex);
+
+	m_prefetchPoint = point;
+	m_prefetchQueue.clear();
+	if(!point)
+		return;
+
+	auto depth = m_preferences.GetInt("Miscellaneous.History.prefetch_depth");
+	if(depth <= 0)
+		return;
+	for(auto p : m_history.GetNeighbors(point, depth))
+		m_prefetchQueue.push_back(p);
+}
+
+/**
+	@brief Discards any pending history prefetch requests
+ */
+void Session::CancelHistoryPrefetch()
+{
+	RequestHistoryPrefetch(nullptr);
+}
+
+/**
+	@brief Discards pending prefetch requests, but only if they're still for the given point
+
+	This avoids throwing away a request for a new point which was made while we were working on the old one.
+ */
+void Session::DropHistoryPrefetch(shared_ptr<HistoryPoint> point)
+{
+	lock_guard<mutex> lock(m_prefetchMutex);
+	if(m_prefetchPoint == point)
+		m_prefetchQueue.clear();
+}
+
+/**
+	@brief Runs one filter of the next pending history point from RequestHistoryPrefetch(), leaving the results in
+	m_filterCache
+
+	Called by the waveform thread when it has nothing better to do. The point is swapped into the instruments, the
+	outputs of any filters already prefetched are restored from the cache, and the next filter that missed is run.
+	Then the point the user is looking at is swapped back in, with its filter outputs restored from the cache. This
+	happens under the waveform data lock so the UI never sees the prefetched data, but the lock is only held for one
+	filter at a time and the request is checked again before each one, so the UI isn't blocked for long and a new
+	selection takes effect right away.
+
+	@return True if any work was done, false if there was nothing to do
+ */
+bool Session::PrefetchHistory()
+{
+	shared_ptr<HistoryPoint> current;
+	shared_ptr<HistoryPoint> target;
+	{
+		lock_guard<mutex> lock(m_prefetchMutex);
+		if(m_prefetchQueue.empty())
+			return false;
+
+		current = m_prefetchPoint;
+		target = m_prefetchQueue.front();
+	}
+
+	//New data is arriving, the cache is useless
+	if(m_triggerArmed)
+	{
+		CancelHistoryPrefetch();
+		return false;
+	}
+
+	auto nodes = GetAllGraphNodes();
+	bool done = false;
+
+	{
+		lock_guard<shared_mutex> lock(m_waveformDataMutex);
+
+		//If the user has moved on to some other point since the request was made, don't touch anything
+		if(!current->IsInUse())
+		{
+			DropHistoryPrefetch(current);
+			return false;
+		}
+
+		//Both the current and prefetched outputs have to fit in the cache at once, or we'll just end up
+		//evicting the current point and recomputing it
+		size_t bytes = 0;
+		for(auto node : nodes)
+		{
+			auto f = dynamic_cast<Filter*>(node);
+			for(size_t i=0; f && (i<f->GetStreamCount()); i++)
+				bytes += FilterOutputCache::GetWaveformBytes(f->GetData(i));
+		}
+		if(2*bytes > m_preferences.GetReal("Miscellaneous.History.filter_cache_size"))
+		{
+			LogTrace("Filter outputs are too big to prefetch history\n");
+			DropHistoryPrefetch(current);
+			return false;
+		}
+
+		//Filters whose outputs can't be cached would be run again every time, so don't let that go on forever
+		if(target != m_prefetchTarget)
+		{
+			m_prefetchTarget = target;
+			m_prefetchSteps = 0;
+		}
+		m_prefetchSteps ++;
+
+		target->AttachToSession(*this);
+		done = RunFilterGraphCached(nodes, true, 1) || (m_prefetchSteps > nodes.size());
+		UpdatePacketManagers(nodes);
+
+		current->AttachToSession(*this);
+		RunFilterGraphCached(nodes, true);
+		UpdatePacketManagers(nodes);
+	}
+
+	//Move on to the next point once this one is complete, unless the request was replaced in the meantime
+	if(done)
+	{
+		LogTrace("Prefetched history point %s\n", target->m_time.PrettyPrint().c_str());
+
+		lock_guard<mutex> lock(m_prefetchMutex);
+		if(!m_prefetchQueue.empty() && (m_prefetchQueue.front() == target))
+			m_prefetchQueue.pop_front();
+	}
+	return true;
+}
+
 /**
 	@brief Flags a single channel as dirty (updated outside of a global trigger event)
  */
@@ -3287,6 +3825,15 @@ void Session::MarkChannelDirty(InstrumentChannel* chan)
 	m_dirtyChannels.emplace(chan);
 }
 
+/**
+	@brief Checks if any channels have been updated since the last partial filter refresh
+ */
+bool Session::HasDirtyChannels()
+{
+	lock_guard<mutex> lock(m_dirtyChannelsMutex);
+	return !m_dirtyChannels.empty();
+}
+
 /**
 	@brief Clear state on all of our filters
  */
@@ -3369,6 +3916,23 @@ void Session::RenderWaveformTextures(vk::raii::CommandBuffer& cmdbuf, vector<sha
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Reference filters
 
+/**
+	@brief Gets the reference instances of every filter type
+
+	Creating one of every filter is expensive, and they're only needed once the user starts adding filters, so this
+	is deferred until the first call rather than slowing down startup.
+ */
+const map<string, Filter*>& Session::GetReferenceFilters()
+{
+	lock_guard<mutex> lock(m_referenceFilterMutex);
+	if(!m_referenceFiltersCreated)
+	{
+		CreateReferenceFilters();
+		m_referenceFiltersCreated = true;
+	}
+	return m_referenceFilters;
+}
+
 /**
 	@brief Creates one filter of each known type to use as a reference for what inputs are legal to use to a new filter
  */
@@ -3397,7 +3961,9 @@ void Session::CreateReferenceFilters()
  */
 void Session::DestroyReferenceFilters()
 {
+	lock_guard<mutex> lock(m_referenceFilterMutex);
 	for(auto it : m_referenceFilters)
 		delete it.second;
 	m_referenceFilters.clear();
+	m_referenceFiltersCreated = false;
 }
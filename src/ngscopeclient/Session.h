@@ -45,11 +45,82 @@ class DisplayedChannel;
 #include "PreferenceManager.h"
 #include "Marker.h"
 #include "TriggerGroup.h"
+#include "WaveformLoader.h"
+#include "AcquisitionJournal.h"
+#include "WaveformMetadata.h"
+#include "FilterCostModel.h"
+#include "FilterOutputCache.h"
 
 extern std::atomic<int64_t> g_lastWaveformRenderTime;
 
 class Session;
 
+/**
+	@brief A stream of a history point whose waveform is being loaded in the background
+ */
+class PendingStream
+{
+public:
+	PendingStream(OscilloscopeChannel* chan, size_t stream, size_t job)
+	: m_chan(chan)
+	, m_stream(stream)
+	, m_job(job)
+	{}
+
+	///@brief Channel the waveform belongs to
+	OscilloscopeChannel* m_chan;
+
+	///@brief Stream index within the channel
+	size_t m_stream;
+
+	///@brief WaveformLoader job index
+	size_t m_job;
+};
+
+/**
+	@brief A history point from a session file which will be added to history once its waveforms are loaded
+ */
+class PendingHistoryPoint
+{
+public:
+	PendingHistoryPoint()
+	: m_time(0, 0)
+	, m_pinned(false)
+	, m_waveformId(-1)
+	{}
+
+	TimePoint m_time;
+	std::shared_ptr<Oscilloscope> m_scope;
+	bool m_pinned;
+	std::string m_label;
+	int m_waveformId;
+	std::vector<PendingStream> m_streams;
+};
+
+/**
+	@brief An instrument from a session file which was connected in the background before being preloaded
+ */
+class PreconnectedInstrument
+{
+public:
+	PreconnectedInstrument()
+	: m_transport(nullptr)
+	, m_verifiedInstrument(nullptr)
+	{}
+
+	///@brief Transport, if it connected successfully (owned by m_instrument once that is created)
+	SCPITransport* m_transport;
+
+	///@brief Driver instance, if it was created successfully
+	std::shared_ptr<Instrument> m_instrument;
+
+	///@brief The driver instance m_verifyError applies to (only used for comparison, never dereferenced)
+	Instrument* m_verifiedInstrument;
+
+	///@brief Result of checking the instrument's identity against the session file (empty if it matched)
+	std::string m_verifyError;
+};
+
 class InstrumentConnectionState
 {
 public:
@@ -100,11 +171,17 @@ public:
 	bool CheckForWaveforms(vk::raii::CommandBuffer& cmdbuf);
 	void RefreshAllFilters();
 	void RefreshAllFiltersNonblocking();
+	void RequestFilterReconfigure(Filter* f);
+	bool RefreshReconfiguredFilters();
+	void RequestHistoryPrefetch(std::shared_ptr<HistoryPoint> point);
+	void CancelHistoryPrefetch();
+	bool PrefetchHistory();
 	void RefreshDirtyFiltersNonblocking();
 	bool RefreshDirtyFilters();
 	void FlushConfigCache();
 
 	void MarkChannelDirty(InstrumentChannel* chan);
+	bool HasDirtyChannels();
 
 	void RenderWaveformTextures(
 		vk::raii::CommandBuffer& cmdbuf,
@@ -122,8 +199,6 @@ public:
 	YAML::Node SerializeFilterConfiguration();
 	YAML::Node SerializeMarkers();
 	bool SerializeWaveforms(const std::string& dataDir);
-	bool SerializeSparseWaveform(SparseWaveformBase* wfm, const std::string& path);
-	bool SerializeUniformWaveform(UniformWaveformBase* wfm, const std::string& path);
 
 	void AddMultimeterDialog(std::shared_ptr<SCPIMultimeter> meter);
 	std::shared_ptr<PacketManager> AddPacketFilter(PacketDecoder* filter);
@@ -165,6 +240,19 @@ public:
 
 	size_t GetFilterCount();
 
+	/**
+		@brief Notifies anything caching the structure of the filter graph that it needs to be rebuilt
+
+		Call when filters are created or reconfigured, inputs are changed, channels are shown or enabled, or
+		instruments are added or removed.
+	 */
+	void InvalidateGraph()
+	{ m_graphRevision ++; }
+
+	///@brief Gets a counter which is incremented every time InvalidateGraph() is called
+	uint64_t GetGraphRevision()
+	{ return m_graphRevision.load(); }
+
 	bool IsChannelBeingDragged();
 
 	int64_t GetToneMapTime();
@@ -175,6 +263,30 @@ public:
 	int64_t GetFilterGraphExecTime()
 	{ return m_lastFilterGraphExecTime.load(); }
 
+	/**
+		@brief Turns per-filter timing on or off
+
+		While enabled, filters are run one at a time so each one can be timed individually. This is a bit slower
+		than running the whole graph at once, so only turn it on while something is displaying the results.
+
+		Turning it on makes the next RefreshAllFilters() run every filter, even ones whose outputs could be reused,
+		so there are numbers to show right away.
+	 */
+	void SetFilterProfilingEnabled(bool enabled)
+	{
+		m_filterProfilingEnabled = enabled;
+		if(enabled)
+			m_forceUncachedRefresh = true;
+	}
+
+	///@brief Gets the per-filter timing and cost estimates
+	FilterCostModel& GetFilterCostModel()
+	{ return m_filterCostModel; }
+
+	///@brief Gets the time taken to connect to all instruments when the last session was loaded, in seconds
+	double GetInstrumentConnectTime()
+	{ return m_instrumentConnectTime; }
+
 	/**
 		@brief Gets the last run time of the waveform rendering shaders
 	 */
@@ -251,6 +363,20 @@ public:
 
 	void StartWaveformThreadIfNeeded();
 
+	/**
+		@brief Returns true if waveform data from a session file is still being loaded in the background
+	 */
+	bool IsLoadingWaveforms()
+	{ return m_waveformLoader != nullptr; }
+
+	/**
+		@brief Returns the background waveform loader, if a load is in progress
+	 */
+	WaveformLoader* GetWaveformLoader()
+	{ return m_waveformLoader.get(); }
+
+	bool FinishLoadingWaveforms();
+
 	void ClearSweeps();
 
 	/**
@@ -316,11 +442,44 @@ public:
 
 protected:
 	void UpdatePacketManagers(const std::set<FlowGraphNode*>& nodes);
+	void RunFilterGraph(const std::set<FlowGraphNode*>& nodes);
+	void RunFilterGraphProfiled(const std::set<FlowGraphNode*>& nodes);
+	bool RunFilterGraphCached(const std::set<FlowGraphNode*>& nodes, bool prefetching, size_t maxRun = SIZE_MAX);
+	bool CanRestoreFilter(Filter* f, uint64_t key);
+	void DropHistoryPrefetch(std::shared_ptr<HistoryPoint> point);
 
 	std::string GetRegisteredTypeOfDriver(const std::string& drivername);
 
 	bool LoadInstruments(int version, const YAML::Node& node, bool online);
 	bool PreLoadInstruments(int version, const YAML::Node& node, bool online);
+	void PreconnectInstruments(const YAML::Node& node);
+	void ClearPreconnectedInstruments();
+	std::shared_ptr<Instrument> CreateInstrumentOfType(
+		const std::string& type,
+		const std::string& driver,
+		SCPITransport* transport);
+
+	/**
+		@brief Takes ownership of the driver instance connected by PreconnectInstruments() for a node, if there is one
+
+		@param node	Instrument node from the session file
+		@param inst	Set to the driver instance on success
+
+		@return True if an instance of the correct type was found
+	 */
+	template<class T>
+	bool TakePreconnectedInstrument(const YAML::Node& node, std::shared_ptr<T>& inst)
+	{
+		auto it = m_preconnected.find(node["id"].as<uintptr_t>());
+		if(it == m_preconnected.end())
+			return false;
+		inst = std::dynamic_pointer_cast<T>(it->second.m_instrument);
+		if(!inst)
+			return false;
+		it->second.m_instrument = nullptr;
+		return true;
+	}
+
 	SCPITransport* CreateTransportForNode(const YAML::Node& node);
 	bool VerifyInstrument(const YAML::Node& node, std::shared_ptr<Instrument> inst);
 	bool PreLoadOscilloscope(int version, const YAML::Node& node, bool online);
@@ -337,23 +496,27 @@ protected:
 	bool LoadInstrumentInputs(int version, const YAML::Node& node);
 	bool LoadWaveformData(int version, const std::string& dataDir);
 	bool LoadWaveformDataForScope(
-		int version,
-		const YAML::Node& node,
+		const std::vector<WaveformMetadata>& waveforms,
 		std::shared_ptr<Oscilloscope> scope,
 		const std::string& dataDir);
 	bool LoadWaveformDataForFilters(
 		int version,
 		const YAML::Node& node,
 		const std::string& dataDir);
-	void DoLoadWaveformDataForStream(
-		OscilloscopeChannel* chan,
-		int stream,
-		std::string format,
-		std::string fname);
+	void LoadPendingMarkers();
 
 	///@brief Version of the file being loaded
 	int m_fileLoadVersion;
 
+	///@brief Loader for waveform data from the file being loaded
+	std::unique_ptr<WaveformLoader> m_waveformLoader;
+
+	///@brief History points waiting on m_waveformLoader, in the order they were read from the file
+	std::vector<PendingHistoryPoint> m_pendingHistory;
+
+	///@brief Markers from the file being loaded, waiting on the history points they're attached to
+	std::vector<Marker> m_pendingMarkers;
+
 	///@brief Warnings generated by loading the current file
 	ConfigWarningList m_warnings;
 
@@ -435,6 +598,50 @@ protected:
 	///@brief Time spent on the last filter graph execution
 	std::atomic<int64_t> m_lastFilterGraphExecTime;
 
+	///@brief Incremented whenever the structure of the filter graph changes
+	std::atomic<uint64_t> m_graphRevision;
+
+	///@brief True if filters should be run and timed individually
+	std::atomic<bool> m_filterProfilingEnabled;
+
+	///@brief True if the next RefreshAllFilters() should run every filter rather than reusing cached outputs
+	std::atomic<bool> m_forceUncachedRefresh;
+
+	///@brief Per-filter timing and cost estimates, updated while m_filterProfilingEnabled is set
+	FilterCostModel m_filterCostModel;
+
+	///@brief Outputs of filters for previously viewed history points
+	FilterOutputCache m_filterCache;
+
+	/**
+		@brief Cache key describing the data each filter's outputs were computed from
+
+		Filters are only present if their outputs are known to match the key, i.e. they were last run or restored by
+		RunFilterGraphCached(). Accessed only under m_waveformDataMutex.
+	 */
+	std::map<FlowGraphNode*, uint64_t> m_filterCacheKeys;
+
+	///@brief Mutex for controlling access to m_prefetchPoint and m_prefetchQueue
+	std::mutex m_prefetchMutex;
+
+	///@brief The history point being viewed when prefetching was requested
+	std::shared_ptr<HistoryPoint> m_prefetchPoint;
+
+	///@brief History points still to be filtered in the background, in order
+	std::deque<std::shared_ptr<HistoryPoint>> m_prefetchQueue;
+
+	///@brief The history point PrefetchHistory() is partway through. Accessed only by the waveform thread.
+	std::shared_ptr<HistoryPoint> m_prefetchTarget;
+
+	///@brief Number of PrefetchHistory() calls spent on m_prefetchTarget so far
+	size_t m_prefetchSteps;
+
+	///@brief Time taken to connect to all instruments when the last session was loaded, in seconds
+	double m_instrumentConnectTime;
+
+	///@brief Instruments connected in parallel during session load, indexed by session file ID
+	std::map<uintptr_t, PreconnectedInstrument> m_preconnected;
+
 	///@brief Mutex for controlling access to performance counters
 	std::mutex m_perfClockMutex;
 
@@ -444,6 +651,27 @@ protected:
 	///@brief Historical waveform data
 	HistoryManager m_history;
 
+	///@brief Data directory that the HistoryPoint::m_savedId of each point in m_history refers to
+	std::string m_savedDataDir;
+
+	///@brief IDs of the waveform directories currently present in m_savedDataDir
+	std::set<int64_t> m_savedWaveformIds;
+
+	///@brief IDs of waveform directories in m_savedDataDir whose data was never loaded into history
+	std::set<int64_t> m_unloadedWaveformIds;
+
+	void JournalHistoryPoint(std::shared_ptr<HistoryPoint> point);
+	void CloseJournal();
+
+	///@brief Crash recovery journal (null if disabled or nothing has been acquired yet)
+	std::unique_ptr<AcquisitionJournal> m_journal;
+
+	///@brief Scopes which are present in the journal's .scopesession file
+	std::set<Oscilloscope*> m_journalScopes;
+
+	///@brief Most recent point added to the journal
+	std::weak_ptr<HistoryPoint> m_lastJournalPoint;
+
 	///@brief Mutex for controlling access to m_packetmgrs
 	std::mutex m_packetMgrMutex;
 
@@ -471,6 +699,18 @@ protected:
 	///@brief Set of dirty channels
 	std::set<FlowGraphNode*> m_dirtyChannels;
 
+	///@brief Mutex for controlling access to m_reconfiguredFilters and m_reconfigureDeadline
+	std::mutex m_reconfiguredFiltersMutex;
+
+	///@brief Filters whose configuration was changed by the user and need to be re-run (along with everything downstream)
+	std::set<FlowGraphNode*> m_reconfiguredFilters;
+
+	///@brief Time after which m_reconfiguredFilters should be processed
+	double m_reconfigureDeadline;
+
+	///@brief Incremented whenever a filter is reconfigured, to abandon any refresh which is already in progress
+	std::atomic<uint64_t> m_reconfigureGeneration;
+
 	///@brief Mutex controlling access to m_dirtyChannels
 	std::mutex m_dirtyChannelsMutex;
 
@@ -532,10 +772,15 @@ public:
 		@brief Gets the reference instance of a given filter
 	 */
 	Filter* GetReferenceFilter(const std::string& name)
-	{ return m_referenceFilters[name]; }
+	{
+		auto& refs = GetReferenceFilters();
+		auto it = refs.find(name);
+		if(it == refs.end())
+			return nullptr;
+		return it->second;
+	}
 
-	const std::map<std::string, Filter*>& GetReferenceFilters()
-	{ return m_referenceFilters; }
+	const std::map<std::string, Filter*>& GetReferenceFilters();
 
 	///@brief Get all of the drivers of a given type
 	const std::vector<std::string>& GetDriverNamesForType(const std::string& type)
@@ -550,8 +795,15 @@ protected:
 	void CreateReferenceFilters();
 	void DestroyReferenceFilters();
 
+	///@brief One instance of each filter type, created the first time one is needed
 	std::map<std::string, Filter*> m_referenceFilters;
 
+	///@brief Mutex protecting m_referenceFilters and m_referenceFiltersCreated
+	std::mutex m_referenceFilterMutex;
+
+	///@brief True once CreateReferenceFilters() has run
+	bool m_referenceFiltersCreated;
+
 	///@brief Map of "type" to drivername[]
 	std::map<std::string, std::vector<std::string> > m_driverNamesByType;
 };
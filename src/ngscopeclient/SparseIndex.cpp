@@ -0,0 +1,67 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Calculation of X axis indexes for rasterizing sparse waveforms
+ */
+#include "../scopehal/scopehal.h"
+#include "SparseIndex.h"
+
+using namespace std;
+
+/**
+	@brief Finds the first sample at or after the left edge of each pixel column
+
+	@param ibuf				Index buffer, one entry per pixel column
+	@param data				The waveform being rasterized
+	@param w				Width of the plot, in pixels
+	@param xscale			Pixels per timebase unit of the waveform
+	@param offset_samples	Offset of the left edge of the plot, in timebase units
+ */
+void CalculateSparseIndexes(
+	AcceleratorBuffer<uint32_t>& ibuf,
+	SparseWaveformBase* data,
+	size_t w,
+	double xscale,
+	int64_t offset_samples)
+{
+	ibuf.PrepareForCpuAccess();
+	data->m_offsets.PrepareForCpuAccess();
+	for(size_t i=0; i<w; i++)
+	{
+		int64_t target = floor(i / xscale) + offset_samples;
+		ibuf[i] = BinarySearchForGequal(
+			data->m_offsets.GetCpuPointer(),
+			data->size(),
+			target);
+	}
+	ibuf.MarkModifiedFromCpu();
+}
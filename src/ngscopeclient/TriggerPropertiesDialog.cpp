@@ -375,6 +375,7 @@ bool TriggerPropertiesDialog::DoRender()
 					//Push changes to the scope all at once after the new trigger is set up
 					scope->SetTrigger(newTrig);
 					scope->PushTrigger();
+					m_session->InvalidateGraph();
 
 					//Replace the properties page with whatever the new trigger eeds
 					m_pages[i] = make_unique<TriggerPropertiesPage>(scope);
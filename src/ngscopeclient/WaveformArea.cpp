@@ -35,6 +35,7 @@
 #include "ngscopeclient.h"
 #include "WaveformArea.h"
 #include "MainWindow.h"
+#include "SparseIndex.h"
 #include "../../scopehal/TwoLevelTrigger.h"
 #include "../../scopeprotocols/ConstellationFilter.h"
 #include "../../scopeprotocols/EyePattern.h"
@@ -62,9 +63,13 @@ DisplayedChannel::DisplayedChannel(StreamDescriptor stream, Session& session)
 		, m_persistenceEnabled(false)
 		, m_yButtonPos(0)
 {
+	//Displaying a channel may enable it
 	auto schan = dynamic_cast<OscilloscopeChannel*>(stream.m_channel);
 	if(schan)
+	{
 		schan->AddRef();
+		m_session.InvalidateGraph();
+	}
 
 	//Use GPU-side memory for rasterized waveform
 	//TODO: instead of using CPU-side mirror, use a shader to memset it when clearing?
@@ -119,6 +124,7 @@ DisplayedChannel::~DisplayedChannel()
 		}
 
 		schan->Release();
+		m_session.InvalidateGraph();
 	}
 }
 
@@ -1830,17 +1836,7 @@ void WaveformArea::RasterizeAnalogOrDigitalWaveform(
 
 		//Calculate indexes for X axis
 		auto& ibuf = channel->GetIndexBuffer();
-		ibuf.PrepareForCpuAccess();
-		sdata->m_offsets.PrepareForCpuAccess();
-		for(size_t i=0; i<w; i++)
-		{
-			int64_t target = floor(i / xscale) + offset_samples;
-			ibuf[i] = BinarySearchForGequal(
-				sdata->m_offsets.GetCpuPointer(),
-				data->size(),
-				target);
-		}
-		ibuf.MarkModifiedFromCpu();
+		CalculateSparseIndexes(ibuf, sdata, w, xscale, offset_samples);
 		comp->BindBufferNonblocking(3, ibuf, cmdbuf);
 	}
 
@@ -0,0 +1,744 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Reading and writing of waveform sample data files in the session data directory
+ */
+#include "../scopehal/scopehal.h"
+#include "../scopeprotocols/scopeprotocols.h"
+#include "WaveformFileIO.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static bool ReadDenseWaveformData(WaveformBase* cap, const string& fname);
+static void DeinterleaveSparseAnalog(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, float* samples);
+static void DeinterleaveSparseDigital(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, bool* samples);
+static void DeinterleaveCAN(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, CANSymbol* samples);
+
+#ifdef __x86_64__
+__attribute__((target("avx2")))
+static void DeinterleaveSparseAnalogAVX2(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, float* samples);
+#endif
+
+///@brief Number of samples per block when deinterleaving sparse waveforms in parallel
+static const size_t g_sparseBlockSize = 65536;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Loading
+
+/**
+	@brief Loads sample data for a single stream of a channel from a file in the session data directory
+
+	The channel must already have a waveform of the appropriate type attached to the stream; it will be resized
+	to fit the file contents. Sparse waveforms which turn out to be dense packed are converted to uniform ones.
+
+	@param chan		The channel to load into
+	@param stream	Stream index within the channel
+	@param format	File format ("sparsev1" or "densev1")
+	@param fname	Path to the sample data file
+ */
+void LoadWaveformDataForStream(
+	OscilloscopeChannel* chan,
+	int stream,
+	const string& format,
+	const string& fname
+	)
+{
+	auto cap = chan->GetData(stream);
+	auto loaded = LoadWaveformData(cap, format, fname);
+	if(!loaded)
+		cap->Resize(0);
+	else if(loaded != cap)
+		chan->SetData(loaded, stream);
+}
+
+/**
+	@brief Loads sample data from a file in the session data directory into a waveform
+
+	Does not touch any channel, so this is safe to call from a background thread on a waveform which isn't yet
+	attached to anything.
+
+	@param cap		Waveform of the appropriate type to load into. It will be resized to fit the file contents.
+	@param format	File format ("sparsev1" or "densev1")
+	@param fname	Path to the sample data file
+
+	@return The waveform containing the data. This is normally cap, but if a sparse waveform turned out to be dense
+			packed it's converted to a new uniform waveform; the caller is then responsible for deleting cap.
+			Returns nullptr if the file couldn't be read, in which case the contents of cap are undefined.
+ */
+WaveformBase* LoadWaveformData(WaveformBase* cap, const string& format, const string& fname)
+{
+	auto sacap = dynamic_cast<SparseAnalogWaveform*>(cap);
+	auto sdcap = dynamic_cast<SparseDigitalWaveform*>(cap);
+	auto ccap = dynamic_cast<CANWaveform*>(cap);
+
+	cap->PrepareForCpuAccess();
+
+	//Dense packed data needs no decoding, so read it straight into the sample buffer rather than mapping the file
+	//and making a second copy
+	if(format == "densev1")
+	{
+		if(!ReadDenseWaveformData(cap, fname))
+			return nullptr;
+		cap->MarkModifiedFromCpu();
+		return cap;
+	}
+
+	//Load samples into memory
+	unsigned char* buf = NULL;
+
+	//Windows: use generic file reads for now
+	#ifdef _WIN32
+		FILE* fp = fopen(fname.c_str(), "rb");
+		if(!fp)
+		{
+			LogError("couldn't open %s\n", fname.c_str());
+			return nullptr;
+		}
+
+		//Read the whole file into a buffer a megabyte at a time
+		fseek(fp, 0, SEEK_END);
+		long len = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		buf = new unsigned char[len];
+		long len_remaining = len;
+		long blocksize = 1024*1024;
+		long read_offset = 0;
+		while(len_remaining > 0)
+		{
+			if(blocksize > len_remaining)
+				blocksize = len_remaining;
+
+			//Most time is spent on the fread's when using this path
+			if(fread(buf + read_offset, 1, blocksize, fp) != (size_t)blocksize)
+			{
+				LogError("short read from %s\n", fname.c_str());
+				fclose(fp);
+				delete[] buf;
+				return nullptr;
+			}
+
+			len_remaining -= blocksize;
+			read_offset += blocksize;
+		}
+		fclose(fp);
+
+	//On POSIX, just memory map the file
+	#else
+		int fd = open(fname.c_str(), O_RDONLY);
+		if(fd < 0)
+		{
+			LogError("couldn't open %s\n", fname.c_str());
+			return nullptr;
+		}
+		size_t len = lseek(fd, 0, SEEK_END);
+		buf = (unsigned char*)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	#endif
+
+	//Sparse interleaved
+	WaveformBase* ret = cap;
+	if(format == "sparsev1")
+	{
+		//Figure out how many samples we have
+		size_t samplesize = 2*sizeof(int64_t);
+		if(sacap)
+			samplesize += sizeof(float);
+		else if(sdcap)
+			samplesize += sizeof(bool);
+		else if(ccap)
+			samplesize += 2*sizeof(int32_t);
+		size_t nsamples = len / samplesize;
+		cap->Resize(nsamples);
+
+		//Split the interleaved records out into the separate offset/duration/sample arrays.
+		//Each sample type has its own kernel so there's no per-sample branching.
+		if(sacap)
+		{
+			DeinterleaveSparseAnalog(
+				buf,
+				nsamples,
+				sacap->m_offsets.GetCpuPointer(),
+				sacap->m_durations.GetCpuPointer(),
+				sacap->m_samples.GetCpuPointer());
+		}
+		else if(sdcap)
+		{
+			DeinterleaveSparseDigital(
+				buf,
+				nsamples,
+				sdcap->m_offsets.GetCpuPointer(),
+				sdcap->m_durations.GetCpuPointer(),
+				sdcap->m_samples.GetCpuPointer());
+		}
+		else if(ccap)
+		{
+			DeinterleaveCAN(
+				buf,
+				nsamples,
+				ccap->m_offsets.GetCpuPointer(),
+				ccap->m_durations.GetCpuPointer(),
+				ccap->m_samples.GetCpuPointer());
+		}
+
+		//Quickly check if the waveform is dense packed, even if it was stored as sparse.
+		//Since we know samples must be monotonic and non-overlapping, we don't have to check every single one!
+		int64_t nlast = nsamples - 1;
+		if(sacap)
+		{
+			if( (sacap->m_offsets[0] == 0) &&
+				(sacap->m_offsets[nlast] == nlast) &&
+				(sacap->m_durations[nlast] == 1) )
+			{
+				//Waveform was actually uniform, so convert it
+				ret = new UniformAnalogWaveform(*sacap);
+			}
+		}
+	}
+
+	else
+	{
+		LogError(
+			"Unknown waveform format \"%s\", perhaps this file was created by a newer version of ngscopeclient?\n",
+			format.c_str());
+	}
+
+	ret->MarkModifiedFromCpu();
+
+	#ifdef _WIN32
+		delete[] buf;
+	#else
+		munmap(buf, len);
+		::close(fd);
+	#endif
+
+	return ret;
+}
+
+/**
+	@brief Reads a densev1 file directly into the sample buffer of a uniform waveform
+
+	The CPU side of the buffer is pinned memory the GPU can DMA from, so once this returns the samples can be
+	uploaded without any further copies on the CPU.
+
+	@param cap		Waveform to load into (must be a UniformAnalogWaveform or UniformDigitalWaveform)
+	@param fname	Path to the sample data file
+
+	@return True on success
+ */
+static bool ReadDenseWaveformData(WaveformBase* cap, const string& fname)
+{
+	auto uacap = dynamic_cast<UniformAnalogWaveform*>(cap);
+	auto udcap = dynamic_cast<UniformDigitalWaveform*>(cap);
+	if(!uacap && !udcap)
+	{
+		LogError("densev1 data in %s can only be loaded into a uniform waveform\n", fname.c_str());
+		return false;
+	}
+
+	FILE* fp = fopen(fname.c_str(), "rb");
+	if(!fp)
+	{
+		LogError("couldn't open %s\n", fname.c_str());
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	size_t len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	//Figure out length and find the destination buffer
+	size_t samplesize = uacap ? sizeof(float) : sizeof(bool);
+	size_t nsamples = len / samplesize;
+	cap->Resize(nsamples);
+	unsigned char* dst;
+	if(uacap)
+		dst = reinterpret_cast<unsigned char*>(uacap->m_samples.GetCpuPointer());
+	else
+		dst = reinterpret_cast<unsigned char*>(udcap->m_samples.GetCpuPointer());
+
+	#ifndef _WIN32
+		posix_fadvise(fileno(fp), 0, len, POSIX_FADV_SEQUENTIAL);
+	#endif
+
+	//Read a few megabytes at a time, bypassing stdio buffering
+	setvbuf(fp, NULL, _IONBF, 0);
+	size_t bytesTotal = nsamples * samplesize;
+	size_t blocksize = 4*1024*1024;
+	size_t readOffset = 0;
+	while(readOffset < bytesTotal)
+	{
+		size_t n = fread(dst + readOffset, 1, min(blocksize, bytesTotal - readOffset), fp);
+		if(n == 0)
+		{
+			LogError("short read from %s\n", fname.c_str());
+			fclose(fp);
+			return false;
+		}
+		readOffset += n;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sparse deinterleaving kernels
+
+/*
+	sparsev1 records are packed with no padding, so nothing in the file is aligned. All reads go through memcpy(),
+	which compiles down to plain unaligned loads.
+
+	Each kernel processes independent blocks of samples in parallel; small waveforms stay on the calling thread.
+ */
+
+/**
+	@brief Deinterleaves sparsev1 analog records (int64 offset, int64 duration, float sample)
+ */
+static void DeinterleaveSparseAnalog(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, float* samples)
+{
+	#ifdef __x86_64__
+	if(g_hasAvx2)
+	{
+		DeinterleaveSparseAnalogAVX2(buf, nsamples, offsets, durations, samples);
+		return;
+	}
+	#endif
+
+	const size_t recordsize = 2*sizeof(int64_t) + sizeof(float);
+	size_t nblocks = (nsamples + g_sparseBlockSize - 1) / g_sparseBlockSize;
+
+	#pragma omp parallel for if(nblocks > 1)
+	for(size_t block=0; block<nblocks; block++)
+	{
+		size_t start = block * g_sparseBlockSize;
+		size_t end = min(start + g_sparseBlockSize, nsamples);
+		for(size_t j=start; j<end; j++)
+		{
+			auto p = buf + j*recordsize;
+
+			//The file format assumes "float" is IEEE754 32-bit float.
+			//If your platform doesn't do that, good luck.
+			memcpy(&offsets[j], p, sizeof(int64_t));
+			memcpy(&durations[j], p + sizeof(int64_t), sizeof(int64_t));
+			memcpy(&samples[j], p + 2*sizeof(int64_t), sizeof(float));
+		}
+	}
+}
+
+#ifdef __x86_64__
+/**
+	@brief AVX2 version of DeinterleaveSparseAnalog, gathering eight records per iteration
+ */
+__attribute__((target("avx2")))
+static void DeinterleaveSparseAnalogAVX2(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, float* samples)
+{
+	const size_t recordsize = 2*sizeof(int64_t) + sizeof(float);
+	size_t nblocks = (nsamples + g_sparseBlockSize - 1) / g_sparseBlockSize;
+
+	//Byte offsets of each record within a group of eight
+	const __m256i idx32 = _mm256_setr_epi32(0, 20, 40, 60, 80, 100, 120, 140);
+	const __m256i idx64 = _mm256_setr_epi64x(0, 20, 40, 60);
+
+	#pragma omp parallel for if(nblocks > 1)
+	for(size_t block=0; block<nblocks; block++)
+	{
+		size_t start = block * g_sparseBlockSize;
+		size_t end = min(start + g_sparseBlockSize, nsamples);
+		size_t end8 = start + ((end - start) & ~(size_t)7);
+
+		size_t j = start;
+		for(; j<end8; j += 8)
+		{
+			auto p = static_cast<const long long*>(static_cast<const void*>(buf + j*recordsize));
+			auto q = static_cast<const long long*>(static_cast<const void*>(buf + (j+4)*recordsize));
+
+			__m256i off0 = _mm256_i64gather_epi64(p, idx64, 1);
+			__m256i off1 = _mm256_i64gather_epi64(q, idx64, 1);
+			__m256i dur0 = _mm256_i64gather_epi64(p + 1, idx64, 1);
+			__m256i dur1 = _mm256_i64gather_epi64(q + 1, idx64, 1);
+			__m256 samp = _mm256_i32gather_ps(
+				static_cast<const float*>(static_cast<const void*>(buf + j*recordsize + 2*sizeof(int64_t))), idx32, 1);
+
+			_mm256_storeu_si256(static_cast<__m256i*>(static_cast<void*>(offsets + j)), off0);
+			_mm256_storeu_si256(static_cast<__m256i*>(static_cast<void*>(offsets + j + 4)), off1);
+			_mm256_storeu_si256(static_cast<__m256i*>(static_cast<void*>(durations + j)), dur0);
+			_mm256_storeu_si256(static_cast<__m256i*>(static_cast<void*>(durations + j + 4)), dur1);
+			_mm256_storeu_ps(samples + j, samp);
+		}
+
+		//Leftovers at the end of the block
+		for(; j<end; j++)
+		{
+			auto p = buf + j*recordsize;
+			memcpy(&offsets[j], p, sizeof(int64_t));
+			memcpy(&durations[j], p + sizeof(int64_t), sizeof(int64_t));
+			memcpy(&samples[j], p + 2*sizeof(int64_t), sizeof(float));
+		}
+	}
+}
+#endif
+
+/**
+	@brief Deinterleaves sparsev1 digital records (int64 offset, int64 duration, bool sample)
+ */
+static void DeinterleaveSparseDigital(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, bool* samples)
+{
+	const size_t recordsize = 2*sizeof(int64_t) + sizeof(bool);
+	size_t nblocks = (nsamples + g_sparseBlockSize - 1) / g_sparseBlockSize;
+
+	#pragma omp parallel for if(nblocks > 1)
+	for(size_t block=0; block<nblocks; block++)
+	{
+		size_t start = block * g_sparseBlockSize;
+		size_t end = min(start + g_sparseBlockSize, nsamples);
+		for(size_t j=start; j<end; j++)
+		{
+			auto p = buf + j*recordsize;
+			memcpy(&offsets[j], p, sizeof(int64_t));
+			memcpy(&durations[j], p + sizeof(int64_t), sizeof(int64_t));
+			samples[j] = (p[2*sizeof(int64_t)] != 0);
+		}
+	}
+}
+
+/**
+	@brief Deinterleaves sparsev1 CAN records (int64 offset, int64 duration, uint32 data, uint32 type)
+ */
+static void DeinterleaveCAN(
+	const unsigned char* buf, size_t nsamples, int64_t* offsets, int64_t* durations, CANSymbol* samples)
+{
+	const size_t recordsize = 2*sizeof(int64_t) + 2*sizeof(uint32_t);
+	size_t nblocks = (nsamples + g_sparseBlockSize - 1) / g_sparseBlockSize;
+
+	#pragma omp parallel for if(nblocks > 1)
+	for(size_t block=0; block<nblocks; block++)
+	{
+		size_t start = block * g_sparseBlockSize;
+		size_t end = min(start + g_sparseBlockSize, nsamples);
+		for(size_t j=start; j<end; j++)
+		{
+			auto p = buf + j*recordsize;
+			memcpy(&offsets[j], p, sizeof(int64_t));
+			memcpy(&durations[j], p + sizeof(int64_t), sizeof(int64_t));
+
+			uint32_t data[2];
+			memcpy(data, p + 2*sizeof(int64_t), sizeof(data));
+			samples[j] = CANSymbol((CANSymbol::stype)data[1], data[0]);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Saving
+
+/**
+	@brief Saves waveform sample data in the "sparsev1" file format.
+
+	Interleaved (slow):
+		int64 offset
+		int64 len
+		for analog
+			float voltage
+		for digital
+			bool voltage
+ */
+bool SerializeSparseWaveform(SparseWaveformBase* wfm, const string& path)
+{
+	FILE* fp = fopen(path.c_str(), "wb");
+	if(!fp)
+		return false;
+
+	wfm->PrepareForCpuAccess();
+	auto achan = dynamic_cast<SparseAnalogWaveform*>(wfm);
+	auto dchan = dynamic_cast<SparseDigitalWaveform*>(wfm);
+	auto cchan = dynamic_cast<CANWaveform*>(wfm);
+	size_t len = wfm->size();
+
+	//Analog channels
+	const size_t samples_per_block = 10000;
+	if(achan)
+	{
+		#pragma pack(push, 1)
+		class asample_t
+		{
+		public:
+			int64_t off;
+			int64_t dur;
+			float voltage;
+
+			asample_t(int64_t o=0, int64_t d=0, float v=0)
+			: off(o), dur(d), voltage(v)
+			{}
+		};
+		#pragma pack(pop)
+
+		//Copy sample data
+		vector<asample_t,	AlignedAllocator<asample_t, 64 > > samples;
+		samples.reserve(len);
+		for(size_t i=0; i<len; i++)
+			samples.push_back(asample_t(achan->m_offsets[i], achan->m_durations[i], achan->m_samples[i]));
+
+		//Write it
+		for(size_t i=0; i<len; i+= samples_per_block)
+		{
+			size_t blocklen = min(len-i, samples_per_block);
+			if(blocklen != fwrite(&samples[i], sizeof(asample_t), blocklen, fp))
+			{
+				LogError("file write error\n");
+				fclose(fp);
+				return false;
+			}
+		}
+	}
+	else if(dchan)
+	{
+		#pragma pack(push, 1)
+		class dsample_t
+		{
+		public:
+			int64_t off;
+			int64_t dur;
+			bool voltage;
+
+			dsample_t(int64_t o=0, int64_t d=0, bool v=0)
+			: off(o), dur(d), voltage(v)
+			{}
+		};
+		#pragma pack(pop)
+
+		//Copy sample data
+		vector<dsample_t,	AlignedAllocator<dsample_t, 64 > > samples;
+		samples.reserve(len);
+		for(size_t i=0; i<len; i++)
+			samples.push_back(dsample_t(dchan->m_offsets[i], dchan->m_durations[i], dchan->m_samples[i]));
+
+		//Write it
+		for(size_t i=0; i<len; i+= samples_per_block)
+		{
+			size_t blocklen = min(len-i, samples_per_block);
+			if(blocklen != fwrite(&samples[i], sizeof(dsample_t), blocklen, fp))
+			{
+				LogError("file write error\n");
+				fclose(fp);
+			}
+		}
+	}
+	else if(cchan)
+	{
+		#pragma pack(push, 1)
+		class csample_t
+		{
+		public:
+			int64_t off;
+			int64_t dur;
+			uint32_t data;
+			uint32_t type;
+
+			csample_t(int64_t o=0, int64_t d=0, CANSymbol s = CANSymbol())
+			: off(o), dur(d), data(s.m_data), type(s.m_stype)
+			{}
+		};
+		#pragma pack(pop)
+
+		//Copy sample data
+		vector<csample_t,	AlignedAllocator<csample_t, 64 > > samples;
+		samples.reserve(len);
+		for(size_t i=0; i<len; i++)
+			samples.push_back(csample_t(cchan->m_offsets[i], cchan->m_durations[i], cchan->m_samples[i]));
+
+		//Write it
+		for(size_t i=0; i<len; i+= samples_per_block)
+		{
+			size_t blocklen = min(len-i, samples_per_block);
+			if(blocklen != fwrite(&samples[i], sizeof(csample_t), blocklen, fp))
+			{
+				LogError("file write error\n");
+				fclose(fp);
+				return false;
+			}
+		}
+	}
+	else
+	{
+		//TODO: support other waveform types (buses, eyes, etc)
+		LogError("unrecognized sample type\n");
+		fclose(fp);
+		return false;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+/**
+	@brief Saves waveform sample data in the "densev1" file format.
+
+	for analog
+		float[] voltage
+	for digital
+		bool[] voltage
+
+	Durations are implied {1....1} and offsets are implied {0...n-1}.
+ */
+bool SerializeUniformWaveform(UniformWaveformBase* wfm, const string& path)
+{
+	FILE* fp = fopen(path.c_str(), "wb");
+	if(!fp)
+		return false;
+
+	wfm->PrepareForCpuAccess();
+	auto achan = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	auto dchan = dynamic_cast<UniformDigitalWaveform*>(wfm);
+	size_t len = wfm->size();
+
+	//Analog channels
+	const size_t samples_per_block = 10000;
+	if(achan)
+	{
+		//Write it
+		for(size_t i=0; i<len; i+= samples_per_block)
+		{
+			size_t blocklen = min(len-i, samples_per_block);
+
+			if(blocklen != fwrite(achan->m_samples.GetCpuPointer() + i, sizeof(float), blocklen, fp))
+			{
+				LogError("file write error\n");
+				return false;
+			}
+		}
+	}
+	else if(dchan)
+	{
+		//Write it
+		for(size_t i=0; i<len; i+= samples_per_block)
+		{
+			size_t blocklen = min(len-i, samples_per_block);
+
+			if(blocklen != fwrite(dchan->m_samples.GetCpuPointer() + i, sizeof(bool), blocklen, fp))
+			{
+				LogError("file write error\n");
+				return false;
+			}
+		}
+	}
+	else
+	{
+		//TODO: support other waveform types (buses, eyes, etc)
+		LogError("unrecognized sample type\n");
+		return false;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+/**
+	@brief Fills out the metadata node for a single channel's waveform in a scope_N_metadata.yml file
+
+	Only the per-waveform fields are written; the caller is responsible for the channel and stream indexes.
+
+	@param wfm		The waveform
+	@param chnode	Node to add metadata to
+ */
+void SerializeWaveformMetadata(WaveformBase* wfm, YAML::Node& chnode)
+{
+	chnode["timescale"] = wfm->m_timescale;
+	chnode["trigphase"] = wfm->m_triggerPhase;
+	chnode["flags"] = (int)wfm->m_flags;
+	//don't serialize revision
+
+	if(dynamic_cast<SparseWaveformBase*>(wfm))
+	{
+		chnode["format"] = "sparsev1";
+
+		//Save type if it's a protocol waveform
+		//so if we do an offline load, we know what type of waveform to make
+		if(dynamic_cast<SparseAnalogWaveform*>(wfm) != nullptr)
+			chnode["datatype"] = "analog";
+		else if(dynamic_cast<SparseDigitalWaveform*>(wfm) != nullptr)
+			chnode["datatype"] = "digital";
+		else if(dynamic_cast<CANWaveform*>(wfm) != nullptr)
+			chnode["datatype"] = "can";
+	}
+	else
+		chnode["format"] = "densev1";
+}
+
+/**
+	@brief Saves waveform sample data in whichever format is appropriate for its type
+
+	@param wfm		The waveform
+	@param path		Path to the output file
+
+	@return True on success
+ */
+bool SerializeWaveform(WaveformBase* wfm, const string& path)
+{
+	auto sparse = dynamic_cast<SparseWaveformBase*>(wfm);
+	if(sparse)
+		return SerializeSparseWaveform(sparse, path);
+
+	auto uniform = dynamic_cast<UniformWaveformBase*>(wfm);
+	if(uniform)
+		return SerializeUniformWaveform(uniform, path);
+
+	LogError("unrecognized waveform type\n");
+	return false;
+}
+
+/**
+	@brief Returns the name of the file, within a waveform_N directory, holding data for one stream of a channel
+ */
+string GetWaveformFileName(size_t channel, size_t stream)
+{
+	if(stream == 0)
+		return string("channel_") + to_string(channel) + ".bin";
+	else
+		return string("channel_") + to_string(channel) + "_stream" + to_string(stream) + ".bin";
+}
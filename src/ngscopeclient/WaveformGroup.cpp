@@ -141,6 +141,8 @@ bool WaveformGroup::Render()
 {
 	auto areas = GetWaveformAreas();
 
+	m_budget.BeginFrame();
+
 	bool open = true;
 	ImGui::SetNextWindowSize(ImVec2(320, 240), ImGuiCond_Appearing);
 	if(!ImGui::Begin(GetID().c_str(), &open, ImGuiWindowFlags_NoScrollWithMouse))
@@ -148,8 +150,10 @@ bool WaveformGroup::Render()
 		//tabbed out, don't draw anything until we're back in the foreground
 		TitleHoverHelp();
 		ImGui::End();
+		m_budget.EndFrame(false);
 		return true;
 	}
+	m_budget.UpdateRefresh(ImGui::IsWindowHovered(ImGuiHoveredFlags_RootAndChildWindows));
 
 	//Check for right click on the title bar
 	//see https://github.com/ocornut/imgui/issues/7914
@@ -237,6 +241,7 @@ bool WaveformGroup::Render()
 	RenderMarkers(pos, plotSize);
 
 	ImGui::End();
+	m_budget.EndFrame(true);
 
 	return open;
 }
@@ -36,6 +36,7 @@
 #define WaveformGroup_h
 
 #include "WaveformArea.h"
+#include "FrameBudget.h"
 
 /**
 	@brief A WaveformGroup is a container for one or more WaveformArea's.
@@ -66,6 +67,9 @@ public:
 	const std::string& GetTitle()
 	{ return m_title; }
 
+	PanelBudget& GetBudget()
+	{ return m_budget; }
+
 	void AddArea(std::shared_ptr<WaveformArea>& area);
 
 	void OnZoomInHorizontal(int64_t target, float step);
@@ -224,6 +228,9 @@ protected:
 	///@brief True if we're displaying an eye pattern (fixed x axis scale)
 	bool m_displayingEye;
 
+	///@brief Frame time accounting for this group
+	PanelBudget m_budget;
+
 public:
 
 	///@brief Type of X axis cursor we're displaying
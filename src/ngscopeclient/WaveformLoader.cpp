@@ -0,0 +1,280 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of WaveformLoader
+ */
+#include "../scopehal/scopehal.h"
+#include "WaveformLoader.h"
+#include "WaveformFileIO.h"
+#include "pthread_compat.h"
+
+#include <sys/stat.h>
+
+extern std::shared_mutex g_vulkanActivityMutex;
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+WaveformLoader::WaveformLoader(size_t maxBytesInFlight)
+	: m_nextJob(0)
+	, m_jobsDone(0)
+	, m_bytesLoaded(0)
+	, m_bytesTotal(0)
+	, m_bytesInFlight(0)
+	, m_maxBytesInFlight(maxBytesInFlight)
+	, m_aborting(false)
+	, m_startTime(0)
+	, m_endTime(0)
+{
+}
+
+WaveformLoader::~WaveformLoader()
+{
+	Abort();
+
+	//Free anything nobody claimed
+	for(auto& job : m_jobs)
+		delete job.m_waveform;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Job management
+
+/**
+	@brief Adds a file to be loaded. Must be called before Start().
+
+	@param wfm		Waveform of the appropriate type to load into. The loader takes ownership of it.
+	@param format	File format
+	@param path		Path to the file
+
+	@return Job index, for use with Detach()
+ */
+size_t WaveformLoader::Add(WaveformBase* wfm, const string& format, const string& path)
+{
+	size_t size = 0;
+	struct stat st;
+	if(stat(path.c_str(), &st) == 0)
+		size = st.st_size;
+
+	m_jobs.push_back(WaveformLoadJob(wfm, format, path, size));
+	m_bytesTotal += size;
+	return m_jobs.size() - 1;
+}
+
+/**
+	@brief Asks for a job's waveform to be uploaded to the GPU on the worker thread once it's loaded
+
+	Intended for the waveforms which will be displayed as soon as loading completes, so the first render doesn't
+	have to stall on a large synchronous upload. Must be called before Start().
+ */
+void WaveformLoader::RequestUpload(size_t job)
+{
+	m_jobs[job].m_upload = true;
+}
+
+/**
+	@brief Spawns the worker threads and begins loading
+
+	@param nthreads	Number of threads to use (zero for one per hardware thread)
+ */
+void WaveformLoader::Start(size_t nthreads)
+{
+	m_startTime = GetTime();
+
+	if(nthreads == 0)
+		nthreads = thread::hardware_concurrency();
+	nthreads = max((size_t)1, min(nthreads, m_jobs.size()));
+
+	LogTrace("Loading %zu waveform files (%zu bytes) using %zu threads\n", m_jobs.size(), m_bytesTotal, nthreads);
+	for(size_t i=0; i<nthreads; i++)
+		m_threads.push_back(thread(&WaveformLoader::WorkerThread, this));
+}
+
+/**
+	@brief Stops loading and waits for all worker threads to exit
+ */
+void WaveformLoader::Abort()
+{
+	{
+		lock_guard<mutex> lock(m_budgetMutex);
+		m_aborting = true;
+	}
+	m_budgetCondition.notify_all();
+
+	for(auto& t : m_threads)
+		t.join();
+	m_threads.clear();
+}
+
+/**
+	@brief Takes ownership of a loaded waveform
+
+	Only valid once IsDone() returns true. The returned waveform may not be the same object passed to Add(), since
+	sparse data which turns out to be uniform is converted.
+ */
+WaveformBase* WaveformLoader::Detach(size_t job)
+{
+	auto ret = m_jobs[job].m_waveform;
+	m_jobs[job].m_waveform = nullptr;
+	return ret;
+}
+
+/**
+	@brief Returns the time spent loading so far, or the total time if loading has completed
+ */
+double WaveformLoader::GetElapsedTime()
+{
+	double end = m_endTime;
+	if(end == 0)
+		end = GetTime();
+	return end - m_startTime;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Worker
+
+void WaveformLoader::WorkerThread()
+{
+	pthread_setname_np_compat("WaveformLoader");
+
+	//Vulkan objects for uploading, created the first time we need them
+	unique_ptr<vk::raii::CommandPool> pool;
+	unique_ptr<vk::raii::CommandBuffer> cmdbuf;
+	shared_ptr<QueueHandle> queue;
+
+	while(!m_aborting)
+	{
+		size_t i = m_nextJob ++;
+		if(i >= m_jobs.size())
+			break;
+		auto& job = m_jobs[i];
+
+		//Wait until there's room in the budget (but always let one job through, no matter how big)
+		{
+			unique_lock<mutex> lock(m_budgetMutex);
+			m_budgetCondition.wait(lock, [&]
+			{
+				return m_aborting ||
+					(m_bytesInFlight == 0) ||
+					(m_bytesInFlight + job.m_size <= m_maxBytesInFlight);
+			});
+			if(m_aborting)
+				break;
+			m_bytesInFlight += job.m_size;
+		}
+
+		auto wfm = LoadWaveformData(job.m_waveform, job.m_format, job.m_path);
+		if(!wfm)
+			job.m_failed = true;
+		else
+		{
+			if(wfm != job.m_waveform)
+			{
+				delete job.m_waveform;
+				job.m_waveform = wfm;
+			}
+			if(job.m_upload)
+				UploadWaveform(wfm, pool, cmdbuf, queue);
+		}
+
+		{
+			lock_guard<mutex> lock(m_budgetMutex);
+			m_bytesInFlight -= job.m_size;
+		}
+		m_budgetCondition.notify_all();
+
+		m_bytesLoaded += job.m_size;
+		if(++m_jobsDone == m_jobs.size())
+			m_endTime = GetTime();
+	}
+}
+
+/**
+	@brief Copies a freshly loaded waveform's samples to the GPU
+
+	The samples were read into pinned memory, so this is a single DMA from the staging buffer. It blocks the
+	worker thread (but not the GUI) until the transfer completes.
+ */
+void WaveformLoader::UploadWaveform(
+	WaveformBase* wfm,
+	unique_ptr<vk::raii::CommandPool>& pool,
+	unique_ptr<vk::raii::CommandBuffer>& cmdbuf,
+	shared_ptr<QueueHandle>& queue)
+{
+	//Only uniform analog waveforms are rendered straight from GPU memory, don't bother with anything else
+	auto uwfm = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	if(!uwfm)
+		return;
+
+	if(!cmdbuf)
+	{
+		queue = g_vkQueueManager->GetComputeQueue("WaveformLoader.queue");
+		vk::CommandPoolCreateInfo poolInfo(
+			vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+			queue->m_family );
+		pool = make_unique<vk::raii::CommandPool>(*g_vkComputeDevice, poolInfo);
+
+		vk::CommandBufferAllocateInfo bufinfo(**pool, vk::CommandBufferLevel::ePrimary, 1);
+		cmdbuf = make_unique<vk::raii::CommandBuffer>(
+			std::move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+		if(g_hasDebugUtils)
+		{
+			string poolname = "WaveformLoader.pool";
+			string bufname = "WaveformLoader.cmdbuf";
+
+			g_vkComputeDevice->setDebugUtilsObjectNameEXT(
+				vk::DebugUtilsObjectNameInfoEXT(
+					vk::ObjectType::eCommandPool,
+					reinterpret_cast<uint64_t>(static_cast<VkCommandPool>(**pool)),
+					poolname.c_str()));
+
+			g_vkComputeDevice->setDebugUtilsObjectNameEXT(
+				vk::DebugUtilsObjectNameInfoEXT(
+					vk::ObjectType::eCommandBuffer,
+					reinterpret_cast<int64_t>(static_cast<VkCommandBuffer>(**cmdbuf)),
+					bufname.c_str()));
+		}
+	}
+
+	uwfm->m_samples.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+
+	//Don't submit while the swapchain is being recreated
+	shared_lock<shared_mutex> lock(g_vulkanActivityMutex);
+	cmdbuf->reset();
+	cmdbuf->begin({});
+	uwfm->m_samples.PrepareForGpuAccessNonblocking(false, *cmdbuf);
+	cmdbuf->end();
+	queue->SubmitAndBlock(*cmdbuf);
+}
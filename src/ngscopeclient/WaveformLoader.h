@@ -0,0 +1,165 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of WaveformLoader
+ */
+#ifndef WaveformLoader_h
+#define WaveformLoader_h
+
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+/**
+	@brief A single waveform data file to be loaded
+ */
+class WaveformLoadJob
+{
+public:
+	WaveformLoadJob(WaveformBase* wfm, const std::string& format, const std::string& path, size_t size)
+	: m_waveform(wfm)
+	, m_format(format)
+	, m_path(path)
+	, m_size(size)
+	, m_upload(false)
+	, m_failed(false)
+	{}
+
+	///@brief The waveform being loaded into (owned by the loader until detached)
+	WaveformBase* m_waveform;
+
+	///@brief File format
+	std::string m_format;
+
+	///@brief Path to the data file
+	std::string m_path;
+
+	///@brief Size of the data file, in bytes
+	size_t m_size;
+
+	///@brief True to push the waveform to the GPU as soon as it's loaded
+	bool m_upload;
+
+	///@brief True if the file couldn't be read, so the waveform contents are meaningless
+	bool m_failed;
+};
+
+/**
+	@brief Loads waveform data files from a session in the background using a pool of worker threads
+
+	The total size of files being decoded at any one time is limited, so a huge session doesn't map all of its
+	data at once.
+ */
+class WaveformLoader
+{
+public:
+	WaveformLoader(size_t maxBytesInFlight = 1024LL * 1024LL * 1024LL);
+	~WaveformLoader();
+
+	size_t Add(WaveformBase* wfm, const std::string& format, const std::string& path);
+	void RequestUpload(size_t job);
+	void Start(size_t nthreads = 0);
+	void Abort();
+
+	WaveformBase* Detach(size_t job);
+
+	///@brief Returns true if the data for a job couldn't be loaded
+	bool IsFailed(size_t job)
+	{ return m_jobs[job].m_failed; }
+
+	///@brief Returns true if there is nothing to load
+	bool empty()
+	{ return m_jobs.empty(); }
+
+	///@brief Returns true once every job has completed
+	bool IsDone()
+	{ return m_jobsDone == m_jobs.size(); }
+
+	///@brief Returns the total size of all files to be loaded
+	size_t GetBytesTotal()
+	{ return m_bytesTotal; }
+
+	///@brief Returns the total size of all files loaded so far
+	size_t GetBytesLoaded()
+	{ return m_bytesLoaded; }
+
+	double GetElapsedTime();
+
+protected:
+	void WorkerThread();
+	void UploadWaveform(
+		WaveformBase* wfm,
+		std::unique_ptr<vk::raii::CommandPool>& pool,
+		std::unique_ptr<vk::raii::CommandBuffer>& cmdbuf,
+		std::shared_ptr<QueueHandle>& queue);
+
+	///@brief Everything we've been asked to load
+	std::vector<WaveformLoadJob> m_jobs;
+
+	///@brief Index of the next job to hand out to a worker
+	std::atomic<size_t> m_nextJob;
+
+	///@brief Number of jobs completed
+	std::atomic<size_t> m_jobsDone;
+
+	///@brief Total size of files loaded
+	std::atomic<size_t> m_bytesLoaded;
+
+	///@brief Total size of all files
+	size_t m_bytesTotal;
+
+	///@brief Mutex protecting m_bytesInFlight
+	std::mutex m_budgetMutex;
+
+	///@brief Signalled when a job completes and its memory is released
+	std::condition_variable m_budgetCondition;
+
+	///@brief Total size of files currently being loaded
+	size_t m_bytesInFlight;
+
+	///@brief Upper limit for m_bytesInFlight (exceeded only if a single file is larger)
+	size_t m_maxBytesInFlight;
+
+	///@brief Set to stop all workers
+	std::atomic<bool> m_aborting;
+
+	///@brief The worker threads
+	std::vector<std::thread> m_threads;
+
+	///@brief Time that loading started
+	double m_startTime;
+
+	///@brief Time that loading completed
+	std::atomic<double> m_endTime;
+};
+
+#endif
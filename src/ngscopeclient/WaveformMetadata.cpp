@@ -0,0 +1,485 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Loading of per-scope waveform metadata, and the binary sidecar which caches it
+
+	scope_N_metadata.yml is the canonical, human readable description of the waveforms in a session's data directory.
+	For sessions with a lot of history it's large and slow to parse, so scope_N_metadata.bin is written next to it
+	containing the same information in a compact binary form. It records the size and a hash of the YAML file it was
+	generated from and is ignored if either no longer matches (e.g. if the YAML was edited by hand). Hashing the YAML
+	means reading it, but that's still orders of magnitude faster than parsing it.
+
+	Sidecar format (all values in native byte order, which is little endian on every platform we support):
+		char[8]		magic "NGSMETA\0"
+		uint32		format version (2)
+		uint64		size of the YAML file, in bytes
+		uint64		FNV-1a hash of the YAML file
+		uint64		number of waveforms
+		for each waveform
+			int64	timestamp (seconds)
+			int64	timestamp (femtoseconds)
+			int32	waveform ID
+			uint8	pinned
+			uint32	label length, followed by that many bytes of label
+			uint32	number of streams
+			for each stream
+				int32	channel index
+				int32	stream index
+				uint8	format (0 = sparsev1, 1 = densev1)
+				uint8	datatype (0 = unspecified, 1 = analog, 2 = digital, 3 = CAN)
+				int64	timescale (fs)
+				int64	trigger phase (fs)
+ */
+#include "../scopehal/scopehal.h"
+#include "WaveformMetadata.h"
+
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char g_sidecarMagic[8] = {'N', 'G', 'S', 'M', 'E', 'T', 'A', '\0'};
+static const uint32_t g_sidecarVersion = 2;
+
+//Smallest possible encoding of one waveform, and of one stream within it, in a sidecar
+static const size_t g_sidecarWaveformSize = 29;
+static const size_t g_sidecarStreamSize = 26;
+
+static const char* g_datatypeNames[] = {"", "analog", "digital", "can"};
+
+static void AppendRaw(vector<uint8_t>& buf, const void* data, size_t len);
+template<class T> static void Append(vector<uint8_t>& buf, T value);
+template<class T> static bool Extract(const uint8_t*& p, const uint8_t* end, T& value);
+static bool HashFile(const string& path, uint64_t& size, uint64_t& hash);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Loading
+
+/**
+	@brief Loads the metadata for all waveforms saved from one scope, using the sidecar if it's valid
+
+	@param dataDir		Path to the session data directory
+	@param scopeID		ID of the scope
+	@param version		Session file format version (needed to interpret older YAML)
+	@param waveforms	Output metadata
+
+	@return False if there's no metadata for this scope
+ */
+bool LoadScopeMetadata(const string& dataDir, int scopeID, int version, vector<WaveformMetadata>& waveforms)
+{
+	string base = dataDir + "/scope_" + to_string(scopeID) + "_metadata";
+	string ymlPath = base + ".yml";
+	string binPath = base + ".bin";
+
+	struct stat st;
+	if(stat(ymlPath.c_str(), &st) != 0)
+		return false;
+
+	double start = GetTime();
+	if(ReadScopeMetadataSidecar(binPath, ymlPath, waveforms))
+	{
+		LogTrace("Loaded metadata for %zu waveforms from %s in %.3f ms\n",
+			waveforms.size(), binPath.c_str(), (GetTime() - start) * 1000);
+		return true;
+	}
+
+	auto docs = YAML::LoadAllFromFile(ymlPath);
+	if(docs.empty())
+		return false;
+	ParseScopeMetadata(version, docs[0], waveforms);
+
+	LogTrace("Loaded metadata for %zu waveforms from %s in %.3f ms\n",
+		waveforms.size(), ymlPath.c_str(), (GetTime() - start) * 1000);
+	return true;
+}
+
+/**
+	@brief Converts the YAML representation of a scope's waveform metadata
+
+	@param version		Session file format version
+	@param node			Root node of the scope_N_metadata.yml file
+	@param waveforms	Output metadata
+ */
+void ParseScopeMetadata(int version, const YAML::Node& node, vector<WaveformMetadata>& waveforms)
+{
+	auto wavenode = node["waveforms"];
+	if(!wavenode)
+		return;
+
+	for(auto it : wavenode)
+	{
+		auto wfm = it.second;
+		WaveformMetadata meta;
+
+		//Older files used picosecond timestamps
+		bool timebase_is_ps = true;
+		meta.m_time.first = wfm["timestamp"].as<long long>();
+		if(wfm["time_psec"])
+		{
+			meta.m_time.second = wfm["time_psec"].as<long long>() * 1000;
+			timebase_is_ps = true;
+		}
+		else
+		{
+			meta.m_time.second = wfm["time_fsec"].as<long long>();
+			timebase_is_ps = false;
+		}
+		meta.m_id = wfm["id"].as<int>();
+		if(wfm["pinned"])
+		{
+			if(version <= 1)
+				meta.m_pinned = wfm["pinned"].as<int>();
+			else
+				meta.m_pinned = wfm["pinned"].as<bool>();
+		}
+		if(wfm["label"])
+			meta.m_label = wfm["label"].as<string>();
+
+		for(auto jt : wfm["channels"])
+		{
+			auto ch = jt.second;
+			WaveformStreamMetadata s;
+			s.m_channel = ch["index"].as<int>();
+			if(ch["stream"])
+				s.m_stream = ch["stream"].as<int>();
+
+			//Waveform format defaults to sparsev1 as that's what was used before
+			//the metadata file contained a format ID at all
+			if(ch["format"])
+				s.m_format = ch["format"].as<string>();
+			if(ch["datatype"])
+				s.m_datatype = ch["datatype"].as<string>();
+
+			s.m_timescale = ch["timescale"].as<long>();
+			if(timebase_is_ps)
+			{
+				s.m_timescale *= 1000;
+				s.m_triggerPhase = ch["trigphase"].as<float>() * 1000;
+			}
+			else
+				s.m_triggerPhase = ch["trigphase"].as<long long>();
+
+			meta.m_streams.push_back(s);
+		}
+
+		waveforms.push_back(meta);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sidecar I/O
+
+/**
+	@brief Reads a binary metadata sidecar
+
+	@param path			Path to the sidecar
+	@param yamlPath		Path to the YAML file the sidecar should have been generated from
+	@param waveforms	Output metadata
+
+	@return True on success, false if the sidecar is missing, corrupted, or out of date
+ */
+bool ReadScopeMetadataSidecar(const string& path, const string& yamlPath, vector<WaveformMetadata>& waveforms)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if(!fp)
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	size_t len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	vector<uint8_t> buf(len);
+	size_t nread = fread(buf.data(), 1, len, fp);
+	fclose(fp);
+	if(nread != len)
+		return false;
+
+	const uint8_t* p = buf.data();
+	const uint8_t* end = p + len;
+
+	//Check header
+	if( (len < sizeof(g_sidecarMagic)) || (memcmp(p, g_sidecarMagic, sizeof(g_sidecarMagic)) != 0) )
+	{
+		LogWarning("%s is not a metadata sidecar, ignoring it\n", path.c_str());
+		return false;
+	}
+	p += sizeof(g_sidecarMagic);
+	uint32_t version;
+	if(!Extract(p, end, version))
+		return false;
+	if(version != g_sidecarVersion)
+	{
+		LogTrace("%s has unsupported version %u, ignoring it\n", path.c_str(), version);
+		return false;
+	}
+	uint64_t expectedYamlSize;
+	uint64_t expectedYamlHash;
+	uint64_t count;
+	if(!Extract(p, end, expectedYamlSize) || !Extract(p, end, expectedYamlHash) || !Extract(p, end, count))
+		return false;
+	uint64_t yamlSize;
+	uint64_t yamlHash;
+	if(!HashFile(yamlPath, yamlSize, yamlHash) || (expectedYamlSize != yamlSize) || (expectedYamlHash != yamlHash) )
+	{
+		LogTrace("%s is out of date, ignoring it\n", path.c_str());
+		return false;
+	}
+
+	//Don't trust the count until we know there's enough data left to hold that many waveforms
+	if(count > static_cast<size_t>(end - p) / g_sidecarWaveformSize)
+	{
+		LogWarning("%s is truncated, ignoring it\n", path.c_str());
+		return false;
+	}
+
+	vector<WaveformMetadata> ret;
+	ret.reserve(count);
+	for(uint64_t i=0; i<count; i++)
+	{
+		WaveformMetadata meta;
+		int64_t sec;
+		int64_t fs;
+		int32_t id;
+		uint8_t pinned;
+		uint32_t labelLen;
+		if(!Extract(p, end, sec) || !Extract(p, end, fs) || !Extract(p, end, id) ||
+			!Extract(p, end, pinned) || !Extract(p, end, labelLen) || (labelLen > (size_t)(end - p)) )
+		{
+			LogWarning("%s is truncated, ignoring it\n", path.c_str());
+			return false;
+		}
+		meta.m_time = TimePoint(sec, fs);
+		meta.m_id = id;
+		meta.m_pinned = (pinned != 0);
+		meta.m_label.assign(reinterpret_cast<const char*>(p), labelLen);
+		p += labelLen;
+
+		uint32_t nstreams;
+		if(!Extract(p, end, nstreams) || (nstreams > static_cast<size_t>(end - p) / g_sidecarStreamSize) )
+		{
+			LogWarning("%s is truncated, ignoring it\n", path.c_str());
+			return false;
+		}
+		meta.m_streams.resize(nstreams);
+		for(auto& s : meta.m_streams)
+		{
+			int32_t chan;
+			int32_t stream;
+			uint8_t format;
+			uint8_t datatype;
+			if(!Extract(p, end, chan) || !Extract(p, end, stream) || !Extract(p, end, format) ||
+				!Extract(p, end, datatype) || !Extract(p, end, s.m_timescale) || !Extract(p, end, s.m_triggerPhase) ||
+				(datatype >= sizeof(g_datatypeNames) / sizeof(g_datatypeNames[0])) )
+			{
+				LogWarning("%s is truncated, ignoring it\n", path.c_str());
+				return false;
+			}
+			s.m_channel = chan;
+			s.m_stream = stream;
+			s.m_format = format ? "densev1" : "sparsev1";
+			s.m_datatype = g_datatypeNames[datatype];
+		}
+
+		ret.push_back(meta);
+	}
+
+	waveforms.insert(waveforms.end(), ret.begin(), ret.end());
+	return true;
+}
+
+/**
+	@brief Writes a binary metadata sidecar
+
+	The file is written to a temporary name then moved into place, so a reader never sees a partial file.
+
+	@param path			Path to the sidecar
+	@param yamlPath		Path to the YAML file the metadata was written to
+	@param waveforms	The metadata
+
+	@return True on success
+ */
+bool WriteScopeMetadataSidecar(const string& path, const string& yamlPath, const vector<WaveformMetadata>& waveforms)
+{
+	uint64_t yamlSize;
+	uint64_t yamlHash;
+	if(!HashFile(yamlPath, yamlSize, yamlHash))
+		return false;
+
+	vector<uint8_t> buf;
+	AppendRaw(buf, g_sidecarMagic, sizeof(g_sidecarMagic));
+	Append<uint32_t>(buf, g_sidecarVersion);
+	Append<uint64_t>(buf, yamlSize);
+	Append<uint64_t>(buf, yamlHash);
+	Append<uint64_t>(buf, waveforms.size());
+
+	for(auto& meta : waveforms)
+	{
+		Append<int64_t>(buf, meta.m_time.first);
+		Append<int64_t>(buf, meta.m_time.second);
+		Append<int32_t>(buf, meta.m_id);
+		Append<uint8_t>(buf, meta.m_pinned);
+		Append<uint32_t>(buf, meta.m_label.length());
+		AppendRaw(buf, meta.m_label.data(), meta.m_label.length());
+
+		Append<uint32_t>(buf, meta.m_streams.size());
+		for(auto& s : meta.m_streams)
+		{
+			uint8_t datatype = 0;
+			for(size_t i=0; i<sizeof(g_datatypeNames) / sizeof(g_datatypeNames[0]); i++)
+			{
+				if(s.m_datatype == g_datatypeNames[i])
+					datatype = i;
+			}
+
+			Append<int32_t>(buf, s.m_channel);
+			Append<int32_t>(buf, s.m_stream);
+			Append<uint8_t>(buf, (s.m_format == "densev1") ? 1 : 0);
+			Append<uint8_t>(buf, datatype);
+			Append<int64_t>(buf, s.m_timescale);
+			Append<int64_t>(buf, s.m_triggerPhase);
+		}
+	}
+
+	string tmp = path + ".tmp";
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if(!fp)
+		return false;
+	bool ok = (fwrite(buf.data(), 1, buf.size(), fp) == buf.size());
+	ok &= (fclose(fp) == 0);
+	if(!ok)
+	{
+		remove(tmp.c_str());
+		return false;
+	}
+
+	#ifdef _WIN32
+		remove(path.c_str());
+	#endif
+	return (rename(tmp.c_str(), path.c_str()) == 0);
+}
+
+/**
+	@brief Generates the sidecar for a scope_N_metadata.yml file which has just been written
+
+	@param yamlPath		Path to the YAML file
+	@param node			The YAML node which was written to it
+
+	@return True on success
+ */
+bool UpdateScopeMetadataSidecar(const string& yamlPath, const YAML::Node& node)
+{
+	//Anything we write is in the current format
+	vector<WaveformMetadata> waveforms;
+	ParseScopeMetadata(2, node, waveforms);
+
+	string path = yamlPath.substr(0, yamlPath.length() - strlen(".yml")) + ".bin";
+	if(!WriteScopeMetadataSidecar(path, yamlPath, waveforms))
+	{
+		LogWarning("Failed to write metadata sidecar %s\n", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Parses the ui_config/markers block of a session file
+
+	@param node		The markers node (may be null if the session has no markers)
+	@param markers	Markers are appended here, in file order
+ */
+void ParseSessionMarkers(const YAML::Node& node, vector<Marker>& markers)
+{
+	if(!node)
+		return;
+
+	for(auto it : node)
+	{
+		auto inode = it.second;
+		TimePoint timestamp(inode["timestamp"].as<int64_t>(), inode["time_fsec"].as<int64_t>());
+		for(auto jt : inode["markers"])
+			markers.push_back(Marker(timestamp, jt.second["offset"].as<int64_t>(), jt.second["name"].as<string>()));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+static void AppendRaw(vector<uint8_t>& buf, const void* data, size_t len)
+{
+	auto p = reinterpret_cast<const uint8_t*>(data);
+	buf.insert(buf.end(), p, p + len);
+}
+
+template<class T>
+static void Append(vector<uint8_t>& buf, T value)
+{
+	AppendRaw(buf, &value, sizeof(value));
+}
+
+/**
+	@brief Reads a value from the buffer and advances past it
+
+	@return False if there's not enough data left
+ */
+template<class T>
+static bool Extract(const uint8_t*& p, const uint8_t* end, T& value)
+{
+	if(static_cast<size_t>(end - p) < sizeof(T))
+		return false;
+	memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return true;
+}
+
+/**
+	@brief Computes the size and 64-bit FNV-1a hash of a file
+
+	@return False if the file couldn't be read
+ */
+static bool HashFile(const string& path, uint64_t& size, uint64_t& hash)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if(!fp)
+		return false;
+
+	size = 0;
+	hash = 0xcbf29ce484222325ULL;
+	vector<uint8_t> buf(1024*1024);
+	size_t n;
+	while( (n = fread(buf.data(), 1, buf.size(), fp)) > 0)
+	{
+		for(size_t i=0; i<n; i++)
+			hash = (hash ^ buf[i]) * 0x100000001b3ULL;
+		size += n;
+	}
+	bool ok = !ferror(fp);
+	fclose(fp);
+	return ok;
+}
@@ -0,0 +1,114 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of WaveformMetadata and the scope metadata sidecar
+ */
+#ifndef WaveformMetadata_h
+#define WaveformMetadata_h
+
+#include "Marker.h"
+
+/**
+	@brief Metadata for a single stream of a saved waveform
+ */
+class WaveformStreamMetadata
+{
+public:
+	WaveformStreamMetadata()
+	: m_channel(0)
+	, m_stream(0)
+	, m_format("sparsev1")
+	, m_timescale(0)
+	, m_triggerPhase(0)
+	{}
+
+	///@brief Index of the channel within the scope
+	int m_channel;
+
+	///@brief Stream index within the channel
+	int m_stream;
+
+	///@brief File format ("sparsev1" or "densev1")
+	std::string m_format;
+
+	///@brief Sample type for sparsev1 data ("analog", "digital", "can", or blank if unknown)
+	std::string m_datatype;
+
+	///@brief Timescale, in fs
+	int64_t m_timescale;
+
+	///@brief Trigger phase, in fs
+	int64_t m_triggerPhase;
+};
+
+/**
+	@brief Metadata for one saved waveform (one history point) from one scope
+ */
+class WaveformMetadata
+{
+public:
+	WaveformMetadata()
+	: m_time(0, 0)
+	, m_id(0)
+	, m_pinned(false)
+	{}
+
+	///@brief Timestamp of the waveform
+	TimePoint m_time;
+
+	///@brief ID of the waveform_N directory the data is stored in
+	int m_id;
+
+	///@brief True if the history point is pinned
+	bool m_pinned;
+
+	///@brief Free-form label for the history point
+	std::string m_label;
+
+	///@brief Metadata for each stream
+	std::vector<WaveformStreamMetadata> m_streams;
+};
+
+bool LoadScopeMetadata(const std::string& dataDir, int scopeID, int version, std::vector<WaveformMetadata>& waveforms);
+void ParseScopeMetadata(int version, const YAML::Node& node, std::vector<WaveformMetadata>& waveforms);
+bool ReadScopeMetadataSidecar(
+	const std::string& path,
+	const std::string& yamlPath,
+	std::vector<WaveformMetadata>& waveforms);
+bool WriteScopeMetadataSidecar(
+	const std::string& path,
+	const std::string& yamlPath,
+	const std::vector<WaveformMetadata>& waveforms);
+bool UpdateScopeMetadataSidecar(const std::string& yamlPath, const YAML::Node& node);
+void ParseSessionMarkers(const YAML::Node& node, std::vector<Marker>& markers);
+
+#endif
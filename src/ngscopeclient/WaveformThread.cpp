@@ -108,9 +108,12 @@ void WaveformThread(Session* session, atomic<bool>* shuttingDown)
 			session->RefreshAllFilters();
 			RenderAllWaveforms(cmdbuf, session, queue);
 			g_refilterDoneEvent.Signal();
+			glfwPostEmptyEvent();
 			continue;
 		}
 
+		//Partial refreshes are mostly driven by instrument polling, so don't wake an idle UI for them.
+		//It'll pick the new values up at the next polling timeout.
 		if(g_partialRefilterRequestedEvent.Peek())
 		{
 			LogTrace("WaveformThread: re-running partial filter graph and re-rendering\n");
@@ -120,19 +123,31 @@ void WaveformThread(Session* session, atomic<bool>* shuttingDown)
 			continue;
 		}
 
+		//If filters were reconfigured, re-run them once the changes settle down
+		if(session->RefreshReconfiguredFilters())
+		{
+			RenderAllWaveforms(cmdbuf, session, queue);
+			g_refilterDoneEvent.Signal();
+			glfwPostEmptyEvent();
+			continue;
+		}
+
 		//If re-rendering was requested due to a window resize etc, do that.
 		if(g_rerenderRequestedEvent.Peek())
 		{
 			LogTrace("WaveformThread: re-rendering\n");
 			RenderAllWaveforms(cmdbuf, session, queue);
 			g_rerenderDoneEvent.Signal();
+			glfwPostEmptyEvent();
 			continue;
 		}
 
-		//Wait for data to be available from all scopes
+		//Wait for data to be available from all scopes.
+		//If there's none, use the time to filter history points the user might look at next
 		if(!session->CheckForPendingWaveforms())
 		{
-			this_thread::sleep_for(chrono::milliseconds(1));
+			if(!session->PrefetchHistory())
+				this_thread::sleep_for(chrono::milliseconds(1));
 			continue;
 		}
 
@@ -143,8 +158,9 @@ void WaveformThread(Session* session, atomic<bool>* shuttingDown)
 		//Rerun the heavyweight rendering shaders
 		RenderAllWaveforms(cmdbuf, session, queue);
 
-		//Unblock the UI threads, then wait for acknowledgement that it's processed
+		//Unblock the UI threads (waking the event loop if it's idle), then wait for acknowledgement that it's processed
 		g_waveformReadyEvent.Signal();
+		glfwPostEmptyEvent();
 		g_waveformProcessedEvent.Block();
 	}
 
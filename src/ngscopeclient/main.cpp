@@ -35,6 +35,7 @@
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "ngscopeclient.h"
 #include "MainWindow.h"
+#include "BatchProcessor.h"
 #include "../scopeprotocols/scopeprotocols.h"
 #include "imgui_internal.h"
 
@@ -44,14 +45,24 @@ unique_ptr<MainWindow> g_mainWindow;
 
 GuiLogSink* g_guiLog;
 
+///@brief Time spent initializing Vulkan and the scopehal libraries at startup, in seconds
+double g_startupInitTime = 0;
+
+///@brief Time from process start until the first frame was drawn, in seconds
+double g_startupTime = 0;
+
 #ifndef _WIN32
 void Relaunch(int argc, char* argv[]);
 #endif
 
 int main(int argc, char* argv[])
 {
+	double startTime = GetTime();
+
 	//Global settings
 	Severity console_verbosity = Severity::NOTICE;
+	bool headless = false;
+	BatchOptions batch;
 
 	for(int i=1; i<argc; i++)
 	{
@@ -61,14 +72,49 @@ int main(int argc, char* argv[])
 		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
 			continue;
 
+		//Batch processing options
+		else if( (s == "--headless") || (s == "--captures") || (s == "--out") || (s == "--jobs") )
+		{
+			if(i+1 >= argc)
+			{
+				fprintf(stderr, "%s requires an argument\n", s.c_str());
+				return 1;
+			}
+
+			if(s == "--headless")
+			{
+				headless = true;
+				batch.m_sessionPath = argv[++i];
+			}
+			else if(s == "--captures")
+				batch.m_captureDir = argv[++i];
+			else if(s == "--out")
+				batch.m_outputDir = argv[++i];
+			else if(!batch.ParseJobs(argv[++i]))
+			{
+				fprintf(stderr, "Invalid job count \"%s\" (expected 0 to use all CPUs, or a thread count)\n", argv[i]);
+				return 1;
+			}
+		}
+
 		//TODO: other arguments
 
 	}
 
-	//Set up logging
-	g_guiLog = new GuiLogSink(console_verbosity);
+	//Batch options do nothing without a session to run
+	if(!headless && (!batch.m_captureDir.empty() || !batch.m_outputDir.empty() || (batch.m_jobs != 0) ) )
+	{
+		fprintf(stderr, "--captures, --out, and --jobs can only be used with --headless\n");
+		return 1;
+	}
+
+	//Set up logging (no GUI log in headless mode since there's nothing to display it)
 	g_log_sinks.push_back(make_unique<ColoredSTDLogSink>(console_verbosity));
-	g_log_sinks.push_back(unique_ptr<GuiLogSink>(g_guiLog));
+	if(!headless)
+	{
+		g_guiLog = new GuiLogSink(console_verbosity);
+		g_log_sinks.push_back(unique_ptr<GuiLogSink>(g_guiLog));
+	}
 
 	//Complain if the OpenMP wait policy isn't set right
 	const char* policy = getenv("OMP_WAIT_POLICY");
@@ -100,13 +146,30 @@ int main(int argc, char* argv[])
 		}
 	#endif
 
-	//Initialize object creation tables for predefined libraries
-	if(!VulkanInit())
+	//Initialize object creation tables for predefined libraries.
+	//Headless mode must work without a display, so don't touch GLFW at all.
+	double initStart = GetTime();
+	if(!VulkanInit(headless))
 		return 1;
 	TransportStaticInit();
 	DriverStaticInit();
 	ScopeProtocolStaticInit();
 	InitializePlugins();
+	g_startupInitTime = GetTime() - initStart;
+	LogDebug("Library initialization took %.3f sec\n", g_startupInitTime);
+
+	//Batch processing: run the session over all of the captures and exit without ever creating a window
+	if(headless)
+	{
+		bool ok;
+		{
+			BatchProcessor proc(batch);
+			ok = proc.Run();
+		}
+
+		ScopehalStaticCleanup();
+		return ok ? 0 : 1;
+	}
 
 	{
 		//Make the top level window
@@ -125,6 +188,12 @@ int main(int argc, char* argv[])
 
 			//Draw the main window
 			g_mainWindow->Render();
+
+			if(g_startupTime == 0)
+			{
+				g_startupTime = GetTime() - startTime;
+				LogDebug("Startup completed in %.3f sec\n", g_startupTime);
+			}
 		}
 
 		session.ClearBackgroundThreads();
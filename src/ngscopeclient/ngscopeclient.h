@@ -78,6 +78,9 @@ void RightJustifiedText(const std::string& str);
 
 extern std::shared_mutex g_vulkanActivityMutex;
 
+extern double g_startupInitTime;
+extern double g_startupTime;
+
 bool RectIntersect(ImVec2 posA, ImVec2 sizeA, ImVec2 posB, ImVec2 sizeB);
 bool RectContains(ImVec2 posA, ImVec2 sizeA, ImVec2 posB, ImVec2 sizeB);
 
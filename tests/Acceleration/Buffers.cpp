@@ -48,6 +48,8 @@ using namespace std;
 void FillAndVerifyBuffer(AcceleratorBuffer<int32_t>& buf, size_t len);
 void FillBuffer(AcceleratorBuffer<int32_t>& buf, size_t len);
 void VerifyBuffer(AcceleratorBuffer<int32_t>& buf, size_t len);
+double MeasureRoundTrip(AcceleratorBuffer<uint8_t>& buf);
+double MeasureGpuCopy(AcceleratorBuffer<uint8_t>& buf);
 
 TEST_CASE("Buffers_CpuOnly")
 {
@@ -295,6 +297,128 @@ TEST_CASE("Buffers_CpuGpu")
 	}
 }
 
+/**
+	@brief Throughput of CPU/GPU migration for various memory configurations
+
+	This is hidden by default since the larger sizes take a long time and need a lot of RAM.
+	Run with "Acceleration [throughput]", optionally adding -c "<configuration>" -c "<size>" to select a subset.
+ */
+TEST_CASE("Buffers_Throughput", "[.][throughput]")
+{
+	struct BufferConfig
+	{
+		const char* name;
+		AcceleratorBuffer<uint8_t>::UsageHint cpuHint;
+		AcceleratorBuffer<uint8_t>::UsageHint gpuHint;
+	};
+
+	const BufferConfig configs[] =
+	{
+		{ "Pinned",			AcceleratorBuffer<uint8_t>::HINT_LIKELY,	AcceleratorBuffer<uint8_t>::HINT_UNLIKELY },
+		{ "Mirrored",		AcceleratorBuffer<uint8_t>::HINT_LIKELY,	AcceleratorBuffer<uint8_t>::HINT_LIKELY },
+		{ "File backed",	AcceleratorBuffer<uint8_t>::HINT_UNLIKELY,	AcceleratorBuffer<uint8_t>::HINT_LIKELY },
+		{ "GPU local",		AcceleratorBuffer<uint8_t>::HINT_NEVER,		AcceleratorBuffer<uint8_t>::HINT_LIKELY }
+	};
+
+	//1 KB to 4 GB in 4x steps
+	const size_t minSize = 1024;
+	const size_t maxSize = 4LL * 1024 * 1024 * 1024;
+
+	for(auto& config : configs)
+	{
+		SECTION(config.name)
+		{
+			LogNotice("AcceleratorBuffer throughput: %s\n", config.name);
+			LogIndenter li;
+
+			for(size_t size = minSize; size <= maxSize; size *= 4)
+			{
+				auto ssize = Unit(Unit::UNIT_BYTES).PrettyPrint(size);
+				SECTION(ssize)
+				{
+					AcceleratorBuffer<uint8_t> buf;
+					buf.SetCpuAccessHint(AcceleratorBuffer<uint8_t>::HINT_LIKELY);
+					buf.SetGpuAccessHint(config.gpuHint);
+					buf.resize(size);
+
+					//Fill with something nonzero so we're not timing zero page tricks
+					buf.PrepareForCpuAccess();
+					memset(buf.GetCpuPointer(), 0x55, size);
+					buf.MarkModifiedFromCpu();
+
+					//Then move to the configuration under test
+					buf.PrepareForGpuAccess();
+					buf.SetCpuAccessHint(config.cpuHint, true);
+
+					double gbps;
+					if(config.cpuHint == AcceleratorBuffer<uint8_t>::HINT_NEVER)
+						gbps = MeasureGpuCopy(buf);
+					else
+						gbps = MeasureRoundTrip(buf);
+
+					LogNotice("%10s: %8.2f GB/s\n", ssize.c_str(), gbps);
+				}
+			}
+		}
+	}
+}
+
+/**
+	@brief Measures throughput of CPU -> GPU -> CPU round trips in GB/s
+
+	Each round trip moves the buffer contents twice (once in each direction).
+ */
+double MeasureRoundTrip(AcceleratorBuffer<uint8_t>& buf)
+{
+	size_t len = buf.size();
+
+	//Repeat until we've spent at least 100ms to smooth out timer resolution and small-buffer overhead
+	size_t iterations = 0;
+	double start = GetTime();
+	double dt = 0;
+	while( (dt < 0.1) || (iterations < 3) )
+	{
+		buf.MarkModifiedFromCpu();
+		buf.PrepareForGpuAccess();
+		buf.MarkModifiedFromGpu();
+		buf.PrepareForCpuAccess();
+
+		iterations ++;
+		dt = GetTime() - start;
+	}
+
+	//Make sure nothing got lost along the way
+	REQUIRE(buf[0] == 0x55);
+	REQUIRE(buf[len-1] == 0x55);
+
+	return (2.0 * len * iterations) / (dt * 1e9);
+}
+
+/**
+	@brief Measures throughput of copying a GPU-local buffer to another GPU-local buffer in GB/s
+ */
+double MeasureGpuCopy(AcceleratorBuffer<uint8_t>& buf)
+{
+	AcceleratorBuffer<uint8_t> dst;
+	dst.SetCpuAccessHint(AcceleratorBuffer<uint8_t>::HINT_NEVER);
+	dst.SetGpuAccessHint(AcceleratorBuffer<uint8_t>::HINT_LIKELY);
+
+	size_t iterations = 0;
+	double start = GetTime();
+	double dt = 0;
+	while( (dt < 0.1) || (iterations < 3) )
+	{
+		dst.CopyFrom(buf);
+
+		iterations ++;
+		dt = GetTime() - start;
+	}
+
+	REQUIRE(dst.size() == buf.size());
+
+	return (1.0 * buf.size() * iterations) / (dt * 1e9);
+}
+
 void FillBuffer(AcceleratorBuffer<int32_t>& buf, size_t len)
 {
 	buf.PrepareForCpuAccess();
@@ -0,0 +1,328 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Compares two sets of benchmark results and flags statistically significant regressions
+
+	Usage: BenchmarkCompare baseline.json current.json [--threshold percent] [--alpha p]
+
+	Each benchmark present in both files is compared with a two-sided Mann-Whitney U test on the raw sample times.
+	A benchmark is considered a regression if the difference is significant at the requested alpha AND the median
+	time increased by more than the threshold. Returns nonzero if any regressions were found, or if a benchmark in the
+	baseline is missing from the current results.
+ */
+
+#include "../../lib/scopehal/scopehal.h"
+
+#include <cerrno>
+
+using namespace std;
+
+/**
+	@brief Raw sample times for a single benchmark
+ */
+typedef map<string, vector<double> > BenchmarkResults;
+
+static bool LoadResults(const string& path, BenchmarkResults& results);
+static double Median(vector<double> v);
+static double MannWhitneyP(const vector<double>& a, const vector<double>& b);
+static bool ParseNumber(const char* str, double& value);
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	string baselinePath;
+	string currentPath;
+	double threshold = 5;
+	double alpha = 0.01;
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		if(s == "--help")
+		{
+			fprintf(stderr, "Usage: BenchmarkCompare baseline.json current.json [--threshold percent] [--alpha p]\n");
+			return 0;
+		}
+		else if( (s == "--threshold") && (i+1 < argc) )
+		{
+			//Zero or negative would flag every run (or none of them) as a regression
+			if(!ParseNumber(argv[++i], threshold) || (threshold <= 0) )
+			{
+				fprintf(stderr, "Invalid threshold \"%s\" (expected a positive percentage, e.g. 5)\n", argv[i]);
+				return 1;
+			}
+		}
+		else if( (s == "--alpha") && (i+1 < argc) )
+		{
+			if(!ParseNumber(argv[++i], alpha) || (alpha <= 0) || (alpha >= 1) )
+			{
+				fprintf(stderr, "Invalid alpha \"%s\" (expected a probability between 0 and 1, e.g. 0.01)\n", argv[i]);
+				return 1;
+			}
+		}
+		else if(s[0] == '-')
+		{
+			fprintf(stderr, "Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+		else if(baselinePath.empty())
+			baselinePath = s;
+		else if(currentPath.empty())
+			currentPath = s;
+		else
+		{
+			fprintf(stderr, "Too many input files, use --help\n");
+			return 1;
+		}
+	}
+
+	//Set up logging
+	g_log_sinks.emplace(g_log_sinks.begin(), new ColoredSTDLogSink(console_verbosity));
+
+	if(currentPath.empty())
+	{
+		LogError("Need both a baseline and a current result file\n");
+		return 1;
+	}
+
+	BenchmarkResults baseline;
+	BenchmarkResults current;
+	if(!LoadResults(baselinePath, baseline) || !LoadResults(currentPath, current))
+		return 1;
+
+	LogNotice("%-50s %12s %12s %9s %9s\n", "Benchmark", "Base (ms)", "New (ms)", "Delta", "p");
+
+	size_t regressions = 0;
+	size_t errors = 0;
+	for(auto& it : current)
+	{
+		auto name = it.first;
+		auto jt = baseline.find(name);
+		if(jt == baseline.end())
+		{
+			LogNotice("%-50s (new)\n", name.c_str());
+			continue;
+		}
+
+		double mbase = Median(jt->second);
+		double mcur = Median(it.second);
+
+		//Can't compute a relative change without a sensible baseline
+		if(mbase <= 0)
+		{
+			LogError("%-50s baseline has no samples or a median time of zero, can't compare\n", name.c_str());
+			errors ++;
+			continue;
+		}
+
+		double delta = 100 * (mcur - mbase) / mbase;
+		double p = MannWhitneyP(jt->second, it.second);
+
+		const char* verdict = "";
+		if(p < alpha)
+		{
+			if(delta > threshold)
+			{
+				verdict = "REGRESSION";
+				regressions ++;
+			}
+			else if(delta < -threshold)
+				verdict = "improved";
+		}
+
+		LogNotice("%-50s %12.3f %12.3f %8.1f%% %9.4f %s\n",
+			name.c_str(), mbase * 1e-6, mcur * 1e-6, delta, p, verdict);
+	}
+
+	//A benchmark that silently stopped running can't be allowed to hide a regression
+	for(auto& it : baseline)
+	{
+		if(current.find(it.first) == current.end())
+		{
+			LogError("%-50s missing from current results\n", it.first.c_str());
+			errors ++;
+		}
+	}
+
+	if(regressions)
+	{
+		LogError("%zu benchmarks regressed by more than %.1f%% (alpha = %g)\n", regressions, threshold, alpha);
+		return 1;
+	}
+	if(errors)
+	{
+		LogError("%zu benchmarks could not be compared\n", errors);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+	@brief Loads the raw sample times from a file written by "Benchmarks --json"
+
+	The file is JSON, which we read with the YAML parser since JSON is (almost) a subset of YAML.
+ */
+static bool LoadResults(const string& path, BenchmarkResults& results)
+{
+	YAML::Node node;
+	try
+	{
+		node = YAML::LoadFile(path);
+	}
+	catch(const YAML::BadFile&)
+	{
+		LogError("Unable to open file %s\n", path.c_str());
+		return false;
+	}
+	catch(const YAML::ParserException& ex)
+	{
+		LogError("Unable to parse %s: %s\n", path.c_str(), ex.what());
+		return false;
+	}
+
+	auto benchmarks = node["benchmarks"];
+	if(!benchmarks)
+	{
+		LogError("%s does not contain any benchmark results\n", path.c_str());
+		return false;
+	}
+
+	try
+	{
+		for(auto b : benchmarks)
+		{
+			auto& samples = results[b["name"].as<string>()];
+			for(auto s : b["samples_ns"])
+				samples.push_back(s.as<double>());
+		}
+	}
+	catch(const YAML::Exception& ex)
+	{
+		LogError("Malformed benchmark results in %s: %s\n", path.c_str(), ex.what());
+		return false;
+	}
+
+	return true;
+}
+
+static double Median(vector<double> v)
+{
+	if(v.empty())
+		return 0;
+
+	sort(v.begin(), v.end());
+	size_t mid = v.size() / 2;
+	if(v.size() & 1)
+		return v[mid];
+	else
+		return (v[mid-1] + v[mid]) / 2;
+}
+
+/**
+	@brief Two-sided Mann-Whitney U test, using the normal approximation with tie correction
+
+	Catch2 takes 100 samples per benchmark by default, which is plenty for the approximation to hold.
+
+	@return p-value for the hypothesis that both sets of samples come from the same distribution
+ */
+static double MannWhitneyP(const vector<double>& a, const vector<double>& b)
+{
+	size_t na = a.size();
+	size_t nb = b.size();
+	size_t n = na + nb;
+	if( (na == 0) || (nb == 0) )
+		return 1;
+
+	//Sort the combined samples, remembering which set each came from
+	vector<pair<double, bool> > all;
+	all.reserve(n);
+	for(auto v : a)
+		all.push_back(pair<double, bool>(v, true));
+	for(auto v : b)
+		all.push_back(pair<double, bool>(v, false));
+	sort(all.begin(), all.end());
+
+	//Sum the ranks of the first set, giving tied values the average of their ranks
+	double ranksum = 0;
+	double tieterm = 0;
+	for(size_t i=0; i<n; )
+	{
+		size_t j = i;
+		while( (j < n) && (all[j].first == all[i].first) )
+			j++;
+
+		double rank = (i + 1 + j) / 2.0;
+		for(size_t k=i; k<j; k++)
+		{
+			if(all[k].second)
+				ranksum += rank;
+		}
+
+		double t = j - i;
+		tieterm += t*t*t - t;
+		i = j;
+	}
+
+	double u = ranksum - na*(na+1)/2.0;
+	double mu = na*nb / 2.0;
+	double sigma = sqrt( (na*nb / 12.0) * ( (n + 1) - tieterm / (n * (n - 1.0)) ) );
+	if(sigma == 0)
+		return 1;
+
+	//Continuity correction
+	double z = (fabs(u - mu) - 0.5) / sigma;
+	if(z < 0)
+		z = 0;
+	return erfc(z / sqrt(2));
+}
+
+/**
+	@brief Parses a floating point command line argument
+
+	@return False if the argument isn't entirely a finite number
+ */
+static bool ParseNumber(const char* str, double& value)
+{
+	char* end = nullptr;
+	errno = 0;
+	value = strtod(str, &end);
+	if( (end == str) || (*end != '\0') || (errno != 0) )
+		return false;
+	return isfinite(value);
+}
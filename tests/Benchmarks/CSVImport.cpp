@@ -0,0 +1,150 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Benchmarks for importing waveforms from CSV files
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/CSVImport.h"
+
+using namespace std;
+
+TEST_CASE("Benchmark_CSVImport")
+{
+	auto rdist = uniform_real_distribution<float>(-1, 1);
+
+	SECTION("Uniform")
+	{
+		const size_t depth = 1000000;
+		const string fname = "bench_import.csv";
+
+		//One analog and one digital column, 1 ns per sample
+		vector<float> analog(depth);
+		vector<bool> digital(depth);
+		FILE* fp = fopen(fname.c_str(), "w");
+		REQUIRE(fp != nullptr);
+		fprintf(fp, "Time,Analog,Digital\n");
+		for(size_t i=0; i<depth; i++)
+		{
+			analog[i] = rdist(g_rng);
+			digital[i] = (g_rng() & 1);
+			fprintf(fp, "%.9g,%.9g,%d\n", i * 1e-9, analog[i], digital[i] ? 1 : 0);
+		}
+		fclose(fp);
+
+		vector<string> names;
+		vector<WaveformBase*> waveforms;
+		BENCHMARK("ImportCSV")
+		{
+			for(auto w : waveforms)
+				delete w;
+			return ImportCSV(fname, names, waveforms);
+		};
+
+		MockOscilloscope scope("CSV Import", "Generic", "12345");
+		BENCHMARK("MockOscilloscope::LoadCSV")
+		{
+			return scope.LoadCSV(fname);
+		};
+
+		//Sanity check the result
+		REQUIRE(ImportCSV(fname, names, waveforms));
+		REQUIRE(names.size() == 2);
+		REQUIRE(names[0] == "Analog");
+		REQUIRE(names[1] == "Digital");
+		REQUIRE(waveforms.size() == 2);
+
+		auto ua = dynamic_cast<UniformAnalogWaveform*>(waveforms[0]);
+		auto ud = dynamic_cast<UniformDigitalWaveform*>(waveforms[1]);
+		REQUIRE(ua != nullptr);
+		REQUIRE(ud != nullptr);
+		REQUIRE(ua->m_timescale == 1000000);
+		REQUIRE(ua->size() == depth);
+		REQUIRE(ud->size() == depth);
+
+		ua->PrepareForCpuAccess();
+		ud->PrepareForCpuAccess();
+		for(size_t i=0; i<depth; i++)
+		{
+			REQUIRE(fabs(ua->m_samples[i] - analog[i]) <= 1e-6);
+			REQUIRE(ud->m_samples[i] == digital[i]);
+		}
+
+		for(auto w : waveforms)
+			delete w;
+		remove(fname.c_str());
+	}
+
+	SECTION("Sparse")
+	{
+		const size_t depth = 1000;
+		const string fname = "bench_import_sparse.csv";
+
+		//Irregular timestamps, no header
+		vector<int64_t> times(depth);
+		FILE* fp = fopen(fname.c_str(), "w");
+		REQUIRE(fp != nullptr);
+		int64_t t = 0;
+		for(size_t i=0; i<depth; i++)
+		{
+			times[i] = t;
+			fprintf(fp, "%.9g,%.9g\r\n", t * 1e-12, rdist(g_rng));
+			t += 1000 + (g_rng() % 5000);
+		}
+		fclose(fp);
+
+		vector<string> names;
+		vector<WaveformBase*> waveforms;
+		REQUIRE(ImportCSV(fname, names, waveforms));
+		REQUIRE(names.size() == 1);
+		REQUIRE(waveforms.size() == 1);
+
+		auto sa = dynamic_cast<SparseAnalogWaveform*>(waveforms[0]);
+		REQUIRE(sa != nullptr);
+		REQUIRE(sa->size() == depth);
+		sa->PrepareForCpuAccess();
+		for(size_t i=0; i<depth; i++)
+		{
+			REQUIRE(sa->m_offsets[i] == times[i] * 1000);
+			if(i+1 < depth)
+				REQUIRE(sa->m_durations[i] == (times[i+1] - times[i]) * 1000);
+		}
+
+		delete waveforms[0];
+		remove(fname.c_str());
+	}
+}
@@ -0,0 +1,148 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Benchmarks for protocol analyzer display filtering
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/ProtocolDisplayFilter.h"
+
+using namespace std;
+
+/**
+	@brief Generates a set of packets resembling the output of a typical serial bus decode
+ */
+static void MakeRandomPackets(vector<Packet*>& packets, size_t count)
+{
+	const char* types[] = { "Read", "Write", "Ack", "Nak" };
+	auto rtype = uniform_int_distribution<int>(0, 3);
+	auto rbyte = uniform_int_distribution<int>(0, 255);
+	auto rlen = uniform_int_distribution<int>(1, 16);
+
+	int64_t off = 0;
+	for(size_t i=0; i<count; i++)
+	{
+		auto p = new Packet;
+		p->m_offset = off;
+		p->m_len = 1000;
+		off += 2000;
+
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), "%02x", rbyte(g_rng));
+		p->m_headers["Type"] = types[rtype(g_rng)];
+		p->m_headers["Address"] = tmp;
+		p->m_headers["Length"] = to_string(rlen(g_rng));
+
+		size_t len = rlen(g_rng);
+		for(size_t j=0; j<len; j++)
+			p->m_data.push_back(rbyte(g_rng));
+
+		packets.push_back(p);
+	}
+}
+
+TEST_CASE("Benchmark_ProtocolDisplayFilter")
+{
+	vector<string> headers = { "Type", "Address", "Length" };
+	vector<string> expressions =
+	{
+		"Type == \"Write\"",
+		"(Type == \"Write\") && (Address startswith \"1\")",
+		"(data[0] == 255) || !(Type == \"Ack\")"
+	};
+
+	//Build a history of a few waveforms with packets in each, laid out the same way PacketManager stores them
+	const size_t nwaveforms = 10;
+	const size_t npackets = 10000;
+	map<TimePoint, vector<Packet*> > history;
+	for(size_t i=0; i<nwaveforms; i++)
+		MakeRandomPackets(history[TimePoint(i, 0)], npackets);
+
+	SECTION("Parse")
+	{
+		for(auto& expr : expressions)
+		{
+			size_t i = 0;
+			ProtocolDisplayFilter filter(expr, i);
+			REQUIRE(filter.Validate(headers));
+		}
+
+		BENCHMARK("ProtocolDisplayFilter::ProtocolDisplayFilter")
+		{
+			size_t nvalid = 0;
+			for(auto& expr : expressions)
+			{
+				size_t i = 0;
+				ProtocolDisplayFilter filter(expr, i);
+				if(filter.Validate(headers))
+					nvalid ++;
+			}
+			return nvalid;
+		};
+	}
+
+	//Equivalent of PacketManager::FilterPackets() on a flat (unmerged) packet history
+	for(size_t nexpr=0; nexpr<expressions.size(); nexpr++)
+	{
+		SECTION(string("Match ") + to_string(nexpr))
+		{
+			size_t i = 0;
+			ProtocolDisplayFilter filter(expressions[nexpr], i);
+			REQUIRE(filter.Validate(headers));
+
+			BENCHMARK(string("ProtocolDisplayFilter::Match ") + to_string(nexpr))
+			{
+				map<TimePoint, vector<Packet*> > filtered;
+				for(auto& it : history)
+				{
+					for(auto p : it.second)
+					{
+						if(filter.Match(p))
+							filtered[it.first].push_back(p);
+					}
+				}
+				return filtered.size();
+			};
+		}
+	}
+
+	for(auto& it : history)
+	{
+		for(auto p : it.second)
+			delete p;
+	}
+}
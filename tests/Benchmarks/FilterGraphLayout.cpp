@@ -0,0 +1,150 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Benchmarks for automatic filter graph layout
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/FilterGraphLayout.h"
+
+using namespace std;
+
+static FilterGraphLayout MakeSyntheticLayout(size_t nnodes);
+static bool Overlaps(float ax, float ay, float aw, float ah, float bx, float by, float bw, float bh);
+
+/**
+	@brief Makes a graph shaped like a big multi-lane decode
+
+	Each lane is a chain of filters fed by one channel, with occasional taps into the neighboring lane, and every
+	fourth lane is in a group.
+ */
+static FilterGraphLayout MakeSyntheticLayout(size_t nnodes)
+{
+	const size_t lanes = 16;
+	auto rsize = uniform_real_distribution<float>(60, 200);
+	auto rtap = uniform_int_distribution<int>(0, 9);
+
+	FilterGraphLayout layout;
+	layout.m_groups.resize(lanes / 4);
+	for(auto& g : layout.m_groups)
+	{
+		g.m_padLeft = 50;
+		g.m_padRight = 50;
+		g.m_padTop = 30;
+		g.m_padBottom = 10;
+	}
+
+	size_t perLane = nnodes / lanes;
+	for(size_t lane=0; lane<lanes; lane++)
+	{
+		int group = ( (lane % 4) == 0) ? static_cast<int>(lane / 4) : -1;
+		for(size_t i=0; i<perLane; i++)
+		{
+			size_t id = layout.m_nodes.size();
+			layout.m_nodes.push_back(FilterGraphLayoutNode(rsize(g_rng), rsize(g_rng) / 2, group));
+
+			if(i > 0)
+				layout.m_edges.push_back(pair<size_t, size_t>(id - 1, id));
+			if( (lane > 0) && (i > 0) && (rtap(g_rng) == 0) )
+				layout.m_edges.push_back(pair<size_t, size_t>(id - perLane - 1, id));
+		}
+	}
+	while(layout.m_nodes.size() < nnodes)
+		layout.m_nodes.push_back(FilterGraphLayoutNode(rsize(g_rng), rsize(g_rng) / 2));
+
+	return layout;
+}
+
+static bool Overlaps(float ax, float ay, float aw, float ah, float bx, float by, float bw, float bh)
+{
+	return (ax < bx + bw) && (bx < ax + aw) && (ay < by + bh) && (by < ay + ah);
+}
+
+TEST_CASE("Benchmark_FilterGraphLayout")
+{
+	const size_t nnodes = 1000;
+	auto base = MakeSyntheticLayout(nnodes);
+
+	auto layout = base;
+	layout.Run();
+
+	//Signals flow left to right
+	for(auto e : layout.m_edges)
+	{
+		auto& src = layout.m_nodes[e.first];
+		auto& dst = layout.m_nodes[e.second];
+		if(src.m_group == dst.m_group)
+			REQUIRE(dst.m_x >= src.m_x + src.m_width);
+	}
+
+	//Nodes stay inside their groups
+	for(auto& n : layout.m_nodes)
+	{
+		if(n.m_group < 0)
+			continue;
+		auto& g = layout.m_groups[n.m_group];
+		REQUIRE(n.m_x >= g.m_x);
+		REQUIRE(n.m_y >= g.m_y);
+		REQUIRE(n.m_x + n.m_width <= g.m_x + g.m_width);
+		REQUIRE(n.m_y + n.m_height <= g.m_y + g.m_height);
+	}
+
+	//Nothing overlaps, except nodes overlapping their own group
+	for(size_t i=0; i<nnodes; i++)
+	{
+		auto& a = layout.m_nodes[i];
+		for(size_t j=i+1; j<nnodes; j++)
+		{
+			auto& b = layout.m_nodes[j];
+			REQUIRE(!Overlaps(a.m_x, a.m_y, a.m_width, a.m_height, b.m_x, b.m_y, b.m_width, b.m_height));
+		}
+		for(size_t g=0; g<layout.m_groups.size(); g++)
+		{
+			if(a.m_group == (int)g)
+				continue;
+			auto& grp = layout.m_groups[g];
+			REQUIRE(!Overlaps(a.m_x, a.m_y, a.m_width, a.m_height, grp.m_x, grp.m_y, grp.m_width, grp.m_height));
+		}
+	}
+
+	BENCHMARK("Layered layout 1000 nodes")
+	{
+		auto l = base;
+		l.Run();
+		return l.m_crossings;
+	};
+}
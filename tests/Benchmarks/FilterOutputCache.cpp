@@ -0,0 +1,361 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit tests for FilterOutputCache
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/FilterOutputCache.h"
+
+using namespace std;
+
+static UniformAnalogWaveform* MakeRandomWaveform(size_t depth);
+static void FillRandom(UniformAnalogWaveform* wfm, size_t depth);
+
+TEST_CASE("FilterOutputCache_Keys")
+{
+	auto ch1 = g_scope->GetOscilloscopeChannel(0);
+	auto ch2 = g_scope->GetOscilloscopeChannel(1);
+
+	UniformAnalogWaveform ua;
+	UniformAnalogWaveform ub;
+	FillRandom(&ua, 1000);
+	FillRandom(&ub, 1000);
+	ch1->SetData(&ua, 0);
+	ch2->SetData(&ub, 0);
+
+	auto sub = dynamic_cast<SubtractFilter*>(Filter::CreateFilter("Subtract", "#ffffff"));
+	REQUIRE(sub != nullptr);
+	sub->AddRef();
+	sub->SetInput("IN+", ch1);
+	sub->SetInput("IN-", ch2);
+
+	//Accumulating filter, plus something downstream of it
+	auto avg = Filter::CreateFilter("Average", "#ffffff");
+	REQUIRE(avg != nullptr);
+	avg->AddRef();
+	avg->SetInput(0, StreamDescriptor(sub, 0));
+
+	auto sub2 = dynamic_cast<SubtractFilter*>(Filter::CreateFilter("Subtract", "#ffffff"));
+	REQUIRE(sub2 != nullptr);
+	sub2->AddRef();
+	sub2->SetInput("IN+", StreamDescriptor(avg, 0));
+	sub2->SetInput("IN-", ch2);
+
+	vector<FlowGraphNode*> order = { ch1, ch2, sub, avg, sub2 };
+
+	SECTION("Stateful filters")
+	{
+		REQUIRE(!FilterOutputCache::IsStateful(sub));
+		REQUIRE(FilterOutputCache::IsStateful(avg));
+
+		auto hist = Filter::CreateFilter("Histogram", "#ffffff");
+		REQUIRE(hist != nullptr);
+		hist->AddRef();
+		REQUIRE(FilterOutputCache::IsStateful(hist));
+		REQUIRE(!FilterOutputCache::IsCacheable(hist));
+		hist->Release();
+
+		auto trend = Filter::CreateFilter("Trend", "#ffffff");
+		REQUIRE(trend != nullptr);
+		trend->AddRef();
+		REQUIRE(FilterOutputCache::IsStateful(trend));
+		REQUIRE(!FilterOutputCache::IsCacheable(trend));
+		trend->Release();
+	}
+
+	SECTION("Only cacheable filters get keys")
+	{
+		map<FlowGraphNode*, uint64_t> keys;
+		FilterOutputCache::GetKeys(order, keys);
+		REQUIRE(keys.size() == 1);
+		REQUIRE(keys.find(sub) != keys.end());
+		REQUIRE(keys.find(avg) == keys.end());
+		REQUIRE(keys.find(sub2) == keys.end());
+	}
+
+	SECTION("Keys track inputs")
+	{
+		map<FlowGraphNode*, uint64_t> first;
+		FilterOutputCache::GetKeys(order, first);
+
+		//Nothing changed, same key
+		map<FlowGraphNode*, uint64_t> same;
+		FilterOutputCache::GetKeys(order, same);
+		REQUIRE(same[sub] == first[sub]);
+
+		//Modified input data
+		ua.m_revision ++;
+		map<FlowGraphNode*, uint64_t> modified;
+		FilterOutputCache::GetKeys(order, modified);
+		REQUIRE(modified[sub] != first[sub]);
+
+		//Different input waveform
+		UniformAnalogWaveform uc;
+		FillRandom(&uc, 1000);
+		ch1->Detach(0);
+		ch1->SetData(&uc, 0);
+		map<FlowGraphNode*, uint64_t> swapped;
+		FilterOutputCache::GetKeys(order, swapped);
+		REQUIRE(swapped[sub] != modified[sub]);
+
+		//Inputs reversed
+		ch1->Detach(0);
+		ch1->SetData(&ua, 0);
+		sub->SetInput("IN+", ch2);
+		sub->SetInput("IN-", ch1);
+		map<FlowGraphNode*, uint64_t> reversed;
+		FilterOutputCache::GetKeys(order, reversed);
+		REQUIRE(reversed[sub] != modified[sub]);
+	}
+
+	sub2->Release();
+	avg->Release();
+	sub->Release();
+
+	ch1->Detach(0);
+	ch2->Detach(0);
+}
+
+TEST_CASE("FilterOutputCache_StashRestore")
+{
+	const size_t depth = 1000;
+	const size_t bytes = depth * sizeof(float);
+
+	auto sub = Filter::CreateFilter("Subtract", "#ffffff");
+	REQUIRE(sub != nullptr);
+	sub->AddRef();
+
+	FilterOutputCache cache;
+	cache.SetBudget(10 * bytes);
+
+	//Nothing to stash
+	REQUIRE(!cache.Stash(sub, 1));
+	REQUIRE(!cache.Contains(sub, 1));
+
+	//Stashing moves the outputs into the cache
+	auto wfm = MakeRandomWaveform(depth);
+	sub->SetData(wfm, 0);
+	REQUIRE(cache.Stash(sub, 1));
+	REQUIRE(sub->GetData(0) == nullptr);
+	REQUIRE(cache.Contains(sub, 1));
+	REQUIRE(!cache.Contains(sub, 2));
+	REQUIRE(cache.Peek(sub, 1, 0) == wfm);
+	REQUIRE(cache.GetUsage() == bytes);
+
+	//Wrong key is a miss
+	REQUIRE(!cache.Restore(sub, 2));
+	REQUIRE(sub->GetData(0) == nullptr);
+
+	//Restoring moves them back, and removes the entry
+	REQUIRE(cache.Restore(sub, 1));
+	REQUIRE(sub->GetData(0) == wfm);
+	REQUIRE(!cache.Contains(sub, 1));
+	REQUIRE(cache.GetUsage() == 0);
+	REQUIRE(cache.GetHitCount() == 1);
+	REQUIRE(!cache.Restore(sub, 1));
+
+	//Entries for filters no longer in the graph are purged
+	REQUIRE(cache.Stash(sub, 3));
+	set<FlowGraphNode*> live;
+	cache.PurgeStaleFilters(live);
+	REQUIRE(!cache.Contains(sub, 3));
+	REQUIRE(cache.GetUsage() == 0);
+
+	//Sample types we can't size would slip past the budget, so they stay with the filter
+	auto odd = new SparseWaveform<int64_t>;
+	odd->Resize(depth);
+	sub->SetData(odd, 0);
+	REQUIRE(!FilterOutputCache::IsSizeKnown(odd));
+	REQUIRE(!cache.Stash(sub, 5));
+	REQUIRE(sub->GetData(0) == odd);
+	REQUIRE(cache.GetUsage() == 0);
+	sub->SetData(nullptr, 0);
+
+	sub->Release();
+}
+
+TEST_CASE("FilterOutputCache_Eviction")
+{
+	const size_t depth = 1000;
+	const size_t bytes = depth * sizeof(float);
+
+	auto sub = Filter::CreateFilter("Subtract", "#ffffff");
+	REQUIRE(sub != nullptr);
+	sub->AddRef();
+
+	FilterOutputCache cache;
+	cache.SetBudget(2*bytes + bytes/2);
+
+	//Third entry pushes out the least recently used one
+	for(uint64_t key=1; key<=3; key++)
+	{
+		sub->SetData(MakeRandomWaveform(depth), 0);
+		REQUIRE(cache.Stash(sub, key));
+	}
+	REQUIRE(!cache.Contains(sub, 1));
+	REQUIRE(cache.Contains(sub, 2));
+	REQUIRE(cache.Contains(sub, 3));
+	REQUIRE(cache.GetUsage() == 2*bytes);
+
+	//Anything bigger than the whole budget stays with the filter
+	auto big = MakeRandomWaveform(3*depth);
+	sub->SetData(big, 0);
+	REQUIRE(!cache.Stash(sub, 4));
+	REQUIRE(sub->GetData(0) == big);
+	REQUIRE(cache.Contains(sub, 2));
+
+	//Shrinking the budget evicts down to it
+	cache.SetBudget(bytes);
+	REQUIRE(!cache.Contains(sub, 2));
+	REQUIRE(cache.Contains(sub, 3));
+	REQUIRE(cache.GetUsage() == bytes);
+
+	cache.Clear();
+	REQUIRE(cache.GetUsage() == 0);
+
+	sub->Release();
+}
+
+TEST_CASE("FilterOutputCache_CachedRun")
+{
+	const size_t depth = 100000;
+
+	shared_ptr<QueueHandle> queue(g_vkQueueManager->GetComputeQueue("FilterOutputCache_CachedRun.queue"));
+	vk::CommandPoolCreateInfo poolInfo(
+		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		queue->m_family );
+	vk::raii::CommandPool pool(*g_vkComputeDevice, poolInfo);
+
+	vk::CommandBufferAllocateInfo bufinfo(*pool, vk::CommandBufferLevel::ePrimary, 1);
+	vk::raii::CommandBuffer cmdbuf(std::move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+	auto ch1 = g_scope->GetOscilloscopeChannel(0);
+	auto ch2 = g_scope->GetOscilloscopeChannel(1);
+
+	auto sub = dynamic_cast<SubtractFilter*>(Filter::CreateFilter("Subtract", "#ffffff"));
+	REQUIRE(sub != nullptr);
+	sub->AddRef();
+	sub->SetInput("IN+", ch1);
+	sub->SetInput("IN-", ch2);
+	vector<FlowGraphNode*> order = { ch1, ch2, sub };
+
+	FilterOutputCache cache;
+	cache.SetBudget(16 * depth * sizeof(float));
+
+	//Two "history points" with different data on the first channel
+	UniformAnalogWaveform ua;
+	UniformAnalogWaveform uc;
+	UniformAnalogWaveform ub;
+	FillRandom(&ua, depth);
+	FillRandom(&uc, depth);
+	FillRandom(&ub, depth);
+	ch2->SetData(&ub, 0);
+
+	//Run on the first point, same as Session::RunFilterGraphCached() would on a miss
+	ch1->SetData(&ua, 0);
+	map<FlowGraphNode*, uint64_t> keysA;
+	FilterOutputCache::GetKeys(order, keysA);
+	sub->Refresh(cmdbuf, queue);
+	auto outA = dynamic_cast<UniformAnalogWaveform*>(sub->GetData(0));
+	REQUIRE(outA != nullptr);
+	outA->PrepareForCpuAccess();
+	vector<float> expected;
+	for(size_t i=0; i<outA->size(); i++)
+		expected.push_back(outA->m_samples[i]);
+
+	//Move to the second point: stash the first point's outputs, then miss and run
+	ch1->Detach(0);
+	ch1->SetData(&uc, 0);
+	map<FlowGraphNode*, uint64_t> keysC;
+	FilterOutputCache::GetKeys(order, keysC);
+	REQUIRE(keysC[sub] != keysA[sub]);
+	REQUIRE(!cache.Contains(sub, keysC[sub]));
+	REQUIRE(cache.Stash(sub, keysA[sub]));
+	sub->Refresh(cmdbuf, queue);
+	REQUIRE(sub->GetData(0) != nullptr);
+	REQUIRE(sub->GetData(0) != outA);
+
+	//Back to the first point: hit, so the original outputs come back without running the filter
+	ch1->Detach(0);
+	ch1->SetData(&ua, 0);
+	map<FlowGraphNode*, uint64_t> keysA2;
+	FilterOutputCache::GetKeys(order, keysA2);
+	REQUIRE(keysA2[sub] == keysA[sub]);
+	REQUIRE(cache.Stash(sub, keysC[sub]));
+	REQUIRE(cache.Restore(sub, keysA2[sub]));
+
+	auto restored = dynamic_cast<UniformAnalogWaveform*>(sub->GetData(0));
+	REQUIRE(restored == outA);
+	restored->PrepareForCpuAccess();
+	REQUIRE(restored->size() == expected.size());
+	for(size_t i=0; i<expected.size(); i++)
+		REQUIRE(restored->m_samples[i] == expected[i]);
+
+	//And the second point is still there for next time
+	REQUIRE(cache.Contains(sub, keysC[sub]));
+
+	sub->Release();
+	ch1->Detach(0);
+	ch2->Detach(0);
+}
+
+/**
+	@brief Allocates a waveform with random content
+ */
+static UniformAnalogWaveform* MakeRandomWaveform(size_t depth)
+{
+	auto wfm = new UniformAnalogWaveform;
+	FillRandom(wfm, depth);
+	return wfm;
+}
+
+/**
+	@brief Fills a waveform with random content
+ */
+static void FillRandom(UniformAnalogWaveform* wfm, size_t depth)
+{
+	auto rdist = uniform_real_distribution<float>(-1, 1);
+
+	wfm->m_timescale = 1000;
+	wfm->Resize(depth);
+	wfm->PrepareForCpuAccess();
+	for(size_t i=0; i<depth; i++)
+		wfm->m_samples[i] = rdist(g_rng);
+	wfm->MarkModifiedFromCpu();
+	wfm->m_revision ++;
+}
@@ -0,0 +1,185 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Benchmarks for filter graph node collision detection
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/NodeCollisionSolver.h"
+
+using namespace std;
+
+static vector<NodeCollisionBody> MakeSyntheticGraph(size_t nnodes, float spacing);
+static void CalculateForcesAllPairs(vector<NodeCollisionBody>& bodies);
+
+/**
+	@brief Makes a graph shaped like a big multi-lane decode: one row of nodes per lane, plus a few groups
+ */
+static vector<NodeCollisionBody> MakeSyntheticGraph(size_t nnodes, float spacing)
+{
+	const size_t lanes = 16;
+	const size_t ngroups = 4;
+	const float width = 150;
+	const float height = 80;
+	auto jitter = uniform_real_distribution<float>(-3, 3);
+
+	vector<NodeCollisionBody> bodies;
+	size_t perLane = (nnodes - ngroups) / lanes;
+	for(size_t lane=0; lane<lanes; lane++)
+	{
+		for(size_t i=0; i<perLane; i++)
+		{
+			NodeCollisionBody b;
+			b.m_x = i*spacing + jitter(g_rng);
+			b.m_y = lane*(height + 20) + jitter(g_rng);
+			b.m_width = width;
+			b.m_height = height;
+			bodies.push_back(b);
+		}
+	}
+
+	//Groups around the first few nodes of some lanes
+	for(size_t i=0; i<ngroups; i++)
+	{
+		NodeCollisionBody b;
+		b.m_x = -20;
+		b.m_y = i*4*(height + 20) - 20;
+		b.m_width = 5*spacing + 40;
+		b.m_height = 2*(height + 20) + 40;
+		b.m_isGroup = true;
+		bodies.push_back(b);
+	}
+
+	//Pad out with stragglers scattered over the graph
+	auto rx = uniform_real_distribution<float>(0, perLane*spacing);
+	auto ry = uniform_real_distribution<float>(0, lanes*(height + 20));
+	while(bodies.size() < nnodes)
+	{
+		NodeCollisionBody b;
+		b.m_x = rx(g_rng);
+		b.m_y = ry(g_rng);
+		b.m_width = width;
+		b.m_height = height;
+		bodies.push_back(b);
+	}
+
+	return bodies;
+}
+
+/**
+	@brief Reference implementation testing every pair of nodes, as FilterGraphEditor used to do
+ */
+static void CalculateForcesAllPairs(vector<NodeCollisionBody>& bodies)
+{
+	for(auto& b : bodies)
+	{
+		b.m_forceX = 0;
+		b.m_forceY = 0;
+	}
+
+	for(size_t i=0; i<bodies.size(); i++)
+	{
+		auto& a = bodies[i];
+		if(!a.m_collide)
+			continue;
+
+		for(size_t j=i+1; j<bodies.size(); j++)
+		{
+			auto& b = bodies[j];
+			if(!b.m_collide)
+				continue;
+
+			if(a.m_isGroup != b.m_isGroup)
+			{
+				auto& group = a.m_isGroup ? a : b;
+				auto& node = a.m_isGroup ? b : a;
+				if(NodeCollisionSolver::Contains(group, node) || node.m_dragging)
+					continue;
+			}
+
+			if(!NodeCollisionSolver::Intersects(a, b))
+				continue;
+
+			float dx = b.m_x - a.m_x;
+			float dy = b.m_y - a.m_y;
+			float mag = sqrt(dx*dx + dy*dy);
+			a.m_forceX -= dx / mag;
+			a.m_forceY -= dy / mag;
+			b.m_forceX += dx / mag;
+			b.m_forceY += dy / mag;
+		}
+	}
+}
+
+TEST_CASE("Benchmark_NodeCollision")
+{
+	const size_t nnodes = 1000;
+
+	//Every node overlapping its neighbors (e.g. a freshly auto-placed graph), and a spread out graph where only a few do
+	const float spacings[] = {140, 200};
+	for(auto spacing : spacings)
+	{
+		SECTION(string("Spacing ") + to_string((int)spacing))
+		{
+			auto bodies = MakeSyntheticGraph(nnodes, spacing);
+			auto expected = bodies;
+			CalculateForcesAllPairs(expected);
+
+			NodeCollisionSolver solver;
+			solver.CalculateForces(bodies);
+
+			//Should find exactly the same collisions, up to rounding from adding them in a different order
+			for(size_t i=0; i<nnodes; i++)
+			{
+				REQUIRE(fabs(bodies[i].m_forceX - expected[i].m_forceX) < 1e-3);
+				REQUIRE(fabs(bodies[i].m_forceY - expected[i].m_forceY) < 1e-3);
+			}
+
+			BENCHMARK(string("Grid broadphase ") + to_string((int)spacing))
+			{
+				solver.CalculateForces(bodies);
+				return bodies[0].m_forceX;
+			};
+
+			BENCHMARK(string("All pairs ") + to_string((int)spacing))
+			{
+				CalculateForcesAllPairs(expected);
+				return expected[0].m_forceX;
+			};
+		}
+	}
+}
@@ -0,0 +1,94 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Benchmarks for computing X axis indexes when rasterizing sparse waveforms
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/SparseIndex.h"
+
+using namespace std;
+
+TEST_CASE("Benchmark_SparseIndex")
+{
+	//Random but monotonic sample offsets, like a typical edge list or protocol decode
+	const size_t depth = 10000000;
+	auto rgap = uniform_int_distribution<int64_t>(1, 100);
+	SparseAnalogWaveform wfm;
+	wfm.Resize(depth);
+	wfm.PrepareForCpuAccess();
+	int64_t off = 0;
+	for(size_t i=0; i<depth; i++)
+	{
+		wfm.m_offsets[i] = off;
+		wfm.m_durations[i] = 1;
+		wfm.m_samples[i] = 0;
+		off += rgap(g_rng);
+	}
+	wfm.MarkModifiedFromCpu();
+
+	//Same pinned-memory configuration as DisplayedChannel::m_indexBuffer
+	AcceleratorBuffer<uint32_t> ibuf;
+	ibuf.SetCpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_LIKELY);
+	ibuf.SetGpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_UNLIKELY);
+
+	const size_t widths[] = {1920, 3840};
+	for(auto w : widths)
+	{
+		SECTION(string("Width ") + to_string(w))
+		{
+			ibuf.resize(w);
+
+			//Fully zoomed out, whole waveform visible
+			double xscale = w * 1.0 / off;
+			int64_t offset_samples = 0;
+
+			BENCHMARK(string("Sparse index ") + to_string(w))
+			{
+				CalculateSparseIndexes(ibuf, &wfm, w, xscale, offset_samples);
+				return ibuf[w-1];
+			};
+
+			//Sanity check the result (benchmarks are skipped under ctest, so calculate it once here too)
+			CalculateSparseIndexes(ibuf, &wfm, w, xscale, offset_samples);
+			ibuf.PrepareForCpuAccess();
+			REQUIRE(ibuf[0] == 0);
+			for(size_t i=1; i<w; i++)
+				REQUIRE(ibuf[i] >= ibuf[i-1]);
+		}
+	}
+}
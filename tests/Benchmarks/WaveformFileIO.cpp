@@ -0,0 +1,144 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Benchmarks for saving and loading session waveform data
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/WaveformFileIO.h"
+
+using namespace std;
+
+TEST_CASE("Benchmark_WaveformFileIO")
+{
+	const size_t depth = 1000000;
+	auto rdist = uniform_real_distribution<float>(-1, 1);
+	auto chan = g_scope->GetOscilloscopeChannel(0);
+
+	SECTION("densev1")
+	{
+		const string fname = "bench_densev1.bin";
+
+		UniformAnalogWaveform wfm;
+		wfm.m_timescale = 1000;
+		wfm.Resize(depth);
+		wfm.PrepareForCpuAccess();
+		for(size_t i=0; i<depth; i++)
+			wfm.m_samples[i] = rdist(g_rng);
+		wfm.MarkModifiedFromCpu();
+
+		BENCHMARK("SerializeUniformWaveform")
+		{
+			return SerializeUniformWaveform(&wfm, fname);
+		};
+
+		auto loaded = new UniformAnalogWaveform;
+		chan->SetData(loaded, 0);
+		BENCHMARK("LoadWaveformDataForStream densev1")
+		{
+			LoadWaveformDataForStream(chan, 0, "densev1", fname);
+		};
+
+		//Sanity check the round trip
+		//(run it once outside the benchmarks too, since they're skipped under ctest)
+		REQUIRE(SerializeUniformWaveform(&wfm, fname));
+		LoadWaveformDataForStream(chan, 0, "densev1", fname);
+		REQUIRE(loaded->size() == depth);
+		loaded->PrepareForCpuAccess();
+		for(size_t i=0; i<depth; i++)
+			REQUIRE(loaded->m_samples[i] == wfm.m_samples[i]);
+
+		chan->SetData(nullptr, 0);
+		remove(fname.c_str());
+	}
+
+	SECTION("sparsev1")
+	{
+		const string fname = "bench_sparsev1.bin";
+
+		//Gaps between samples so the loader doesn't convert it to a uniform waveform
+		SparseAnalogWaveform wfm;
+		wfm.m_timescale = 1000;
+		wfm.Resize(depth);
+		wfm.PrepareForCpuAccess();
+		for(size_t i=0; i<depth; i++)
+		{
+			wfm.m_offsets[i] = i*2;
+			wfm.m_durations[i] = 1;
+			wfm.m_samples[i] = rdist(g_rng);
+		}
+		wfm.MarkModifiedFromCpu();
+
+		BENCHMARK("SerializeSparseWaveform")
+		{
+			return SerializeSparseWaveform(&wfm, fname);
+		};
+
+		auto loaded = new SparseAnalogWaveform;
+		chan->SetData(loaded, 0);
+		BENCHMARK("LoadWaveformDataForStream sparsev1")
+		{
+			LoadWaveformDataForStream(chan, 0, "sparsev1", fname);
+		};
+
+		//Sanity check the round trip
+		//(run it once outside the benchmarks too, since they're skipped under ctest)
+		REQUIRE(SerializeSparseWaveform(&wfm, fname));
+		LoadWaveformDataForStream(chan, 0, "sparsev1", fname);
+		REQUIRE(loaded->size() == depth);
+		loaded->PrepareForCpuAccess();
+		for(size_t i=0; i<depth; i++)
+		{
+			REQUIRE(loaded->m_offsets[i] == wfm.m_offsets[i]);
+			REQUIRE(loaded->m_durations[i] == wfm.m_durations[i]);
+			REQUIRE(loaded->m_samples[i] == wfm.m_samples[i]);
+		}
+
+		chan->SetData(nullptr, 0);
+		remove(fname.c_str());
+	}
+}
+
+TEST_CASE("WaveformFileIO_LoadFailure")
+{
+	//Unreadable files must be reported as a failure, not silently loaded as an empty or garbage waveform
+	UniformAnalogWaveform dense;
+	REQUIRE(LoadWaveformData(&dense, "densev1", "nonexistent_densev1.bin") == nullptr);
+
+	SparseAnalogWaveform sparse;
+	REQUIRE(LoadWaveformData(&sparse, "sparsev1", "nonexistent_sparsev1.bin") == nullptr);
+}
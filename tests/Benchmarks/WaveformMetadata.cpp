@@ -0,0 +1,219 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Benchmarks for loading waveform metadata from YAML versus the binary sidecar
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Benchmarks.h"
+#include "../../src/ngscopeclient/WaveformMetadata.h"
+
+#include <fstream>
+#include <sys/stat.h>
+
+using namespace std;
+
+TEST_CASE("Benchmark_WaveformMetadata")
+{
+	const size_t nwaveforms = 10000;
+	const size_t nchans = 4;
+	const string ymlPath = "bench_scope_1_metadata.yml";
+	const string binPath = "bench_scope_1_metadata.bin";
+
+	//Generate metadata in the same layout Session::SerializeWaveforms() uses
+	YAML::Node node;
+	for(size_t i=0; i<nwaveforms; i++)
+	{
+		YAML::Node mnode;
+		mnode["timestamp"] = 1700000000 + i;
+		mnode["time_fsec"] = i * 12345;
+		mnode["id"] = i;
+		mnode["pinned"] = (i % 100) == 0;
+		mnode["label"] = (i % 10) ? "" : string("label ") + to_string(i);
+		for(size_t j=0; j<nchans; j++)
+		{
+			YAML::Node chnode;
+			chnode["index"] = j;
+			chnode["stream"] = 0;
+			chnode["timescale"] = 1000;
+			chnode["trigphase"] = (int64_t)(i * 7 + j);
+			chnode["flags"] = 0;
+			chnode["format"] = (j & 1) ? "sparsev1" : "densev1";
+			if(j & 1)
+				chnode["datatype"] = "digital";
+			mnode["channels"][string("ch") + to_string(j) + "s0"] = chnode;
+		}
+		node["waveforms"][string("wfm") + to_string(i)] = mnode;
+	}
+
+	ofstream outfs(ymlPath);
+	outfs << node;
+	outfs.close();
+	REQUIRE(UpdateScopeMetadataSidecar(ymlPath, node));
+
+	vector<WaveformMetadata> fromYaml;
+	BENCHMARK("ParseScopeMetadata")
+	{
+		fromYaml.clear();
+		auto docs = YAML::LoadAllFromFile(ymlPath);
+		ParseScopeMetadata(2, docs[0], fromYaml);
+		return fromYaml.size();
+	};
+
+	vector<WaveformMetadata> fromSidecar;
+	BENCHMARK("ReadScopeMetadataSidecar")
+	{
+		fromSidecar.clear();
+		return ReadScopeMetadataSidecar(binPath, ymlPath, fromSidecar);
+	};
+
+	//Both paths have to give the same answer
+	if(fromYaml.empty())
+	{
+		auto docs = YAML::LoadAllFromFile(ymlPath);
+		ParseScopeMetadata(2, docs[0], fromYaml);
+	}
+	if(fromSidecar.empty())
+		REQUIRE(ReadScopeMetadataSidecar(binPath, ymlPath, fromSidecar));
+	REQUIRE(fromYaml.size() == nwaveforms);
+	REQUIRE(fromSidecar.size() == nwaveforms);
+	for(size_t i=0; i<nwaveforms; i++)
+	{
+		auto& a = fromYaml[i];
+		auto& b = fromSidecar[i];
+		REQUIRE(a.m_time == b.m_time);
+		REQUIRE(a.m_id == b.m_id);
+		REQUIRE(a.m_pinned == b.m_pinned);
+		REQUIRE(a.m_label == b.m_label);
+		REQUIRE(a.m_streams.size() == b.m_streams.size());
+		for(size_t j=0; j<a.m_streams.size(); j++)
+		{
+			REQUIRE(a.m_streams[j].m_channel == b.m_streams[j].m_channel);
+			REQUIRE(a.m_streams[j].m_stream == b.m_streams[j].m_stream);
+			REQUIRE(a.m_streams[j].m_format == b.m_streams[j].m_format);
+			REQUIRE(a.m_streams[j].m_datatype == b.m_streams[j].m_datatype);
+			REQUIRE(a.m_streams[j].m_timescale == b.m_streams[j].m_timescale);
+			REQUIRE(a.m_streams[j].m_triggerPhase == b.m_streams[j].m_triggerPhase);
+		}
+	}
+
+	//A sidecar with an absurd waveform count must be rejected, not trusted for allocation
+	{
+		fstream fs(binPath, ios::in | ios::out | ios::binary);
+		fs.seekp(8 + 4 + 8 + 8);
+		uint64_t count = UINT64_MAX / 2;
+		fs.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	}
+	vector<WaveformMetadata> corrupt;
+	REQUIRE(!ReadScopeMetadataSidecar(binPath, ymlPath, corrupt));
+	REQUIRE(corrupt.empty());
+
+	//A sidecar generated from a different version of the YAML must be ignored, even if the size is unchanged
+	REQUIRE(UpdateScopeMetadataSidecar(ymlPath, node));
+	{
+		fstream fs(ymlPath, ios::in | ios::out | ios::binary);
+		fs.seekg(0);
+		char c = fs.get();
+		fs.seekp(0);
+		fs.put(c ^ 1);
+	}
+	vector<WaveformMetadata> stale;
+	REQUIRE(!ReadScopeMetadataSidecar(binPath, ymlPath, stale));
+	REQUIRE(stale.empty());
+}
+
+TEST_CASE("WaveformMetadata_SessionMarkers")
+{
+	const string dataDir = "markers_data";
+	mkdir(dataDir.c_str(), 0755);
+
+	//Three waveforms from one scope, with two markers on the middle one
+	YAML::Node meta;
+	for(int i=0; i<3; i++)
+	{
+		YAML::Node mnode;
+		mnode["timestamp"] = 1700000000 + i;
+		mnode["time_fsec"] = i * 1000;
+		mnode["id"] = i;
+		mnode["pinned"] = false;
+		mnode["label"] = "";
+		meta["waveforms"][string("wfm") + to_string(i)] = mnode;
+	}
+	ofstream outfs(dataDir + "/scope_1_metadata.yml");
+	outfs << meta;
+	outfs.close();
+
+	//Same layout as Session::SerializeMarkers()
+	YAML::Node session;
+	YAML::Node wfmNode;
+	wfmNode["timestamp"] = 1700000001;
+	wfmNode["time_fsec"] = 1000;
+	wfmNode["markers"]["marker0"]["offset"] = 5000;
+	wfmNode["markers"]["marker0"]["name"] = "M1";
+	wfmNode["markers"]["marker1"]["offset"] = 9000;
+	wfmNode["markers"]["marker1"]["name"] = "M2";
+	session["ui_config"]["markers"]["wfm0"] = wfmNode;
+	auto reloaded = YAML::Load(YAML::Dump(session));
+
+	vector<WaveformMetadata> waveforms;
+	REQUIRE(LoadScopeMetadata(dataDir, 1, 2, waveforms));
+	REQUIRE(waveforms.size() == 3);
+
+	vector<Marker> markers;
+	ParseSessionMarkers(reloaded["ui_config"]["markers"], markers);
+	REQUIRE(markers.size() == 2);
+	REQUIRE(markers[0].m_offset == 5000);
+	REQUIRE(markers[0].m_name == "M1");
+	REQUIRE(markers[1].m_offset == 9000);
+	REQUIRE(markers[1].m_name == "M2");
+
+	//Markers must land on the loaded waveform, not on a placeholder point of their own
+	for(auto& m : markers)
+	{
+		size_t matches = 0;
+		for(auto& w : waveforms)
+		{
+			if(w.m_time == m.m_timestamp)
+				matches ++;
+		}
+		REQUIRE(matches == 1);
+	}
+
+	//A session without markers is fine too
+	vector<Marker> none;
+	ParseSessionMarkers(YAML::Node(), none);
+	REQUIRE(none.empty());
+}
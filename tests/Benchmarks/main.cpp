@@ -0,0 +1,162 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Main code for Benchmarks
+
+	In addition to the normal Catch2 command line arguments, "--json path" may be specified to write the raw sample
+	times of every benchmark to a JSON file for regression tracking.
+ */
+
+#define CATCH_CONFIG_RUNNER
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#define EventListenerBase TestEventListenerBase
+#endif
+#include "Benchmarks.h"
+
+using namespace std;
+
+minstd_rand g_rng;
+MockOscilloscope* g_scope;
+
+///@brief Path to write benchmark results to (empty if not requested)
+static string g_jsonPath;
+
+///@brief Results of every benchmark run so far, as JSON objects
+static vector<string> g_benchmarkResults;
+
+// Global initialization
+class testRunListener : public Catch::EventListenerBase
+{
+public:
+    using Catch::EventListenerBase::EventListenerBase;
+
+    void testRunStarting(Catch::TestRunInfo const&) override
+    {
+		g_log_sinks.emplace(g_log_sinks.begin(), new ColoredSTDLogSink(Severity::VERBOSE));
+
+		if(!VulkanInit(true))
+			exit(1);
+		TransportStaticInit();
+		DriverStaticInit();
+		InitializePlugins();
+		ScopeProtocolStaticInit();
+
+		//Add search path
+		g_searchPaths.push_back(GetDirOfCurrentExecutable() + "/../../src/ngscopeclient/");
+
+		//Initialize the RNG
+		g_rng.seed(0);
+
+		//Create some fake scope channels
+		g_scope = new MockOscilloscope("Test Scope", "Antikernel Labs", "12345", "null", "mock", "");
+		g_scope->AddChannel(new OscilloscopeChannel(
+			g_scope, "CH1", "#ffffffff", Unit(Unit::UNIT_FS), Unit(Unit::UNIT_VOLTS)));
+		g_scope->AddChannel(new OscilloscopeChannel(
+			g_scope, "CH2", "#ffffffff", Unit(Unit::UNIT_FS), Unit(Unit::UNIT_VOLTS)));
+	}
+
+	void benchmarkEnded(Catch::BenchmarkStats<> const& stats) override
+	{
+		//Save raw sample times (not just the summary) so downstream tools can do proper statistics
+		string samples;
+		for(auto s : stats.samples)
+		{
+			if(!samples.empty())
+				samples += ", ";
+			samples += to_string(s.count());
+		}
+
+		char tmp[256];
+		snprintf(tmp, sizeof(tmp), "\"mean_ns\": %f, \"stddev_ns\": %f, \"iterations\": %d, ",
+			stats.mean.point.count(),
+			stats.standardDeviation.point.count(),
+			stats.info.iterations);
+
+		g_benchmarkResults.push_back(
+			string("    { \"name\": \"") + stats.info.name + "\", " + tmp + "\"samples_ns\": [ " + samples + " ] }");
+	}
+
+	//Clean up after the scope goes out of scope (pun not intended)
+	void testRunEnded([[maybe_unused]] Catch::TestRunStats const& testRunStats) override
+	{
+		delete g_scope;
+		ScopehalStaticCleanup();
+	}
+};
+CATCH_REGISTER_LISTENER(testRunListener)
+
+/**
+	@brief Writes all benchmark results to the requested JSON file
+ */
+static bool WriteBenchmarkResults()
+{
+	FILE* fp = fopen(g_jsonPath.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", g_jsonPath.c_str());
+		return false;
+	}
+
+	//Indent with spaces rather than tabs so the file is also valid YAML (for BenchmarkCompare)
+	fprintf(fp, "{\n  \"benchmarks\":\n  [\n");
+	for(size_t i=0; i<g_benchmarkResults.size(); i++)
+	{
+		fprintf(fp, "%s%s\n",
+			g_benchmarkResults[i].c_str(),
+			(i+1 < g_benchmarkResults.size()) ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+	fclose(fp);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	//Pull out our own arguments, pass everything else on to Catch
+	vector<char*> args;
+	for(int i=0; i<argc; i++)
+	{
+		if( (string(argv[i]) == "--json") && (i+1 < argc) )
+			g_jsonPath = argv[++i];
+		else
+			args.push_back(argv[i]);
+	}
+
+	int ret = Catch::Session().run(static_cast<int>(args.size()), args.data());
+
+	if(!g_jsonPath.empty() && !WriteBenchmarkResults())
+		return 1;
+	return ret;
+}
@@ -191,4 +191,56 @@ TEST_CASE("Filter_DeEmbed")
 	filter->Release();
 }
 
+TEST_CASE("Filter_DeEmbed_Scaling", "[.][scaling]")
+{
+	auto filter = dynamic_cast<DeEmbedFilter*>(Filter::CreateFilter("De-Embed", "#ffffff"));
+	REQUIRE(filter != nullptr);
+	filter->AddRef();
+
+	//Create a queue and command buffer
+	shared_ptr<QueueHandle> queue(g_vkQueueManager->GetComputeQueue("Filter_DeEmbed_Scaling.queue"));
+	vk::CommandPoolCreateInfo poolInfo(
+		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		queue->m_family );
+	vk::raii::CommandPool pool(*g_vkComputeDevice, poolInfo);
+
+	vk::CommandBufferAllocateInfo bufinfo(*pool, vk::CommandBufferLevel::ePrimary, 1);
+	vk::raii::CommandBuffer cmdbuf(std::move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+	UniformAnalogWaveform ua;
+	ua.m_timescale = 100000;		//10 Gsps
+	ua.m_triggerPhase = 0;
+	UniformAnalogWaveform umag;
+	umag.m_timescale = 1e6;			//1 MHz per point
+	umag.m_triggerPhase = 0;
+	UniformAnalogWaveform uang;
+	uang.m_timescale = 1e6;			//1 MHz per point
+	uang.m_triggerPhase = 0;
+
+	g_scope->GetOscilloscopeChannel(0)->SetData(&ua, 0);
+	g_scope->GetOscilloscopeChannel(2)->SetData(&umag, 0);
+	g_scope->GetOscilloscopeChannel(3)->SetData(&uang, 0);
+	filter->SetInput("signal", g_scope->GetOscilloscopeChannel(0));
+	filter->SetInput("mag", g_scope->GetOscilloscopeChannel(2));
+	filter->SetInput("angle", g_scope->GetOscilloscopeChannel(3));
+
+	RunScalingSweep(
+		"DeEmbed",
+		filter,
+		[&](size_t depth)
+		{
+			FillRandomWaveform(&ua, depth, -1, 1);
+			FillRandomWaveform(&umag, depth, -15, 0);
+			FillRandomWaveform(&uang, depth, -180, 180);
+		},
+		cmdbuf,
+		queue);
+
+	g_scope->GetOscilloscopeChannel(0)->Detach(0);
+	g_scope->GetOscilloscopeChannel(2)->Detach(0);
+	g_scope->GetOscilloscopeChannel(3)->Detach(0);
+
+	filter->Release();
+}
+
 #endif
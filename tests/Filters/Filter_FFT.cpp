@@ -308,4 +308,40 @@ void HammingWindow(const float* data, size_t len, float* out)
 	CosineSumWindow(data, len, out, 25.0f / 46);
 }
 
+TEST_CASE("Filter_FFT_Scaling", "[.][scaling]")
+{
+	auto filter = dynamic_cast<FFTFilter*>(Filter::CreateFilter("FFT", "#ffffff"));
+	REQUIRE(filter != nullptr);
+	filter->AddRef();
+
+	//Create a queue and command buffer
+	shared_ptr<QueueHandle> queue(g_vkQueueManager->GetComputeQueue("Filter_FFT_Scaling.queue"));
+	vk::CommandPoolCreateInfo poolInfo(
+		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		queue->m_family );
+	vk::raii::CommandPool pool(*g_vkComputeDevice, poolInfo);
+
+	vk::CommandBufferAllocateInfo bufinfo(*pool, vk::CommandBufferLevel::ePrimary, 1);
+	vk::raii::CommandBuffer cmdbuf(std::move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+	UniformAnalogWaveform ua;
+	ua.m_timescale = 10000;		//100 Gsps
+	ua.m_triggerPhase = 0;
+
+	g_scope->GetOscilloscopeChannel(0)->SetData(&ua, 0);
+	filter->SetInput("din", g_scope->GetOscilloscopeChannel(0));
+	filter->SetWindowFunction(FFTFilter::WINDOW_BLACKMAN_HARRIS);
+
+	RunScalingSweep(
+		"FFT",
+		filter,
+		[&](size_t depth) { FillRandomWaveform(&ua, depth); },
+		cmdbuf,
+		queue);
+
+	g_scope->GetOscilloscopeChannel(0)->Detach(0);
+
+	filter->Release();
+}
+
 #endif
@@ -185,3 +185,40 @@ TEST_CASE("Filter_FIR")
 
 	filter->Release();
 }
+
+TEST_CASE("Filter_FIR_Scaling", "[.][scaling]")
+{
+	auto filter = dynamic_cast<FIRFilter*>(Filter::CreateFilter("FIR Filter", "#ffffff"));
+	REQUIRE(filter != nullptr);
+	filter->AddRef();
+
+	//Create a queue and command buffer
+	shared_ptr<QueueHandle> queue(g_vkQueueManager->GetComputeQueue("Filter_FIR_Scaling.queue"));
+	vk::CommandPoolCreateInfo poolInfo(
+		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		queue->m_family );
+	vk::raii::CommandPool pool(*g_vkComputeDevice, poolInfo);
+
+	vk::CommandBufferAllocateInfo bufinfo(*pool, vk::CommandBufferLevel::ePrimary, 1);
+	vk::raii::CommandBuffer cmdbuf(std::move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+	UniformAnalogWaveform ua;
+	ua.m_timescale = 100000;		//10 Gsps
+	ua.m_triggerPhase = 0;
+
+	g_scope->GetOscilloscopeChannel(0)->SetData(&ua, 0);
+	filter->SetInput("in", g_scope->GetOscilloscopeChannel(0));
+	filter->SetFilterType(FIRFilter::FILTER_TYPE_LOWPASS);
+	filter->SetFreqHigh(500e6);
+
+	RunScalingSweep(
+		"FIR",
+		filter,
+		[&](size_t depth) { FillRandomWaveform(&ua, depth); },
+		cmdbuf,
+		queue);
+
+	g_scope->GetOscilloscopeChannel(0)->Detach(0);
+
+	filter->Release();
+}
@@ -117,3 +117,38 @@ TEST_CASE("Filter_Upsample")
 
 	filter->Release();
 }
+
+TEST_CASE("Filter_Upsample_Scaling", "[.][scaling]")
+{
+	auto filter = dynamic_cast<UpsampleFilter*>(Filter::CreateFilter("Upsample", "#ffffff"));
+	REQUIRE(filter != nullptr);
+	filter->AddRef();
+
+	//Create a queue and command buffer
+	shared_ptr<QueueHandle> queue(g_vkQueueManager->GetComputeQueue("Filter_Upsample_Scaling.queue"));
+	vk::CommandPoolCreateInfo poolInfo(
+		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		queue->m_family );
+	vk::raii::CommandPool pool(*g_vkComputeDevice, poolInfo);
+
+	vk::CommandBufferAllocateInfo bufinfo(*pool, vk::CommandBufferLevel::ePrimary, 1);
+	vk::raii::CommandBuffer cmdbuf(std::move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+	UniformAnalogWaveform ua;
+
+	g_scope->GetOscilloscopeChannel(0)->SetData(&ua, 0);
+	filter->SetInput("din", g_scope->GetOscilloscopeChannel(0));
+
+	//Output is 10x the input depth, so don't go all the way up
+	RunScalingSweep(
+		"Upsample",
+		filter,
+		[&](size_t depth) { FillRandomWaveform(&ua, depth); },
+		cmdbuf,
+		queue,
+		16 * 1024 * 1024);
+
+	g_scope->GetOscilloscopeChannel(0)->Detach(0);
+
+	filter->Release();
+}
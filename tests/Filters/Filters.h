@@ -34,6 +34,7 @@
 #include "../../lib/scopeprotocols/scopeprotocols.h"
 #include "MockOscilloscope.h"
 #include <random>
+#include <functional>
 
 extern MockOscilloscope* g_scope;
 extern std::minstd_rand g_rng;
@@ -41,4 +42,12 @@ extern std::minstd_rand g_rng;
 void FillRandomWaveform(UniformAnalogWaveform* wfm, size_t size, float fmin=-1, float fmax=1);
 void VerifyMatchingResult(AcceleratorBuffer<float>& golden, AcceleratorBuffer<float>& observed, float tolerance = 1e-6f);
 
+void RunScalingSweep(
+	const std::string& name,
+	Filter* filter,
+	std::function<void(size_t)> fill,
+	vk::raii::CommandBuffer& cmdbuf,
+	std::shared_ptr<QueueHandle> queue,
+	size_t maxDepth = 256 * 1024 * 1024);
+
 #endif
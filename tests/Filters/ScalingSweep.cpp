@@ -0,0 +1,194 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2024 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Depth and thread count sweeps comparing CPU and GPU implementations of a filter
+ */
+
+#include "Filters.h"
+#include <omp.h>
+#include <cfloat>
+
+using namespace std;
+
+static double TimeRefresh(Filter* filter, vk::raii::CommandBuffer& cmdbuf, shared_ptr<QueueHandle> queue);
+
+/**
+	@brief Runs a filter over a range of input depths and thread counts and reports throughput of each path
+
+	For every depth from 1K to maxDepth points (in 4x steps), the CPU implementation is timed at 1, 2, 4... threads
+	up to the OpenMP limit (and, on x86, once more with AVX disabled) and the GPU implementation is timed once.
+	Results are logged and also written to "<name>_scaling.csv" in the current directory for plotting.
+
+	Depths where the best CPU result beats the GPU are flagged, and the smallest depth above which the GPU always wins
+	is reported since that's the threshold Refresh() should use to pick an implementation.
+
+	@param name		Name of the filter, used for log messages and the output file
+	@param filter	The filter to test, with inputs already connected
+	@param fill		Callback which resizes and fills all of the filter's inputs to a given number of points
+	@param cmdbuf	Command buffer for the filter to use
+	@param queue	Queue for the filter to use
+	@param maxDepth	Largest input depth to test
+ */
+void RunScalingSweep(
+	const string& name,
+	Filter* filter,
+	std::function<void(size_t)> fill,
+	vk::raii::CommandBuffer& cmdbuf,
+	shared_ptr<QueueHandle> queue,
+	size_t maxDepth)
+{
+	LogNotice("Scaling sweep for %s\n", name.c_str());
+	LogIndenter li;
+
+	string fname = name + "_scaling.csv";
+	FILE* fp = fopen(fname.c_str(), "w");
+	if(fp)
+		fprintf(fp, "depth,path,threads,ms,msps\n");
+	else
+		LogWarning("Couldn't open %s, results will only be logged\n", fname.c_str());
+
+	#ifdef __x86_64__
+		bool reallyHasAvx2 = g_hasAvx2;
+		bool reallyHasAvx512F = g_hasAvx512F;
+	#endif
+	bool reallyGpuEnabled = g_gpuFilterEnabled;
+
+	int maxThreads = omp_get_max_threads();
+	size_t crossover = 0;
+	size_t gpuWins = 0;
+	size_t cpuWins = 0;
+	size_t largestDepth = 0;
+
+	for(size_t depth = 1024; depth <= maxDepth; depth *= 4)
+	{
+		fill(depth);
+
+		string sdepth = Unit(Unit::UNIT_SAMPLEDEPTH).PrettyPrint(depth);
+		LogNotice("%s points\n", sdepth.c_str());
+		LogIndenter li2;
+
+		//CPU at increasing thread counts
+		g_gpuFilterEnabled = false;
+		double bestCpu = FLT_MAX;
+		for(int threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			omp_set_num_threads(threads);
+			double dt = TimeRefresh(filter, cmdbuf, queue);
+			bestCpu = min(bestCpu, dt);
+
+			LogNotice("CPU (%2d threads)  : %10.3f ms, %8.2f MS/s\n", threads, dt * 1e3, depth * 1e-6 / dt);
+			if(fp)
+				fprintf(fp, "%zu,cpu,%d,%f,%f\n", depth, threads, dt * 1e3, depth * 1e-6 / dt);
+		}
+		omp_set_num_threads(maxThreads);
+
+		//CPU without any vector extensions, to see how much AVX is buying us
+		#ifdef __x86_64__
+			if(reallyHasAvx2 || reallyHasAvx512F)
+			{
+				g_hasAvx2 = false;
+				g_hasAvx512F = false;
+				double dt = TimeRefresh(filter, cmdbuf, queue);
+				g_hasAvx2 = reallyHasAvx2;
+				g_hasAvx512F = reallyHasAvx512F;
+
+				LogNotice("CPU (no AVX)      : %10.3f ms, %8.2f MS/s\n", dt * 1e3, depth * 1e-6 / dt);
+				if(fp)
+					fprintf(fp, "%zu,cpu_noavx,%d,%f,%f\n", depth, maxThreads, dt * 1e3, depth * 1e-6 / dt);
+			}
+		#endif
+
+		//GPU
+		g_gpuFilterEnabled = true;
+		double gpu = TimeRefresh(filter, cmdbuf, queue);
+		bool gpuLost = gpu > bestCpu;
+		LogNotice("GPU               : %10.3f ms, %8.2f MS/s%s\n",
+			gpu * 1e3,
+			depth * 1e-6 / gpu,
+			gpuLost ? "   <-- slower than CPU" : "");
+		if(fp)
+			fprintf(fp, "%zu,gpu,0,%f,%f\n", depth, gpu * 1e3, depth * 1e-6 / gpu);
+
+		//Track the point above which the GPU always wins
+		largestDepth = depth;
+		if(gpuLost)
+		{
+			crossover = 0;
+			cpuWins ++;
+		}
+		else
+		{
+			if(crossover == 0)
+				crossover = depth;
+			gpuWins ++;
+		}
+	}
+
+	g_gpuFilterEnabled = reallyGpuEnabled;
+
+	Unit depthUnit(Unit::UNIT_SAMPLEDEPTH);
+	if(gpuWins == 0)
+		LogNotice("%s: CPU was faster at every depth tested\n", name.c_str());
+	else if(cpuWins == 0)
+		LogNotice("%s: GPU was faster at every depth tested\n", name.c_str());
+	else if(crossover == 0)
+	{
+		LogNotice("%s: GPU was faster at %zu of %zu depths, but not at the largest (%s points)\n",
+			name.c_str(), gpuWins, gpuWins + cpuWins, depthUnit.PrettyPrint(largestDepth).c_str());
+	}
+	else
+	{
+		LogNotice("%s: GPU is faster at %s points and above\n",
+			name.c_str(), depthUnit.PrettyPrint(crossover).c_str());
+	}
+
+	if(fp)
+		fclose(fp);
+}
+
+/**
+	@brief Returns the best of several runs of a filter, in seconds, after a warmup run
+ */
+static double TimeRefresh(Filter* filter, vk::raii::CommandBuffer& cmdbuf, shared_ptr<QueueHandle> queue)
+{
+	//Make sure caches are hot and buffers are allocated etc
+	filter->Refresh(cmdbuf, queue);
+
+	double best = FLT_MAX;
+	for(int i=0; i<3; i++)
+	{
+		double start = GetTime();
+		filter->Refresh(cmdbuf, queue);
+		best = min(best, GetTime() - start);
+	}
+	return best;
+}